@@ -1,7 +1,9 @@
 #include "pch.h"
 #include "assets/assets.h"
+#include "logic/buildmanifest.h"
 #include "logic/buildsettings.h"
 #include "logic/pakfile.h"
+#include "logic/pakloadsim.h"
 #include "logic/streamfile.h"
 #include "logic/streamcache.h"
 #include "utils/zstdutils.h"
@@ -13,6 +15,11 @@
 #define REPAK_STR_TO_UIMG_HASH_COMMAND "-uimghash"
 #define REPAK_COMPRESS_PAK_COMMAND "-compress"
 #define REPAK_DECOMPRESS_PAK_COMMAND "-decompress"
+#define REPAK_SIMULATE_LOAD_COMMAND "-loadsim"
+#define REPAK_COMPILE_MAP_COMMAND "-compilemap"
+
+// Environment variable selecting the file IO backend, see BinaryIO::Backend_e.
+#define REPAK_IO_BACKEND_ENV_VAR "REPAK_IO_BACKEND"
 
 static void RePak_InitBuilder(const js::Document& doc, const char* const mapPath, CBuildSettings& settings, CStreamFileBuilder& streamBuilder)
 {
@@ -42,7 +49,7 @@ static void RePak_ParseListedDocument(js::Document& doc, const char* const docPa
     JSON_ParseFromFile(finalName.c_str(), "listed build map", doc, true);
 }
 
-static void RePak_BuildSingle(const js::Document& doc, const char* const mapPath)
+static void RePak_BuildSingle(const js::Document& doc, const char* const mapPath, const CBuildManifest* const manifest)
 {
     CBuildSettings settings;
     CStreamFileBuilder streamBuilder(&settings);
@@ -50,12 +57,12 @@ static void RePak_BuildSingle(const js::Document& doc, const char* const mapPath
     RePak_InitBuilder(doc, mapPath, settings, streamBuilder);
 
     CPakFileBuilder pakFile(&settings, &streamBuilder);
-    pakFile.BuildFromMap(doc);
+    pakFile.BuildFromMap(doc, manifest);
 
     RePak_ShutdownBuilder(settings, streamBuilder);
 }
 
-static void RePak_BuildFromList(const js::Document& doc, const js::Value& list, const char* const mapPath)
+static void RePak_BuildFromList(const js::Document& doc, const js::Value& list, const char* const mapPath, const CBuildManifest* const manifest)
 {
     if (!list.IsArray())
     {
@@ -81,10 +88,23 @@ static void RePak_BuildFromList(const js::Document& doc, const js::Value& list,
         }
 
         js::Document pakDoc;
-        RePak_ParseListedDocument(pakDoc, settings.GetBuildMapPath(), pak.GetString());
+
+        // Listed maps follow the main map in the manifest.
+        const uint32_t mapIndex = static_cast<uint32_t>(i + 1);
+
+        if (manifest)
+        {
+            if (mapIndex >= manifest->GetMapCount())
+                Error("Pak #%zd in build list is missing from the build manifest.\n", i);
+
+            Log("*** loading listed build map \"%s\" from build manifest.\n", pak.GetString());
+            manifest->LoadDocument(mapIndex, pakDoc);
+        }
+        else
+            RePak_ParseListedDocument(pakDoc, settings.GetBuildMapPath(), pak.GetString());
 
         CPakFileBuilder pakFile(&settings, &streamBuilder);
-        pakFile.BuildFromMap(pakDoc);
+        pakFile.BuildFromMap(pakDoc, manifest, mapIndex);
     }
 
     RePak_ShutdownBuilder(settings, streamBuilder);
@@ -108,14 +128,26 @@ static void RePak_HandleBuildFromPath(const char* const inputPath)
         // load and parse map file, this file is essentially the
         // control file; deciding what is getting packed, etc..
         js::Document doc;
-        JSON_ParseFromFile(inputPath, "main build map", doc, true);
+
+        // Compiled build maps are used as is, relative paths in these are
+        // resolved against the map they were compiled from.
+        CBuildManifest manifest;
+        const bool isManifest = manifest.Load(inputPath);
+
+        const char* const mapPath = isManifest ? manifest.GetMapPath() : inputPath;
+        const CBuildManifest* const compiledMap = isManifest ? &manifest : nullptr;
+
+        if (isManifest)
+            manifest.LoadDocument(0, doc);
+        else
+            JSON_ParseFromFile(inputPath, "main build map", doc, true);
 
         js::Value::ConstMemberIterator paksIt;
 
         if (JSON_GetIterator(doc, "paks", paksIt))
-            RePak_BuildFromList(doc, paksIt->value, inputPath);
+            RePak_BuildFromList(doc, paksIt->value, mapPath, compiledMap);
         else
-            RePak_BuildSingle(doc, inputPath);
+            RePak_BuildSingle(doc, mapPath, compiledMap);
     }
 }
 
@@ -141,7 +173,19 @@ static void RePak_ExplainUsage()
         "\t<%s>\t- ( optional ) the number of compression workers [ %d, %d ]; default = %d\n"
 
         "For decompressing standalone paks, run 'repak %s' with the following parameter:\n"
-        "\t<%s>\t- the target pak file to decompress\n",
+        "\t<%s>\t- the target pak file to decompress\n"
+
+        "For simulating the runtime load of standalone paks, run 'repak %s' with the following parameters:\n"
+        "\t<%s>\t- the target pak file to simulate, must not be compressed\n"
+        "\t<%s>\t- ( optional ) the number of pages arriving per tick; default = %d\n"
+
+        "For compiling build maps into a manifest that can be built from instead, run 'repak %s' with the following parameters:\n"
+        "\t<%s>\t- path to the map file to compile, including the maps it lists\n"
+        "\t<%s>\t- ( optional ) path to the manifest file; default = map file with the '%s' extension\n"
+
+        "For selecting the file IO backend, set the environment variable '%s' to one of:\n"
+        "\t<%s>\t- buffered standard streams; default\n"
+        "\t<%s>\t- native file handles with buffered writes and mapped reads\n",
 
         "buildMapPath",
         "streamingPath",
@@ -157,7 +201,17 @@ static void RePak_ExplainUsage()
         1, ZSTDMT_NBWORKERS_MAX, REPAK_DEFAULT_COMPRESS_WORKERS,
 
         REPAK_DECOMPRESS_PAK_COMMAND,
-        "pakFilePath"
+        "pakFilePath",
+
+        REPAK_SIMULATE_LOAD_COMMAND,
+        "pakFilePath", "pagesPerTick", PAK_LOADSIM_DEFAULT_PAGES_PER_TICK,
+
+        REPAK_COMPILE_MAP_COMMAND,
+        "buildMapPath", "manifestPath", BUILD_MANIFEST_FILE_EXTENSION,
+
+        REPAK_IO_BACKEND_ENV_VAR,
+        BinaryIO::BackendToString(BinaryIO::Backend_e::Stream),
+        BinaryIO::BackendToString(BinaryIO::Backend_e::Native)
     );
 }
 
@@ -293,6 +347,32 @@ static void RePak_HandleDecompressPak(const char* const pakPath)
     bio.Write(tempHdrBuf, headerSize);
 }
 
+static void RePak_InitIOBackend()
+{
+    char backendName[32];
+    const DWORD nameLen = GetEnvironmentVariableA(REPAK_IO_BACKEND_ENV_VAR, backendName, sizeof(backendName));
+
+    // Not set, or too long to be valid in which case the size is returned.
+    if (!nameLen || nameLen >= sizeof(backendName))
+    {
+        if (nameLen)
+            Warning("%s: value of \"%s\" is too long; using default backend.\n", __FUNCTION__, REPAK_IO_BACKEND_ENV_VAR);
+
+        return;
+    }
+
+    BinaryIO::Backend_e backend;
+
+    if (!BinaryIO::StringToBackend(backendName, backend))
+    {
+        Warning("%s: unknown IO backend \"%s\"; using default backend.\n", __FUNCTION__, backendName);
+        return;
+    }
+
+    BinaryIO::SetDefaultBackend(backend);
+    Debug("Using \"%s\" IO backend.\n", BinaryIO::BackendToString(backend));
+}
+
 static void RePak_HandleCommandLine(const int argc, char** argv)
 {
     if (argc < 2)
@@ -339,6 +419,29 @@ static void RePak_HandleCommandLine(const int argc, char** argv)
         return;
     }
 
+    if (RePak_CheckCommandLine(argv[1], REPAK_SIMULATE_LOAD_COMMAND, argc, 3))
+    {
+        int pagesPerTick = PAK_LOADSIM_DEFAULT_PAGES_PER_TICK;
+
+        if ((argc > 3) && (!JSON_StringToNumber(argv[3], strlen(argv[3]), pagesPerTick)))
+            Error("%s: failed to parse pagesPerTick for argument \"%s\".\n", __FUNCTION__, argv[1]);
+
+        CPakLoadSimulator simulator;
+
+        simulator.Load(argv[2]);
+        simulator.Run(pagesPerTick);
+
+        return;
+    }
+
+    if (RePak_CheckCommandLine(argv[1], REPAK_COMPILE_MAP_COMMAND, argc, 3))
+    {
+        const std::string manifestPath = argc > 3 ? argv[3] : Utils::ChangeExtension(argv[2], BUILD_MANIFEST_FILE_EXTENSION);
+        CBuildManifest::Compile(argv[2], manifestPath.c_str());
+
+        return;
+    }
+
     RePak_HandleBuildFromPath(argv[1]);
 }
 
@@ -348,6 +451,7 @@ int main(int argc, char** argv)
     Console_ColorInit();
 
     g_jsonErrorCallback = Error;
+    RePak_InitIOBackend();
 
     RePak_HandleCommandLine(argc, argv);
     return EXIT_SUCCESS;
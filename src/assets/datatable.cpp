@@ -1,15 +1,80 @@
 #include "pch.h"
 #include "assets.h"
 #include "public/datatable.h"
+#include "utils/csvdocument.h"
+#include "utils/mappedfile.h"
+#include "utils/stringpool.h"
+#include "utils/MurmurHash3.h"
+#include <charconv>
 
-static inline size_t DataTable_CalcColumnNameBufSize(const rapidcsv::Document& doc)
+#define DATATABLE_CACHE_FILE_MAGIC ('D'+('T'<<8)+('B'<<16)+('C'<<24))
+#define DATATABLE_CACHE_FILE_VERSION 2
+#define DATATABLE_CACHE_FILE_EXTENSION ".dtblc"
+
+#define DATATABLE_CACHE_HASH_SEED 0x165DCA75
+
+// Values of a single column, parsed from all data rows in one pass. String
+// values are interned, identical strings in the table are stored once.
+struct DataTableColumn_s
+{
+    dtblcoltype_t type;
+    std::vector<char> podValues; // DataTable_GetValueSize(type) bytes per row.
+    std::vector<size_t> stringOffsets; // Offset in the string pool per row.
+};
+
+// Header of a cached datatable, followed by the pointers, the guid ref offsets
+// and the data lump. Cache files are named after the hash of the asset path,
+// the csv and the datatable version; the latter two are checked again as the
+// name could collide.
+struct DataTableCacheHeader_s
+{
+    int magic;
+    unsigned short version;
+    unsigned short tableVersion;
+
+    uint64_t csvHash[2];
+    uint64_t csvSize;
+
+    uint32_t numColumns;
+    uint32_t numRows;
+    uint32_t rowStride;
+
+    uint32_t pointerCount;
+    uint32_t guidRefCount;
+    uint32_t rowPodValuesBase;
+
+    uint64_t dataSize;
+
+    // Interning statistics of the string values, reported on a hit.
+    StringPoolStats_s stringStats;
+};
+
+// Pointer within the data lump, registered in the order it was added.
+struct DataTableCachePointer_s
+{
+    uint32_t pointerOffset;
+    uint32_t targetOffset;
+};
+
+// Everything that is added to the pak besides the lump data, recorded while
+// the datatable is built so it can be replayed on a cache hit.
+struct DataTableCacheRecord_s
+{
+    std::vector<DataTableCachePointer_s> pointers;
+    std::vector<uint32_t> guidRefOffsets;
+};
+
+static size_t s_dataTableCacheHits = 0;
+static size_t s_dataTableCacheMisses = 0;
+
+static inline size_t DataTable_CalcColumnNameBufSize(const CCsvDocument& doc)
 {
     size_t colNameBufSize = 0;
 
     // get required size to store all of the column names in a single buffer
-    for (const std::string& it : doc.GetColumnNames())
+    for (size_t i = 0; i < doc.GetColumnCount(0); ++i)
     {
-        colNameBufSize += it.length() + 1;
+        colNameBufSize += doc.GetCell(0, i).length() + 1;
     }
 
     return colNameBufSize;
@@ -20,12 +85,255 @@ static void DataTable_ReportInvalidDataTypeError(const char* const type, const u
     Error("Invalid data type \"%s\" at cell [%u,%u].\n", type, rowIdx, colIdx);
 }
 
+static void DataTable_ReportInvalidValueError(const dtblcoltype_t type, const uint32_t rowIdx, const uint32_t colIdx)
+{
+    Error("Invalid %s value at cell [%u,%u].\n", DataTable_GetStringFromType(type), rowIdx, colIdx);
+}
+
+static void DataTable_ReportParseError(const dtblcoltype_t type, const uint32_t rowIdx, const uint32_t colIdx, const char* const reason)
+{
+    Error("Exception while parsing %s value from cell [%u,%u]: %s.\n", DataTable_GetStringFromType(type), rowIdx, colIdx, reason);
+}
+
+static inline bool DataTable_IsSpace(const char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Parses the leading integer of the string the way std::stoul does; leading
+// whitespace and a sign are accepted, trailing characters are ignored.
+// Returns the reason on failure, or nullptr on success.
+static const char* DataTable_ParseInt(const std::string_view& str, uint32_t& out)
+{
+    size_t i = 0;
+
+    while (i < str.size() && DataTable_IsSpace(str[i]))
+        i++;
+
+    bool negative = false;
+
+    if (i < str.size() && (str[i] == '-' || str[i] == '+'))
+        negative = str[i++] == '-';
+
+    if (i == str.size() || str[i] < '0' || str[i] > '9')
+        return "invalid stoul argument";
+
+    uint64_t value = 0;
+
+    for (; i < str.size() && str[i] >= '0' && str[i] <= '9'; i++)
+    {
+        value = (value * 10) + (str[i] - '0');
+
+        if (value > UINT32_MAX)
+            return "stoul argument out of range";
+    }
+
+    // Negative values wrap around, as they do with std::stoul.
+    out = negative ? static_cast<uint32_t>(0 - value) : static_cast<uint32_t>(value);
+    return nullptr;
+}
+
+// Parses the leading float of the string the way std::strtod does. Returns
+// the number of characters consumed, or 0 if there is no number.
+template <typename T>
+static size_t DataTable_ParseFloat(const std::string_view& str, T& out, bool& outOfRange)
+{
+    size_t i = 0;
+
+    while (i < str.size() && DataTable_IsSpace(str[i]))
+        i++;
+
+    // std::from_chars doesn't take a plus sign or the hex prefix.
+    bool negative = false;
+
+    if (i < str.size() && (str[i] == '-' || str[i] == '+'))
+        negative = str[i++] == '-';
+
+    // Sign was already consumed.
+    if (i < str.size() && (str[i] == '-' || str[i] == '+'))
+        return 0;
+
+    std::chars_format format = std::chars_format::general;
+
+    if (i + 2 < str.size() && str[i] == '0' && (str[i + 1] == 'x' || str[i + 1] == 'X'))
+    {
+        format = std::chars_format::hex;
+        i += 2;
+    }
+
+    const char* const begin = str.data() + i;
+    const std::from_chars_result result = std::from_chars(begin, str.data() + str.size(), out, format);
+
+    if (result.ptr == begin || (format == std::chars_format::hex && (*begin == '-' || *begin == '+')))
+    {
+        // "0x" without hex digits after it is just a 0.
+        if (format == std::chars_format::hex)
+        {
+            out = 0;
+            return i - 1;
+        }
+
+        return 0;
+    }
+
+    outOfRange = result.ec == std::errc::result_out_of_range;
+
+    if (negative)
+        out = -out;
+
+    return result.ptr - str.data();
+}
+
+static bool DataTable_ParseBool(const std::string_view& str, uint32_t& out)
+{
+    if ((str.size() == 4 && !_strnicmp(str.data(), "true", 4)) || str == "1")
+        out = true;
+    else if ((str.size() == 5 && !_strnicmp(str.data(), "false", 5)) || str == "0")
+        out = false;
+    else
+        return false;
+
+    return true;
+}
+
+// Parses vectors in format "<x,y,z>", text around it is ignored. Like atof,
+// components that aren't numbers are 0. If there are more than 3 components,
+// the leading ones end up in x.
+static bool DataTable_ParseVector(const std::string_view& str, Vector3& out)
+{
+    const size_t open = str.find('<');
+    const size_t close = str.rfind('>');
+
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open)
+        return false;
+
+    const std::string_view inner = str.substr(open + 1, close - open - 1);
+
+    const size_t lastComma = inner.rfind(',');
+
+    if (lastComma == std::string_view::npos || lastComma == 0)
+        return false;
+
+    const size_t midComma = inner.rfind(',', lastComma - 1);
+
+    if (midComma == std::string_view::npos)
+        return false;
+
+    const std::string_view components[3] = {
+        inner.substr(0, midComma),
+        inner.substr(midComma + 1, lastComma - midComma - 1),
+        inner.substr(lastComma + 1)
+    };
+
+    float values[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        // atof parses as double.
+        double value = 0.0;
+        bool outOfRange = false;
+
+        if (!DataTable_ParseFloat(components[i], value, outOfRange))
+            value = 0.0;
+
+        values[i] = static_cast<float>(value);
+    }
+
+    out.Set(values[0], values[1], values[2]);
+    return true;
+}
+
+// parses all values of a column, and computes the buffer sizes they need
+static void DataTable_ParseColumn(const CCsvDocument& doc, const uint32_t colIdx, const uint32_t numRows, DataTableColumn_s& column,
+    datatable_asset_t& tmp, CStringPool& stringPool)
+{
+    const dtblcoltype_t type = column.type;
+
+    if (DataTable_IsStringType(type))
+    {
+        const bool isPrecachedAsset = type == dtblcoltype_t::Asset;
+        column.stringOffsets.resize(numRows);
+
+        for (uint32_t rowIdx = 0; rowIdx < numRows; ++rowIdx)
+        {
+            const std::string_view& cell = doc.GetCell(rowIdx + 1, colIdx);
+
+            // guid refs are still registered per cell, even if the string is shared.
+            if (isPrecachedAsset && !cell.empty())
+                tmp.guidRefBufSize += sizeof(PakGuid_t);
+
+            column.stringOffsets[rowIdx] = stringPool.Add(cell);
+        }
+
+        return;
+    }
+
+    const size_t valueSize = DataTable_GetValueSize(type);
+    column.podValues.resize(valueSize * numRows);
+
+    for (uint32_t rowIdx = 0; rowIdx < numRows; ++rowIdx)
+    {
+        const std::string_view& cell = doc.GetCell(rowIdx + 1, colIdx);
+        char* const value = &column.podValues[valueSize * rowIdx];
+
+        switch (type)
+        {
+        case dtblcoltype_t::Bool:
+        {
+            uint32_t val;
+
+            if (!DataTable_ParseBool(cell, val))
+                DataTable_ReportInvalidValueError(type, rowIdx, colIdx);
+
+            memcpy(value, &val, sizeof(val));
+            break;
+        }
+        case dtblcoltype_t::Int:
+        {
+            uint32_t val = 0;
+            const char* const reason = DataTable_ParseInt(cell, val);
+
+            if (reason)
+                DataTable_ReportParseError(type, rowIdx, colIdx, reason);
+
+            memcpy(value, &val, sizeof(val));
+            break;
+        }
+        case dtblcoltype_t::Float:
+        {
+            float val = 0.0f;
+            bool outOfRange = false;
+
+            if (!DataTable_ParseFloat(cell, val, outOfRange))
+                DataTable_ReportParseError(type, rowIdx, colIdx, "invalid stof argument");
+
+            if (outOfRange)
+                DataTable_ReportParseError(type, rowIdx, colIdx, "stof argument out of range");
+
+            memcpy(value, &val, sizeof(val));
+            break;
+        }
+        case dtblcoltype_t::Vector:
+        {
+            Vector3 val;
+
+            if (!DataTable_ParseVector(cell, val))
+                DataTable_ReportInvalidValueError(type, rowIdx, colIdx);
+
+            memcpy(value, &val, sizeof(val));
+            break;
+        }
+        }
+    }
+}
+
 template <typename datatable_t>
-static size_t DataTable_SetupRows(const rapidcsv::Document& doc, datatable_t* const dtblHdr, datatable_asset_t& tmp, std::vector<std::string>& outTypeRow)
+static size_t DataTable_SetupRows(const CCsvDocument& doc, datatable_t* const dtblHdr, datatable_asset_t& tmp, std::vector<DataTableColumn_s>& outColumns,
+    CStringPool& stringPool)
 {
-    // cache it so we don't have to make another deep copy.
-    outTypeRow = doc.GetRow<std::string>(dtblHdr->numRows);
-    const uint32_t numTypeNames = static_cast<uint32_t>(outTypeRow.size());
+    // the type row is the last one, after the header and the data rows.
+    const size_t typeRowIdx = dtblHdr->numRows + 1;
+    const uint32_t numTypeNames = static_cast<uint32_t>(doc.GetColumnCount(typeRowIdx));
 
     // typically happens when there's an empty line in the csv file.
     if (numTypeNames != dtblHdr->numColumns)
@@ -35,19 +343,20 @@ static size_t DataTable_SetupRows(const rapidcsv::Document& doc, datatable_t* co
     // have the same number of columns as the type row. The column count in the
     // datatable header is set to the count in the type row and therefore all
     // other rows must match this count.
-    for (uint32_t i = 0; i < doc.GetRowCount(); ++i)
+    for (uint32_t i = 0; i < doc.GetRowCount() - 1; ++i)
     {
-        const uint32_t columnCount = static_cast<uint32_t>(doc.GetColumnCount(i));
+        const uint32_t columnCount = static_cast<uint32_t>(doc.GetColumnCount(i + 1));
 
         if (columnCount != dtblHdr->numColumns)
             Error("Expected %u columns for data row #%u, found %u.\n", dtblHdr->numColumns, i, columnCount);
     }
 
+    outColumns.resize(dtblHdr->numColumns);
     size_t highestTypeAlign = 0;
 
     for (uint32_t i = 0; i < dtblHdr->numColumns; ++i)
     {
-        const std::string& typeString = outTypeRow[i];
+        const std::string typeString(doc.GetCell(typeRowIdx, i));
         const dtblcoltype_t type = DataTable_GetTypeFromString(typeString);
 
         if (type == dtblcoltype_t::INVALID)
@@ -58,56 +367,46 @@ static size_t DataTable_SetupRows(const rapidcsv::Document& doc, datatable_t* co
         if (curTypeAlign > highestTypeAlign)
             highestTypeAlign = curTypeAlign;
 
-        if (DataTable_IsStringType(type))
-        {
-            const bool isPrecachedAsset = type == dtblcoltype_t::Asset;
-
-            for (uint32_t j = 0; j < dtblHdr->numRows; ++j)
-            {
-                // this can be std::string since we only deal with the string types here
-                std::vector<std::string> row = doc.GetRow<std::string>(j);
-                const size_t strLen = row[i].length();
+        DataTableColumn_s& column = outColumns[i];
+        column.type = type;
 
-                if (isPrecachedAsset && strLen > 0)
-                    tmp.guidRefBufSize += sizeof(PakGuid_t);
-
-                tmp.rowStringValueBufSize += strLen + 1;
-            }
-        }
+        DataTable_ParseColumn(doc, i, dtblHdr->numRows, column, tmp, stringPool);
 
         tmp.rowPodValueBufSize += static_cast<size_t>(DataTable_GetValueSize(type)) * dtblHdr->numRows; // size of type * row count (excluding the type row)
     }
 
+    tmp.rowStringValueBufSize = stringPool.GetSize();
     return highestTypeAlign;
 }
 
 // fills a PakPageDataChunk_s with column data from a provided csv
 template <typename datatable_t>
 static void DataTable_SetupColumns(CPakFileBuilder* const pak, PakPageLump_s& dataChunk, const size_t columnNameBase, datatable_t* const dtblHdr,
-    datatable_asset_t& tmp, const rapidcsv::Document& doc, const std::vector<std::string>& typeRow)
+    datatable_asset_t& tmp, const CCsvDocument& doc, const std::vector<DataTableColumn_s>& columns, DataTableCacheRecord_s& record)
 {
     char* const colNameBufBase = &dataChunk.data[columnNameBase];
     char* colNameBuf = colNameBufBase;
 
     for (uint32_t i = 0; i < dtblHdr->numColumns; ++i)
     {
-        const std::string name = doc.GetColumnName(i);
-        const size_t nameBufLen = name.length() + 1;
+        const std::string_view& name = doc.GetCell(0, i);
+        const size_t nameLen = name.length();
 
         // copy the column name into the namebuf
-        memcpy(colNameBuf, name.c_str(), nameBufLen);
+        memcpy(colNameBuf, name.data(), nameLen);
+        colNameBuf[nameLen] = '\0';
 
         datacolumn_t& col = tmp.pDataColums[i];
 
         // register name pointer
-        pak->AddPointer(dataChunk, ((sizeof(datacolumn_t) * i) + offsetof(datacolumn_t, pName)), dataChunk, columnNameBase + (colNameBuf - colNameBufBase));
-        colNameBuf += nameBufLen;
+        const DataTableCachePointer_s& namePointer = record.pointers.emplace_back(DataTableCachePointer_s{
+            static_cast<uint32_t>((sizeof(datacolumn_t) * i) + offsetof(datacolumn_t, pName)),
+            static_cast<uint32_t>(columnNameBase + (colNameBuf - colNameBufBase)) });
 
-        const std::string& typeString = typeRow[i];
-        const dtblcoltype_t type = DataTable_GetTypeFromString(typeString);
+        pak->AddPointer(dataChunk, namePointer.pointerOffset, dataChunk, namePointer.targetOffset);
+        colNameBuf += nameLen + 1;
 
-        if (type == dtblcoltype_t::INVALID)
-            DataTable_ReportInvalidDataTypeError(typeString.c_str(), dtblHdr->numRows, i);
+        const dtblcoltype_t type = columns[i].type;
 
         col.rowOffset = dtblHdr->rowStride;
         col.type = type;
@@ -116,31 +415,13 @@ static void DataTable_SetupColumns(CPakFileBuilder* const pak, PakPageLump_s& da
     }
 }
 
-template <typename T>
-static T DataTable_ParseCellFromDocument(rapidcsv::Document& doc, const uint32_t colIdx, const uint32_t rowIdx, const dtblcoltype_t type)
-{
-    try {
-        return doc.GetCell<T>(colIdx, rowIdx);
-    }
-    catch (const std::exception& ex) {
-        Error("Exception while parsing %s value from cell [%u,%u]: %s.\n", DataTable_GetStringFromType(type), rowIdx, colIdx, ex.what());
-        return T{};
-    }
-}
-
-static void DataTable_ReportInvalidValueError(const dtblcoltype_t type, const uint32_t rowIdx, const uint32_t colIdx)
-{
-    Error("Invalid %s value at cell [%u,%u].\n", DataTable_GetStringFromType(type), rowIdx, colIdx);
-}
-
-// fills a PakPageDataChunk_s with row data from a provided csv
+// fills a PakPageDataChunk_s with row data from the parsed columns
 template <typename datatable_t>
 static void DataTable_SetupValues(CPakFileBuilder* const pak, PakAsset_t& asset, PakPageLump_s& dataChunk, const size_t guidRefBufBase,
-    const size_t podValueBase, const size_t stringValueBase, datatable_t* const dtblHdr, datatable_asset_t& tmp, rapidcsv::Document& doc)
+    const size_t podValueBase, const size_t stringValueBase, datatable_t* const dtblHdr, datatable_asset_t& tmp, const CCsvDocument& doc,
+    const std::vector<DataTableColumn_s>& columns, const CStringPool& stringPool, DataTableCacheRecord_s& record)
 {
-    char* const pStringBufBase = &dataChunk.data[stringValueBase];
-    char* pStringBuf = pStringBufBase;
-
+    stringPool.Write(&dataChunk.data[stringValueBase]);
     size_t curGuidRefIndex = 0;
 
     for (uint32_t rowIdx = 0; rowIdx < dtblHdr->numRows; ++rowIdx)
@@ -150,144 +431,245 @@ static void DataTable_SetupValues(CPakFileBuilder* const pak, PakAsset_t& asset,
             const datacolumn_t& col = tmp.pDataColums[colIdx];
             const size_t valueOffset = (dtblHdr->rowStride * rowIdx) + col.rowOffset;
 
-            void* const valueBufBase = &dataChunk.data[podValueBase + valueOffset];
-
-            // get rmem instance for this cell's value buffer
-            rmem valbuf(valueBufBase);
+            char* const valueBuf = &dataChunk.data[podValueBase + valueOffset];
 
-            switch (col.type)
-            {
-            case dtblcoltype_t::Bool:
+            if (!DataTable_IsStringType(col.type))
             {
-                const std::string val = DataTable_ParseCellFromDocument<std::string>(doc, colIdx, rowIdx, col.type);
+                const size_t valueSize = DataTable_GetValueSize(col.type);
+                memcpy(valueBuf, &columns[colIdx].podValues[valueSize * rowIdx], valueSize);
 
-                if (!_stricmp(val.c_str(), "true") || val == "1")
-                    valbuf.write<uint32_t>(true);
-                else if (!_stricmp(val.c_str(), "false") || val == "0")
-                    valbuf.write<uint32_t>(false);
-                else
-                    DataTable_ReportInvalidValueError(col.type, rowIdx, colIdx);
-
-                break;
+                continue;
             }
-            case dtblcoltype_t::Int:
-            {
-                const uint32_t val = DataTable_ParseCellFromDocument<uint32_t>(doc, colIdx, rowIdx, col.type);
-                valbuf.write(val);
-                break;
-            }
-            case dtblcoltype_t::Float:
-            {
-                const float val = DataTable_ParseCellFromDocument<float>(doc, colIdx, rowIdx, col.type);
-                valbuf.write(val);
-                break;
-            }
-            case dtblcoltype_t::Vector:
+
+            const std::string_view& val = doc.GetCell(rowIdx + 1, colIdx);
+
+            // dtblcoltype_t::Asset types must be precached, add guid dependency
+            // that needs to be resolved in the runtime before this asset is parsed.
+            if (!val.empty() && col.type == dtblcoltype_t::Asset)
             {
-                std::string val = DataTable_ParseCellFromDocument<std::string>(doc, colIdx, rowIdx, col.type);
-                std::smatch sm;
-
-                // get values from format "<x,y,z>"
-                const bool result = std::regex_search(val, sm, std::regex("<(.*),(.*),(.*)>"));
-
-                // 0 - all
-                // 1 - x
-                // 2 - y
-                // 3 - z
-                if (result && (sm.size() == 4))
-                {
-                    const Vector3 vec(
-                        static_cast<float>(atof(sm[1].str().c_str())),
-                        static_cast<float>(atof(sm[2].str().c_str())),
-                        static_cast<float>(atof(sm[3].str().c_str())));
-
-                    valbuf.write(vec);
-                }
-                else
-                    DataTable_ReportInvalidValueError(col.type, rowIdx, colIdx);
-                break;
+                const PakGuid_t assetGuid = RTech::StringToGuid(std::string(val).c_str());
+                const size_t guidRefOffset = guidRefBufBase + curGuidRefIndex;
+
+                *(PakGuid_t*)&dataChunk.data[guidRefOffset] = assetGuid;
+
+                if (Pak_RegisterGuidRefAtOffset(assetGuid, guidRefOffset, dataChunk, asset))
+                    record.guidRefOffsets.push_back(static_cast<uint32_t>(guidRefOffset));
+
+                curGuidRefIndex += sizeof(PakGuid_t);
             }
-            case dtblcoltype_t::String:
-            case dtblcoltype_t::Asset:
-            case dtblcoltype_t::AssetNoPrecache:
-            {
-                const std::string val = DataTable_ParseCellFromDocument<std::string>(doc, colIdx, rowIdx, col.type);
-                const size_t valBufLen = val.length()+1;
 
-                // dtblcoltype_t::Asset types must be precached, add guid dependency
-                // that needs to be resolved in the runtime before this asset is parsed.
-                if (valBufLen > 1 && col.type == dtblcoltype_t::Asset)
-                {
-                    const PakGuid_t assetGuid = RTech::StringToGuid(val.c_str());
-                    const size_t guidRefOffset = guidRefBufBase + curGuidRefIndex;
+            const size_t stringOffset = columns[colIdx].stringOffsets[rowIdx];
+            *reinterpret_cast<PagePtr_t*>(valueBuf) = dataChunk.GetPointer(stringValueBase + stringOffset);
 
-                    *(PakGuid_t*)&dataChunk.data[guidRefOffset] = assetGuid;
-                    Pak_RegisterGuidRefAtOffset(assetGuid, guidRefOffset, dataChunk, asset);
+            pak->AddPointer(dataChunk, podValueBase + valueOffset);
+            record.pointers.push_back({ static_cast<uint32_t>(podValueBase + valueOffset), static_cast<uint32_t>(stringValueBase + stringOffset) });
+        }
+    }
+}
 
-                    curGuidRefIndex += sizeof(PakGuid_t);
-                }
+// Cache files are placed next to the output directory, and are shared between
+// all paks that are built into it. The file name starts with the hash of the
+// asset path, so older entries of the same datatable can be found and evicted.
+static std::string DataTable_GetCachePath(const CPakFileBuilder* const pak, const char* const assetPath, const uint64_t(&csvHash)[2],
+    const unsigned short tableVersion)
+{
+    const fs::path outputDir = fs::path(pak->GetBuildSettings()->GetOutputPath()).parent_path();
 
-                memcpy(pStringBuf, val.c_str(), valBufLen);
-                valbuf.write(dataChunk.GetPointer(stringValueBase + (pStringBuf - pStringBufBase)));
+    uint64_t pathHash[2];
+    MurmurHash3_x64_128(assetPath, strlen(assetPath), DATATABLE_CACHE_HASH_SEED, pathHash);
 
-                pak->AddPointer(dataChunk, podValueBase + valueOffset);
-                pStringBuf += valBufLen;
+    char fileName[96];
+    snprintf(fileName, sizeof(fileName), "%016llx_%016llx%016llx_v%hu" DATATABLE_CACHE_FILE_EXTENSION, pathHash[0], csvHash[1], csvHash[0], tableVersion);
 
-                break;
-            }
-            }
+    return (outputDir.parent_path() / (outputDir.filename().string() + "_cache") / "datatables" / fileName).string();
+}
+
+// Removes the cache files of the same datatable and version that were built
+// from a different csv, as these won't be used again until the csv reverts.
+static void DataTable_EvictStaleCacheFiles(const std::string& cachePath)
+{
+    const fs::path path(cachePath);
+    const std::string fileName = path.filename().string();
+
+    // The asset path hash up to and including its separator, and the version
+    // with the extension.
+    const std::string prefix = fileName.substr(0, fileName.find('_') + 1);
+    const std::string suffix = fileName.substr(fileName.rfind('_'));
+
+    std::error_code ec;
+
+    for (fs::directory_iterator it(path.parent_path(), ec); !ec && it != fs::directory_iterator(); it.increment(ec))
+    {
+        const fs::directory_entry& entry = *it;
+        const std::string entryName = entry.path().filename().string();
+
+        if (entryName == fileName || entryName.size() != fileName.size()
+            || !entryName.starts_with(prefix) || !entryName.ends_with(suffix))
+        {
+            continue;
         }
+
+        std::error_code removeEc;
+
+        if (!fs::remove(entry.path(), removeEc) || removeEc)
+            Warning("Failed to remove stale datatable cache file \"%s\".\n", entry.path().string().c_str());
     }
 }
 
-// page chunk structure and order:
-// - header        HEAD        (align=8)
-// - data          CPU         (align=8) data columns, column names, pod row values then string row values. only data columns is aligned to 8, the rest is 1.
-template <typename datatable_t>
-static void DataTable_AddDataTable(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const rapidjson::Value& mapEntry)
+// Returns true if the cache file exists and was built from the same csv data.
+static bool DataTable_OpenCacheFile(const std::string& cachePath, const uint64_t(&csvHash)[2], const size_t csvSize,
+    const unsigned short tableVersion, CMappedFile& cacheFile)
 {
-    UNUSED(mapEntry);
-    PakAsset_t& asset = pak->BeginAsset(assetGuid, assetPath);
+    if (!cacheFile.Open(cachePath) || !cacheFile.IsInRange(0, sizeof(DataTableCacheHeader_s)))
+        return false;
 
-    const std::string datatableFile = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".csv");
-    std::ifstream datatableStream(datatableFile);
+    const DataTableCacheHeader_s* const hdr = reinterpret_cast<const DataTableCacheHeader_s*>(cacheFile.GetData());
 
-    if (!datatableStream.is_open())
-        Error("Failed to open datatable asset \"%s\".\n", datatableFile.c_str());
+    if (hdr->magic != DATATABLE_CACHE_FILE_MAGIC || hdr->version != DATATABLE_CACHE_FILE_VERSION || hdr->tableVersion != tableVersion
+        || hdr->csvHash[0] != csvHash[0] || hdr->csvHash[1] != csvHash[1] || hdr->csvSize != csvSize)
+    {
+        return false;
+    }
 
-    rapidcsv::Document doc(datatableStream);
-    const size_t columnCount = doc.GetColumnCount();
+    const size_t pointersOffset = sizeof(DataTableCacheHeader_s);
+    const size_t guidRefsOffset = pointersOffset + (hdr->pointerCount * sizeof(DataTableCachePointer_s));
+    const size_t dataOffset = guidRefsOffset + (hdr->guidRefCount * sizeof(uint32_t));
 
-    if (columnCount == 0)
+    if (!cacheFile.IsInRange(dataOffset, hdr->dataSize) || hdr->rowPodValuesBase > hdr->dataSize)
+        return false;
+
+    const DataTableCachePointer_s* const pointers = reinterpret_cast<const DataTableCachePointer_s*>(&cacheFile.GetData()[pointersOffset]);
+
+    for (uint32_t i = 0; i < hdr->pointerCount; i++)
     {
-        Error("Attempted to add datatable with no columns.\n");
+        if (pointers[i].pointerOffset + sizeof(PagePtr_t) > hdr->dataSize || pointers[i].targetOffset > hdr->dataSize)
+            return false;
+    }
+
+    const uint32_t* const guidRefOffsets = reinterpret_cast<const uint32_t*>(&cacheFile.GetData()[guidRefsOffset]);
+
+    for (uint32_t i = 0; i < hdr->guidRefCount; i++)
+    {
+        if (guidRefOffsets[i] + sizeof(PakGuid_t) > hdr->dataSize)
+            return false;
+    }
+
+    return true;
+}
+
+static void DataTable_WriteCacheFile(const std::string& cachePath, const DataTableCacheHeader_s& hdr, const DataTableCacheRecord_s& record,
+    const char* const data)
+{
+    std::error_code ec;
+    fs::create_directories(fs::path(cachePath).parent_path(), ec);
+
+    // Written to a temporary file first, so a partially written cache file
+    // never gets picked up.
+    const std::string tempPath = cachePath + ".tmp";
+    BinaryIO out;
+
+    if (ec || !out.Open(tempPath, BinaryIO::Mode_e::Write))
+    {
+        Warning("Failed to open datatable cache file \"%s\" for write.\n", tempPath.c_str());
         return;
     }
 
-    const size_t rowCount = doc.GetRowCount();
+    const BinaryIOVec_s vecs[] = {
+        { &hdr, sizeof(hdr) },
+        { record.pointers.data(), record.pointers.size() * sizeof(DataTableCachePointer_s) },
+        { record.guidRefOffsets.data(), record.guidRefOffsets.size() * sizeof(uint32_t) },
+        { data, hdr.dataSize },
+    };
 
-    if (rowCount < 2)
+    out.WriteGathered(vecs, ARRAYSIZE(vecs));
+    out.Close();
+
+    fs::rename(tempPath, cachePath, ec);
+
+    if (ec)
     {
-        Error("Attempted to add datatable with invalid row count %zu.\nDTBL    - CSV must have a row of column types at the end of the table.\n", rowCount);
+        Warning("Failed to move datatable cache file to \"%s\": %s.\n", cachePath.c_str(), ec.message().c_str());
         return;
     }
 
-    const uint32_t pakVersion = pak->GetVersion();
+    DataTable_EvictStaleCacheFiles(cachePath);
+}
 
-    PakPageLump_s hdrChunk;
-    if (pakVersion <= 7)
-        hdrChunk = pak->CreatePageLump(sizeof(datatable_v0_t), SF_HEAD, 8);
-    else
-        hdrChunk = pak->CreatePageLump(sizeof(datatable_v1_t), SF_HEAD, 8);
+// Adds the data lump, its pointers and guid refs as they were recorded in the
+// cache file, which must have been validated with DataTable_OpenCacheFile.
+template <typename datatable_t>
+static size_t DataTable_ReplayFromCache(CPakFileBuilder* const pak, PakAsset_t& asset, PakPageLump_s& hdrChunk, const CMappedFile& cacheFile,
+    PakPageLump_s& outDataChunk)
+{
+    const DataTableCacheHeader_s* const hdr = reinterpret_cast<const DataTableCacheHeader_s*>(cacheFile.GetData());
+
+    const size_t pointersOffset = sizeof(DataTableCacheHeader_s);
+    const size_t guidRefsOffset = pointersOffset + (hdr->pointerCount * sizeof(DataTableCachePointer_s));
+    const size_t dataOffset = guidRefsOffset + (hdr->guidRefCount * sizeof(uint32_t));
+
+    datatable_t* const dtblHdr = reinterpret_cast<datatable_t*>(hdrChunk.data);
+
+    dtblHdr->numColumns = hdr->numColumns;
+    dtblHdr->numRows = hdr->numRows;
+    dtblHdr->rowStride = hdr->rowStride;
+
+    char* const data = new char[hdr->dataSize];
+    memcpy(data, &cacheFile.GetData()[dataOffset], hdr->dataSize);
+
+    outDataChunk = pak->CreatePageLump(hdr->dataSize, SF_CPU, 8, data);
+
+    // datatable v0 and v1 use the same struct offset for pColumns.
+    pak->AddPointer(hdrChunk, offsetof(datatable_v1_t, pColumns), outDataChunk, 0);
+
+    const DataTableCachePointer_s* const pointers = reinterpret_cast<const DataTableCachePointer_s*>(&cacheFile.GetData()[pointersOffset]);
+
+    for (uint32_t i = 0; i < hdr->pointerCount; i++)
+        pak->AddPointer(outDataChunk, pointers[i].pointerOffset, outDataChunk, pointers[i].targetOffset);
+
+    const uint32_t* const guidRefOffsets = reinterpret_cast<const uint32_t*>(&cacheFile.GetData()[guidRefsOffset]);
+
+    for (uint32_t i = 0; i < hdr->guidRefCount; i++)
+    {
+        const size_t guidRefOffset = guidRefOffsets[i];
+        const PakGuid_t assetGuid = *reinterpret_cast<const PakGuid_t*>(&outDataChunk.data[guidRefOffset]);
+
+        Pak_RegisterGuidRefAtOffset(assetGuid, guidRefOffset, outDataChunk, asset);
+    }
+
+    StringPool_AddStats(hdr->stringStats);
+
+    return hdr->rowPodValuesBase;
+}
+
+// Parses and validates the csv, adds the data lump and writes it to the cache.
+template <typename datatable_t>
+static size_t DataTable_BuildFromCsv(CPakFileBuilder* const pak, PakAsset_t& asset, PakPageLump_s& hdrChunk, const CMappedFile& datatableInput,
+    DataTableCacheHeader_s& cacheHdr, const std::string& cachePath, PakPageLump_s& outDataChunk)
+{
+    CCsvDocument doc;
+    doc.Parse(datatableInput.GetData(), datatableInput.GetSize());
+
+    // the first row holds the column names.
+    const size_t columnCount = doc.GetRowCount() > 0 ? doc.GetColumnCount(0) : 0;
+
+    if (columnCount == 0)
+        Error("Attempted to add datatable with no columns.\n");
+
+    const size_t rowCount = doc.GetRowCount() - 1;
+
+    if (rowCount < 2)
+        Error("Attempted to add datatable with invalid row count %zu.\nDTBL    - CSV must have a row of column types at the end of the table.\n", rowCount);
 
     datatable_t* const dtblHdr = reinterpret_cast<datatable_t*>(hdrChunk.data);
     datatable_asset_t dtblAsset{}; // temp header that we store values in.
 
-    dtblHdr->numColumns = static_cast<uint32_t>(doc.GetColumnCount());
-    dtblHdr->numRows = static_cast<uint32_t>(doc.GetRowCount() - 1); // -1 because last row isn't added (used for type info)
+    dtblHdr->numColumns = static_cast<uint32_t>(columnCount);
+    dtblHdr->numRows = static_cast<uint32_t>(rowCount - 1); // -1 because last row isn't added (used for type info)
+
+    std::vector<DataTableColumn_s> columns;
+    CStringPool stringPool;
 
-    std::vector<std::string> typeRow;
-    const size_t valueBufAlign = DataTable_SetupRows(doc, dtblHdr, dtblAsset, typeRow);
+    const size_t valueBufAlign = DataTable_SetupRows(doc, dtblHdr, dtblAsset, columns, stringPool);
 
     const size_t dataColumnsBufSize = dtblHdr->numColumns * sizeof(datacolumn_t);
     const size_t columnNamesBufSize = IALIGN(DataTable_CalcColumnNameBufSize(doc), valueBufAlign);
@@ -303,8 +685,10 @@ static void DataTable_AddDataTable(CPakFileBuilder* const pak, const PakGuid_t a
     // datatable v0 and v1 use the same struct offset for pColumns.
     pak->AddPointer(hdrChunk, offsetof(datatable_v1_t, pColumns), dataChunk, 0);
 
+    DataTableCacheRecord_s record;
+
     // setup data in column data chunk
-    DataTable_SetupColumns(pak, dataChunk, dataColumnsBufSize, dtblHdr, dtblAsset, doc, typeRow);
+    DataTable_SetupColumns(pak, dataChunk, dataColumnsBufSize, dtblHdr, dtblAsset, doc, columns, record);
 
     // Plain-old-data and string values use different buffers!
     const size_t guidRefBufBase = dataColumnsBufSize + columnNamesBufSize;
@@ -312,17 +696,83 @@ static void DataTable_AddDataTable(CPakFileBuilder* const pak, const PakGuid_t a
     const size_t rowStringValuesBase = rowPodValuesBase + dtblAsset.rowPodValueBufSize;
 
     // setup row data chunks
-    DataTable_SetupValues(pak, asset, dataChunk, guidRefBufBase, rowPodValuesBase, rowStringValuesBase, dtblHdr, dtblAsset, doc);
+    DataTable_SetupValues(pak, asset, dataChunk, guidRefBufBase, rowPodValuesBase, rowStringValuesBase, dtblHdr, dtblAsset, doc, columns, stringPool, record);
+
+    cacheHdr.numColumns = dtblHdr->numColumns;
+    cacheHdr.numRows = dtblHdr->numRows;
+    cacheHdr.rowStride = dtblHdr->rowStride;
+
+    cacheHdr.pointerCount = static_cast<uint32_t>(record.pointers.size());
+    cacheHdr.guidRefCount = static_cast<uint32_t>(record.guidRefOffsets.size());
+    cacheHdr.rowPodValuesBase = static_cast<uint32_t>(rowPodValuesBase);
+
+    cacheHdr.dataSize = totalChunkSize;
+    cacheHdr.stringStats = stringPool.GetStats();
+
+    StringPool_AddStats(cacheHdr.stringStats);
+
+    DataTable_WriteCacheFile(cachePath, cacheHdr, record, dataChunk.data);
+
+    outDataChunk = dataChunk;
+    return rowPodValuesBase;
+}
+
+// page chunk structure and order:
+// - header        HEAD        (align=8)
+// - data          CPU         (align=8) data columns, column names, pod row values then string row values. only data columns is aligned to 8, the rest is 1.
+template <typename datatable_t>
+static void DataTable_AddDataTable(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const rapidjson::Value& mapEntry)
+{
+    UNUSED(mapEntry);
+    PakAsset_t& asset = pak->BeginAsset(assetGuid, assetPath);
+
+    const std::string datatableFile = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".csv");
+    CMappedFile datatableInput;
+
+    if (!datatableInput.Open(datatableFile))
+        Error("Failed to open datatable asset \"%s\".\n", datatableFile.c_str());
+
+    const uint32_t pakVersion = pak->GetVersion();
+
+    // rpak v7: v0
+    // rpak v8: v1
+    const unsigned short tableVersion = pakVersion <= 7 ? 0 : 1;
+
+    DataTableCacheHeader_s cacheHdr{};
+
+    cacheHdr.magic = DATATABLE_CACHE_FILE_MAGIC;
+    cacheHdr.version = DATATABLE_CACHE_FILE_VERSION;
+    cacheHdr.tableVersion = tableVersion;
+    cacheHdr.csvSize = datatableInput.GetSize();
+
+    MurmurHash3_x64_128(datatableInput.GetData(), datatableInput.GetSize(), DATATABLE_CACHE_HASH_SEED, cacheHdr.csvHash);
+
+    const std::string cachePath = DataTable_GetCachePath(pak, assetPath, cacheHdr.csvHash, tableVersion);
+    CMappedFile cacheFile;
+
+    PakPageLump_s hdrChunk = pak->CreatePageLump(sizeof(datatable_t), SF_HEAD, 8);
+    PakPageLump_s dataChunk;
+
+    size_t rowPodValuesBase;
+
+    if (DataTable_OpenCacheFile(cachePath, cacheHdr.csvHash, cacheHdr.csvSize, tableVersion, cacheFile))
+    {
+        rowPodValuesBase = DataTable_ReplayFromCache<datatable_t>(pak, asset, hdrChunk, cacheFile, dataChunk);
+        s_dataTableCacheHits++;
+    }
+    else
+    {
+        rowPodValuesBase = DataTable_BuildFromCsv<datatable_t>(pak, asset, hdrChunk, datatableInput, cacheHdr, cachePath, dataChunk);
+        s_dataTableCacheMisses++;
+    }
 
     // datatable v0 and v1 use the same struct offset for pRows.
     pak->AddPointer(hdrChunk, offsetof(datatable_v0_t, pRows), dataChunk, rowPodValuesBase);
 
     asset.InitAsset(
-        hdrChunk.GetPointer(), pakVersion <= 7 ? sizeof(datatable_v0_t) : sizeof(datatable_v1_t),
+        hdrChunk.GetPointer(), sizeof(datatable_t),
         dataChunk.GetPointer(rowPodValuesBase), // points to datatable_asset_t::pRow
-        // rpak v7: v0
-        // rpak v8: v1
-        pakVersion <= 7 ? 0 : 1,
+        tableVersion,
         AssetType::DTBL);
 
     asset.SetHeaderPointer(hdrChunk.data);
@@ -330,6 +780,22 @@ static void DataTable_AddDataTable(CPakFileBuilder* const pak, const PakGuid_t a
     pak->FinishAsset();
 }
 
+//-----------------------------------------------------------------------------
+// purpose: logs how many datatables were replayed from the cache in the
+//          current build, and resets the statistics for the next one
+//-----------------------------------------------------------------------------
+void DataTable_LogCacheStats()
+{
+    if (s_dataTableCacheHits || s_dataTableCacheMisses)
+    {
+        Log("*** datatable cache: %zu hits, %zu misses.\n",
+            s_dataTableCacheHits, s_dataTableCacheMisses);
+    }
+
+    s_dataTableCacheHits = 0;
+    s_dataTableCacheMisses = 0;
+}
+
 void Assets::AddDataTableAsset(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const rapidjson::Value& mapEntry)
 {
     if (pak->GetVersion() <= 7)
@@ -489,12 +489,15 @@ void Material_SetTitanfall2Preset(MaterialAsset_t* const material, const std::st
     material->dxStates[1] = material->dxStates[0];
 }
 
-static void Material_OpenFile(CPakFileBuilder* const pak, const char* const assetPath, rapidjson::Document& document)
+static const rapidjson::Document& Material_OpenFile(CPakFileBuilder* const pak, const char* const assetPath)
 {
     const string fileName = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".json");
+    const rapidjson::Document* const document = JSON_GetCachedDocument(fileName.c_str(), "material asset", true);
 
-    if (!JSON_ParseFromFile(fileName.c_str(), "material asset", document, true))
+    if (!document)
         Error("Failed to open material asset \"%s\".\n", fileName.c_str());
+
+    return *document;
 }
 
 static void Material_InternalAddMaterialV12(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath,
@@ -728,8 +731,7 @@ static void Material_InternalAddMaterialV15(CPakFileBuilder* const pak, const Pa
 
 static bool Material_InternalAddMaterial(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const rapidjson::Value* const /*mapEntry*/, const int assetVersion)
 {
-    rapidjson::Document document;
-    Material_OpenFile(pak, assetPath, document);
+    const rapidjson::Document& document = Material_OpenFile(pak, assetPath);
 
     rapidjson::Value::ConstMemberIterator texturesIt;
     const bool hasTextures = JSON_GetIterator(document, "$textures", JSONFieldType_e::kObject, texturesIt);
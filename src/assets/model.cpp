@@ -2,23 +2,43 @@
 #include "assets.h"
 #include "public/studio.h"
 #include "public/material.h"
-
-char* Model_ReadRMDLFile(const std::string& path, const uint64_t alignment = 64)
+#include "utils/meshopt.h"
+#include "utils/parallel.h"
+#include "logic/streamcache.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Reads the file into a new buffer whose size is aligned to the given
+// alignment, the remainder is zeroed. Returns null if the file couldn't be
+// opened. Doesn't report errors, so it is safe to call from any thread.
+static char* Model_LoadFile(const std::string& path, const uint64_t alignment, int64_t& fileSize)
 {
-    BinaryIO modelFile;
+    BinaryIO file;
 
-    if (!modelFile.Open(path, BinaryIO::Mode_e::Read))
-        Error("Failed to open model file \"%s\".\n", path.c_str());
+    if (!file.Open(path, BinaryIO::Mode_e::Read))
+        return nullptr;
+
+    fileSize = file.GetSize();
+    const size_t alignedSize = IALIGN(fileSize, alignment);
+
+    char* const buf = new char[alignedSize];
+    file.Read(buf, fileSize);
+
+    const size_t remainder = alignedSize - fileSize;
 
-    const size_t fileSize = modelFile.GetSize();
+    if (remainder > 0)
+        memset(&buf[fileSize], 0, remainder);
 
+    return buf;
+}
+
+static void Model_ValidateRMDLFile(const char* const buf, const int64_t fileSize, const std::string& path)
+{
     if (fileSize < sizeof(studiohdr_t))
         Error("Invalid model file \"%s\"; must be at least %zu bytes, found %zu.\n", path.c_str(), sizeof(studiohdr_t), fileSize);
 
-    char* const buf = new char[IALIGN(fileSize, alignment)];
-    modelFile.Read(buf, fileSize);
-
-    studiohdr_t* const pHdr = reinterpret_cast<studiohdr_t*>(buf);
+    const studiohdr_t* const pHdr = reinterpret_cast<const studiohdr_t*>(buf);
 
     if (pHdr->id != 'TSDI') // "IDST"
         Error("Invalid model file \"%s\"; expected magic %x, found %x.\n", path.c_str(), 'TSDI', pHdr->id);
@@ -28,51 +48,452 @@ char* Model_ReadRMDLFile(const std::string& path, const uint64_t alignment = 64)
 
     if (pHdr->length > fileSize)
         Error("Invalid model file \"%s\"; studiohdr->length(%zu) > fileSize(%zu).\n", path.c_str(), (size_t)pHdr->length, fileSize);
+}
+
+char* Model_ReadRMDLFile(const std::string& path, const uint64_t alignment = 64)
+{
+    int64_t fileSize = 0;
+    char* const buf = Model_LoadFile(path, alignment, fileSize);
 
+    if (!buf)
+        Error("Failed to open model file \"%s\".\n", path.c_str());
+
+    Model_ValidateRMDLFile(buf, fileSize, path);
     return buf;
 }
 
-static char* Model_ReadVGFile(const std::string& path, int64_t* const pFileSize, size_t* const pFileSizePageAligned)
+// Returns true if the file looks like a vertex group, Model_ValidateVGFile
+// reports the details.
+static bool Model_IsVGFile(const char* const buf, const int64_t fileSize)
 {
-    BinaryIO vgFile;
-
-    if (!vgFile.Open(path, BinaryIO::Mode_e::Read))
-        Error("Failed to open vertex group file \"%s\".\n", path.c_str());
+    if (fileSize < sizeof(VertexGroupHeader_t))
+        return false;
 
-    const int64_t fileSize = vgFile.GetSize();
+    const VertexGroupHeader_t* const pHdr = reinterpret_cast<const VertexGroupHeader_t*>(buf);
+    return pHdr->id == 'GVt0' && pHdr->version == 1;
+}
 
+static void Model_ValidateVGFile(const char* const buf, const int64_t fileSize, const std::string& path)
+{
     if (fileSize < sizeof(VertexGroupHeader_t))
         Error("Invalid vertex group file \"%s\"; must be at least %zu bytes, found %zu.\n", path.c_str(), sizeof(VertexGroupHeader_t), fileSize);
 
+    const VertexGroupHeader_t* const pHdr = reinterpret_cast<const VertexGroupHeader_t*>(buf);
+
+    if (pHdr->id != 'GVt0') // "0tVG"
+        Error("Invalid vertex group file \"%s\"; expected magic %x, found %x.\n", path.c_str(), 'GVt0', pHdr->id);
+
+    // not sure if this is actually version but i've also never seen it != 1
+    if (pHdr->version != 1)
+        Error("Invalid vertex group file \"%s\"; expected version %i, found %i.\n", path.c_str(), 1, pHdr->version);
+}
+
+static char* Model_ReadVGFile(const std::string& path, int64_t* const pFileSize, size_t* const pFileSizePageAligned)
+{
     // note(amos): need to align it to STARPAK_DATABLOCK_ALIGNMENT since the
     // actual VG is also aligned to this value in the starpak, and the table at
     // the end of the starpak (see struct PakStreamSetAssetEntry_s in starpak.h
     // ), that we use for data deduplication, stores the asset's size aligned
     // so in order to yield the same hash we need to hash the data page aligned.
-    const size_t fileSizePageAligned = IALIGN(fileSize, STARPAK_DATABLOCK_ALIGNMENT);
+    int64_t fileSize = 0;
+    char* const buf = Model_LoadFile(path, STARPAK_DATABLOCK_ALIGNMENT, fileSize);
 
-    char* const buf = new char[fileSizePageAligned];
-    vgFile.Read(buf, fileSize);
+    if (!buf)
+        Error("Failed to open vertex group file \"%s\".\n", path.c_str());
 
-    const size_t remainder = fileSizePageAligned - fileSize;
+    Model_ValidateVGFile(buf, fileSize, path);
 
-    // Null the rest since this will affect the hash result.
-    if (remainder > 0)
-        memset(&buf[fileSize], 0, remainder);
+    *pFileSize = fileSize;
+    *pFileSizePageAligned = IALIGN(fileSize, STARPAK_DATABLOCK_ALIGNMENT);
 
-    VertexGroupHeader_t* const pHdr = reinterpret_cast<VertexGroupHeader_t*>(buf);
+    return buf;
+}
 
-    if (pHdr->id != 'GVt0') // "0tVG"
-        Error("Invalid vertex group file \"%s\"; expected magic %x, found %x.\n", path.c_str(), 'GVt0', pHdr->id);
+// Returns true if the array of count elements of the given size at offset
+// lies within the vertex group.
+static bool Model_IsInVGRange(const int64_t vgFileSize, const int64_t offset, const int64_t count, const size_t elemSize)
+{
+    return offset >= 0 && count >= 0 && offset <= vgFileSize
+        && count <= (vgFileSize - offset) / static_cast<int64_t>(elemSize);
+}
 
-    // not sure if this is actually version but i've also never seen it != 1
-    if (pHdr->version != 1)
-        Error("Invalid vertex group file \"%s\"; expected version %i, found %i.\n", path.c_str(), 1, pHdr->version);
+// Results of Model_OptimizeVertexGroup, these are reported separately as the
+// optimization may run ahead on a prefetch worker.
+struct VGOptimizeStats_s
+{
+    bool buffersInRange;
 
-    *pFileSize = fileSize;
-    *pFileSizePageAligned = fileSizePageAligned;
+    // Cache misses are summed over all optimized strips, weighted by their
+    // triangle count.
+    double missesBefore;
+    double missesAfter;
 
-    return buf;
+    size_t triCount;
+    size_t skippedMeshes;
+
+    microseconds duration;
+};
+
+//-----------------------------------------------------------------------------
+// purpose: reorders the triangles of every strip in the vertex group for the
+//          post-transform vertex cache, and the vertices of meshes that consist
+//          of a single strip for vertex fetch locality
+//-----------------------------------------------------------------------------
+static void Model_OptimizeVertexGroup(char* const vgBuf, const int64_t vgFileSize, VGOptimizeStats_s& stats)
+{
+    const VertexGroupHeader_t* const hdr = reinterpret_cast<const VertexGroupHeader_t*>(vgBuf);
+
+    stats = {};
+
+    stats.buffersInRange = Model_IsInVGRange(vgFileSize, hdr->meshOffset, hdr->numMeshes, sizeof(VertexGroupMesh_t))
+        && Model_IsInVGRange(vgFileSize, hdr->indexOffset, hdr->numIndices, sizeof(uint16_t))
+        && Model_IsInVGRange(vgFileSize, hdr->vertOffset, hdr->vertDataSize, 1)
+        && Model_IsInVGRange(vgFileSize, hdr->stripOffset, hdr->numStrips, sizeof(VertexGroupStrip_t));
+
+    if (!stats.buffersInRange)
+        return;
+
+    const steady_clock::time_point start = high_resolution_clock::now();
+
+    double& missesBefore = stats.missesBefore;
+    double& missesAfter = stats.missesAfter;
+    size_t& triCount = stats.triCount;
+    size_t& skippedMeshes = stats.skippedMeshes;
+
+    std::vector<uint16_t> indices;
+    std::vector<uint32_t> remap;
+    std::vector<char> vertices;
+
+    for (int64_t i = 0; i < hdr->numMeshes; i++)
+    {
+        VertexGroupMesh_t mesh;
+        memcpy(&mesh, &vgBuf[hdr->meshOffset + (i * sizeof(VertexGroupMesh_t))], sizeof(mesh));
+
+        if (!mesh.indexCount)
+            continue;
+
+        const bool meshInRange = mesh.indexOffset >= 0 && mesh.indexCount > 0 && mesh.indexOffset <= hdr->numIndices
+            && mesh.indexCount <= hdr->numIndices - mesh.indexOffset
+            && mesh.stripOffset >= 0 && mesh.stripCount >= 0 && mesh.stripOffset <= hdr->numStrips
+            && mesh.stripCount <= hdr->numStrips - mesh.stripOffset
+            && mesh.vertCount > 0 && mesh.vertCount <= UINT16_MAX + 1
+            && mesh.vertOffset <= hdr->vertDataSize
+            && static_cast<int64_t>(mesh.vertCacheSize) * mesh.vertCount <= hdr->vertDataSize - mesh.vertOffset;
+
+        if (!meshInRange)
+        {
+            skippedMeshes++;
+            continue;
+        }
+
+        char* const meshIndexData = &vgBuf[hdr->indexOffset + (mesh.indexOffset * sizeof(uint16_t))];
+
+        indices.resize(mesh.indexCount);
+        memcpy(indices.data(), meshIndexData, mesh.indexCount * sizeof(uint16_t));
+
+        const uint16_t maxIndex = *std::max_element(indices.begin(), indices.end());
+
+        if (maxIndex >= mesh.vertCount)
+        {
+            skippedMeshes++;
+            continue;
+        }
+
+        const VertexGroupStrip_t* const strips = reinterpret_cast<const VertexGroupStrip_t*>(&vgBuf[hdr->stripOffset + (mesh.stripOffset * sizeof(VertexGroupStrip_t))]);
+
+        // Vertices can only be moved if nothing else refers to them by index,
+        // i.e. when a single strip covers the whole mesh.
+        bool canRemapVertices = mesh.stripCount == 1 && mesh.legacyWeightCount == 0;
+
+        for (int j = 0; j < mesh.stripCount; j++)
+        {
+            VertexGroupStrip_t strip;
+            memcpy(&strip, &strips[j], sizeof(strip));
+
+            const bool stripIsValid = (strip.flags & VG_STRIP_IS_TRILIST) && strip.numTopologyIndices == 0
+                && strip.indexOffset >= 0 && strip.numIndices >= 0 && strip.indexOffset <= mesh.indexCount
+                && strip.numIndices <= mesh.indexCount - strip.indexOffset && (strip.numIndices % 3) == 0;
+
+            if (!stripIsValid)
+            {
+                canRemapVertices = false;
+                continue;
+            }
+
+            if (strip.indexOffset != 0 || strip.numIndices != mesh.indexCount
+                || strip.vertOffset != 0 || static_cast<unsigned int>(strip.numVerts) != mesh.vertCount)
+            {
+                canRemapVertices = false;
+            }
+
+            uint16_t* const stripIndices = &indices[strip.indexOffset];
+            const size_t stripTriCount = strip.numIndices / 3;
+
+            missesBefore += MeshOpt_ComputeACMR(stripIndices, strip.numIndices) * stripTriCount;
+            MeshOpt_OptimizeVertexCache(stripIndices, strip.numIndices, mesh.vertCount);
+            missesAfter += MeshOpt_ComputeACMR(stripIndices, strip.numIndices) * stripTriCount;
+
+            triCount += stripTriCount;
+        }
+
+        if (canRemapVertices)
+        {
+            MeshOpt_OptimizeVertexFetch(indices.data(), indices.size(), mesh.vertCount, remap);
+
+            char* const meshVertexData = &vgBuf[hdr->vertOffset + mesh.vertOffset];
+            const size_t vertexSize = mesh.vertCacheSize;
+
+            vertices.assign(meshVertexData, meshVertexData + (vertexSize * mesh.vertCount));
+
+            for (unsigned int v = 0; v < mesh.vertCount; v++)
+                memcpy(&meshVertexData[remap[v] * vertexSize], &vertices[v * vertexSize], vertexSize);
+        }
+
+        memcpy(meshIndexData, indices.data(), mesh.indexCount * sizeof(uint16_t));
+    }
+
+    const steady_clock::time_point stop = high_resolution_clock::now();
+    stats.duration = duration_cast<microseconds>(stop - start);
+}
+
+static void Model_ReportVertexGroupStats(const VGOptimizeStats_s& stats, const char* const vgFilePath)
+{
+    if (!stats.buffersInRange)
+    {
+        Warning("Vertex group file \"%s\" has buffers outside of the file; skipping vertex cache optimization.\n", vgFilePath);
+        return;
+    }
+
+    if (stats.skippedMeshes)
+        Warning("Vertex group file \"%s\" has %zu meshes with invalid buffer ranges; these were left as is.\n", vgFilePath, stats.skippedMeshes);
+
+    if (stats.triCount)
+    {
+        Log("Optimized vertex group \"%s\"; ACMR %.3f -> %.3f over %zu triangles in %lld ms.\n", vgFilePath,
+            stats.missesBefore / stats.triCount, stats.missesAfter / stats.triCount, stats.triCount,
+            duration_cast<milliseconds>(stats.duration).count());
+    }
+}
+
+// Number of models that may be loaded ahead of the one that is currently
+// being added, this bounds the memory held by loaded but unused sources.
+#define MODEL_PREFETCH_MAX_AHEAD 32
+#define MODEL_PREFETCH_MAX_WORKERS 8
+
+// Model sources that are loaded, optimized and hashed on a worker thread
+// while the serial build is busy with the assets before it. Buffers that
+// are handed out by Model_TakePrefetchedJob are owned by the caller.
+struct ModelPrefetchJob_s
+{
+    std::string rmdlFilePath;
+
+    bool loadVertexGroup;
+    bool optimizeVertexCache;
+
+    char* rmdlBuf;
+    int64_t rmdlFileSize;
+
+    // Null if the file couldn't be opened.
+    char* phyBuf;
+    int64_t phyFileSize;
+
+    char* vgBuf;
+    int64_t vgFileSize;
+
+    // Only set if the vertex group had a valid header, invalid ones are
+    // reported by the serial build.
+    bool vgValid;
+    __m128i vgHash;
+    VGOptimizeStats_s vgStats;
+
+    bool isDone;
+};
+
+struct ModelPrefetcher_s
+{
+    std::vector<ModelPrefetchJob_s> jobs;
+    std::unordered_map<std::string, size_t> jobIndices;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    // Next job to hand out to a worker, and the first job that hasn't been
+    // taken by the serial build yet.
+    size_t nextJob;
+    size_t windowBase;
+
+    bool stop;
+};
+
+// Allocated on the heap so an Error() during the build doesn't destroy
+// joinable threads on exit.
+static ModelPrefetcher_s* s_modelPrefetcher = nullptr;
+
+static void Model_RunPrefetchJob(ModelPrefetchJob_s& job)
+{
+    job.rmdlBuf = Model_LoadFile(job.rmdlFilePath, 64, job.rmdlFileSize);
+
+    const std::string phyFilePath = Utils::ChangeExtension(job.rmdlFilePath, ".phy");
+    job.phyBuf = Model_LoadFile(phyFilePath, 1, job.phyFileSize);
+
+    if (!job.loadVertexGroup)
+        return;
+
+    const std::string vgFilePath = Utils::ChangeExtension(job.rmdlFilePath, ".vg");
+    job.vgBuf = Model_LoadFile(vgFilePath, STARPAK_DATABLOCK_ALIGNMENT, job.vgFileSize);
+
+    if (!job.vgBuf || !Model_IsVGFile(job.vgBuf, job.vgFileSize))
+        return;
+
+    if (job.optimizeVertexCache)
+        Model_OptimizeVertexGroup(job.vgBuf, job.vgFileSize, job.vgStats);
+
+    // Same data and size as Model_InternalAddVertexGroupData hands to the
+    // stream cache, so the hash matches the one computed in a serial build.
+    job.vgHash = CStreamCache::HashData(reinterpret_cast<const uint8_t*>(job.vgBuf), IALIGN(job.vgFileSize, STARPAK_DATABLOCK_ALIGNMENT));
+    job.vgValid = true;
+}
+
+static void Model_PrefetchWorker(ModelPrefetcher_s* const prefetcher)
+{
+    std::unique_lock<std::mutex> lock(prefetcher->mutex);
+
+    while (true)
+    {
+        prefetcher->cond.wait(lock, [prefetcher]()
+            {
+                return prefetcher->stop || (prefetcher->nextJob < prefetcher->jobs.size()
+                    && prefetcher->nextJob < prefetcher->windowBase + MODEL_PREFETCH_MAX_AHEAD);
+            });
+
+        if (prefetcher->stop)
+            return;
+
+        ModelPrefetchJob_s& job = prefetcher->jobs[prefetcher->nextJob++];
+
+        lock.unlock();
+        Model_RunPrefetchJob(job);
+        lock.lock();
+
+        job.isDone = true;
+        prefetcher->cond.notify_all();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// purpose: starts loading the sources of all models in the map ahead of the
+//          serial build, the assets are still added in map order
+//-----------------------------------------------------------------------------
+void Model_BeginPrefetch(CPakFileBuilder* const pak, const rapidjson::Value& files)
+{
+    assert(!s_modelPrefetcher);
+
+    ModelPrefetcher_s* const prefetcher = new ModelPrefetcher_s();
+    const bool keepClientOnly = pak->IsFlagSet(PF_KEEP_CLIENT);
+
+    for (const auto& file : files.GetArray())
+    {
+        const char* const assetType = JSON_GetValueOrDefault(file, "_type", static_cast<const char*>(nullptr));
+        const char* const assetPath = JSON_GetValueOrDefault(file, "_path", static_cast<const char*>(nullptr));
+
+        if (!assetType || !assetPath || strcmp(assetType, "mdl_") != 0)
+            continue;
+
+        // Duplicates are loaded by the serial build, which reports them.
+        if (!prefetcher->jobIndices.emplace(assetPath, prefetcher->jobs.size()).second)
+            continue;
+
+        ModelPrefetchJob_s& job = prefetcher->jobs.emplace_back();
+
+        job.rmdlFilePath = pak->GetAssetPath() + assetPath;
+        job.loadVertexGroup = keepClientOnly;
+        job.optimizeVertexCache = JSON_GetValueOrDefault(file, "$optimizeVertexCache", false);
+    }
+
+    const size_t numWorkers = (std::min)(prefetcher->jobs.size(),
+        (std::min)(Parallel_GetDefaultWorkerCount(), static_cast<size_t>(MODEL_PREFETCH_MAX_WORKERS)));
+
+    for (size_t i = 0; i < numWorkers; i++)
+        prefetcher->workers.emplace_back(Model_PrefetchWorker, prefetcher);
+
+    s_modelPrefetcher = prefetcher;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: stops the prefetch workers and frees the sources of the models
+//          that were never added
+//-----------------------------------------------------------------------------
+void Model_EndPrefetch()
+{
+    ModelPrefetcher_s* const prefetcher = s_modelPrefetcher;
+
+    if (!prefetcher)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(prefetcher->mutex);
+        prefetcher->stop = true;
+    }
+
+    prefetcher->cond.notify_all();
+
+    for (std::thread& worker : prefetcher->workers)
+        worker.join();
+
+    // Jobs that were taken have their buffers cleared, delete is a no-op on
+    // these as well as on jobs that never ran.
+    for (ModelPrefetchJob_s& job : prefetcher->jobs)
+    {
+        delete[] job.rmdlBuf;
+        delete[] job.phyBuf;
+        delete[] job.vgBuf;
+    }
+
+    delete prefetcher;
+    s_modelPrefetcher = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: waits for the prefetched sources of the model and hands them over
+//          to the caller, returns false if the model wasn't prefetched
+//-----------------------------------------------------------------------------
+static bool Model_TakePrefetchedJob(const char* const assetPath, ModelPrefetchJob_s& out)
+{
+    ModelPrefetcher_s* const prefetcher = s_modelPrefetcher;
+
+    if (!prefetcher)
+        return false;
+
+    const auto it = prefetcher->jobIndices.find(assetPath);
+
+    if (it == prefetcher->jobIndices.end())
+        return false;
+
+    const size_t index = it->second;
+    prefetcher->jobIndices.erase(it);
+
+    std::unique_lock<std::mutex> lock(prefetcher->mutex);
+    ModelPrefetchJob_s& job = prefetcher->jobs[index];
+
+    // Make sure the job falls within the window, else we would wait forever.
+    prefetcher->windowBase = (std::max)(prefetcher->windowBase, index);
+    prefetcher->cond.notify_all();
+
+    prefetcher->cond.wait(lock, [&job]() { return job.isDone; });
+
+    out = job;
+
+    job.rmdlBuf = nullptr;
+    job.phyBuf = nullptr;
+    job.vgBuf = nullptr;
+
+    // Let the workers move on to the next batch, models may be taken out of
+    // order so the window must never move backwards.
+    prefetcher->windowBase = (std::max)(prefetcher->windowBase, index + 1);
+    prefetcher->cond.notify_all();
+
+    return true;
 }
 
 static PakGuid_t* Model_AddAnimRigRefs(uint32_t* const animrigCount, const rapidjson::Value& mapEntry)
@@ -170,7 +591,8 @@ static void Model_AllocateIntermediateDataChunk(CPakFileBuilder* const pak, PakP
     }
 }
 
-static void Model_InternalAddVertexGroupData(CPakFileBuilder* const pak, PakPageLump_s* const hdrChunk, ModelAssetHeader_t* const modelHdr, studiohdr_t* const studiohdr, const std::string& rmdlFilePath, PakStreamSetEntry_s& de)
+static void Model_InternalAddVertexGroupData(CPakFileBuilder* const pak, PakPageLump_s* const hdrChunk, ModelAssetHeader_t* const modelHdr, studiohdr_t* const studiohdr, const std::string& rmdlFilePath,
+    const bool optimizeVertexCache, const ModelPrefetchJob_s* const prefetched, PakStreamSetEntry_s& de)
 {
     modelHdr->totalVertexDataSize = studiohdr->vtxsize + studiohdr->vvdsize + studiohdr->vvcsize + studiohdr->vvwsize;
 
@@ -181,9 +603,42 @@ static void Model_InternalAddVertexGroupData(CPakFileBuilder* const pak, PakPage
     const std::string vgFilePath = Utils::ChangeExtension(rmdlFilePath, ".vg");
 
     int64_t vgFileSize = 0; size_t vgSizeAligned = 0;
-    char* const vgBuf = Model_ReadVGFile(vgFilePath, &vgFileSize, &vgSizeAligned);
+    char* vgBuf;
+
+    const __m128i* vgHash = nullptr;
 
-    de = pak->AddStreamingDataEntry(vgSizeAligned, (uint8_t*)vgBuf, STREAMING_SET_MANDATORY);
+    if (prefetched && prefetched->vgValid)
+    {
+        // Already optimized and hashed by the prefetcher.
+        vgBuf = prefetched->vgBuf;
+        vgFileSize = prefetched->vgFileSize;
+        vgSizeAligned = IALIGN(vgFileSize, STARPAK_DATABLOCK_ALIGNMENT);
+
+        vgHash = &prefetched->vgHash;
+
+        if (optimizeVertexCache)
+            Model_ReportVertexGroupStats(prefetched->vgStats, vgFilePath.c_str());
+    }
+    else
+    {
+        // Invalid or missing prefetched files are reloaded here to report them.
+        if (prefetched)
+            delete[] prefetched->vgBuf;
+
+        vgBuf = Model_ReadVGFile(vgFilePath, &vgFileSize, &vgSizeAligned);
+
+        // Must happen before the data is hashed for deduplication, and before
+        // it is copied into the permanent lump of static props.
+        if (optimizeVertexCache)
+        {
+            VGOptimizeStats_s stats;
+            Model_OptimizeVertexGroup(vgBuf, vgFileSize, stats);
+
+            Model_ReportVertexGroupStats(stats, vgFilePath.c_str());
+        }
+    }
+
+    de = pak->AddStreamingDataEntry(vgSizeAligned, (uint8_t*)vgBuf, STREAMING_SET_MANDATORY, vgHash);
 
     assert(vgSizeAligned <= UINT32_MAX);
     modelHdr->streamedVertexDataSize = static_cast<uint32_t>(vgSizeAligned);
@@ -300,21 +755,42 @@ void Assets::AddModelAsset_v9(CPakFileBuilder* const pak, const PakGuid_t assetG
 
     const std::string rmdlFilePath = pak->GetAssetPath() + assetPath;
 
-    char* const rmdlBuf = Model_ReadRMDLFile(rmdlFilePath);
+    // Sources are usually loaded ahead by the prefetcher, the files that
+    // failed to load are reloaded here so the errors are reported in order.
+    ModelPrefetchJob_s prefetched;
+    const bool isPrefetched = Model_TakePrefetchedJob(assetPath, prefetched);
+
+    char* rmdlBuf;
+
+    if (isPrefetched && prefetched.rmdlBuf)
+    {
+        rmdlBuf = prefetched.rmdlBuf;
+        Model_ValidateRMDLFile(rmdlBuf, prefetched.rmdlFileSize, rmdlFilePath);
+    }
+    else
+        rmdlBuf = Model_ReadRMDLFile(rmdlFilePath);
+
     studiohdr_t* const studiohdr = reinterpret_cast<studiohdr_t*>(rmdlBuf);
 
     //
     // Physics
     //
     const bool physicsRequired = studiohdr->vphysize != 0;
-
-    BinaryIO phyInput;
     const std::string physicsFile = Utils::ChangeExtension(rmdlFilePath, ".phy");
 
-    if (phyInput.Open(physicsFile, BinaryIO::Mode_e::Read))
+    int64_t phyFileSize = 0;
+    char* phyBuf;
+
+    if (isPrefetched)
     {
-        const size_t phyFileSize = phyInput.GetSize();
+        phyBuf = prefetched.phyBuf;
+        phyFileSize = prefetched.phyFileSize;
+    }
+    else
+        phyBuf = Model_LoadFile(physicsFile, 1, phyFileSize);
 
+    if (phyBuf)
+    {
         // If it exists, but is 0, then the file is truncated/corrupt.
         // Still report the error even if physicsRequired is false as
         // this is an indication there's more wrong.
@@ -324,9 +800,7 @@ void Assets::AddModelAsset_v9(CPakFileBuilder* const pak, const PakGuid_t assetG
         if (physicsRequired && (studiohdr->vphysize != phyFileSize))
             Error("Physics file \"%s\" has a size of %zu, but the model expected a size of %zu.\n", physicsFile.c_str(), phyFileSize, (size_t)studiohdr->vphysize);
 
-        PakPageLump_s phyChunk = pak->CreatePageLump(phyFileSize, SF_CPU | SF_TEMP, 1);
-        phyInput.Read(phyChunk.data, phyFileSize);
-
+        PakPageLump_s phyChunk = pak->CreatePageLump(phyFileSize, SF_CPU | SF_TEMP, 1, phyBuf);
         pak->AddPointer(hdrChunk, offsetof(ModelAssetHeader_t, pPhyData), phyChunk, 0);
     }
     else if (physicsRequired)
@@ -340,7 +814,12 @@ void Assets::AddModelAsset_v9(CPakFileBuilder* const pak, const PakGuid_t assetG
     const bool keepClientOnly = pak->IsFlagSet(PF_KEEP_CLIENT);
 
     if (keepClientOnly)
-        Model_InternalAddVertexGroupData(pak, &hdrChunk, pHdr, studiohdr, rmdlFilePath, streamedVg);
+    {
+        const bool optimizeVertexCache = JSON_GetValueOrDefault(mapEntry, "$optimizeVertexCache", false);
+        Model_InternalAddVertexGroupData(pak, &hdrChunk, pHdr, studiohdr, rmdlFilePath, optimizeVertexCache, isPrefetched ? &prefetched : nullptr, streamedVg);
+    }
+    else if (isPrefetched)
+        delete[] prefetched.vgBuf;
 
     // the last chunk is the actual data chunk that contains the rmdl
     PakPageLump_s dataChunk = pak->CreatePageLump(studiohdr->length, SF_CPU, 64, rmdlBuf);
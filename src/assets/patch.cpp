@@ -22,16 +22,18 @@ void Assets::AddPatchAsset(CPakFileBuilder* const pak, const PakGuid_t assetGuid
 
     for (const rapidjson::Value& entry : entryArray)
     {
-        const char* const name = JSON_GetValueRequired<const char*>(entry, "name");
+        rapidjson::Value::ConstMemberIterator nameIt;
+        JSON_GetRequired(entry, "name", JSONFieldType_e::kString, nameIt);
         const uint8_t patchNum = (uint8_t)JSON_GetValueRequired<int>(entry, "version");
 
         PtchEntry& patchEntry = patchEntries.emplace_back();
 
-        patchEntry.pakFileName = name;
+        patchEntry.pakFileName = nameIt->value.GetString();
+        patchEntry.pakFileNameLen = nameIt->value.GetStringLength();
         patchEntry.highestPatchNum = patchNum;
         patchEntry.pakFileNameOffset = entryNamesSectionSize;
 
-        entryNamesSectionSize += static_cast<uint32_t>(patchEntry.pakFileName.length() + 1);
+        entryNamesSectionSize += static_cast<uint32_t>(patchEntry.pakFileNameLen + 1);
     }
 
     const size_t dataPageSize = (sizeof(PagePtr_t) * pHdr->patchedPakCount) + (sizeof(uint8_t) * pHdr->patchedPakCount) + entryNamesSectionSize;
@@ -54,7 +56,7 @@ void Assets::AddPatchAsset(CPakFileBuilder* const pak, const PakGuid_t assetGuid
         // write the patch number for this entry into the buffer
         dataBuf.write<uint8_t>(it.highestPatchNum, pHdr->pPakPatchNums.offset + i);
 
-        memcpy(&dataChunk.data[fileNameOffset], it.pakFileName.c_str(), it.pakFileName.length() + 1);
+        memcpy(&dataChunk.data[fileNameOffset], it.pakFileName, it.pakFileNameLen + 1);
 
         pak->AddPointer(dataChunk, (sizeof(PagePtr_t) * i));
         i++;
@@ -2,36 +2,43 @@
 #include "assets.h"
 #include "public/settings_layout.h"
 #include "public/settings.h"
+#include "utils/stringpool.h"
 
 #undef GetObject
 #define SETTINGS_MODS_NAMES_FIELD "$modNames"
 #define SETTINGS_MODS_VALUES_FIELD "$modValues"
 
-static void SettingsAsset_OpenFile(CPakFileBuilder* const pak, const char* const assetPath, rapidjson::Document& document)
+static const rapidjson::Document& SettingsAsset_OpenFile(CPakFileBuilder* const pak, const char* const assetPath)
 {
     const string fileName = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".json");
+    const rapidjson::Document* const document = JSON_GetCachedDocument(fileName.c_str(), "settings asset", true);
 
-    if (!JSON_ParseFromFile(fileName.c_str(), "settings asset", document, true))
+    if (!document)
         Error("Failed to open settings asset \"%s\".\n", fileName.c_str());
+
+    return *document;
 }
 
-static int64_t FindColumnCell(const std::vector<std::string>& column, const char* const name, const int occurrence)
+// Returns the index of the next occurrence of the field name in the layout,
+// or -1 if the layout doesn't have another field with this name. Occurrences
+// are counted in occurrenceMap, indexed by the first field with the name.
+static int64_t FindLayoutField(const SettingsLayoutParseResult_s& layout, const std::string_view& name, std::vector<int>& occurrenceMap, int& occurrenceOut)
 {
-    const int64_t numColumns = static_cast<int64_t>(column.size());
-    int numFound = 0;
+    occurrenceOut = 0;
+    const auto it = layout.fieldNameMap.find(name);
 
-    for (int64_t i = 0; i < numColumns; i++)
-    {
-        const std::string& entry = column[i];
+    if (it == layout.fieldNameMap.end())
+        return -1;
 
-        if (entry.compare(name) == 0)
-        {
-            if (numFound++ == occurrence)
-                return i;
-        }
-    }
+    int& occurrence = occurrenceMap[it->second];
+    occurrenceOut = occurrence++;
+
+    uint32_t index = it->second;
+
+    for (int i = 0; i < occurrenceOut && index != UINT32_MAX; i++)
+        index = layout.nextOccurrenceMap[index];
 
-    return -1;
+    return index != UINT32_MAX ? index : -1;
 }
 
 static JSONFieldType_e GetJsonMemberTypeForSettingsType(const SettingsFieldType_e type)
@@ -73,7 +80,7 @@ struct SettingsAssetMemory_s
         curModNamesPtrBufIndex = guidBufSize;
         curModValuesBufIndex = guidBufSize + modNamesPtrBufSize;
         valueBufIndex = guidBufSize + modNamesPtrBufSize + modValuesBufSize;
-        curStringBufIndex = guidBufSize + modNamesPtrBufSize + modValuesBufSize + valueBufSize;
+        stringBufIndex = guidBufSize + modNamesPtrBufSize + modValuesBufSize + valueBufSize;
     }
 
     size_t guidBufSize;
@@ -89,7 +96,10 @@ struct SettingsAssetMemory_s
     size_t valueBufIndex;
 
     size_t stringBufSize;
-    size_t curStringBufIndex;
+    size_t stringBufIndex;
+
+    // Strings are interned, identical values share the same bytes.
+    CStringPool stringPool;
 };
 
 static void SettingsAsset_InitializeAndMap(const char* const layoutAssetPath, SettingsAsset_s& settingsAsset,
@@ -115,19 +125,19 @@ static void SettingsAsset_InitializeAndMap(const char* const layoutAssetPath, Se
         settingsMemory.valueBufSize += layoutAsset.rootLayout.totalValueBufferSize;
     }
 
-    std::map<std::string, int> occurenceMap;
+    std::vector<int> occurenceMap(numLayoutFields, 0);
+    settingsAsset.fieldIndexMap.reserve(numSettingsFields);
 
     for (const auto& it : value.GetObject())
     {
         const char* const fieldName = it.name.GetString();
-        int& occurence = occurenceMap[fieldName];
+        int occurence;
 
-        const int64_t cellIndex = FindColumnCell(layoutAsset.rootLayout.fieldNames, fieldName, occurence);
+        const int64_t cellIndex = FindLayoutField(layoutAsset.rootLayout, std::string_view(fieldName, it.name.GetStringLength()), occurenceMap, occurence);
 
         if (cellIndex == -1)
             Error("Field \"%s\" with occurrence #%d does not exist in settings layout \"%s\".\n", fieldName, occurence, layoutAssetPath);
 
-        occurence++;
         settingsAsset.fieldIndexMap.push_back(cellIndex);
 
         const SettingsFieldType_e typeToUse = layoutAsset.rootLayout.typeMap[cellIndex];
@@ -141,9 +151,12 @@ static void SettingsAsset_InitializeAndMap(const char* const layoutAssetPath, Se
                 fieldName, JSON_TypeToString(hasJsonType), JSON_TypeToString(expectJsonType), s_settingsFieldTypeNames[typeToUse]);
         }
 
-        if (expectJsonType == JSONFieldType_e::kString)
+        // Float2 and float3 values are strings in the json, but these are
+        // stored as vectors.
+        if (expectJsonType == JSONFieldType_e::kString
+            && typeToUse != SettingsFieldType_e::ST_Float2 && typeToUse != SettingsFieldType_e::ST_Float3)
         {
-            settingsMemory.stringBufSize += it.value.GetStringLength() + 1; // +1 for the null char.
+            settingsMemory.stringPool.Add(std::string_view(it.value.GetString(), it.value.GetStringLength()));
 
             // Note(amos): only precached asset fields need to have their value
             // hashed and stored as a GUID dependency. Only on string types.
@@ -212,7 +225,7 @@ static void SettingsAsset_CalculateModNamesBuffers(const rapidjson::Value& modNa
         }
 
         settingsMemory.modNamesPtrBufSize += sizeof(PagePtr_t);
-        settingsMemory.stringBufSize += elem.GetStringLength() + 1;
+        settingsMemory.stringPool.Add(std::string_view(elem.GetString(), elem.GetStringLength()));
 
         elemIndex++;
     }
@@ -338,7 +351,7 @@ static void SettingsAsset_CalculateModValuesBuffers(const rapidjson::Value& modV
         // Strings are stored in the string buffer, and the offset to it will
         // be stored as value instead.
         if (isStringType)
-            settingsMemory.stringBufSize += value.GetStringLength() + 1;
+            settingsMemory.stringPool.Add(std::string_view(value.GetString(), value.GetStringLength()));
 
         const char* targetFieldName;
         SettingsFieldType_e fieldTypeExpected;
@@ -420,12 +433,8 @@ static void SettingsAsset_CalculateModValuesBuffers(const rapidjson::Value& modV
 static void SettingsAsset_WriteStringValue(const char* const string, const size_t stringLen, const size_t valueOffset,
     CPakFileBuilder* const pak, PakPageLump_s& dataLump, SettingsAssetMemory_s& settingsMemory)
 {
-    pak->AddPointer(dataLump, valueOffset, dataLump, settingsMemory.curStringBufIndex);
-
-    const size_t strBufLen = stringLen+1; // +1 for null char.
-    memcpy(&dataLump.data[settingsMemory.curStringBufIndex], string, strBufLen);
-
-    settingsMemory.curStringBufIndex += strBufLen;
+    const size_t stringOffset = settingsMemory.stringPool.Find(std::string_view(string, stringLen));
+    pak->AddPointer(dataLump, valueOffset, dataLump, settingsMemory.stringBufIndex + stringOffset);
 }
 
 static void SettingsAsset_WriteAssetValue(const char* const string, const size_t stringLen, const size_t valueOffset,
@@ -562,18 +571,14 @@ static void SettingsAsset_WriteModNames(const SettingsModCache_s& modCache, CPak
 
     for (const rapidjson::Value& elem : array)
     {
-        const size_t stringBufLen = elem.GetStringLength() + 1;
-        memcpy(&dataLump.data[settingsMemory.curStringBufIndex], elem.GetString(), stringBufLen);
-
-        pak->AddPointer(dataLump, settingsMemory.curModNamesPtrBufIndex, dataLump, settingsMemory.curStringBufIndex);
+        const size_t stringOffset = settingsMemory.stringPool.Find(std::string_view(elem.GetString(), elem.GetStringLength()));
+        pak->AddPointer(dataLump, settingsMemory.curModNamesPtrBufIndex, dataLump, settingsMemory.stringBufIndex + stringOffset);
 
         settingsMemory.curModNamesPtrBufIndex += sizeof(PagePtr_t);
-        settingsMemory.curStringBufIndex += stringBufLen;
     }
 }
 
-static void SettingsAsset_WriteModValues(const SettingsModCache_s& modCache, const size_t stringBufferBase,
-    SettingsAssetMemory_s& settingsMemory, PakPageLump_s& dataLump)
+static void SettingsAsset_WriteModValues(const SettingsModCache_s& modCache, SettingsAssetMemory_s& settingsMemory, PakPageLump_s& dataLump)
 {
     for (const SettingsModValueItem_s& item : modCache.modValues)
     {
@@ -605,13 +610,10 @@ static void SettingsAsset_WriteModValues(const SettingsModCache_s& modCache, con
             break;
         case SettingsModType_e::kString:
         {
+            // The offset is relative to the string data of the asset.
             const rapidjson::Value& val = item.valueIt->value;
-            const size_t strBufLen = val.GetStringLength() + 1; // +1 for null char.
-
-            memcpy(&dataLump.data[settingsMemory.curStringBufIndex], val.GetString(), strBufLen);
-            mod->value.stringOffset = static_cast<uint32_t>(settingsMemory.curStringBufIndex - stringBufferBase);
+            mod->value.stringOffset = static_cast<uint32_t>(settingsMemory.stringPool.Find(std::string_view(val.GetString(), val.GetStringLength())));
 
-            settingsMemory.curStringBufIndex += strBufLen;
             break;
         }
         }
@@ -669,17 +671,13 @@ static bool SettingsAsset_ParseMods(SettingsAssetHeader_s* const setHdr, const S
     return true;
 }
 
-extern void SettingsLayout_ParseLayout(CPakFileBuilder* const pak, const char* const assetPath, SettingsLayoutAsset_s& layoutAsset);
-
 static void SettingsAsset_InternalAddSettingsAsset(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath)
 {
-    rapidjson::Document settings;
-    SettingsAsset_OpenFile(pak, assetPath, settings);
+    const rapidjson::Document& settings = SettingsAsset_OpenFile(pak, assetPath);
 
     const char* const layoutAssetPath = JSON_GetValueRequired<const char*>(settings, "layoutAsset");
 
-    SettingsLayoutAsset_s layoutAsset;
-    SettingsLayout_ParseLayout(pak, layoutAssetPath, layoutAsset);
+    const SettingsLayoutAsset_s& layoutAsset = SettingsLayout_GetLayout(pak, layoutAssetPath);
 
     PakAsset_t& asset = pak->BeginAsset(assetGuid, assetPath);
     PakPageLump_s hdrLump = pak->CreatePageLump(sizeof(SettingsAssetHeader_s), SF_HEAD, 8);
@@ -707,7 +705,7 @@ static void SettingsAsset_InternalAddSettingsAsset(CPakFileBuilder* const pak, c
     const bool hasMods = SettingsAsset_ParseMods(setHdr, layoutAsset, settingsMemory, modCache, settings);
 
     const size_t assetNameBufLen = strlen(assetPath)+1;
-    settingsMemory.stringBufSize += assetNameBufLen;
+    settingsMemory.stringBufSize = settingsMemory.stringPool.GetSize() + assetNameBufLen;
 
     settingsMemory.InitCurrentIndices();
     const size_t totalPageSize = settingsMemory.GetTotalBufferSize();
@@ -720,8 +718,9 @@ static void SettingsAsset_InternalAddSettingsAsset(CPakFileBuilder* const pak, c
     pak->AddPointer(hdrLump, offsetof(SettingsAssetHeader_s, valueData), dataLump, settingsMemory.valueBufIndex);
     pak->AddPointer(hdrLump, offsetof(SettingsAssetHeader_s, name), dataLump, assetNameOffset);
 
-    const size_t stringBufferBase = settingsMemory.curStringBufIndex;
-    pak->AddPointer(hdrLump, offsetof(SettingsAssetHeader_s, stringData), dataLump, stringBufferBase);
+    pak->AddPointer(hdrLump, offsetof(SettingsAssetHeader_s, stringData), dataLump, settingsMemory.stringBufIndex);
+    settingsMemory.stringPool.Write(&dataLump.data[settingsMemory.stringBufIndex]);
+    StringPool_AddStats(settingsMemory.stringPool.GetStats());
 
     SettingsAsset_WriteValues(layoutAsset, settingsAsset, settingsMemory, asset, pak, dataLump);
 
@@ -731,7 +730,7 @@ static void SettingsAsset_InternalAddSettingsAsset(CPakFileBuilder* const pak, c
         pak->AddPointer(hdrLump, offsetof(SettingsAssetHeader_s, modValues), dataLump, settingsMemory.curModValuesBufIndex);
 
         SettingsAsset_WriteModNames(modCache, pak, settingsMemory, dataLump);
-        SettingsAsset_WriteModValues(modCache, stringBufferBase, settingsMemory, dataLump);
+        SettingsAsset_WriteModValues(modCache, settingsMemory, dataLump);
     }
 
     asset.InitAsset(hdrLump.GetPointer(), sizeof(SettingsAssetHeader_s), PagePtr_t::NullPtr(), STGS_VERSION, AssetType::STGS);
@@ -1,10 +1,16 @@
 #include "pch.h"
 #include "assets.h"
 #include "public/settings_layout.h"
+#include "utils/parallel.h"
+#include <mutex>
 
-// Maximum number of retries to find a good hashing configuration
-// with the least amount of collisions.
-#define SETTINGS_LAYOUT_MAX_HASH_RETRIES 128
+// Number of hashing configurations to try, the one with the shortest
+// probe lengths is used. The first 128 were the only ones tried before,
+// so the results can only get better.
+#define SETTINGS_LAYOUT_HASH_CANDIDATES 1024
+
+// Layouts with fewer fields are searched on the calling thread.
+#define SETTINGS_LAYOUT_PARALLEL_HASH_MIN_FIELDS 64
 
 uint32_t SettingsLayout_GetFieldSizeForType(const SettingsFieldType_e type)
 {
@@ -276,90 +282,136 @@ static uint32_t SettingsFieldFinder_HashFieldName(const char* const name, const
     return hash ^ (hash >> 4);
 }
 
-static uint32_t SettingsFieldFinder_GetFieldNameBucket(const char* const name, const uint32_t stepScale, const uint32_t seed, const uint32_t tableSize)
+struct SettingsLayoutHashCandidate_s
+{
+    uint32_t totalProbes;
+    uint32_t maxProbes;
+};
+
+// Places the fields into the hash table the way the runtime expects them, and
+// returns the linear probe lengths it takes to find them. The bucket of each
+// field is written to bucketMap if it isn't null. Doesn't allocate if the
+// scratch buffer is large enough already.
+static SettingsLayoutHashCandidate_s SettingsLayout_PlaceFields(const std::vector<uint32_t>& nameHashes, const uint32_t numBuckets,
+    std::vector<uint8_t>& occupied, uint32_t* const bucketMap)
 {
-    const uint32_t hash = SettingsFieldFinder_HashFieldName(name, stepScale, seed);
-    const uint32_t bucketMask = tableSize - 1;
+    const uint32_t bucketMask = numBuckets - 1;
+    occupied.assign(numBuckets, false);
+
+    SettingsLayoutHashCandidate_s result = { 0, 0 };
+
+    for (size_t i = 0; i < nameHashes.size(); i++)
+    {
+        const uint32_t bucket = nameHashes[i] & bucketMask;
+        uint32_t probes = 1;
+
+        // Note(amos): collisions are expected, the game does linear
+        // probing to minimize the number of string comparisons while
+        // trying to solve these. We must place our field contiguously
+        // after the colliding bucket index, at the first free bucket
+        // as the lookup in SettingsFieldFinder_FindFieldByName() stops
+        // when it encounters an empty bucket.
+        while (occupied[(bucket + probes - 1) & bucketMask])
+            probes++;
+
+        const uint32_t placedBucket = (bucket + probes - 1) & bucketMask;
+        occupied[placedBucket] = true;
+
+        if (bucketMap)
+            bucketMap[i] = placedBucket;
 
-    return hash & bucketMask;
+        result.totalProbes += probes;
+
+        if (probes > result.maxProbes)
+            result.maxProbes = probes;
+    }
+
+    return result;
 }
 
 static void SettingsLayout_ComputeHashParameters(SettingsLayoutParseResult_s& result)
 {
     const size_t numFields = result.fieldNames.size();
-
     const uint32_t numBuckets = static_cast<uint32_t>(NextPowerOfTwo(numFields + 1));
-    const uint32_t bucketMask = numBuckets - 1;
 
-    uint32_t bestStepScale = 1;
-    uint32_t bestSeed = 0;
-    uint32_t minCollisions = UINT32_MAX; // Track the minimum number of collisions.
+    // Candidates are scored on the probe lengths of the runtime's lookup, the
+    // sum of all of them is the expected length times the field count.
+    std::vector<SettingsLayoutHashCandidate_s> candidates(SETTINGS_LAYOUT_HASH_CANDIDATES);
 
-    std::vector<uint32_t> bestBucketMap(numFields, 0);
-
-    for (uint32_t retryCount = 0; retryCount < SETTINGS_LAYOUT_MAX_HASH_RETRIES; retryCount++)
+    const auto evaluateCandidate = [&](const size_t candidateIndex, std::vector<uint32_t>& nameHashes, std::vector<uint8_t>& occupied)
     {
-        const uint32_t currentStepScale = retryCount * 2 + 1;
-        const uint32_t currentSeed = retryCount;
-
-        std::vector<bool> collisionVec(numBuckets, false);
-        std::vector<uint32_t> bucketMap(numFields, 0);
+        const uint32_t stepScale = static_cast<uint32_t>(candidateIndex) * 2 + 1;
+        const uint32_t seed = static_cast<uint32_t>(candidateIndex);
 
-        uint32_t currentCollisions = 0;
+        nameHashes.resize(numFields);
 
         for (size_t i = 0; i < numFields; i++)
-        {
-            const std::string& fieldName = result.fieldNames[i];
-            const uint32_t bucket = SettingsFieldFinder_GetFieldNameBucket(fieldName.c_str(), currentStepScale, currentSeed, numBuckets);
+            nameHashes[i] = SettingsFieldFinder_HashFieldName(result.fieldNames[i].c_str(), stepScale, seed);
 
-            if (collisionVec[bucket])
-            {
-                currentCollisions++;
-
-                // Note(amos): collisions are expected, the game does linear
-                // probing to minimize the number of string comparisons while
-                // trying to solve these. We must place our field contiguously
-                // after the colliding bucket index, at the first free bucket
-                // as the lookup in SettingsFieldFinder_FindFieldByName() stops
-                // when it encounters an empty bucket.
-                for (size_t j = 1; j < numBuckets; j++)
-                {
-                    const uint32_t curBucket = (bucket+j) & bucketMask;
-
-                    if (collisionVec[curBucket])
-                        continue;
+        candidates[candidateIndex] = SettingsLayout_PlaceFields(nameHashes, numBuckets, occupied, nullptr);
+    };
 
-                    collisionVec[curBucket] = true;
-                    bucketMap[i] = curBucket;
+    // Spawning the workers costs more than the search itself on small layouts.
+    if (numFields < SETTINGS_LAYOUT_PARALLEL_HASH_MIN_FIELDS)
+    {
+        std::vector<uint32_t> nameHashes;
+        std::vector<uint8_t> occupied;
 
-                    break;
-                }
-            }
-            else
+        for (size_t i = 0; i < SETTINGS_LAYOUT_HASH_CANDIDATES; i++)
+            evaluateCandidate(i, nameHashes, occupied);
+    }
+    else
+    {
+        Parallel_For(SETTINGS_LAYOUT_HASH_CANDIDATES, [&](const size_t candidateIndex)
             {
-                collisionVec[bucket] = true;
-                bucketMap[i] = bucket;
-            }
-        }
+                // Reused between the candidates evaluated by the same worker.
+                thread_local std::vector<uint32_t> nameHashes;
+                thread_local std::vector<uint8_t> occupied;
 
-        // Check if this configuration is better than the previous best.
-        if (currentCollisions < minCollisions)
-        {
-            minCollisions = currentCollisions;
-            bestStepScale = currentStepScale;
-            bestSeed = currentSeed;
+                evaluateCandidate(candidateIndex, nameHashes, occupied);
+            });
+    }
 
-            bestBucketMap = bucketMap;
+    // Lowest candidate index wins ties, so the result is deterministic.
+    size_t bestIndex = 0;
 
-            if (minCollisions == 0)
-                break; // No collisions at all, stop early.
-        }
+    for (size_t i = 1; i < candidates.size(); i++)
+    {
+        const SettingsLayoutHashCandidate_s& best = candidates[bestIndex];
+        const SettingsLayoutHashCandidate_s& cur = candidates[i];
+
+        if (cur.totalProbes < best.totalProbes || (cur.totalProbes == best.totalProbes && cur.maxProbes < best.maxProbes))
+            bestIndex = i;
     }
 
-    result.bucketMap = std::move(bestBucketMap);
     result.hashTableSize = numBuckets;
-    result.hashStepScale = bestStepScale;
-    result.hashSeed = bestSeed;
+    result.hashStepScale = static_cast<uint32_t>(bestIndex) * 2 + 1;
+    result.hashSeed = static_cast<uint32_t>(bestIndex);
+
+    std::vector<uint32_t> nameHashes(numFields);
+
+    for (size_t i = 0; i < numFields; i++)
+        nameHashes[i] = SettingsFieldFinder_HashFieldName(result.fieldNames[i].c_str(), result.hashStepScale, result.hashSeed);
+
+    std::vector<uint8_t> occupied;
+    result.bucketMap.resize(numFields);
+
+    const SettingsLayoutHashCandidate_s placement = SettingsLayout_PlaceFields(nameHashes, numBuckets, occupied, result.bucketMap.data());
+
+    result.hashTotalProbes = placement.totalProbes;
+    result.hashMaxProbes = placement.maxProbes;
+}
+
+static void SettingsLayout_LogHashStatsRecursive(const SettingsLayoutAsset_s& layoutAsset, const std::string& layoutName)
+{
+    const SettingsLayoutParseResult_s& root = layoutAsset.rootLayout;
+    const size_t numFields = root.fieldNames.size();
+
+    Debug("Settings layout \"%s\" hashes %zu fields into %u buckets; average probe length %.3f, max %u.\n", layoutName.c_str(),
+        numFields, root.hashTableSize, numFields ? static_cast<double>(root.hashTotalProbes) / numFields : 0.0, root.hashMaxProbes);
+
+    for (size_t i = 0; i < layoutAsset.subLayouts.size(); i++)
+        SettingsLayout_LogHashStatsRecursive(layoutAsset.subLayouts[i], layoutName + "[" + std::to_string(i) + "]");
 }
 
 static void SettingsLayout_ComputeHashParametersRecursive(SettingsLayoutAsset_s& layoutAsset)
@@ -590,10 +642,72 @@ static void SettingsLayout_BuildOffsetMap(SettingsLayoutAsset_s& layoutAsset)
     }
 }
 
-void SettingsLayout_ParseLayout(CPakFileBuilder* const pak, const char* const assetPath, SettingsLayoutAsset_s& layoutAsset)
+static void SettingsLayout_BuildFieldNameMap(SettingsLayoutAsset_s& layoutAsset)
 {
-    SettingsLayout_ParseMap(pak, assetPath, layoutAsset);
-    SettingsLayout_BuildOffsetMap(layoutAsset);
+    for (SettingsLayoutAsset_s& subLayout : layoutAsset.subLayouts)
+        SettingsLayout_BuildFieldNameMap(subLayout);
+
+    SettingsLayoutParseResult_s& root = layoutAsset.rootLayout;
+
+    const uint32_t numFields = static_cast<uint32_t>(root.fieldNames.size());
+    root.nextOccurrenceMap.assign(numFields, UINT32_MAX);
+
+    // Last occurrence of each name seen so far, to append to the chain.
+    std::unordered_map<std::string_view, uint32_t> lastOccurrences;
+
+    for (uint32_t i = 0; i < numFields; i++)
+    {
+        const std::string& fieldName = root.fieldNames[i];
+        const auto it = lastOccurrences.try_emplace(fieldName, i);
+
+        if (it.second)
+            root.fieldNameMap.emplace(fieldName, i);
+        else
+        {
+            root.nextOccurrenceMap[it.first->second] = i;
+            it.first->second = i;
+        }
+    }
+}
+
+// Parsed layouts keyed by their file path. Entries are never modified or
+// removed once added until the cache is cleared at the end of the build, so
+// references to them remain valid while assets are being added.
+static std::unordered_map<std::string, std::unique_ptr<const SettingsLayoutAsset_s>> s_settingsLayoutCache;
+static std::mutex s_settingsLayoutCacheMutex;
+
+const SettingsLayoutAsset_s& SettingsLayout_GetLayout(CPakFileBuilder* const pak, const char* const assetPath)
+{
+    const std::string layoutFilePath = pak->GetAssetPath() + assetPath;
+
+    {
+        std::lock_guard<std::mutex> lock(s_settingsLayoutCacheMutex);
+        const auto it = s_settingsLayoutCache.find(layoutFilePath);
+
+        if (it != s_settingsLayoutCache.end())
+            return *it->second;
+    }
+
+    std::unique_ptr<SettingsLayoutAsset_s> layoutAsset = std::make_unique<SettingsLayoutAsset_s>();
+
+    SettingsLayout_ParseMap(pak, assetPath, *layoutAsset);
+    SettingsLayout_BuildOffsetMap(*layoutAsset);
+    SettingsLayout_ComputeHashParametersRecursive(*layoutAsset);
+    SettingsLayout_BuildFieldNameMap(*layoutAsset);
+    SettingsLayout_LogHashStatsRecursive(*layoutAsset, assetPath);
+
+    std::lock_guard<std::mutex> lock(s_settingsLayoutCacheMutex);
+
+    // If another thread parsed it in the meantime, use that one as it might
+    // already be referenced.
+    const auto it = s_settingsLayoutCache.try_emplace(layoutFilePath, std::move(layoutAsset));
+    return *it.first->second;
+}
+
+void SettingsLayout_ClearCache()
+{
+    std::lock_guard<std::mutex> lock(s_settingsLayoutCacheMutex);
+    s_settingsLayoutCache.clear();
 }
 
 static void SettingsLayout_InitializeHeader(SettingsLayoutHeader_s* const header, const SettingsLayoutParseResult_s& parse)
@@ -636,9 +750,20 @@ struct SettingsLayoutMemory_s
     size_t curStringBufIndex;
 };
 
-static void SettingsLayout_CalculateBufferSizes(SettingsLayoutAsset_s& layoutAsset, SettingsLayoutMemory_s& layoutMemory, size_t& bufBaseIndexer, const bool isInitialRoot)
+// Write cursors for the sub headers of a layout, the tree mirrors that of
+// the layout as the cached layouts themselves are immutable.
+struct SettingsLayoutWriteState_s
+{
+    size_t subHeadersBufBase;
+    size_t curSubHeaderBufIndex;
+
+    std::vector<SettingsLayoutWriteState_s> subStates;
+};
+
+static void SettingsLayout_CalculateBufferSizes(const SettingsLayoutAsset_s& layoutAsset, SettingsLayoutWriteState_s& writeState,
+    SettingsLayoutMemory_s& layoutMemory, size_t& bufBaseIndexer, const bool isInitialRoot)
 {
-    SettingsLayoutParseResult_s& rootParseResult = layoutAsset.rootLayout;
+    const SettingsLayoutParseResult_s& rootParseResult = layoutAsset.rootLayout;
 
     layoutMemory.outFieldBufSize += (rootParseResult.hashTableSize * sizeof(SettingsField_s));
 
@@ -666,13 +791,17 @@ static void SettingsLayout_CalculateBufferSizes(SettingsLayoutAsset_s& layoutAss
 
     const size_t subLayoutCount = layoutAsset.subLayouts.size();
 
+    writeState.subHeadersBufBase = 0;
+    writeState.curSubHeaderBufIndex = 0;
+    writeState.subStates.resize(subLayoutCount);
+
     if (subLayoutCount > 0)
     {
-        rootParseResult.subHeadersBufBase = bufBaseIndexer;
+        writeState.subHeadersBufBase = bufBaseIndexer;
         bufBaseIndexer += layoutAsset.subLayouts.size() * sizeof(SettingsLayoutHeader_s);
 
-        for (SettingsLayoutAsset_s& subLayout : layoutAsset.subLayouts)
-            SettingsLayout_CalculateBufferSizes(subLayout, layoutMemory, bufBaseIndexer, false);
+        for (size_t i = 0; i < subLayoutCount; i++)
+            SettingsLayout_CalculateBufferSizes(layoutAsset.subLayouts[i], writeState.subStates[i], layoutMemory, bufBaseIndexer, false);
     }
 }
 
@@ -722,10 +851,10 @@ static void SettingsLayout_WriteFieldData(PakPageLump_s& dataLump, const Setting
     layoutMemory.curFieldMapIndex += parse.fieldNames.size() * sizeof(SettingsFieldMap_s);
 }
 
-static void SettingsLayout_WriteLayoutRecursive(CPakFileBuilder* const pak, SettingsLayoutAsset_s& layoutAsset,
-    SettingsLayoutMemory_s& layoutMemory, PakPageLump_s& dataLump, SettingsLayoutParseResult_s* const parent)
+static void SettingsLayout_WriteLayoutRecursive(CPakFileBuilder* const pak, const SettingsLayoutAsset_s& layoutAsset, SettingsLayoutWriteState_s& writeState,
+    SettingsLayoutMemory_s& layoutMemory, PakPageLump_s& dataLump, SettingsLayoutWriteState_s* const parent)
 {
-    SettingsLayoutParseResult_s& parse = layoutAsset.rootLayout;
+    const SettingsLayoutParseResult_s& parse = layoutAsset.rootLayout;
 
     if (parent)
     {
@@ -742,7 +871,7 @@ static void SettingsLayout_WriteLayoutRecursive(CPakFileBuilder* const pak, Sett
 
         if (!layoutAsset.subLayouts.empty())
         {
-            const size_t subIndex = layoutMemory.subHeadersBufIndex + parse.subHeadersBufBase + parse.curSubHeaderBufIndex;
+            const size_t subIndex = layoutMemory.subHeadersBufIndex + writeState.subHeadersBufBase + writeState.curSubHeaderBufIndex;
             pak->AddPointer(dataLump, rootIndex + offsetof(SettingsLayoutHeader_s, subHeaders), dataLump, subIndex);
         }
     }
@@ -751,24 +880,22 @@ static void SettingsLayout_WriteLayoutRecursive(CPakFileBuilder* const pak, Sett
     size_t numRootStringBufBytes = 1;
     SettingsLayout_WriteFieldData(dataLump, parse, numRootStringBufBytes, layoutMemory);
 
-    for (SettingsLayoutAsset_s& subLayout : layoutAsset.subLayouts)
-        SettingsLayout_WriteLayoutRecursive(pak, subLayout, layoutMemory, dataLump, &parse);
+    for (size_t i = 0; i < layoutAsset.subLayouts.size(); i++)
+        SettingsLayout_WriteLayoutRecursive(pak, layoutAsset.subLayouts[i], writeState.subStates[i], layoutMemory, dataLump, &writeState);
 }
 
 static void SettingsLayout_InternalAddLayoutAsset(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath)
 {
-    SettingsLayoutAsset_s layoutAsset;
-    SettingsLayout_ParseLayout(pak, assetPath, layoutAsset);
+    const SettingsLayoutAsset_s& layoutAsset = SettingsLayout_GetLayout(pak, assetPath);
 
     PakAsset_t& asset = pak->BeginAsset(assetGuid, assetPath);
     PakPageLump_s hdrLump = pak->CreatePageLump(sizeof(SettingsLayoutHeader_s), SF_HEAD, 8);
 
-    SettingsLayout_ComputeHashParametersRecursive(layoutAsset);
-
     SettingsLayoutMemory_s layoutMemory{};
+    SettingsLayoutWriteState_s writeState;
     size_t headersBufIndexer = 0;
 
-    SettingsLayout_CalculateBufferSizes(layoutAsset, layoutMemory, headersBufIndexer, true);
+    SettingsLayout_CalculateBufferSizes(layoutAsset, writeState, layoutMemory, headersBufIndexer, true);
 
     // The asset name is only stored for the root layout.
     const size_t assetNameBufLen = strlen(assetPath) + 1;
@@ -793,7 +920,7 @@ static void SettingsLayout_InternalAddLayoutAsset(CPakFileBuilder* const pak, co
     if (!layoutAsset.subLayouts.empty())
         pak->AddPointer(hdrLump, offsetof(SettingsLayoutHeader_s, subHeaders), dataLump, layoutMemory.subHeadersBufIndex);
 
-    SettingsLayout_WriteLayoutRecursive(pak, layoutAsset, layoutMemory, dataLump, nullptr);
+    SettingsLayout_WriteLayoutRecursive(pak, layoutAsset, writeState, layoutMemory, dataLump, nullptr);
 
     asset.InitAsset(hdrLump.GetPointer(), sizeof(SettingsLayoutHeader_s), PagePtr_t::NullPtr(), STLT_VERSION, AssetType::STLT);
     asset.SetHeaderPointer(hdrLump.data);
@@ -3,6 +3,37 @@
 #include "public/shader.h"
 #include "public/multishader.h"
 #include "utils/dxutils.h"
+#include "utils/MurmurHash3.h"
+
+#define SHADER_BYTECODE_HASH_SEED 0x165DCA75
+
+struct ShaderByteCodeKey_s
+{
+	bool operator==(const ShaderByteCodeKey_s& other) const
+	{
+		return hash[0] == other.hash[0] && hash[1] == other.hash[1] && size == other.size;
+	}
+
+	uint64_t hash[2];
+	uint32_t size;
+};
+
+struct ShaderByteCodeKeyHash_s
+{
+	size_t operator()(const ShaderByteCodeKey_s& key) const
+	{
+		return static_cast<size_t>(key.hash[0]);
+	}
+};
+
+// Bytecode lumps added in the current build, shared by all shader assets
+// that contain the same bytecode.
+static std::unordered_map<ShaderByteCodeKey_s, PakPageLump_s, ShaderByteCodeKeyHash_s> s_shaderByteCodeLumps;
+
+static size_t s_shaderStrippedBytes = 0;
+
+static size_t s_shaderTotalBuffers = 0;
+static size_t s_shaderDeduplicatedBytes = 0;
 
 static void Shader_LoadFromMSW(CPakFileBuilder* const pak, const char* const assetPath, CMultiShaderWrapperIO::ShaderCache_t& shaderCache)
 {
@@ -12,10 +43,10 @@ static void Shader_LoadFromMSW(CPakFileBuilder* const pak, const char* const ass
 
 template <typename ShaderAssetHeader_t>
 static void Shader_CreateFromMSW(CPakFileBuilder* const pak, PakPageLump_s& cpuDataChunk, ParsedDXShaderData_t* const firstShaderData,
-								const CMultiShaderWrapperIO::Shader_t* shader, PakPageLump_s& hdrChunk, ShaderAssetHeader_t* const hdr)
+								CMultiShaderWrapperIO::Shader_t* const shader, PakPageLump_s& hdrChunk, ShaderAssetHeader_t* const hdr)
 {
 	const size_t numShaderBuffers = shader->entries.size();
-	size_t totalShaderDataSize = 0;
+	bool hasShaderData = false;
 
 	for (auto& it : shader->entries)
 	{
@@ -34,25 +65,20 @@ static void Shader_CreateFromMSW(CPakFileBuilder* const pak, PakPageLump_s& cpuD
 			}
 		}
 
-		totalShaderDataSize += IALIGN(it.size, 8);
+		hasShaderData = true;
 	}
-	assert(totalShaderDataSize != 0);
+	assert(hasShaderData);
+	UNUSED(hasShaderData);
 
 	const int8_t entrySize = hdr->type == eShaderType::Vertex ? 24 : 16;
 
 	// Size of the data that describes each shader bytecode buffer
 	const size_t descriptorSize = numShaderBuffers * entrySize;
-
-	const size_t shaderBufferChunkSize = descriptorSize + totalShaderDataSize;
-	cpuDataChunk = pak->CreatePageLump(shaderBufferChunkSize, SF_CPU | SF_TEMP, 8);
-
-	// Offset at which the next bytecode buffer will be written.
-	// Initially starts at the end of the descriptors and then gets increased every time a buffer is written.
-	size_t nextBytecodeBufferOffset = descriptorSize;
+	cpuDataChunk = pak->CreatePageLump(descriptorSize, SF_CPU | SF_TEMP, 8);
 
 	for (size_t i = 0; i < numShaderBuffers; ++i)
 	{
-		const CMultiShaderWrapperIO::ShaderEntry_t& entry = shader->entries[i];
+		CMultiShaderWrapperIO::ShaderEntry_t& entry = shader->entries[i];
 
 		ShaderByteCode_t* bc = reinterpret_cast<ShaderByteCode_t*>(cpuDataChunk.data + (i * entrySize));
 
@@ -60,18 +86,73 @@ static void Shader_CreateFromMSW(CPakFileBuilder* const pak, PakPageLump_s& cpuD
 		{
 			assert(entry.size > 0);
 
+			// The bytecode buffers are allocated by the MSW parser, adopt them
+			// into their own lumps instead of copying them after the
+			// descriptors. Buffers not owned by the entry must be copied as
+			// their lifetime isn't guaranteed to match the pak's.
+			// 
+			// Each lump is padded to 8 bytes, which is the same padding the
+			// contiguous layout applied between buffers. The buffers are no
+			// longer guaranteed to follow the descriptors however, as a lump
+			// that doesn't fit the current page is placed in another one.
+			char* ownedBuffer = entry.DetachBuffer();
+
+			if (!ownedBuffer)
+			{
+				ownedBuffer = new char[entry.size];
+				memcpy_s(ownedBuffer, entry.size, entry.buffer, entry.size);
+
+				entry.buffer = ownedBuffer;
+			}
+
+			if (pak->IsFlagSet(PF_STRIP_SHADERS))
+			{
+				// The container is rebuilt in place, the entry keeps pointing
+				// to the same buffer so its size must be updated as well.
+				const uint32_t strippedSize = DXUtils::StripShaderByteCode(ownedBuffer, entry.size);
+
+				s_shaderStrippedBytes += entry.size - strippedSize;
+				entry.size = strippedSize;
+			}
+
+			ShaderByteCodeKey_s key;
+			MurmurHash3_x64_128(ownedBuffer, entry.size, SHADER_BYTECODE_HASH_SEED, key.hash);
+			key.size = entry.size;
+
+			PakPageLump_s bytecodeChunk;
+			const auto it = s_shaderByteCodeLumps.find(key);
+
+			if (it != s_shaderByteCodeLumps.end())
+			{
+				// Identical bytecode has already been added by this or another
+				// shader asset, point to that copy instead.
+				bytecodeChunk = it->second;
+
+				delete[] ownedBuffer;
+				entry.buffer = bytecodeChunk.data;
+
+				s_shaderDeduplicatedBytes += entry.size;
+			}
+			else
+			{
+				bytecodeChunk = pak->CreatePageLump(entry.size, SF_CPU | SF_TEMP, 8, ownedBuffer);
+				s_shaderByteCodeLumps.emplace(key, bytecodeChunk);
+			}
+
+			s_shaderTotalBuffers++;
+
 			// Register the data pointer at the byte code.
-			pak->AddPointer(cpuDataChunk, (i * entrySize) + offsetof(ShaderByteCode_t, data), cpuDataChunk, nextBytecodeBufferOffset);
+			pak->AddPointer(cpuDataChunk, (i * entrySize) + offsetof(ShaderByteCode_t, data), bytecodeChunk, 0);
 			bc->dataSize = entry.size;
 
+			// The input signature aliases the whole buffer, which is still
+			// valid after stripping as the signature blobs are kept. It also
+			// aliases the shared copy if the bytecode was deduplicated.
 			if (hdr->type == eShaderType::Vertex)
 			{
-				pak->AddPointer(cpuDataChunk, (i * entrySize) + offsetof(ShaderByteCode_t, inputSignatureBlob), cpuDataChunk, nextBytecodeBufferOffset);
+				pak->AddPointer(cpuDataChunk, (i * entrySize) + offsetof(ShaderByteCode_t, inputSignatureBlob), bytecodeChunk, 0);
 				bc->inputSignatureBlobSize = bc->dataSize;
 			}
-
-			memcpy_s(cpuDataChunk.data + nextBytecodeBufferOffset, entry.size, entry.buffer, entry.size);
-			nextBytecodeBufferOffset += IALIGN(entry.size, 8);
 		}
 		else
 		{
@@ -114,6 +195,36 @@ static void Shader_CreateFromMSW(CPakFileBuilder* const pak, PakPageLump_s& cpuD
 	}
 }
 
+//-----------------------------------------------------------------------------
+// purpose: logs how many bytes were stripped and deduplicated from the shader
+//          bytecode in the current build, and resets the statistics for the
+//          next one
+//-----------------------------------------------------------------------------
+void Shader_LogBuildStats()
+{
+	if (s_shaderStrippedBytes)
+		Log("*** stripped %.2f KiB of debug and reflection data from shader bytecode.\n", s_shaderStrippedBytes / 1024.0);
+
+	if (s_shaderTotalBuffers)
+	{
+		Log("*** %zu of %zu shader bytecode buffers were unique; deduplication saved %.2f KiB.\n",
+			s_shaderByteCodeLumps.size(), s_shaderTotalBuffers, s_shaderDeduplicatedBytes / 1024.0);
+	}
+
+	s_shaderStrippedBytes = 0;
+	s_shaderTotalBuffers = 0;
+	s_shaderDeduplicatedBytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: forgets the bytecode lumps of the current build, as these can't be
+//          referenced from another pak
+//-----------------------------------------------------------------------------
+void Shader_ClearByteCodeCache()
+{
+	s_shaderByteCodeLumps.clear();
+}
+
 static void Shader_SetupHeader(ShaderAssetHeader_v8_t* const hdr, const CMultiShaderWrapperIO::Shader_t* const shader)
 {
 	// Set to invalid so we can update it when a buffer is found, and detect that it has been set.
@@ -129,7 +240,7 @@ static void Shader_SetupHeader(ShaderAssetHeader_v12_t* const hdr, const CMultiS
 }
 
 template<typename ShaderAssetHeader_t>
-static void Shader_InternalAddShader(CPakFileBuilder* const pak, const char* const assetPath, const CMultiShaderWrapperIO::Shader_t* const shader, 
+static void Shader_InternalAddShader(CPakFileBuilder* const pak, const char* const assetPath, CMultiShaderWrapperIO::Shader_t* const shader, 
 									const PakGuid_t shaderGuid, const int assetVersion)
 {
 	PakAsset_t& asset = pak->BeginAsset(shaderGuid, assetPath);
@@ -170,17 +281,17 @@ static void Shader_InternalAddShader(CPakFileBuilder* const pak, const char* con
 	pak->FinishAsset();
 }
 
-static void Shader_AddShaderV8(CPakFileBuilder* const pak, const char* const assetPath, const CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid)
+static void Shader_AddShaderV8(CPakFileBuilder* const pak, const char* const assetPath, CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid)
 {
 	Shader_InternalAddShader<ShaderAssetHeader_v8_t>(pak, assetPath, shader, shaderGuid, 8);
 }
 
-static void Shader_AddShaderV12(CPakFileBuilder* const pak, const char* const assetPath, const CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid)
+static void Shader_AddShaderV12(CPakFileBuilder* const pak, const char* const assetPath, CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid)
 {
 	Shader_InternalAddShader<ShaderAssetHeader_v12_t>(pak, assetPath, shader, shaderGuid, 12);
 }
 
-bool Shader_AutoAddShader(CPakFileBuilder* const pak, const char* const assetPath, const CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid, const int shaderAssetVersion)
+bool Shader_AutoAddShader(CPakFileBuilder* const pak, const char* const assetPath, CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid, const int shaderAssetVersion)
 {
 	PakAsset_t* const existingAsset = pak->GetAssetByGuid(shaderGuid, nullptr, true);
 
@@ -43,9 +43,9 @@ static void ShaderSet_SetInputSlots(ShaderSetAssetHeader_t* const hdr, PakAsset_
 	*inputCount = textureCount;
 }
 
-extern bool Shader_AutoAddShader(CPakFileBuilder* const pak, const char* const assetPath, const CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid, const int shaderAssetVersion);
+extern bool Shader_AutoAddShader(CPakFileBuilder* const pak, const char* const assetPath, CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid, const int shaderAssetVersion);
 
-static void ShaderSet_AutoAddEmbeddedShader(CPakFileBuilder* const pak, const CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid, const int assetVersion)
+static void ShaderSet_AutoAddEmbeddedShader(CPakFileBuilder* const pak, CMultiShaderWrapperIO::Shader_t* const shader, const PakGuid_t shaderGuid, const int assetVersion)
 {
 	if (shader)
 	{
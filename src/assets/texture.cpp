@@ -1,13 +1,29 @@
 #include "pch.h"
 #include "assets.h"
 #include "utils/dxutils.h"
+#include "utils/mappedfile.h"
+#include "utils/imageloader.h"
+#include "utils/bcencoder.h"
+#include "utils/mipgen.h"
 #include "public/texture.h"
 
+#include <queue>
+
 #define TEXTURE_RESOURCE_FLAGS_FIELD "resourceFlags"
 #define TEXTURE_USAGE_FLAGS_FIELD "usageFlags"
 #define TEXTURE_MIP_INFO_FIELD "mipInfo"
 #define TEXTURE_STREAM_LAYOUT_FIELD "streamLayout"
 
+#define TEXTURE_RAW_FORMAT_FIELD "$format"
+#define TEXTURE_RAW_QUALITY_FIELD "$compressQuality"
+#define TEXTURE_GENERATE_MIPS_FIELD "$generateMips"
+#define TEXTURE_MIP_FILTER_FIELD "$mipFilter"
+
+#define TEXTURE_ATLAS_DEFAULT_FORMAT "BC7_UNORM_SRGB"
+
+#define TEXTURE_PERMANENT_BUDGET_FIELD "texturePermanentBudget"
+#define TEXTURE_MANDATORY_BUDGET_FIELD "textureMandatoryBudget"
+
 static void Texture_ValidateMetadataArray(const rapidjson::Value& arrayValue, const int totalMipCount, const char* const fieldName)
 {
     if (!JSON_IsOfType(arrayValue, JSONFieldType_e::kArray))
@@ -37,53 +53,62 @@ static mipType_e Texture_GetMipTypeFromName(const char* const typeName)
     return mipType_e::INVALID;
 }
 
-// If the texture has additional metadata, parse it.
-static void Texture_ProcessMetaData(CPakFileBuilder* const pak, const char* const assetPath, 
-                                    TextureAssetHeader_t* const hdr, const int totalMipCount, std::vector<mipType_e>& streamLayout)
+// Parses the stream layout from the texture metadata, returns false if the
+// metadata has no stream layout.
+static bool Texture_ParseStreamLayout(const rapidjson::Value& document, const int totalMipCount, std::vector<mipType_e>& streamLayout)
 {
-    const std::string metaFilePath = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".json");
-    rapidjson::Document document;
+    rapidjson::Value::ConstMemberIterator streamLayoutIt;
 
-    if (!JSON_ParseFromFile(metaFilePath.c_str(), "texture metadata", document, false))
-        return;
+    if (!JSON_GetIterator(document, TEXTURE_STREAM_LAYOUT_FIELD, streamLayoutIt))
+        return false;
 
-    rapidjson::Value::ConstMemberIterator streamLayoutIt;
+    Texture_ValidateMetadataArray(streamLayoutIt->value, totalMipCount, TEXTURE_STREAM_LAYOUT_FIELD);
+    const rapidjson::Value::ConstArray& streamLayoutArray = streamLayoutIt->value.GetArray();
 
-    if (JSON_GetIterator(document, TEXTURE_STREAM_LAYOUT_FIELD, streamLayoutIt))
+    // -1 because the first mip isn't counted, it is always permanent.
+    streamLayout.resize(totalMipCount-1);
+
+    // note: unclamped loop and write into dynamic sized array because we
+    // have already confirmed that the texture mip count is sane.
+    uint32_t index = 0;
+
+    for (const js::Value& streamLayoutEntry : streamLayoutArray)
     {
-        Texture_ValidateMetadataArray(streamLayoutIt->value, totalMipCount, TEXTURE_STREAM_LAYOUT_FIELD);
-        const rapidjson::Value::ConstArray& streamLayoutArray = streamLayoutIt->value.GetArray();
+        if (!streamLayoutEntry.IsString())
+            Error("Expected type %s for \"" TEXTURE_MIP_INFO_FIELD "\" #%u, got %s.\n",
+                JSON_TypeToString(JSONFieldType_e::kString), index, JSON_TypeToString(streamLayoutEntry));
 
-        // -1 because the first mip isn't counted, it is always permanent.
-        streamLayout.resize(totalMipCount-1);
+        const char* const mipTypeName = streamLayoutEntry.GetString();
+        const mipType_e mipType = Texture_GetMipTypeFromName(mipTypeName);
 
-        // note: unclamped loop and write into dynamic sized array because we
-        // have already confirmed that the texture mip count is sane.
-        uint32_t index = 0;
+        if (mipType == mipType_e::INVALID)
+            Error("Invalid texture mip type \"%s\" in \"" TEXTURE_MIP_INFO_FIELD "\" #%u; expected one of the following: permanent:mandatory:optional\n.",
+                mipTypeName, index);
 
-        for (const js::Value& streamLayoutEntry : streamLayoutArray)
-        {
-            if (!streamLayoutEntry.IsString())
-                Error("Expected type %s for \"" TEXTURE_MIP_INFO_FIELD "\" #%u, got %s.\n",
-                    JSON_TypeToString(JSONFieldType_e::kString), index, JSON_TypeToString(streamLayoutEntry));
+        // The lookup in Texture_InternalAddTexture happens in reverse,
+        // write it out in reverse here.
+        const uint32_t idx = (totalMipCount - 2) - index++;
+        streamLayout[idx] = mipType;
+    }
 
-            const char* const mipTypeName = streamLayoutEntry.GetString();
-            const mipType_e mipType = Texture_GetMipTypeFromName(mipTypeName);
+    return true;
+}
+
+// If the texture has additional metadata, parse it.
+static void Texture_ProcessMetaData(CPakFileBuilder* const pak, const char* const assetPath, 
+                                    TextureAssetHeader_t* const hdr, const int totalMipCount, std::vector<mipType_e>& streamLayout)
+{
+    const std::string metaFilePath = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".json");
+    const rapidjson::Document* const document = JSON_GetCachedDocument(metaFilePath.c_str(), "texture metadata", false);
 
-            if (mipType == mipType_e::INVALID)
-                Error("Invalid texture mip type \"%s\" in \"" TEXTURE_MIP_INFO_FIELD "\" #%u; expected one of the following: permanent:mandatory:optional\n.",
-                    mipTypeName, index);
+    if (!document)
+        return;
 
-            // The lookup in Texture_InternalAddTexture happens in reverse,
-            // write it out in reverse here.
-            const uint32_t idx = (totalMipCount - 2) - index++;
-            streamLayout[idx] = mipType;
-        }
-    }
+    Texture_ParseStreamLayout(*document, totalMipCount, streamLayout);
 
     rapidjson::Value::ConstMemberIterator mipInfoIt;
 
-    if (JSON_GetIterator(document, TEXTURE_MIP_INFO_FIELD, mipInfoIt))
+    if (JSON_GetIterator(*document, TEXTURE_MIP_INFO_FIELD, mipInfoIt))
     {
         Texture_ValidateMetadataArray(mipInfoIt->value, totalMipCount, TEXTURE_MIP_INFO_FIELD);
         const rapidjson::Value::ConstArray& mipInfoArray = mipInfoIt->value.GetArray();
@@ -105,7 +130,7 @@ static void Texture_ProcessMetaData(CPakFileBuilder* const pak, const char* cons
 
     rapidjson::Value::ConstMemberIterator resourceFlagsIt;
 
-    if (JSON_GetIterator(document, TEXTURE_RESOURCE_FLAGS_FIELD, resourceFlagsIt))
+    if (JSON_GetIterator(*document, TEXTURE_RESOURCE_FLAGS_FIELD, resourceFlagsIt))
     {
         int32_t resourceFlags;
 
@@ -117,7 +142,7 @@ static void Texture_ProcessMetaData(CPakFileBuilder* const pak, const char* cons
 
     rapidjson::Value::ConstMemberIterator usageFlagsIt;
 
-    if (JSON_GetIterator(document, TEXTURE_USAGE_FLAGS_FIELD, usageFlagsIt))
+    if (JSON_GetIterator(*document, TEXTURE_USAGE_FLAGS_FIELD, usageFlagsIt))
     {
         int32_t usageFlags;
 
@@ -128,96 +153,936 @@ static void Texture_ProcessMetaData(CPakFileBuilder* const pak, const char* cons
     }
 }
 
-// materialGeneratedTexture - whether this texture's creation was invoked by material automatic texture generation
-static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const bool forceDisableStreaming)
-{
-    PakAsset_t& asset = pak->BeginAsset(assetGuid, assetPath);
+// Returns the unaligned size of the mip level.
+static uint32_t Texture_CalcMipSize(const uint16_t imageFormat, const uint16_t width, const uint16_t height, const unsigned int mipLevel)
+{
+    // subtracts 1 so skip mips w/h at 1
+    uint16_t mipWidth = 0;
+    if (width >> mipLevel > 1)
+        mipWidth = (width >> mipLevel) - 1;
+
+    uint16_t mipHeight = 0;
+    if (height >> mipLevel > 1)
+        mipHeight = (height >> mipLevel) - 1;
+
+    const auto& bytesPerPixel = s_pBytesPerPixel[imageFormat];
+
+    const uint8_t x = bytesPerPixel.x;
+    const uint8_t y = bytesPerPixel.y;
+
+    const uint32_t bppWidth = (y + mipWidth) >> (y >> 1);
+    const uint32_t bppHeight = (y + mipHeight) >> (y >> 1);
+
+    return x * bppWidth * bppHeight;
+}
+
+// Texture ingest statistics, accumulated over all textures of the current build.
+static size_t s_textureIngestBytes = 0;
+static microseconds s_textureIngestTime(0);
+
+// The DDS image of the texture, either mapped from disk or encoded in memory
+// from a raw image source.
+struct TextureSource_s
+{
+    const char* data;
+    size_t size;
+
+    inline bool IsInRange(const size_t offset, const size_t rangeSize) const
+    {
+        return offset <= size && rangeSize <= (size - offset);
+    }
+};
+
+// Copies a range from the DDS image into the buffer, errors if the range lies
+// outside the image.
+static void Texture_CopyFromSource(const TextureSource_s& input, void* const dest, const size_t offset, const size_t size, const char* const filePath)
+{
+    if (!input.IsInRange(offset, size))
+        Error("Texture asset \"%s\" appears truncated; %zu bytes at offset %zu are out of range ( file size = %zu ).\n",
+            filePath, size, offset, input.size);
+
+    memcpy(dest, &input.data[offset], size);
+}
+
+// Options for textures that are encoded in memory, either from a raw image
+// source or from a DDS file whose mips are generated.
+struct TextureEncodeOptions_s
+{
+    BCQuality_e quality;
+    MipFilter_e mipFilter;
+    bool generateMips;
+};
+
+static void Texture_ParseEncodeOptions(const char* const assetPath, const rapidjson::Value* const mapEntry, TextureEncodeOptions_s& options)
+{
+    options.quality = BCQuality_e::Normal;
+    options.mipFilter = MipFilter_e::Box;
+    options.generateMips = false;
+
+    if (!mapEntry)
+        return;
+
+    rapidjson::Value::ConstMemberIterator qualityIt;
+
+    if (JSON_GetIterator(*mapEntry, TEXTURE_RAW_QUALITY_FIELD, JSONFieldType_e::kString, qualityIt)
+        && !BC_ParseQuality(qualityIt->value.GetString(), options.quality))
+    {
+        Error("Texture asset \"%s\" requested invalid compression quality \"%s\"; expected one of the following: fast:normal:high.\n",
+            assetPath, qualityIt->value.GetString());
+    }
+
+    rapidjson::Value::ConstMemberIterator mipFilterIt;
+
+    if (JSON_GetIterator(*mapEntry, TEXTURE_MIP_FILTER_FIELD, JSONFieldType_e::kString, mipFilterIt)
+        && !Mip_ParseFilter(mipFilterIt->value.GetString(), options.mipFilter))
+    {
+        Error("Texture asset \"%s\" requested invalid mip filter \"%s\"; expected one of the following: box:kaiser.\n",
+            assetPath, mipFilterIt->value.GetString());
+    }
+
+    options.generateMips = JSON_GetValueOrDefault(*mapEntry, TEXTURE_GENERATE_MIPS_FIELD, false);
+}
+
+// Sizes the in-memory DDS image to fit the image data, and writes out its DX10
+// headers. Returns the size of the headers, at which the image data starts.
+static size_t Texture_WriteDDSHeader(const DXGI_FORMAT dxgiFormat, const uint32_t width, const uint32_t height, const uint32_t mipCount,
+                                     const uint32_t arraySize, const size_t imageDataSize, std::vector<char>& ddsImage)
+{
+    const size_t headerSize = sizeof(int) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+    ddsImage.resize(headerSize + imageDataSize);
+
+    const int magic = DDS_MAGIC;
+    memcpy(ddsImage.data(), &magic, sizeof(magic));
+
+    DDS_HEADER ddsh{};
+    ddsh.dwSize = sizeof(DDS_HEADER);
+    ddsh.dwWidth = width;
+    ddsh.dwHeight = height;
+    ddsh.dwMipMapCount = mipCount;
+    ddsh.ddspf.dwSize = sizeof(DDS_PIXELFORMAT);
+    ddsh.ddspf.dwFlags = DDS_FOURCC;
+    ddsh.ddspf.dwFourCC = '01XD';
+
+    memcpy(&ddsImage[sizeof(magic)], &ddsh, sizeof(ddsh));
+
+    DDS_HEADER_DXT10 ddsh_dx10{};
+    ddsh_dx10.dxgiFormat = dxgiFormat;
+    ddsh_dx10.resourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+    ddsh_dx10.arraySize = arraySize;
+
+    memcpy(&ddsImage[sizeof(magic) + sizeof(ddsh)], &ddsh_dx10, sizeof(ddsh_dx10));
+
+    return headerSize;
+}
+
+// Reads the headers of the DDS image, returns false if the image is not a
+// valid DDS image. The image data starts at dataOffset.
+static bool Texture_ReadDDSHeader(const TextureSource_s& input, DDS_HEADER& ddsh, DXGI_FORMAT& dxgiFormat, uint32_t& arraySize, size_t& dataOffset)
+{
+    int magic;
+
+    if (!input.IsInRange(0, sizeof(magic) + sizeof(ddsh)))
+        return false;
+
+    memcpy(&magic, input.data, sizeof(magic));
+    memcpy(&ddsh, &input.data[sizeof(magic)], sizeof(ddsh));
+
+    if (magic != DDS_MAGIC)
+        return false;
+
+    dataOffset = sizeof(magic) + sizeof(ddsh);
+    arraySize = 1;
+
+    if (ddsh.ddspf.dwFourCC == '01XD')
+    {
+        DDS_HEADER_DXT10 ddsh_dx10;
+
+        if (!input.IsInRange(dataOffset, sizeof(ddsh_dx10)))
+            return false;
+
+        memcpy(&ddsh_dx10, &input.data[dataOffset], sizeof(ddsh_dx10));
+        dataOffset += sizeof(ddsh_dx10);
+
+        dxgiFormat = ddsh_dx10.dxgiFormat;
+        arraySize = ddsh_dx10.arraySize;
+    }
+    else
+        dxgiFormat = DXUtils::GetFormatFromHeader(ddsh);
+
+    return true;
+}
+
+// Block compresses the image into an in-memory DDS image, along with its mip
+// chain if requested. Color channels of sRGB formats are filtered in linear
+// space.
+static void Texture_BuildDDSImage(const ImageRGBA_s& image, const DXGI_FORMAT dxgiFormat, const TextureEncodeOptions_s& options,
+                                  const char* const sourcePath, std::vector<char>& ddsImage)
+{
+    const uint32_t mipCount = options.generateMips
+        ? (std::min)(Mip_GetFullChainCount(image.width, image.height), static_cast<uint32_t>(MAX_MIPS_PER_TEXTURE))
+        : 1;
+
+    std::vector<ImageRGBA_s> mips;
+
+    if (mipCount > 1)
+    {
+        const steady_clock::time_point start = high_resolution_clock::now();
+        Mip_GenerateChain(image, mipCount, DXUtils::IsSRGB(dxgiFormat), options.mipFilter, mips);
+        const steady_clock::time_point stop = high_resolution_clock::now();
+
+        Debug("-> generated %u mips in %.3f seconds\n", mipCount - 1, duration_cast<microseconds>(stop - start).count() / 1000000.0);
+    }
+
+    size_t totalImageSize = BC_GetImageSize(dxgiFormat, image.width, image.height);
+
+    for (const ImageRGBA_s& mip : mips)
+        totalImageSize += BC_GetImageSize(dxgiFormat, mip.width, mip.height);
+
+    const size_t headerSize = Texture_WriteDDSHeader(dxgiFormat, image.width, image.height, mipCount, 1, totalImageSize, ddsImage);
+
+    // Mips are stored from the largest to the smallest, which is the order in
+    // which Texture_InternalAddTexture expects them.
+    uint8_t* const encoded = reinterpret_cast<uint8_t*>(&ddsImage[headerSize]);
+    size_t encodedOffset = BC_GetImageSize(dxgiFormat, image.width, image.height);
+
+    const steady_clock::time_point start = high_resolution_clock::now();
+    BC_CompressImage(image.pixels.data(), image.width, image.height, dxgiFormat, options.quality, encoded);
+
+    for (const ImageRGBA_s& mip : mips)
+    {
+        BC_CompressImage(mip.pixels.data(), mip.width, mip.height, dxgiFormat, options.quality, &encoded[encodedOffset]);
+        encodedOffset += BC_GetImageSize(dxgiFormat, mip.width, mip.height);
+    }
+
+    const steady_clock::time_point stop = high_resolution_clock::now();
+
+    const double seconds = duration_cast<microseconds>(stop - start).count() / 1000000.0;
+    size_t blockCount = BC_GetBlockCount(image.width, image.height);
+
+    for (const ImageRGBA_s& mip : mips)
+        blockCount += BC_GetBlockCount(mip.width, mip.height);
+
+    // Only the base level is compared, as the mips have no reference image.
+    const double psnr = BC_ComputePSNR(image.pixels.data(), image.width, image.height, dxgiFormat, encoded);
+
+    Log("Encoded \"%s\" to %s in %.3f seconds ( %.0f blocks/s, PSNR %.2f dB ).\n", sourcePath,
+        DXUtils::GetFormatAsString(dxgiFormat), seconds, seconds > 0.0 ? blockCount / seconds : 0.0, psnr);
+}
+
+// Loads the PNG or TGA image of the texture, and block compresses it into an
+// in-memory DDS image using the format requested by the map entry.
+static void Texture_EncodeRawImage(CPakFileBuilder* const pak, const char* const assetPath, const rapidjson::Value& mapEntry,
+                                   const TextureEncodeOptions_s& options, std::vector<char>& ddsImage, std::string& imagePath)
+{
+    const char* const formatName = JSON_GetValueRequired<const char*>(mapEntry, TEXTURE_RAW_FORMAT_FIELD);
+    const DXGI_FORMAT dxgiFormat = BC_ParseFormat(formatName);
+
+    if (dxgiFormat == DXGI_FORMAT_UNKNOWN)
+        Error("Texture asset \"%s\" requested unsupported format \"%s\"; expected one of the following: "
+            "BC1_UNORM(_SRGB):BC3_UNORM(_SRGB):BC4_UNORM:BC5_UNORM:BC7_UNORM(_SRGB):R8G8B8A8_UNORM(_SRGB).\n", assetPath, formatName);
+
+    const std::string basePath = pak->GetAssetPath() + assetPath;
+    ImageRGBA_s image;
+    std::string imageError;
+
+    imagePath = Utils::ChangeExtension(basePath, ".png");
+
+    // The error is only set if the file exists but could not be decoded.
+    if (!Image_LoadRGBA(imagePath, image, imageError) && imageError.empty())
+    {
+        imagePath = Utils::ChangeExtension(basePath, ".tga");
+
+        if (!Image_LoadRGBA(imagePath, image, imageError) && imageError.empty())
+            Error("Failed to open raw image for texture asset \"%s\"; expected a .png or .tga file.\n", assetPath);
+    }
+
+    if (!imageError.empty())
+        Error("%s", imageError.c_str());
+
+    if (image.width > UINT16_MAX || image.height > UINT16_MAX)
+        Error("Texture asset \"%s\" has dimensions %ux%u which exceed the maximum of %u.\n", assetPath, image.width, image.height, UINT16_MAX);
+
+    Texture_BuildDDSImage(image, dxgiFormat, options, imagePath.c_str(), ddsImage);
+}
+
+// Generates the mip chain of a DDS file that only has its base level, the base
+// level is decoded and re-encoded along with the generated mips. Returns false
+// if the file already has mips, in which case it is used as-is.
+static bool Texture_GenerateDDSMips(const TextureSource_s& input, const TextureEncodeOptions_s& options, const char* const filePath,
+                                    std::vector<char>& ddsImage)
+{
+    size_t headerOffset = 0;
+
+    int magic;
+    Texture_CopyFromSource(input, &magic, headerOffset, sizeof(magic), filePath);
+    headerOffset += sizeof(magic);
+
+    // Leave the error reporting to Texture_InternalAddTexture.
+    if (magic != DDS_MAGIC)
+        return false;
+
+    DDS_HEADER ddsh;
+    Texture_CopyFromSource(input, &ddsh, headerOffset, sizeof(ddsh), filePath);
+    headerOffset += sizeof(ddsh);
+
+    if (ddsh.dwMipMapCount > 1)
+    {
+        Warning("Texture asset \"%s\" already has %u mips; ignoring mip generation.\n", filePath, ddsh.dwMipMapCount);
+        return false;
+    }
+
+    DXGI_FORMAT dxgiFormat;
+
+    if (ddsh.ddspf.dwFourCC == '01XD')
+    {
+        DDS_HEADER_DXT10 ddsh_dx10;
+        Texture_CopyFromSource(input, &ddsh_dx10, headerOffset, sizeof(ddsh_dx10), filePath);
+        headerOffset += sizeof(ddsh_dx10);
+
+        if (ddsh_dx10.arraySize > 1)
+            Error("Texture asset \"%s\" is a texture array; mips cannot be generated for texture arrays.\n", filePath);
+
+        dxgiFormat = ddsh_dx10.dxgiFormat;
+    }
+    else
+        dxgiFormat = DXUtils::GetFormatFromHeader(ddsh);
+
+    if (!BC_IsFormatSupported(dxgiFormat))
+        Error("Texture asset \"%s\" uses format \"%s\" for which mips cannot be generated.\n", filePath, DXUtils::GetFormatAsString(dxgiFormat));
+
+    ImageRGBA_s image;
+    image.width = ddsh.dwWidth;
+    image.height = ddsh.dwHeight;
+    image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+
+    const size_t imageSize = BC_GetImageSize(dxgiFormat, image.width, image.height);
+
+    if (!input.IsInRange(headerOffset, imageSize))
+        Error("Texture asset \"%s\" appears truncated; %zu bytes at offset %zu are out of range ( file size = %zu ).\n",
+            filePath, imageSize, headerOffset, input.size);
+
+    BC_DecompressImage(reinterpret_cast<const uint8_t*>(&input.data[headerOffset]), image.width, image.height, dxgiFormat, image.pixels.data());
+    Texture_BuildDDSImage(image, dxgiFormat, options, filePath, ddsImage);
+
+    return true;
+}
+
+// Textures that were collapsed to a single block during the current build.
+struct TextureCollapseEntry_s
+{
+    std::string assetPath;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipCount;
+
+    size_t savedBytes;
+};
+
+static std::vector<TextureCollapseEntry_s> s_collapsedTextures;
+
+// Returns true if all indices of the BC1 style color block are equal.
+static inline bool Texture_IsUniformColorBlock(const char* const block)
+{
+    uint32_t indexBits;
+    memcpy(&indexBits, &block[4], sizeof(indexBits));
+
+    return indexBits == (indexBits & 0x3) * 0x55555555u;
+}
+
+// Returns true if all indices of the BC4 style channel block are equal.
+static inline bool Texture_IsUniformChannelBlock(const char* const block)
+{
+    uint64_t indexBits = 0;
+    memcpy(&indexBits, &block[2], 6);
+
+    return indexBits == (indexBits & 0x7) * 0x249249249249ull;
+}
+
+// Returns true if all explicit 4 bit alpha values of the BC2 block are equal.
+static inline bool Texture_IsUniformExplicitAlphaBlock(const char* const block)
+{
+    const uint8_t first = static_cast<uint8_t>(block[0]);
+
+    if ((first >> 4) != (first & 0xF))
+        return false;
+
+    for (int i = 1; i < 8; i++)
+    {
+        if (static_cast<uint8_t>(block[i]) != first)
+            return false;
+    }
+
+    return true;
+}
+
+// Returns true if every pixel of the block decodes to the same color, this is
+// only determined from the indices of the block. Formats that aren't covered
+// are never considered uniform.
+static bool Texture_IsUniformBlock(const DXGI_FORMAT dxgiFormat, const bool isBlockCompressed, const char* const block)
+{
+    // Uncompressed formats have single pixel "blocks".
+    if (!isBlockCompressed)
+        return true;
+
+    switch (dxgiFormat)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+        return Texture_IsUniformColorBlock(block);
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+        return Texture_IsUniformExplicitAlphaBlock(block) && Texture_IsUniformColorBlock(&block[8]);
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        return Texture_IsUniformChannelBlock(block) && Texture_IsUniformColorBlock(&block[8]);
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return Texture_IsUniformChannelBlock(block);
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+        return Texture_IsUniformChannelBlock(block) && Texture_IsUniformChannelBlock(&block[8]);
+    default:
+        return false;
+    }
+}
+
+// Checks if the texture is a single color across all of its mips, and if so,
+// replaces it with a 4x4 texture of the same format holding that color. The
+// scan compares the raw blocks, so textures whose blocks are encoded
+// differently while decoding to the same color are not collapsed.
+static bool Texture_CollapseSolidColor(CPakFileBuilder* const pak, const char* const assetPath, const TextureSource_s& input,
+                                       const char* const filePath, std::vector<char>& ddsImage)
+{
+    DDS_HEADER ddsh;
+    DXGI_FORMAT dxgiFormat;
+    uint32_t arraySize;
+    size_t dataOffset;
+
+    // Leave the error reporting to Texture_InternalAddTexture.
+    if (!Texture_ReadDDSHeader(input, ddsh, dxgiFormat, arraySize, dataOffset))
+        return false;
+
+    const uint16_t imageFormat = Texture_DXGIToImageFormat(dxgiFormat);
+
+    if (imageFormat == TEXTURE_INVALID_FORMAT_INDEX || arraySize != 1 || ddsh.dwMipMapCount > MAX_MIPS_PER_TEXTURE
+        || ddsh.dwWidth > UINT16_MAX || ddsh.dwHeight > UINT16_MAX)
+    {
+        return false;
+    }
+
+    const auto& bytesPerPixel = s_pBytesPerPixel[imageFormat];
+
+    const bool isBlockCompressed = bytesPerPixel.y != 1;
+    const uint32_t blockSize = bytesPerPixel.x;
+
+    // Already as small as it gets.
+    if (ddsh.dwMipMapCount <= 1 && ddsh.dwWidth <= 4 && ddsh.dwHeight <= 4)
+        return false;
+
+    size_t totalSize = 0;
+
+    for (unsigned int mipLevel = 0; mipLevel < ddsh.dwMipMapCount; mipLevel++)
+        totalSize += Texture_CalcMipSize(imageFormat, static_cast<uint16_t>(ddsh.dwWidth), static_cast<uint16_t>(ddsh.dwHeight), mipLevel);
+
+    if (totalSize < blockSize || !input.IsInRange(dataOffset, totalSize))
+        return false;
+
+    const char* const data = &input.data[dataOffset];
+
+    if (!Texture_IsUniformBlock(dxgiFormat, isBlockCompressed, data))
+        return false;
+
+    for (size_t offset = blockSize; offset < totalSize; offset += blockSize)
+    {
+        if (memcmp(&data[offset], data, blockSize) != 0)
+            return false;
+    }
+
+    // Texture metadata that is specified per mip no longer applies once the
+    // mips are gone, so these textures are left as-is.
+    const std::string metaFilePath = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".json");
+    const rapidjson::Document* const document = JSON_GetCachedDocument(metaFilePath.c_str(), "texture metadata", false);
+
+    if (document && (document->HasMember(TEXTURE_STREAM_LAYOUT_FIELD) || document->HasMember(TEXTURE_MIP_INFO_FIELD)))
+    {
+        Debug("-> texture \"%s\" is a solid color, but has per mip metadata; not collapsing\n", filePath);
+        return false;
+    }
+
+    const uint32_t pixelCount = isBlockCompressed ? 1 : 16;
+    const size_t headerSize = Texture_WriteDDSHeader(dxgiFormat, 4, 4, 1, 1, pixelCount * blockSize, ddsImage);
+
+    for (uint32_t i = 0; i < pixelCount; i++)
+        memcpy(&ddsImage[headerSize + (i * blockSize)], data, blockSize);
+
+    TextureCollapseEntry_s& entry = s_collapsedTextures.emplace_back();
+
+    entry.assetPath = assetPath;
+    entry.width = ddsh.dwWidth;
+    entry.height = ddsh.dwHeight;
+    entry.mipCount = ddsh.dwMipMapCount;
+    entry.savedBytes = totalSize - (pixelCount * blockSize);
+
+    Debug("-> collapsed solid color texture from %ux%u with %u mips to 4x4\n", ddsh.dwWidth, ddsh.dwHeight, ddsh.dwMipMapCount);
+    return true;
+}
+
+// Opaque BC3 textures demoted to BC1 during the current build.
+static size_t s_demotedTextureCount = 0;
+static size_t s_demotedTextureSavedBytes = 0;
+
+// Returns true if every pixel of the BC3 alpha block decodes to 255. Only the
+// endpoints and the explicit 255 entry are considered opaque, as interpolated
+// entries may round differently between decoders.
+static bool Texture_IsOpaqueAlphaBlock(const char* const block)
+{
+    uint64_t bits;
+    memcpy(&bits, block, sizeof(bits));
+
+    const uint32_t a0 = bits & 0xFF;
+    const uint32_t a1 = (bits >> 8) & 0xFF;
+    const uint64_t indexBits = bits >> 16;
+
+    // Fast path for the encoding most encoders produce for opaque blocks.
+    if (a0 == 255 && indexBits == 0)
+        return true;
+
+    uint32_t opaqueMask = 0;
+
+    if (a0 == 255)
+        opaqueMask |= 1 << 0;
+    if (a1 == 255)
+        opaqueMask |= 1 << 1;
+
+    // In 6 value mode, entries 2 to 5 are interpolated between the endpoints,
+    // and entry 7 is always 255.
+    if (a0 <= a1)
+    {
+        if (a0 == 255)
+            opaqueMask |= 0x3C;
+
+        opaqueMask |= 1 << 7;
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+        if (!(opaqueMask & (1 << ((indexBits >> (i * 3)) & 0x7))))
+            return false;
+    }
+
+    return true;
+}
+
+// Converts the color half of a BC3 block into a BC1 block. BC3 color blocks
+// are always decoded in 4 color mode, which BC1 only uses if c0 > c1, so the
+// endpoints are reordered when needed without changing the decoded colors.
+static void Texture_ConvertColorBlockToBC1(const char* const src, char* const dest)
+{
+    uint16_t c0, c1;
+    uint32_t indexBits;
+
+    memcpy(&c0, &src[0], sizeof(c0));
+    memcpy(&c1, &src[2], sizeof(c1));
+    memcpy(&indexBits, &src[4], sizeof(indexBits));
+
+    if (c0 < c1)
+    {
+        // Swapping the endpoints swaps the indices 0<->1 and 2<->3.
+        std::swap(c0, c1);
+        indexBits ^= 0x55555555u;
+    }
+    else if (c0 == c1)
+    {
+        // All 4 entries are equal to c0, but in 3 color mode the last entry
+        // is transparent; the first entry is equal in both modes.
+        indexBits = 0;
+    }
+
+    memcpy(&dest[0], &c0, sizeof(c0));
+    memcpy(&dest[2], &c1, sizeof(c1));
+    memcpy(&dest[4], &indexBits, sizeof(indexBits));
+}
+
+// Checks if the BC3 texture is fully opaque across all of its mips, and if so,
+// rewrites it as BC1 which halves its size without any loss in quality.
+static bool Texture_DemoteOpaqueBC3(const TextureSource_s& input, const char* const filePath, std::vector<char>& ddsImage)
+{
+    DDS_HEADER ddsh;
+    DXGI_FORMAT dxgiFormat;
+    uint32_t arraySize;
+    size_t dataOffset;
+
+    // Leave the error reporting to Texture_InternalAddTexture.
+    if (!Texture_ReadDDSHeader(input, ddsh, dxgiFormat, arraySize, dataOffset))
+        return false;
+
+    DXGI_FORMAT demotedFormat;
+
+    switch (dxgiFormat)
+    {
+    case DXGI_FORMAT_BC3_UNORM:
+        demotedFormat = DXGI_FORMAT_BC1_UNORM;
+        break;
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+        demotedFormat = DXGI_FORMAT_BC1_UNORM_SRGB;
+        break;
+    default:
+        return false;
+    }
+
+    if (ddsh.dwMipMapCount > MAX_MIPS_PER_TEXTURE || ddsh.dwWidth > UINT16_MAX || ddsh.dwHeight > UINT16_MAX)
+        return false;
+
+    const uint16_t imageFormat = Texture_DXGIToImageFormat(dxgiFormat);
+    size_t sliceSize = 0;
+
+    for (unsigned int mipLevel = 0; mipLevel < ddsh.dwMipMapCount; mipLevel++)
+        sliceSize += Texture_CalcMipSize(imageFormat, static_cast<uint16_t>(ddsh.dwWidth), static_cast<uint16_t>(ddsh.dwHeight), mipLevel);
+
+    const size_t totalSize = sliceSize * arraySize;
+
+    if (totalSize == 0 || !input.IsInRange(dataOffset, totalSize))
+        return false;
+
+    const char* const data = &input.data[dataOffset];
+    const size_t blockCount = totalSize / 16;
+
+    // Scan everything first, textures that use their alpha are rejected as
+    // soon as a block with transparency is found.
+    for (size_t i = 0; i < blockCount; i++)
+    {
+        if (!Texture_IsOpaqueAlphaBlock(&data[i * 16]))
+            return false;
+    }
+
+    const size_t headerSize = Texture_WriteDDSHeader(demotedFormat, ddsh.dwWidth, ddsh.dwHeight, ddsh.dwMipMapCount, arraySize, blockCount * 8, ddsImage);
+    char* const demoted = &ddsImage[headerSize];
+
+    for (size_t i = 0; i < blockCount; i++)
+        Texture_ConvertColorBlockToBC1(&data[(i * 16) + 8], &demoted[i * 8]);
+
+    s_demotedTextureCount++;
+    s_demotedTextureSavedBytes += blockCount * 8;
+
+    Debug("-> demoted opaque %s texture to %s\n", DXUtils::GetFormatAsString(dxgiFormat), DXUtils::GetFormatAsString(demotedFormat));
+    return true;
+}
+
+// Streaming split chosen by the planner, the optional mips are the largest
+// ones, followed by the mandatory and permanent ones.
+struct TextureStreamPlan_s
+{
+    uint32_t optionalMips;
+    uint32_t mandatoryMips;
+    uint32_t permanentMips;
+};
+
+// A texture whose image has been produced and whose header has been filled,
+// but whose mips are not yet split into permanent and streamed data.
+struct TextureLayout_s
+{
+    PakGuid_t guid;
+    std::string assetPath;
+    std::string filePath;
+
+    // Storage of the image that the input points to, the image is either
+    // mapped from disk or produced in memory.
+    CMappedFile mappedFile;
+    std::vector<char> encodedImage;
+    std::vector<char> demotedImage;
+    std::vector<char> collapsedImage;
+
+    TextureSource_s input;
+
+    PakPageLump_s hdrChunk;
+
+    size_t mipOffset; // Offset of the first mip in the image.
+    uint32_t mipCount;
+
+    bool forceDisableStreaming;
+    bool isCollapsed;
+
+    // The layout from the metadata, empty if the metadata doesn't have one.
+    std::vector<mipType_e> streamLayout;
+};
+
+// Texture as seen by the planner.
+struct TexturePlanEntry_s
+{
+    size_t layoutIndex;
+
+    std::vector<size_t> mipSizes;     // Aligned sizes, ordered from the largest mip.
+    std::vector<uint32_t> mipExtents; // Largest dimension of each mip.
+
+    bool isFixed; // The split is dictated by the texture itself or its metadata.
+    TextureStreamPlan_s plan;
+};
+
+// Set while the map has streaming budgets, the textures are then laid out
+// after all assets have been added so the plan covers every texture in the
+// pak, including the ones added by other assets, at their final size.
+static bool s_textureLayoutDeferred = false;
+
+static uint64_t s_texturePermanentBudget = 0;
+static uint64_t s_textureMandatoryBudget = 0;
+
+static bool s_textureHasPermanentBudget = false;
+static bool s_textureHasMandatoryBudget = false;
+
+static std::vector<std::unique_ptr<TextureLayout_s>> s_pendingTextureLayouts;
+
+// Promotes mips into a tier for as long as the budget allows. The coarsest
+// mips across all textures are promoted first, as these make up most of what
+// is visible on screen while costing the least memory.
+static void Texture_FillPlanTier(std::vector<TexturePlanEntry_s>& entries, const uint64_t budget, uint64_t& used, const bool permanentTier)
+{
+    struct Candidate_s
+    {
+        size_t entry;
+        size_t level;
+    };
+
+    const auto compare = [&entries](const Candidate_s& a, const Candidate_s& b)
+    {
+        const uint32_t extentA = entries[a.entry].mipExtents[a.level];
+        const uint32_t extentB = entries[b.entry].mipExtents[b.level];
+
+        if (extentA != extentB)
+            return extentA > extentB;
+
+        return entries[a.entry].mipSizes[a.level] > entries[b.entry].mipSizes[b.level];
+    };
+
+    std::priority_queue<Candidate_s, std::vector<Candidate_s>, decltype(compare)> queue(compare);
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const TexturePlanEntry_s& entry = entries[i];
+
+        if (entry.isFixed)
+            continue;
+
+        const size_t assigned = entry.plan.permanentMips + entry.plan.mandatoryMips;
+
+        if (assigned < entry.mipSizes.size())
+            queue.push({ i, entry.mipSizes.size() - 1 - assigned });
+    }
+
+    while (!queue.empty())
+    {
+        const Candidate_s candidate = queue.top();
+        queue.pop();
+
+        TexturePlanEntry_s& entry = entries[candidate.entry];
+        const size_t mipSize = entry.mipSizes[candidate.level];
+
+        // Mips of a texture must be promoted in order, so this texture is
+        // done once its next mip doesn't fit.
+        if (used + mipSize > budget)
+            continue;
+
+        used += mipSize;
+
+        if (permanentTier)
+            entry.plan.permanentMips++;
+        else
+            entry.plan.mandatoryMips++;
+
+        if (candidate.level > 0)
+            queue.push({ candidate.entry, candidate.level - 1 });
+    }
+}
+
+//-----------------------------------------------------------------------------
+// purpose: plans the streaming split of all pending textures, such that they
+//          fit in the permanent and mandatory streaming budgets
+//-----------------------------------------------------------------------------
+static void Texture_PlanStreaming(CPakFileBuilder* const pak, std::vector<TexturePlanEntry_s>& entries)
+{
+    const bool hasOptionalSet = pak->GetVersion() >= 8;
+
+    uint64_t permanentUsed = 0;
+    uint64_t mandatoryUsed = 0;
+    uint64_t optionalUsed = 0;
+
+    for (size_t i = 0; i < s_pendingTextureLayouts.size(); i++)
+    {
+        const TextureLayout_s& layout = *s_pendingTextureLayouts[i];
+        const TextureAssetHeader_t* const hdr = reinterpret_cast<const TextureAssetHeader_t*>(layout.hdrChunk.data);
+
+        TexturePlanEntry_s& entry = entries.emplace_back();
+
+        entry.layoutIndex = i;
+        entry.isFixed = false;
+        entry.plan = {};
+
+        for (uint32_t mipLevel = 0; mipLevel < layout.mipCount; mipLevel++)
+        {
+            const uint32_t mipSize = Texture_CalcMipSize(hdr->imageFormat, hdr->width, hdr->height, mipLevel);
+
+            entry.mipSizes.push_back(IALIGN16(mipSize) * hdr->arraySize);
+            entry.mipExtents.push_back((std::max)(1u, static_cast<uint32_t>((std::max)(hdr->width, hdr->height)) >> mipLevel));
+        }
+
+        // Texture arrays and textures with a single mip can't be streamed,
+        // and collapsed textures have nothing left to stream.
+        if (layout.forceDisableStreaming || layout.mipCount == 1 || hdr->arraySize > 1 || layout.isCollapsed)
+        {
+            entry.isFixed = true;
+
+            for (const size_t mipSize : entry.mipSizes)
+                permanentUsed += mipSize;
+
+            continue;
+        }
+
+        if (!layout.streamLayout.empty())
+        {
+            // The metadata overrides the plan, but still counts towards the
+            // budgets; resolved the same way as in Texture_LayoutMips.
+            entry.isFixed = true;
+
+            for (uint32_t mipLevel = 0; mipLevel < layout.mipCount; mipLevel++)
+            {
+                const mipType_e mipType = mipLevel < (layout.mipCount - 1) ? layout.streamLayout[mipLevel] : mipType_e::STATIC;
+                const size_t mipSize = entry.mipSizes[mipLevel];
+
+                if (mipType == mipType_e::STREAMED_OPT && hasOptionalSet)
+                    optionalUsed += mipSize;
+                else if (mipType == mipType_e::STREAMED)
+                    mandatoryUsed += mipSize;
+                else
+                    permanentUsed += mipSize;
+            }
+
+            continue;
+        }
+
+        // There must always be at least 1 permanent mip level, see the notes
+        // in Texture_LayoutMips.
+        entry.plan.permanentMips = 1;
+        permanentUsed += entry.mipSizes.back();
+    }
+
+    if (entries.empty())
+        return;
+
+    if (s_textureHasPermanentBudget && permanentUsed > s_texturePermanentBudget)
+        Warning("Texture streaming plan exceeds the permanent budget by %llu bytes with only the mandatory permanent mips.\n", permanentUsed - s_texturePermanentBudget);
 
-    const std::string textureFilePath = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".dds");
-    BinaryIO input;
+    Texture_FillPlanTier(entries, s_texturePermanentBudget, permanentUsed, true);
+    Texture_FillPlanTier(entries, s_textureMandatoryBudget, mandatoryUsed, false);
 
-    if (!input.Open(textureFilePath, BinaryIO::Mode_e::Read))
-        Error("Failed to open texture asset \"%s\".\n", textureFilePath.c_str());
+    for (TexturePlanEntry_s& entry : entries)
+    {
+        if (entry.isFixed)
+            continue;
 
-    PakPageLump_s hdrChunk = pak->CreatePageLump(sizeof(TextureAssetHeader_t), SF_HEAD, 8);
-    TextureAssetHeader_t* const hdr = reinterpret_cast<TextureAssetHeader_t*>(hdrChunk.data);
+        const uint32_t mipCount = static_cast<uint32_t>(entry.mipSizes.size());
+        const uint32_t remaining = mipCount - entry.plan.permanentMips - entry.plan.mandatoryMips;
 
-    // used for creating data buffers
-    struct {
-        int64_t staticSize;
-        int64_t streamedSize;
-        int64_t streamedOptSize;
-    } mipSizes{};
+        // Without an optional set, the remainder has to be mandatory.
+        for (uint32_t i = 0; i < remaining; i++)
+        {
+            if (hasOptionalSet)
+                optionalUsed += entry.mipSizes[i];
+            else
+                mandatoryUsed += entry.mipSizes[i];
+        }
 
-    // parse input image file
-    int magic;
-    input.Read(magic);
+        if (hasOptionalSet)
+            entry.plan.optionalMips = remaining;
+        else
+            entry.plan.mandatoryMips += remaining;
 
-    if (magic != DDS_MAGIC) // b'DDS '
-        Error("Attempted to add a texture asset that was not a valid DDS file (invalid magic).\n");
+        Debug("Planned texture \"%s\"; permanent:mandatory:optional mips = %u:%u:%u.\n", s_pendingTextureLayouts[entry.layoutIndex]->assetPath.c_str(),
+            entry.plan.permanentMips, entry.plan.mandatoryMips, entry.plan.optionalMips);
+    }
 
-    DDS_HEADER ddsh;
-    input.Read(ddsh);
+    if (s_textureHasMandatoryBudget && mandatoryUsed > s_textureMandatoryBudget)
+    {
+        if (!hasOptionalSet)
+            Warning("Texture streaming plan exceeds the mandatory streaming budget by %llu bytes as pak version %hu has no optional streaming set.\n",
+                mandatoryUsed - s_textureMandatoryBudget, pak->GetVersion());
+        else
+            Warning("Texture streaming plan exceeds the mandatory streaming budget by %llu bytes with the textures whose stream layout is fixed.\n",
+                mandatoryUsed - s_textureMandatoryBudget);
+    }
 
-    if (ddsh.dwMipMapCount > MAX_MIPS_PER_TEXTURE)
-        Error("Attempted to add a texture asset with too many mipmaps (max %u, got %u).\n", MAX_MIPS_PER_TEXTURE, ddsh.dwMipMapCount);
+    const double toMiB = 1.0 / (1024.0 * 1024.0);
 
-    std::vector<mipType_e> streamLayout;
-    Texture_ProcessMetaData(pak, assetPath, hdr, ddsh.dwMipMapCount, streamLayout);
+    Log("*** planned %zu textures; permanent %.2f / %.2f MiB, mandatory %.2f / %.2f MiB, optional %.2f MiB.\n", entries.size(),
+        permanentUsed * toMiB, s_texturePermanentBudget * toMiB, mandatoryUsed * toMiB, s_textureMandatoryBudget * toMiB, optionalUsed * toMiB);
+}
 
-    DXGI_FORMAT dxgiFormat = DXGI_FORMAT_UNKNOWN;
+// Converts the plan of the texture into a stream layout.
+static void Texture_ApplyStreamPlan(const TextureStreamPlan_s& plan, const uint32_t totalMipCount, std::vector<mipType_e>& streamLayout)
+{
+    assert(plan.optionalMips + plan.mandatoryMips + plan.permanentMips == totalMipCount);
 
-    uint8_t arraySize = 1;
-    bool isDX10 = false;
+    // -1 because the last mip isn't counted, it is always permanent.
+    streamLayout.resize(totalMipCount - 1);
 
-    // Go to the end of the DX10 header if it exists.
-    if (ddsh.ddspf.dwFourCC == '01XD')
+    for (uint32_t mipLevel = 0; mipLevel < totalMipCount - 1; mipLevel++)
     {
-        DDS_HEADER_DXT10 ddsh_dx10;
-        input.Read(ddsh_dx10);
-
-        dxgiFormat = ddsh_dx10.dxgiFormat;
-        arraySize = static_cast<uint8_t>(ddsh_dx10.arraySize);
-        isDX10 = true;
+        if (mipLevel < plan.optionalMips)
+            streamLayout[mipLevel] = mipType_e::STREAMED_OPT;
+        else if (mipLevel < plan.optionalMips + plan.mandatoryMips)
+            streamLayout[mipLevel] = mipType_e::STREAMED;
+        else
+            streamLayout[mipLevel] = mipType_e::STATIC;
     }
-    else {
-        dxgiFormat = DXUtils::GetFormatFromHeader(ddsh);
+}
+//-----------------------------------------------------------------------------
+// purpose: splits the mips of the texture into permanent and streamed data,
+//          and copies them from its image into the pak and streaming sets
+//-----------------------------------------------------------------------------
+static void Texture_LayoutMips(CPakFileBuilder* const pak, PakAsset_t& asset, TextureLayout_s& layout, const TextureStreamPlan_s* const plan)
+{
+    const steady_clock::time_point start = high_resolution_clock::now();
 
-        if (dxgiFormat == DXGI_FORMAT_UNKNOWN)
-            Error("Attempted to add a texture asset from which the format type couldn't be classified.\n");
-    }
+    TextureAssetHeader_t* const hdr = reinterpret_cast<TextureAssetHeader_t*>(layout.hdrChunk.data);
 
-    const char* const pDxgiFormat = DXUtils::GetFormatAsString(dxgiFormat);
-    const uint16_t imageFormat = Texture_DXGIToImageFormat(dxgiFormat);
+    const TextureSource_s& input = layout.input;
+    const char* const pFilePath = layout.filePath.c_str();
 
-    if (imageFormat == TEXTURE_INVALID_FORMAT_INDEX)
-        Error("Attempted to add a texture asset using an unsupported format type \"%s\".\n", pDxgiFormat);
+    // used for creating data buffers
+    struct {
+        int64_t staticSize;
+        int64_t streamedSize;
+        int64_t streamedOptSize;
+    } mipSizes{};
 
-    hdr->imageFormat = imageFormat;
-    Debug("-> fmt: %s\n", pDxgiFormat);
+    std::vector<mipType_e>& streamLayout = layout.streamLayout;
 
-    hdr->width = static_cast<uint16_t>(ddsh.dwWidth);
-    hdr->height = static_cast<uint16_t>(ddsh.dwHeight);
-    Debug("-> dimensions: %ux%u\n", ddsh.dwWidth, ddsh.dwHeight);
+    // The stream layout from the metadata takes precedence over the plan.
+    if (streamLayout.empty() && plan)
+        Texture_ApplyStreamPlan(*plan, layout.mipCount, streamLayout);
 
     bool isStreamable = false; // does this texture require streaming? true if total size of mip levels would exceed 64KiB. can be forced to false.
     bool isStreamableOpt = false; // can this texture use optional starpaks? can only be set if pak is version v8
 
     // set streamable boolean based on if we have disabled it, also don't stream if we have only one mip
-    if (!forceDisableStreaming && ddsh.dwMipMapCount > 1)
+    if (!layout.forceDisableStreaming && layout.mipCount > 1)
         isStreamable = true;
 
     if (isStreamable && pak->GetVersion() >= 8)
         isStreamableOpt = true;
 
     /*MIPMAP HANDLING*/
-    hdr->arraySize = arraySize;
+    const uint8_t arraySize = hdr->arraySize;
     std::vector<std::vector<mipLevel_t>> textureArray(arraySize);
 
     for (auto& mips : textureArray)
-        mips.resize(ddsh.dwMipMapCount);
+        mips.resize(layout.mipCount);
 
-    size_t mipOffset = isDX10 ? 0x94 : 0x80; // add header length
+    size_t mipOffset = layout.mipOffset;
     bool firstTexture = true;
 
     for (auto& mips : textureArray)
@@ -233,15 +1098,7 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
             if (hdr->height >> mipLevel > 1)
                 mipHeight = (hdr->height >> mipLevel) - 1;
 
-            const auto& bytesPerPixel = s_pBytesPerPixel[hdr->imageFormat];
-
-            const uint8_t x = bytesPerPixel.x;
-            const uint8_t y = bytesPerPixel.y;
-
-            const uint32_t bppWidth = (y + mipWidth) >> (y >> 1);
-            const uint32_t bppHeight = (y + mipHeight) >> (y >> 1);
-
-            const uint32_t slicePitch = x * bppWidth * bppHeight;
+            const uint32_t slicePitch = Texture_CalcMipSize(hdr->imageFormat, hdr->width, hdr->height, mipLevel);
             const uint32_t alignedSize = IALIGN16(slicePitch);
 
             mipLevel_t& mipMap = mips[mipLevel];
@@ -265,7 +1122,7 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
             //   of its size. not adhering to this rule will result in a failure
             //   in ID3D11Device::CreateTexture2D during the runtime. we make
             //   sure that the smallest mip is always permanent (static) here.
-            if (arraySize == 1 && (mipLevel != (ddsh.dwMipMapCount - 1)))
+            if (arraySize == 1 && (mipLevel != (layout.mipCount - 1)))
             {
                 const mipType_e override = streamLayout.empty() 
                     ? mipType_e::INVALID 
@@ -313,23 +1170,8 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
         firstTexture = false;
     }
 
-    hdr->guid = assetGuid;
     Debug("-> total mipmaps permanent:mandatory:optional : %hhu:%hhu:%hhu\n", hdr->mipLevels, hdr->streamedMipLevels, hdr->optStreamedMipLevels);
 
-    if (pak->IsFlagSet(PF_KEEP_DEV))
-    {
-        char pathStem[PAK_MAX_STEM_PATH];
-        const size_t stemLen = Pak_ExtractAssetStem(assetPath, pathStem, sizeof(pathStem), "texture");
-
-        if (stemLen > 0)
-        {
-            PakPageLump_s nameChunk = pak->CreatePageLump(stemLen + 1, SF_CPU | SF_DEV, 1);
-            memcpy(nameChunk.data, pathStem, stemLen + 1);
-
-            pak->AddPointer(hdrChunk, offsetof(TextureAssetHeader_t, name), nameChunk, 0);
-        }
-    }
-
     PakPageLump_s dataChunk = pak->CreatePageLump(mipSizes.staticSize, SF_CPU | SF_TEMP, 16);
 
     // note(amos): page align it because we need to hash this entire block and
@@ -338,8 +1180,9 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
     const size_t pageAlignedStreamedSize = IALIGN(mipSizes.streamedSize, STARPAK_DATABLOCK_ALIGNMENT);
     const size_t pageAlignedStreamedOptSize = IALIGN(mipSizes.streamedOptSize, STARPAK_DATABLOCK_ALIGNMENT);
 
-    char* const streamedbuf = new char[pageAlignedStreamedSize];
-    char* const optstreamedbuf = new char[pageAlignedStreamedOptSize];
+    // Nothing is allocated for the sets that have no streamed mips.
+    std::unique_ptr<char[]> streamedbuf(pageAlignedStreamedSize ? new char[pageAlignedStreamedSize] : nullptr);
+    std::unique_ptr<char[]> optstreamedbuf(pageAlignedStreamedOptSize ? new char[pageAlignedStreamedOptSize] : nullptr);
 
     { // clear the remainder as this will affect the Murmur hash result.
         const size_t streamedbufRemainder = pageAlignedStreamedSize - mipSizes.streamedSize;
@@ -353,18 +1196,20 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
             memset(&optstreamedbuf[mipSizes.streamedOptSize], 0, optstreamedbufRemainder);
     }
 
+    size_t ingestedBytes = 0;
+
     for (size_t i = 0; i < textureArray.size(); i++)
     {
         const auto& mips = textureArray[i];
 
         char* pCurrentPosStatic = dataChunk.data;
-        char* pCurrentPosStreamed = streamedbuf;
-        char* pCurrentPosStreamedOpt = optstreamedbuf;
+        char* pCurrentPosStreamed = streamedbuf.get();
+        char* pCurrentPosStreamedOpt = optstreamedbuf.get();
 
         for (auto mipIter = mips.rbegin(); mipIter != mips.rend(); ++mipIter)
         {
             const mipLevel_t& mipMap = *mipIter;
-            input.SeekGet(mipMap.mipOffset);
+            ingestedBytes += mipMap.mipSize;
 
             // only used by static mip types, used for offsetting the pointer
             // from mip base into the actual mip corresponding to the texture
@@ -375,7 +1220,7 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
             {
             case mipType_e::STATIC:
                 targetPos = pCurrentPosStatic + (mipMap.mipSizeAligned * i);
-                input.Read(targetPos, mipMap.mipSize);
+                Texture_CopyFromSource(input, targetPos, mipMap.mipOffset, mipMap.mipSize, pFilePath);
 
                 // texture arrays group mips together, i.e. mip 1 of texture 1
                 // 2 and 3 are directly placed into a contiguous block, and to
@@ -385,12 +1230,12 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
 
                 break;
             case mipType_e::STREAMED:
-                input.Read(pCurrentPosStreamed, mipMap.mipSize);
+                Texture_CopyFromSource(input, pCurrentPosStreamed, mipMap.mipOffset, mipMap.mipSize, pFilePath);
                 pCurrentPosStreamed += mipMap.mipSizeAligned; // move ptr
 
                 break;
             case mipType_e::STREAMED_OPT:
-                input.Read(pCurrentPosStreamedOpt, mipMap.mipSize);
+                Texture_CopyFromSource(input, pCurrentPosStreamedOpt, mipMap.mipOffset, mipMap.mipSize, pFilePath);
                 pCurrentPosStreamedOpt += mipMap.mipSizeAligned; // move ptr
 
                 break;
@@ -400,29 +1245,364 @@ static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid
         }
     }
 
+    const steady_clock::time_point stop = high_resolution_clock::now();
+
+    s_textureIngestBytes += ingestedBytes;
+    s_textureIngestTime += duration_cast<microseconds>(stop - start);
+
     // now time to add the higher level asset entry
     PakStreamSetEntry_s mandatoryStreamData;
 
     if (isStreamable && hdr->streamedMipLevels > 0)
-        mandatoryStreamData = pak->AddStreamingDataEntry(pageAlignedStreamedSize, (uint8_t*)streamedbuf, STREAMING_SET_MANDATORY);
-
-    delete[] streamedbuf;
+        mandatoryStreamData = pak->AddStreamingDataEntry(pageAlignedStreamedSize, (uint8_t*)streamedbuf.get(), STREAMING_SET_MANDATORY);
 
     PakStreamSetEntry_s optionalStreamData;
 
     if (isStreamableOpt && hdr->optStreamedMipLevels > 0)
-        optionalStreamData = pak->AddStreamingDataEntry(pageAlignedStreamedOptSize, (uint8_t*)optstreamedbuf, STREAMING_SET_OPTIONAL);
-
-    delete[] optstreamedbuf;
+        optionalStreamData = pak->AddStreamingDataEntry(pageAlignedStreamedOptSize, (uint8_t*)optstreamedbuf.get(), STREAMING_SET_OPTIONAL);
 
-    asset.InitAsset(hdrChunk.GetPointer(), sizeof(TextureAssetHeader_t), dataChunk.GetPointer(), TXTR_VERSION, AssetType::TXTR,
+    asset.InitAsset(layout.hdrChunk.GetPointer(), sizeof(TextureAssetHeader_t), dataChunk.GetPointer(), TXTR_VERSION, AssetType::TXTR,
         mandatoryStreamData.streamOffset, mandatoryStreamData.streamIndex, optionalStreamData.streamOffset, optionalStreamData.streamIndex);
 
+    asset.SetHeaderPointer(layout.hdrChunk.data);
+}
+
+// materialGeneratedTexture - whether this texture's creation was invoked by material automatic texture generation
+// mapEntry - the map entry of this texture, or null if this texture was added automatically
+// memoryImage - a DDS image that was built in memory to use instead of the texture file, or null
+static void Texture_InternalAddTexture(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath,
+                                       const bool forceDisableStreaming, const rapidjson::Value* const mapEntry,
+                                       std::vector<char>* const memoryImage = nullptr)
+{
+    PakAsset_t& asset = pak->BeginAsset(assetGuid, assetPath);
+
+    const steady_clock::time_point start = high_resolution_clock::now();
+
+    std::unique_ptr<TextureLayout_s> layout = std::make_unique<TextureLayout_s>();
+
+    layout->guid = assetGuid;
+    layout->assetPath = assetPath;
+    layout->forceDisableStreaming = forceDisableStreaming;
+    layout->isCollapsed = false;
+
+    std::string& textureFilePath = layout->filePath;
+
+    // The file is mapped once, and every mip is copied from it directly.
+    CMappedFile& mappedFile = layout->mappedFile;
+    std::vector<char>& encodedImage = layout->encodedImage;
+
+    TextureSource_s& input = layout->input;
+
+    std::vector<char>& demotedImage = layout->demotedImage;
+    std::vector<char>& collapsedImage = layout->collapsedImage;
+    bool& isCollapsed = layout->isCollapsed;
+
+    // The image that input currently points to, if it lives in memory.
+    std::vector<char>* inMemoryImage = nullptr;
+
+    TextureEncodeOptions_s encodeOptions;
+    Texture_ParseEncodeOptions(assetPath, mapEntry, encodeOptions);
+
+    if (memoryImage)
+    {
+        textureFilePath = assetPath;
+
+        // Taken over, as the mips may be laid out after the caller returns.
+        encodedImage = std::move(*memoryImage);
+
+        input = { encodedImage.data(), encodedImage.size() };
+        inMemoryImage = &encodedImage;
+    }
+    else if (mapEntry && mapEntry->HasMember(TEXTURE_RAW_FORMAT_FIELD))
+    {
+        Texture_EncodeRawImage(pak, assetPath, *mapEntry, encodeOptions, encodedImage, textureFilePath);
+
+        input = { encodedImage.data(), encodedImage.size() };
+        inMemoryImage = &encodedImage;
+    }
+    else
+    {
+        textureFilePath = Utils::ChangeExtension(pak->GetAssetPath() + assetPath, ".dds");
+
+        if (!mappedFile.Open(textureFilePath))
+            Error("Failed to open texture asset \"%s\".\n", textureFilePath.c_str());
+
+        input = { mappedFile.GetData(), mappedFile.GetSize() };
+
+        if (encodeOptions.generateMips && Texture_GenerateDDSMips(input, encodeOptions, textureFilePath.c_str(), encodedImage))
+        {
+            input = { encodedImage.data(), encodedImage.size() };
+            inMemoryImage = &encodedImage;
+        }
+    }
+
+    if (pak->IsFlagSet(PF_DEMOTE_OPAQUE_BC3) && Texture_DemoteOpaqueBC3(input, textureFilePath.c_str(), demotedImage))
+    {
+        input = { demotedImage.data(), demotedImage.size() };
+        inMemoryImage = &demotedImage;
+    }
+
+    if (pak->IsFlagSet(PF_COLLAPSE_SOLID_TEXTURES) && Texture_CollapseSolidColor(pak, assetPath, input, textureFilePath.c_str(), collapsedImage))
+    {
+        input = { collapsedImage.data(), collapsedImage.size() };
+        inMemoryImage = &collapsedImage;
+        isCollapsed = true;
+    }
+
+    // Only the image that input points to has to be kept until the mips
+    // are laid out, the intermediate ones are released here.
+    if (inMemoryImage)
+        mappedFile.Close();
+
+    if (input.data != encodedImage.data())
+        std::vector<char>().swap(encodedImage);
+
+    if (input.data != demotedImage.data())
+        std::vector<char>().swap(demotedImage);
+
+    const char* const pFilePath = textureFilePath.c_str();
+
+    size_t headerOffset = 0;
+
+    layout->hdrChunk = pak->CreatePageLump(sizeof(TextureAssetHeader_t), SF_HEAD, 8);
+
+    PakPageLump_s& hdrChunk = layout->hdrChunk;
+    TextureAssetHeader_t* const hdr = reinterpret_cast<TextureAssetHeader_t*>(hdrChunk.data);
+
+    // parse input image file
+    int magic;
+    Texture_CopyFromSource(input, &magic, headerOffset, sizeof(magic), pFilePath);
+    headerOffset += sizeof(magic);
+
+    if (magic != DDS_MAGIC) // b'DDS '
+        Error("Attempted to add a texture asset that was not a valid DDS file (invalid magic).\n");
+
+    DDS_HEADER ddsh;
+    Texture_CopyFromSource(input, &ddsh, headerOffset, sizeof(ddsh), pFilePath);
+    headerOffset += sizeof(ddsh);
+
+    if (ddsh.dwMipMapCount > MAX_MIPS_PER_TEXTURE)
+        Error("Attempted to add a texture asset with too many mipmaps (max %u, got %u).\n", MAX_MIPS_PER_TEXTURE, ddsh.dwMipMapCount);
+
+    std::vector<mipType_e>& streamLayout = layout->streamLayout;
+    Texture_ProcessMetaData(pak, assetPath, hdr, ddsh.dwMipMapCount, streamLayout);
+
+    DXGI_FORMAT dxgiFormat = DXGI_FORMAT_UNKNOWN;
+
+    uint8_t arraySize = 1;
+    bool isDX10 = false;
+
+    // Go to the end of the DX10 header if it exists.
+    if (ddsh.ddspf.dwFourCC == '01XD')
+    {
+        DDS_HEADER_DXT10 ddsh_dx10;
+        Texture_CopyFromSource(input, &ddsh_dx10, headerOffset, sizeof(ddsh_dx10), pFilePath);
+
+        dxgiFormat = ddsh_dx10.dxgiFormat;
+        arraySize = static_cast<uint8_t>(ddsh_dx10.arraySize);
+        isDX10 = true;
+    }
+    else {
+        dxgiFormat = DXUtils::GetFormatFromHeader(ddsh);
+
+        if (dxgiFormat == DXGI_FORMAT_UNKNOWN)
+            Error("Attempted to add a texture asset from which the format type couldn't be classified.\n");
+    }
+
+    const char* const pDxgiFormat = DXUtils::GetFormatAsString(dxgiFormat);
+    const uint16_t imageFormat = Texture_DXGIToImageFormat(dxgiFormat);
+
+    if (imageFormat == TEXTURE_INVALID_FORMAT_INDEX)
+        Error("Attempted to add a texture asset using an unsupported format type \"%s\".\n", pDxgiFormat);
+
+    size_t mipOffset = isDX10 ? 0x94 : 0x80; // add header length
+
+    hdr->imageFormat = imageFormat;
+    Debug("-> fmt: %s\n", pDxgiFormat);
+
+    hdr->width = static_cast<uint16_t>(ddsh.dwWidth);
+    hdr->height = static_cast<uint16_t>(ddsh.dwHeight);
+    Debug("-> dimensions: %ux%u\n", ddsh.dwWidth, ddsh.dwHeight);
+
+    hdr->arraySize = arraySize;
+    hdr->guid = assetGuid;
+
+    layout->mipOffset = mipOffset;
+    layout->mipCount = ddsh.dwMipMapCount;
+
+    if (pak->IsFlagSet(PF_KEEP_DEV))
+    {
+        char pathStem[PAK_MAX_STEM_PATH];
+        const size_t stemLen = Pak_ExtractAssetStem(assetPath, pathStem, sizeof(pathStem), "texture");
+
+        if (stemLen > 0)
+        {
+            PakPageLump_s nameChunk = pak->CreatePageLump(stemLen + 1, SF_CPU | SF_DEV, 1);
+            memcpy(nameChunk.data, pathStem, stemLen + 1);
+
+            pak->AddPointer(hdrChunk, offsetof(TextureAssetHeader_t, name), nameChunk, 0);
+        }
+    }
+
+    const steady_clock::time_point stop = high_resolution_clock::now();
+    s_textureIngestTime += duration_cast<microseconds>(stop - start);
+
+    // The type and header are set up front so other assets can look up the
+    // texture, the data pointers are filled in once the mips are laid out.
+    asset.InitAsset(hdrChunk.GetPointer(), sizeof(TextureAssetHeader_t), PagePtr_t::NullPtr(), TXTR_VERSION, AssetType::TXTR);
     asset.SetHeaderPointer(hdrChunk.data);
 
+    if (s_textureLayoutDeferred)
+    {
+        s_pendingTextureLayouts.push_back(std::move(layout));
+        pak->FinishAsset();
+
+        return;
+    }
+
+    Texture_LayoutMips(pak, asset, *layout, nullptr);
     pak->FinishAsset();
 }
 
+//-----------------------------------------------------------------------------
+// purpose: defers the layout of the textures in the build map until all of
+//          its assets have been added, if the map has streaming budgets
+//-----------------------------------------------------------------------------
+void Texture_BeginStreamPlan(const rapidjson::Value& doc)
+{
+    s_texturePermanentBudget = 0;
+    s_textureMandatoryBudget = 0;
+
+    s_textureHasPermanentBudget = JSON_GetValue(doc, TEXTURE_PERMANENT_BUDGET_FIELD, s_texturePermanentBudget);
+    s_textureHasMandatoryBudget = JSON_GetValue(doc, TEXTURE_MANDATORY_BUDGET_FIELD, s_textureMandatoryBudget);
+
+    s_textureLayoutDeferred = s_textureHasPermanentBudget || s_textureHasMandatoryBudget;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: plans the streaming split of every texture that was added to the
+//          pak, and lays out their mips accordingly
+//-----------------------------------------------------------------------------
+void Texture_EndStreamPlan(CPakFileBuilder* const pak)
+{
+    if (!s_textureLayoutDeferred)
+        return;
+
+    std::vector<TexturePlanEntry_s> entries;
+    Texture_PlanStreaming(pak, entries);
+
+    for (const TexturePlanEntry_s& entry : entries)
+    {
+        TextureLayout_s& layout = *s_pendingTextureLayouts[entry.layoutIndex];
+        PakAsset_t* const asset = pak->GetAssetByGuid(layout.guid);
+
+        assert(asset);
+        Texture_LayoutMips(pak, *asset, layout, entry.isFixed ? nullptr : &entry.plan);
+
+        // The data of the texture is only added now, so the asset can't be
+        // processed before the pages that have been created since are loaded.
+        asset->pageEnd = pak->GetNumPages();
+    }
+
+    s_pendingTextureLayouts.clear();
+    s_textureLayoutDeferred = false;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: keeps all mips of a texture that is still waiting for the plan
+//          permanent, returns false if the texture was already laid out
+//-----------------------------------------------------------------------------
+bool Texture_DisablePendingStreaming(const PakGuid_t assetGuid)
+{
+    for (const std::unique_ptr<TextureLayout_s>& layout : s_pendingTextureLayouts)
+    {
+        if (layout->guid == assetGuid)
+        {
+            layout->forceDisableStreaming = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// purpose: logs the texture ingest throughput and the collapsed textures of the
+//          current build, and resets the statistics for the next one
+//-----------------------------------------------------------------------------
+void Texture_LogIngestStats()
+{
+    if (s_textureIngestBytes)
+    {
+        const double seconds = s_textureIngestTime.count() / 1000000.0;
+        const double megaBytes = s_textureIngestBytes / (1024.0 * 1024.0);
+
+        Log("*** ingested %.2f MiB of texture data in %.3f seconds ( %.1f MiB/s ).\n",
+            megaBytes, seconds, seconds > 0.0 ? megaBytes / seconds : 0.0);
+    }
+
+    if (s_demotedTextureCount)
+    {
+        Log("*** demoted %zu opaque BC3 textures to BC1, saving %.2f MiB.\n",
+            s_demotedTextureCount, s_demotedTextureSavedBytes / (1024.0 * 1024.0));
+    }
+
+    if (!s_collapsedTextures.empty())
+    {
+        size_t savedBytes = 0;
+
+        for (const TextureCollapseEntry_s& entry : s_collapsedTextures)
+            savedBytes += entry.savedBytes;
+
+        Log("*** collapsed %zu solid color textures to 4x4, saving %.2f MiB:\n",
+            s_collapsedTextures.size(), savedBytes / (1024.0 * 1024.0));
+
+        for (const TextureCollapseEntry_s& entry : s_collapsedTextures)
+        {
+            Log("    \"%s\" ( %ux%u, %u mips, %zu bytes saved )\n", entry.assetPath.c_str(),
+                entry.width, entry.height, entry.mipCount, entry.savedBytes);
+        }
+    }
+
+    s_textureIngestBytes = 0;
+    s_textureIngestTime = microseconds(0);
+
+    s_demotedTextureCount = 0;
+    s_demotedTextureSavedBytes = 0;
+
+    s_collapsedTextures.clear();
+}
+
+//-----------------------------------------------------------------------------
+// purpose: adds an atlas texture that was composed in memory, the image is
+//          block compressed into the format requested by the map entry of the
+//          asset that owns the atlas
+//-----------------------------------------------------------------------------
+bool Texture_AddAtlasTexture(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath,
+                             const ImageRGBA_s& image, const rapidjson::Value& ownerEntry)
+{
+    if (pak->GetAssetByGuid(assetGuid, nullptr, true))
+        return false; // already present in the pak.
+
+    const char* const formatName = JSON_GetValueOrDefault(ownerEntry, TEXTURE_RAW_FORMAT_FIELD, TEXTURE_ATLAS_DEFAULT_FORMAT);
+    const DXGI_FORMAT dxgiFormat = BC_ParseFormat(formatName);
+
+    if (dxgiFormat == DXGI_FORMAT_UNKNOWN)
+        Error("Atlas texture \"%s\" requested unsupported format \"%s\"; expected one of the following: "
+            "BC1_UNORM(_SRGB):BC3_UNORM(_SRGB):BC4_UNORM:BC5_UNORM:BC7_UNORM(_SRGB):R8G8B8A8_UNORM(_SRGB).\n", assetPath, formatName);
+
+    TextureEncodeOptions_s encodeOptions;
+    Texture_ParseEncodeOptions(assetPath, &ownerEntry, encodeOptions);
+
+    std::vector<char> ddsImage;
+    Texture_BuildDDSImage(image, dxgiFormat, encodeOptions, assetPath, ddsImage);
+
+    // Atlases are sampled as a whole, these are never streamed.
+    Texture_InternalAddTexture(pak, assetGuid, assetPath, true, nullptr, &ddsImage);
+
+    return true;
+}
+
 bool Texture_AutoAddTexture(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const bool forceDisableStreaming)
 {
     PakAsset_t* const existingAsset = pak->GetAssetByGuid(assetGuid, nullptr, true);
@@ -431,7 +1611,7 @@ bool Texture_AutoAddTexture(CPakFileBuilder* const pak, const PakGuid_t assetGui
         return false; // already present in the pak.
 
     Debug("Auto-adding 'txtr' asset \"%s\".\n", assetPath);
-    Texture_InternalAddTexture(pak, assetGuid, assetPath, forceDisableStreaming);
+    Texture_InternalAddTexture(pak, assetGuid, assetPath, forceDisableStreaming, nullptr);
 
     return true;
 }
@@ -439,5 +1619,5 @@ bool Texture_AutoAddTexture(CPakFileBuilder* const pak, const PakGuid_t assetGui
 void Assets::AddTextureAsset_v8(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const rapidjson::Value& mapEntry)
 {
     const bool disableStreaming = JSON_GetValueOrDefault(mapEntry, "$disableStreaming", false);
-    Texture_InternalAddTexture(pak, assetGuid, assetPath, disableStreaming);
+    Texture_InternalAddTexture(pak, assetGuid, assetPath, disableStreaming, &mapEntry);
 }
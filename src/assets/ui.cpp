@@ -20,15 +20,18 @@ void UI_loadFromPackage(CPakFileBuilder* const pak, const PakGuid_t assetGuid, c
     RuiHeader_v30_s* ruiHdr = reinterpret_cast<RuiHeader_v30_s*>(hdrChunk.data);
     *ruiHdr = rui.CreateRuiHeader_v30();
     
-    PakPageLump_s nameChunk = pak->CreatePageLump(rui.name.size(),SF_CPU|SF_CLIENT,8);
-    memcpy(nameChunk.data,rui.name.data(),rui.name.size());
+    PakPageLump_s nameChunk = pak->ReservePageLump(rui.hdr.nameSize,SF_CPU|SF_CLIENT,8);
+    rui.ReadSection(nameChunk.data,rui.hdr.nameOffset,rui.hdr.nameSize);
     pak->AddPointer(hdrChunk,offsetof(RuiHeader_v30_s,name),nameChunk,0);
 
-    PakPageLump_s defaultValuesChunk = pak->CreatePageLump(rui.defaultData.size()+rui.defaultStrings.size(),SF_CPU|SF_CLIENT,8);
-    memcpy(defaultValuesChunk.data,rui.defaultData.data(),rui.defaultData.size());
-    memcpy(&defaultValuesChunk.data[rui.defaultData.size()],rui.defaultStrings.data(),rui.defaultStrings.size());
+    const size_t defaultDataSize = rui.hdr.defaultValuesSize;
+    const size_t defaultStringsSize = rui.hdr.defaultStringsDataSize;
+
+    PakPageLump_s defaultValuesChunk = pak->ReservePageLump(defaultDataSize+defaultStringsSize,SF_CPU|SF_CLIENT,8);
+    rui.ReadSection(defaultValuesChunk.data,rui.hdr.defaultValuesOffset,defaultDataSize);
+    rui.ReadSection(&defaultValuesChunk.data[defaultDataSize],rui.hdr.defaultStringDataOffset,defaultStringsSize);
     for (uint16_t offset : rui.defaultStringOffsets) {
-        uint64_t stringOffset = *reinterpret_cast<uint64_t*>(&rui.defaultData[offset])+rui.defaultData.size();
+        uint64_t stringOffset = *reinterpret_cast<uint64_t*>(&defaultValuesChunk.data[offset])+defaultDataSize;
         pak->AddPointer(defaultValuesChunk,offset,defaultValuesChunk,stringOffset);
     }
     pak->AddPointer(hdrChunk,offsetof(RuiHeader_v30_s,dataStructInitData),defaultValuesChunk,0);
@@ -38,8 +41,7 @@ void UI_loadFromPackage(CPakFileBuilder* const pak, const PakGuid_t assetGuid, c
         PakPageLump_s keyframingChunk = pak->CreatePageLump(rui.RuntimeKeyframingSize(), SF_CPU | SF_CLIENT, 8);
         const size_t keyframingValuesOffset = rui.keyframingMappings.size() * sizeof(RuiMapping_v30_s);
 
-        if (!rui.keyframingValues.empty())
-            memcpy(&keyframingChunk.data[keyframingValuesOffset], rui.keyframingValues.data(), rui.keyframingValues.size());
+        rui.ReadSection(&keyframingChunk.data[keyframingValuesOffset], rui.KeyframingValuesOffset(), rui.KeyframingValuesSize());
 
         for (size_t i = 0; i < rui.keyframingMappings.size(); ++i)
         {
@@ -56,26 +58,26 @@ void UI_loadFromPackage(CPakFileBuilder* const pak, const PakGuid_t assetGuid, c
         pak->AddPointer(hdrChunk, offsetof(RuiHeader_v30_s, keyframings), keyframingChunk, 0);
     }
 
-    PakPageLump_s argClustersChunk = pak->CreatePageLump(rui.argCluster.size()*sizeof(ArgCluster_s),SF_CPU|SF_CLIENT,8);
-    memcpy(argClustersChunk.data,rui.argCluster.data(),rui.argCluster.size()*sizeof(ArgCluster_s));
+    PakPageLump_s argClustersChunk = pak->ReservePageLump(rui.hdr.argClusterCount*sizeof(ArgCluster_s),SF_CPU|SF_CLIENT,8);
+    rui.ReadSection(argClustersChunk.data,rui.hdr.argClusterOffset,rui.hdr.argClusterCount*sizeof(ArgCluster_s));
     pak->AddPointer(hdrChunk,offsetof(RuiHeader_v30_s,argClusters),argClustersChunk,0);
 
-    PakPageLump_s argumentsChunk = pak->CreatePageLump(rui.arguments.size()*sizeof(Argument_s),SF_CPU|SF_CLIENT,8);
-    memcpy(argumentsChunk.data,rui.arguments.data(),rui.arguments.size()*sizeof(Argument_s));
+    PakPageLump_s argumentsChunk = pak->ReservePageLump(rui.hdr.argCount*sizeof(Argument_s),SF_CPU|SF_CLIENT,8);
+    rui.ReadSection(argumentsChunk.data,rui.hdr.argumentsOffset,rui.hdr.argCount*sizeof(Argument_s));
     pak->AddPointer(hdrChunk,offsetof(RuiHeader_v30_s,arguments),argumentsChunk,0);
     
     ruiHdr->argNames = 0;
 
-    PakPageLump_s styleDescriptorChunk = pak->CreatePageLump(rui.styleDescriptors.size(),SF_CPU|SF_CLIENT,8);
-    memcpy(styleDescriptorChunk.data,rui.styleDescriptors.data(),rui.styleDescriptors.size());
+    PakPageLump_s styleDescriptorChunk = pak->ReservePageLump(rui.StyleDescriptorsSize(),SF_CPU|SF_CLIENT,8);
+    rui.ReadSection(styleDescriptorChunk.data,rui.hdr.styleDescriptorOffset,rui.StyleDescriptorsSize());
     pak->AddPointer(hdrChunk,offsetof(RuiHeader_v30_s,styleDescriptors),styleDescriptorChunk,0);
     
-    PakPageLump_s renderJobChunk = pak->CreatePageLump(rui.renderJobs.size(),SF_CPU|SF_CLIENT,8);
-    memcpy(renderJobChunk.data,rui.renderJobs.data(),rui.renderJobs.size());
+    PakPageLump_s renderJobChunk = pak->ReservePageLump(rui.hdr.renderJobSize,SF_CPU|SF_CLIENT,8);
+    rui.ReadSection(renderJobChunk.data,rui.hdr.renderJobOffset,rui.hdr.renderJobSize);
     pak->AddPointer(hdrChunk,offsetof(RuiHeader_v30_s,renderJobData),renderJobChunk,0);
 
-    PakPageLump_s transformDataChunk = pak->CreatePageLump(rui.transformData.size(),SF_CPU|SF_CLIENT,8);
-    memcpy(transformDataChunk.data,rui.transformData.data(),rui.transformData.size());
+    PakPageLump_s transformDataChunk = pak->ReservePageLump(rui.hdr.transformDataSize,SF_CPU|SF_CLIENT,8);
+    rui.ReadSection(transformDataChunk.data,rui.hdr.transformDataOffset,rui.hdr.transformDataSize);
     pak->AddPointer(hdrChunk,offsetof(RuiHeader_v30_s,transformData),transformDataChunk,0);
 
     asset.InitAsset(hdrChunk.GetPointer(),sizeof(RuiHeader_v30_s),
@@ -1,9 +1,313 @@
 #include "pch.h"
 #include "assets.h"
 #include "utils/dxutils.h"
+#include "utils/imageloader.h"
+#include "utils/parallel.h"
+#include "utils/rectpacker.h"
 #include "public/texture.h"
 
 extern bool Texture_AutoAddTexture(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath, const bool forceDisableStreaming);
+extern bool Texture_DisablePendingStreaming(const PakGuid_t assetGuid);
+extern bool Texture_AddAtlasTexture(CPakFileBuilder* const pak, const PakGuid_t assetGuid, const char* const assetPath,
+                                    const ImageRGBA_s& image, const rapidjson::Value& ownerEntry);
+
+#define UIIMAGE_ATLAS_DEFAULT_PADDING 2
+#define UIIMAGE_ATLAS_MAX_SIZE 16384 // D3D11 texture dimension limit.
+
+// Image as placed in the atlas, either read from the map entry or produced by
+// the sprite packer.
+struct UIImageEntry_s
+{
+    std::string path;
+
+    float posX;
+    float posY;
+
+    uint16_t width;
+    uint16_t height;
+
+    UIImageOffset offset;
+};
+
+// Sprite loaded from the sprite directory, the image is trimmed to the area
+// that isn't fully transparent.
+struct UIImageSprite_s
+{
+    std::string path;
+    std::string filePath;
+
+    ImageRGBA_s image;
+
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+
+    uint32_t trimX;
+    uint32_t trimY;
+};
+
+static void UIImage_ParseImages(const rapidjson::Value& mapEntry, std::vector<UIImageEntry_s>& entries)
+{
+    rapidjson::Value::ConstMemberIterator imagesIt;
+    JSON_GetRequired(mapEntry, "images", JSONFieldType_e::kArray, imagesIt);
+
+    const rapidjson::Value::ConstArray& imageArray = imagesIt->value.GetArray();
+    entries.reserve(imageArray.Size());
+
+    int index = -1;
+
+    for (const rapidjson::Value& it : imageArray)
+    {
+        index++;
+
+        UIImageEntry_s& entry = entries.emplace_back();
+
+        rapidjson::Value::ConstMemberIterator pathIt;
+        JSON_GetRequired(it, "path", JSONFieldType_e::kString, pathIt);
+
+        if (pathIt->value.GetStringLength() == 0)
+            Error("Image #%i has an empty name!\n", index);
+
+        entry.path.assign(pathIt->value.GetString(), pathIt->value.GetStringLength());
+
+        entry.posX = JSON_GetNumberRequired<float>(it, "posX");
+        entry.posY = JSON_GetNumberRequired<float>(it, "posY");
+
+        entry.width = (uint16_t)JSON_GetNumberRequired<int>(it, "width");
+        entry.height = (uint16_t)JSON_GetNumberRequired<int>(it, "height");
+
+        UIImageOffset& uiio = entry.offset;
+        uiio.cropInsetLeft = JSON_GetValueOrDefault(it, "cropInsetLeft", 0.0f);
+        uiio.cropInsetTop = JSON_GetValueOrDefault(it, "cropInsetTop", 0.0f);
+
+        uiio.endAnchorX = JSON_GetValueOrDefault(it, "endAnchorX", 1.0f);
+        uiio.endAnchorY = JSON_GetValueOrDefault(it, "endAnchorY", 1.0f);
+
+        uiio.startAnchorX = JSON_GetValueOrDefault(it, "startAnchorX", 0.0f);
+        uiio.startAnchorY = JSON_GetValueOrDefault(it, "startAnchorY", 0.0f);
+
+        // Lower means more zoomed in.
+        uiio.scaleRatioX = JSON_GetValueOrDefault(it, "scaleRatioX", 1.0f);
+        uiio.scaleRatioY = JSON_GetValueOrDefault(it, "scaleRatioY", 1.0f);
+    }
+}
+
+// Shrinks the sprite to the bounding box of its pixels that aren't fully
+// transparent. Fully transparent sprites are kept as a single pixel.
+static void UIImage_TrimSprite(UIImageSprite_s& sprite)
+{
+    const ImageRGBA_s& image = sprite.image;
+
+    uint32_t minX = image.width, minY = image.height;
+    uint32_t maxX = 0, maxY = 0;
+
+    for (uint32_t y = 0; y < image.height; y++)
+    {
+        const uint8_t* const row = &image.pixels[static_cast<size_t>(y) * image.width * 4];
+
+        for (uint32_t x = 0; x < image.width; x++)
+        {
+            if (row[x * 4 + 3] == 0)
+                continue;
+
+            minX = (std::min)(minX, x);
+            maxX = (std::max)(maxX, x);
+            minY = (std::min)(minY, y);
+            maxY = (std::max)(maxY, y);
+        }
+    }
+
+    if (minX > maxX)
+        minX = maxX = minY = maxY = 0;
+
+    sprite.trimX = minX;
+    sprite.trimY = minY;
+
+    const uint32_t trimWidth = maxX - minX + 1;
+    const uint32_t trimHeight = maxY - minY + 1;
+
+    if (trimWidth == image.width && trimHeight == image.height)
+        return;
+
+    ImageRGBA_s trimmed;
+    trimmed.width = trimWidth;
+    trimmed.height = trimHeight;
+    trimmed.pixels.resize(static_cast<size_t>(trimWidth) * trimHeight * 4);
+
+    for (uint32_t y = 0; y < trimHeight; y++)
+    {
+        memcpy(&trimmed.pixels[static_cast<size_t>(y) * trimWidth * 4],
+            &image.pixels[((static_cast<size_t>(minY + y) * image.width) + minX) * 4], static_cast<size_t>(trimWidth) * 4);
+    }
+
+    sprite.image = std::move(trimmed);
+}
+
+// Loads all PNG and TGA files in the sprite directory and its subdirectories,
+// the image path of each sprite is its path relative to the directory without
+// the extension, prefixed with spritePrefix.
+static void UIImage_LoadSprites(const std::string& spriteDir, const char* const spritePrefix, const bool trim, std::vector<UIImageSprite_s>& sprites)
+{
+    if (!fs::is_directory(spriteDir))
+        Error("Sprite directory \"%s\" does not exist.\n", spriteDir.c_str());
+
+    for (const fs::directory_entry& it : fs::recursive_directory_iterator(spriteDir))
+    {
+        if (!it.is_regular_file())
+            continue;
+
+        std::string ext = it.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (ext != ".png" && ext != ".tga")
+            continue;
+
+        UIImageSprite_s& sprite = sprites.emplace_back();
+
+        sprite.filePath = it.path().string();
+        sprite.path = spritePrefix + fs::relative(it.path(), spriteDir).replace_extension().generic_string();
+    }
+
+    if (sprites.empty())
+        Error("Sprite directory \"%s\" does not contain any .png or .tga files.\n", spriteDir.c_str());
+
+    // Directory iteration order isn't defined, sort to keep builds deterministic.
+    std::sort(sprites.begin(), sprites.end(), [](const UIImageSprite_s& a, const UIImageSprite_s& b) { return a.path < b.path; });
+
+    for (size_t i = 1; i < sprites.size(); i++)
+    {
+        if (sprites[i].path == sprites[i - 1].path)
+            Error("Sprites \"%s\" and \"%s\" map to the same image path \"%s\".\n",
+                sprites[i - 1].filePath.c_str(), sprites[i].filePath.c_str(), sprites[i].path.c_str());
+    }
+
+    // Workers must not exit the process, failures are reported afterwards.
+    std::vector<char> loaded(sprites.size(), false);
+    std::vector<std::string> loadErrors(sprites.size());
+
+    const auto loadSprite = [&](const size_t i)
+    {
+        UIImageSprite_s& sprite = sprites[i];
+
+        if (!Image_LoadRGBA(sprite.filePath, sprite.image, loadErrors[i]))
+            return;
+
+        sprite.sourceWidth = sprite.image.width;
+        sprite.sourceHeight = sprite.image.height;
+
+        sprite.trimX = 0;
+        sprite.trimY = 0;
+
+        if (trim)
+            UIImage_TrimSprite(sprite);
+
+        loaded[i] = true;
+    };
+
+    if (!Image_InitDecoders())
+        Error("Failed to initialize the Windows Imaging Component for sprite directory \"%s\".\n", spriteDir.c_str());
+
+    Parallel_For(sprites.size(), loadSprite);
+
+    for (size_t i = 0; i < sprites.size(); i++)
+    {
+        if (loaded[i])
+            continue;
+
+        if (!loadErrors[i].empty())
+            Error("Failed to load sprite \"%s\": %s", sprites[i].filePath.c_str(), loadErrors[i].c_str());
+
+        Error("Failed to open sprite \"%s\".\n", sprites[i].filePath.c_str());
+    }
+}
+
+// Packs the sprites from the sprite directory into a new atlas texture, and
+// produces the image entries that map them back out of it.
+static bool UIImage_PackSprites(CPakFileBuilder* const pak, const PakGuid_t atlasGuid, const char* const atlasPath,
+                                const rapidjson::Value& mapEntry, const char* const spriteDir, std::vector<UIImageEntry_s>& entries)
+{
+    const steady_clock::time_point start = high_resolution_clock::now();
+
+    const char* const spritePrefix = JSON_GetValueOrDefault(mapEntry, "spritePrefix", "");
+    const bool trim = JSON_GetValueOrDefault(mapEntry, "trimSprites", true);
+    const uint32_t padding = JSON_GetValueOrDefault(mapEntry, "spritePadding", static_cast<uint32_t>(UIIMAGE_ATLAS_DEFAULT_PADDING));
+
+    std::vector<UIImageSprite_s> sprites;
+    UIImage_LoadSprites(pak->GetAssetPath() + spriteDir, spritePrefix, trim, sprites);
+
+    if (sprites.size() > MAX_UI_ATLAS_IMAGES)
+        Error("UI image atlas contains too many images (max %zu, got %zu).\n", (size_t)MAX_UI_ATLAS_IMAGES, sprites.size());
+
+    // The padding keeps the sprites from bleeding into each other through
+    // filtering, and partially through block compression.
+    std::vector<PackRect_s> rects(sprites.size());
+
+    for (size_t i = 0; i < sprites.size(); i++)
+    {
+        rects[i].width = sprites[i].image.width + padding;
+        rects[i].height = sprites[i].image.height + padding;
+    }
+
+    uint32_t atlasWidth, atlasHeight;
+
+    // Heights are aligned to the block size of the compressed formats.
+    if (!RectPack_PackMinArea(rects, UIIMAGE_ATLAS_MAX_SIZE, 4, atlasWidth, atlasHeight))
+        Error("Sprites in \"%s\" do not fit in an atlas of %ux%u.\n", spriteDir, UIIMAGE_ATLAS_MAX_SIZE, UIIMAGE_ATLAS_MAX_SIZE);
+
+    ImageRGBA_s atlas;
+    atlas.width = atlasWidth;
+    atlas.height = atlasHeight;
+    atlas.pixels.resize(static_cast<size_t>(atlasWidth) * atlasHeight * 4, 0);
+
+    size_t spriteArea = 0;
+    entries.reserve(sprites.size());
+
+    for (size_t i = 0; i < sprites.size(); i++)
+    {
+        const UIImageSprite_s& sprite = sprites[i];
+        const PackRect_s& rect = rects[i];
+
+        const ImageRGBA_s& image = sprite.image;
+        const size_t rowSize = static_cast<size_t>(image.width) * 4;
+
+        for (uint32_t y = 0; y < image.height; y++)
+            memcpy(&atlas.pixels[((static_cast<size_t>(rect.y + y) * atlasWidth) + rect.x) * 4], &image.pixels[y * rowSize], rowSize);
+
+        spriteArea += static_cast<size_t>(image.width) * image.height;
+
+        UIImageEntry_s& entry = entries.emplace_back();
+
+        entry.path = sprite.path;
+
+        entry.posX = static_cast<float>(rect.x);
+        entry.posY = static_cast<float>(rect.y);
+
+        entry.width = static_cast<uint16_t>(image.width);
+        entry.height = static_cast<uint16_t>(image.height);
+
+        // The scale ratios zoom the trimmed image back out to the size of
+        // the source sprite in the runtime, and the anchors place the trimmed
+        // area where it was within the source sprite.
+        UIImageOffset& uiio = entry.offset;
+        uiio.cropInsetLeft = 0.0f;
+        uiio.cropInsetTop = 0.0f;
+
+        uiio.scaleRatioX = (float)sprite.sourceWidth / (float)image.width;
+        uiio.scaleRatioY = (float)sprite.sourceHeight / (float)image.height;
+
+        uiio.startAnchorX = (float)sprite.trimX / (float)sprite.sourceWidth;
+        uiio.startAnchorY = (float)sprite.trimY / (float)sprite.sourceHeight;
+        uiio.endAnchorX = ((float)sprite.trimX + (float)image.width) / (float)sprite.sourceWidth;
+        uiio.endAnchorY = ((float)sprite.trimY + (float)image.height) / (float)sprite.sourceHeight;
+    }
+
+    const steady_clock::time_point stop = high_resolution_clock::now();
+    const double seconds = duration_cast<microseconds>(stop - start).count() / 1000000.0;
+
+    Log("Packed %zu sprites from \"%s\" into a %ux%u atlas in %.3f seconds ( %.1f%% occupancy ).\n", sprites.size(), spriteDir,
+        atlasWidth, atlasHeight, seconds, (100.0 * spriteArea) / (static_cast<double>(atlasWidth) * atlasHeight));
+
+    return Texture_AddAtlasTexture(pak, atlasGuid, atlasPath, atlas, mapEntry);
+}
 
 // page lump structure and order:
 // - header        HEAD        (align=8)
@@ -16,11 +320,31 @@ void Assets::AddUIImageAsset_v10(CPakFileBuilder* const pak, const PakGuid_t ass
     const char* const atlasPath = JSON_GetValueRequired<const char*>(mapEntry, "atlas");
     const PakGuid_t atlasGuid = RTech::StringToGuid(atlasPath);
 
-    const bool textureAdded = Texture_AutoAddTexture(pak, atlasGuid, atlasPath, true);
+    std::vector<UIImageEntry_s> images;
+    bool textureAdded;
+
+    rapidjson::Value::ConstMemberIterator spritesIt;
+
+    // Either pack the atlas from a directory of loose sprites, or use a
+    // pre-packed atlas along with the placement of each image.
+    if (JSON_GetIterator(mapEntry, "sprites", JSONFieldType_e::kString, spritesIt))
+    {
+        textureAdded = UIImage_PackSprites(pak, atlasGuid, atlasPath, mapEntry, spritesIt->value.GetString(), images);
+
+        if (!textureAdded)
+            Error("UI Atlas texture \"%s\" with GUID 0x%llX was already added while its sprites are packed by this asset.\n", atlasPath, atlasGuid);
+    }
+    else
+    {
+        textureAdded = Texture_AutoAddTexture(pak, atlasGuid, atlasPath, true);
+        UIImage_ParseImages(mapEntry, images);
+    }
 
     const PakAsset_t* const atlasAsset = pak->GetAssetByGuid(atlasGuid, nullptr, true);
 
-    if(!textureAdded && atlasAsset && atlasAsset->HasAnyStreamedData())
+    // Textures that are still waiting for the streaming plan don't have any
+    // streamed data yet, these are kept permanent instead.
+    if(!textureAdded && atlasAsset && !Texture_DisablePendingStreaming(atlasGuid) && atlasAsset->HasAnyStreamedData())
         Error("UI Atlas texture \"%s\" with GUID 0x%llX was already added as a texture with streaming data. UI Image atlases do not support streaming.\n", atlasPath, atlasGuid);
 
     if (!atlasAsset) [[ unlikely ]]
@@ -34,11 +358,7 @@ void Assets::AddUIImageAsset_v10(CPakFileBuilder* const pak, const PakGuid_t ass
 
     PakAsset_t& asset = pak->BeginAsset(assetGuid, assetPath);
 
-    rapidjson::Value::ConstMemberIterator imagesIt;
-    JSON_GetRequired(mapEntry, "images", JSONFieldType_e::kArray, imagesIt);
-
-    const rapidjson::Value::ConstArray& imageArray = imagesIt->value.GetArray();
-    const size_t imageArraySize = imageArray.Size();
+    const size_t imageArraySize = images.size();
 
     if (imageArraySize > MAX_UI_ATLAS_IMAGES)
         Error("UI image atlas contains too many images (max %zu, got %zu).\n", (size_t)MAX_UI_ATLAS_IMAGES, imageArraySize);
@@ -77,102 +397,8 @@ void Assets::AddUIImageAsset_v10(CPakFileBuilder* const pak, const PakGuid_t ass
 
     ////////////////////
     // IMAGE OFFSETS
-    for (const rapidjson::Value& it : imageArray)
-    {
-        UIImageOffset uiio;
-        uiio.cropInsetLeft = JSON_GetValueOrDefault(it, "cropInsetLeft", 0.0f);
-        uiio.cropInsetTop = JSON_GetValueOrDefault(it, "cropInsetTop", 0.0f);
-
-        uiio.endAnchorX = JSON_GetValueOrDefault(it, "endAnchorX", 1.0f);
-        uiio.endAnchorY = JSON_GetValueOrDefault(it, "endAnchorY", 1.0f);
-
-        uiio.startAnchorX = JSON_GetValueOrDefault(it, "startAnchorX", 0.0f);
-        uiio.startAnchorY = JSON_GetValueOrDefault(it, "startAnchorY", 0.0f);
-
-        // Lower means more zoomed in.
-        uiio.scaleRatioX = JSON_GetValueOrDefault(it, "scaleRatioX", 1.0f);
-        uiio.scaleRatioY = JSON_GetValueOrDefault(it, "scaleRatioY", 1.0f);
-
-        // [amos]: tools like TexturePacker can automatically create entire ui image atlases.
-        // TexturePacker can also trim out transparent area's (exactly like how the original
-        // Respawn UI image atlas textures have their transparency clipped out). The purpose
-        // of this `UIImageAtlasOffset` structure is to account for this; the scaleRatioX
-        // and scaleRatioY can zoom the image back out again to reconstruct the trimmed out
-        // transparency in the runtime. This is very ideal for keeping the image atlas size
-        // as low as possible.
-        // 
-        // TexturePacker exports the following data alongside the generated atlas texture:
-        // {
-        // 	"filename": "rui/hud/tactical_icons/pilot_tactical_particle_wall",
-        // 	"frame": {"x":1921,"y":1501,"w":62,"h":80},
-        // 	"rotated": false,
-        // 	"trimmed": true,
-        // 	"spriteSourceSize": {"x":33,"y":24,"w":62,"h":80},
-        // 	"sourceSize": {"w":128,"h":128}
-        // },
-        // {
-        // 	"filename": "rui/menu/buttons/weapon_categories/marksman",
-        // 	"frame": {"x":1226,"y":1,"w":526,"h":329},
-        // 	"rotated": false,
-        // 	"trimmed": true,
-        // 	"spriteSourceSize": {"x":138,"y":55,"w":526,"h":329},
-        // 	"sourceSize": {"w":802,"h":440}
-        // },
-        // 
-        // It keeps the source sprite size and positions and provides the actual (new) size
-        // and positions of the sprite within the atlas, the idea is to figure out how to
-        // compute the scale ratios and anchors based on these values.
-        // 
-        // For scaleRatio, this seems to get very close:
-        // uiio.scaleRatioX = 1.0f + ((float)(sourceWidth - croppedWidth) / (float)croppedWidth);
-        // uiio.scaleRatioY = 1.0f + ((float)(sourceHeight - croppedHeight) / (float)croppedHeight);
-        // 
-        // I'm not sure how to calculate the anchors correctly yet, time ran out when I
-        // started to poke around with those. These need to be figured out so that the
-        // images are correctly placed again on the RUI mesh within the runtime as scaling
-        // does offset the image slightly (which the anchors need to correct).
-        // 
-        // 
-        // Also, on Respawn UI image atlases, the cropInsetLeft and cropInsetTop variables
-        // are sometimes set as well, these aren't very important, but probably need more
-        // research as well...
-        /*
-        uint32_t sourcePosX;
-        uint32_t sourcePosY;
-        uint32_t sourceWidth;
-        uint32_t sourceHeight;
-
-        if (JSON_GetValue(it, "sourcePosX", JSONFieldType_e::kUint32, sourcePosX) &&
-            JSON_GetValue(it, "sourcePosY", JSONFieldType_e::kUint32, sourcePosY) &&
-            JSON_GetValue(it, "sourceWidth", JSONFieldType_e::kUint32, sourceWidth) &&
-            JSON_GetValue(it, "sourceHeight", JSONFieldType_e::kUint32, sourceHeight)
-            )
-        {
-            const uint16_t croppedWidth = (uint16_t)JSON_GetNumberRequired<uint32_t>(it, "width");
-            const uint16_t croppedHeight = (uint16_t)JSON_GetNumberRequired<uint32_t>(it, "height");
-
-            uiio.scaleRatioX = (float)sourceWidth / (float)croppedWidth;
-            uiio.scaleRatioY = (float)sourceHeight / (float)croppedHeight;
-
-            uiio.startAnchorX = (float)sourcePosX / (float)sourceWidth;
-            uiio.startAnchorY = (float)sourcePosY / (float)sourceHeight;
-            uiio.endAnchorX = ((float)sourcePosX + (float)croppedWidth) / (float)sourceWidth;
-            uiio.endAnchorY = ((float)sourcePosY + (float)croppedHeight) / (float)sourceHeight;
-        }
-        else // Default scale.
-        {
-            uiio.endAnchorX = 1.0f;
-            uiio.endAnchorY = 1.0f;
-
-            uiio.startAnchorX = 0.0f;
-            uiio.startAnchorY = 0.0f;
-
-            uiio.scaleRatioX = 1.0f;
-            uiio.scaleRatioY = 1.0f;
-        }
-        */
-        ofBuf.write(uiio);
-    }
+    for (const UIImageEntry_s& it : images)
+        ofBuf.write(it.offset);
 
     const size_t imageDimensionsDataSize = sizeof(uint16_t) * 2 * imageArraySize;
     const size_t imageHashesDataSize = (sizeof(uint32_t) + sizeof(uint32_t)) * imageArraySize;
@@ -188,13 +414,10 @@ void Assets::AddUIImageAsset_v10(CPakFileBuilder* const pak, const PakGuid_t ass
     // set image dimensions page index and offset
     pak->AddPointer(hdrLump, offsetof(UIImageAtlasHeader_t, pImageDimensions), infoLump, 0);
 
-    for (const rapidjson::Value& it : imageArray)
+    for (const UIImageEntry_s& it : images)
     {
-        const uint16_t width = (uint16_t)JSON_GetNumberRequired<int>(it, "width");
-        const uint16_t height = (uint16_t)JSON_GetNumberRequired<int>(it, "height");
-
-        ifBuf.write<uint16_t>(width);
-        ifBuf.write<uint16_t>(height);
+        ifBuf.write<uint16_t>(it.width);
+        ifBuf.write<uint16_t>(it.height);
     }
 
     // set image hashes page index and offset
@@ -203,22 +426,8 @@ void Assets::AddUIImageAsset_v10(CPakFileBuilder* const pak, const PakGuid_t ass
 
     if (pak->IsFlagSet(PF_KEEP_DEV))
     {
-        int index = -1;
-
-        for (const rapidjson::Value& it : imageArray)
-        {
-            index++;
-
-            rapidjson::Value::ConstMemberIterator pathIt;
-            JSON_GetRequired(it, "path", JSONFieldType_e::kString, pathIt);
-
-            const size_t pathLen = pathIt->value.GetStringLength();
-
-            if (pathLen == 0)
-                Error("Image #%i has an empty name!\n", index);
-
-            stringBufSize += pathLen + 1; // +1 for null terminator.
-        }
+        for (const UIImageEntry_s& it : images)
+            stringBufSize += it.path.length() + 1; // +1 for null terminator.
     }
 
     PakPageLump_s devLump{};
@@ -230,23 +439,13 @@ void Assets::AddUIImageAsset_v10(CPakFileBuilder* const pak, const PakGuid_t ass
     }
 
     uint32_t nextStringTableOffset = 0;
-    int index = -1;
 
     /////////////////////////
     // IMAGE HASHES/NAMES
-    for (const rapidjson::Value& it : imageArray)
+    for (const UIImageEntry_s& it : images)
     {
-        index++;
-
-        rapidjson::Value::ConstMemberIterator pathIt;
-        JSON_GetRequired(it, "path", JSONFieldType_e::kString, pathIt);
-
-        const size_t pathLen = pathIt->value.GetStringLength();
-
-        if (pathLen == 0)
-            Error("Image #%i has an empty name!\n", index);
-
-        const char* const imagePath = pathIt->value.GetString();
+        const size_t pathLen = it.path.length();
+        const char* const imagePath = it.path.c_str();
         const uint32_t pathHash = RTech::StringToUIMGHash(imagePath);
 
         ifBuf.write(pathHash);
@@ -275,17 +474,17 @@ void Assets::AddUIImageAsset_v10(CPakFileBuilder* const pak, const PakGuid_t ass
 
     //////////////
     // IMAGE UVS
-    for (const rapidjson::Value& it : imageArray)
+    for (const UIImageEntry_s& it : images)
     {
         UIImageUV uiiu;
 
-        const float uv0x = JSON_GetNumberRequired<float>(it, "posX") / pHdr->width;
-        const float uv1x = JSON_GetNumberRequired<float>(it, "width") / pHdr->width;
+        const float uv0x = it.posX / pHdr->width;
+        const float uv1x = static_cast<float>(it.width) / pHdr->width;
 
         Debug("X: %f -> %f\n", uv0x, uv0x + uv1x);
 
-        const float uv0y = JSON_GetNumberRequired<float>(it, "posY") / pHdr->height;
-        const float uv1y = JSON_GetNumberRequired<float>(it, "height") / pHdr->height;
+        const float uv0y = it.posY / pHdr->height;
+        const float uv1y = static_cast<float>(it.height) / pHdr->height;
 
         Debug("Y: %f -> %f\n", uv0y, uv0y + uv1y);
 
@@ -5,6 +5,9 @@
 #define PF_KEEP_DEV 1 << 0 // whether or not to keep debugging information
 #define PF_KEEP_SERVER 1 << 1 // whether or not to keep server only data
 #define PF_KEEP_CLIENT 1 << 2 // whether or not to keep client only data
+#define PF_COLLAPSE_SOLID_TEXTURES 1 << 3 // whether or not to collapse solid color textures to 4x4
+#define PF_DEMOTE_OPAQUE_BC3 1 << 4 // whether or not to rewrite fully opaque BC3 textures as BC1
+#define PF_STRIP_SHADERS 1 << 5 // whether or not to strip blobs the runtime doesn't use from shader bytecode
 
 #define PAK_HEADER_SIZE_V8 0x80
 #define PAK_HEADER_SIZE_V6 0x58
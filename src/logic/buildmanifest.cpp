@@ -0,0 +1,516 @@
+//=============================================================================//
+//
+// Compiled build map manifest
+//
+//=============================================================================//
+#include "pch.h"
+#include "buildmanifest.h"
+#include "pakfile.h"
+#include "utils/stringpool.h"
+
+struct BuildManifestWriter_s
+{
+	// Strings are interned, asset paths are referenced by both the value
+	// stream and the asset table.
+	CStringPool strings;
+	std::vector<char> values;
+};
+
+template <typename T>
+static void BuildManifest_Append(std::vector<char>& buf, const T& value)
+{
+	const char* const data = reinterpret_cast<const char*>(&value);
+	buf.insert(buf.end(), data, data + sizeof(T));
+}
+
+static void BuildManifest_WriteTag(BuildManifestWriter_s& writer, const BuildManifestValueType_e type)
+{
+	BuildManifest_Append(writer.values, type);
+}
+
+static void BuildManifest_WriteString(BuildManifestWriter_s& writer, const char* const str, const size_t length)
+{
+	const size_t offset = writer.strings.Add(std::string_view(str, length));
+
+	BuildManifest_Append(writer.values, static_cast<uint32_t>(offset));
+	BuildManifest_Append(writer.values, static_cast<uint32_t>(length));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: serializes the json value, numbers keep the representation the
+//          parser would have given them so the reconstructed document passes
+//          the same type checks
+//-----------------------------------------------------------------------------
+static void BuildManifest_WriteValue(BuildManifestWriter_s& writer, const js::Value& value)
+{
+	switch (value.GetType())
+	{
+	case js::kNullType:
+		BuildManifest_WriteTag(writer, BuildManifestValueType_e::kNull);
+		break;
+	case js::kFalseType:
+		BuildManifest_WriteTag(writer, BuildManifestValueType_e::kFalse);
+		break;
+	case js::kTrueType:
+		BuildManifest_WriteTag(writer, BuildManifestValueType_e::kTrue);
+		break;
+	case js::kNumberType:
+	{
+		if (value.IsDouble())
+		{
+			BuildManifest_WriteTag(writer, BuildManifestValueType_e::kDouble);
+			BuildManifest_Append(writer.values, value.GetDouble());
+		}
+		else if (value.IsUint())
+		{
+			BuildManifest_WriteTag(writer, BuildManifestValueType_e::kUint);
+			BuildManifest_Append(writer.values, value.GetUint());
+		}
+		else if (value.IsInt())
+		{
+			BuildManifest_WriteTag(writer, BuildManifestValueType_e::kInt);
+			BuildManifest_Append(writer.values, value.GetInt());
+		}
+		else if (value.IsUint64())
+		{
+			BuildManifest_WriteTag(writer, BuildManifestValueType_e::kUint64);
+			BuildManifest_Append(writer.values, value.GetUint64());
+		}
+		else
+		{
+			BuildManifest_WriteTag(writer, BuildManifestValueType_e::kInt64);
+			BuildManifest_Append(writer.values, value.GetInt64());
+		}
+		break;
+	}
+	case js::kStringType:
+		BuildManifest_WriteTag(writer, BuildManifestValueType_e::kString);
+		BuildManifest_WriteString(writer, value.GetString(), value.GetStringLength());
+		break;
+	case js::kArrayType:
+	{
+		BuildManifest_WriteTag(writer, BuildManifestValueType_e::kArray);
+		BuildManifest_Append(writer.values, static_cast<uint32_t>(value.Size()));
+
+		for (const js::Value& element : value.GetArray())
+			BuildManifest_WriteValue(writer, element);
+
+		break;
+	}
+	case js::kObjectType:
+	{
+		BuildManifest_WriteTag(writer, BuildManifestValueType_e::kObject);
+		BuildManifest_Append(writer.values, static_cast<uint32_t>(value.MemberCount()));
+
+		for (const auto& member : value.GetObject())
+		{
+			BuildManifest_WriteString(writer, member.name.GetString(), member.name.GetStringLength());
+			BuildManifest_WriteValue(writer, member.value);
+		}
+
+		break;
+	}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: validates the assets of the map and resolves their handlers and
+//          guids, the checks match those of CPakFileBuilder::AddAsset
+//-----------------------------------------------------------------------------
+static void BuildManifest_ResolveAssets(const js::Document& doc, BuildManifestWriter_s& writer, std::vector<BuildManifestAsset_s>& assets)
+{
+	js::Value::ConstMemberIterator filesIt;
+
+	if (!JSON_GetIterator(doc, "files", JSONFieldType_e::kArray, filesIt))
+		return;
+
+	for (const js::Value& file : filesIt->value.GetArray())
+	{
+		const char* const assetType = JSON_GetValueOrDefault(file, "_type", static_cast<const char*>(nullptr));
+		const char* const assetPath = JSON_GetValueOrDefault(file, "_path", static_cast<const char*>(nullptr));
+
+		if (!assetType)
+			Error("No type provided for asset \"%s\".\n", assetPath ? assetPath : "(unknown)");
+
+		if (!assetPath)
+			Error("No path provided for an asset of type '%.4s'.\n", assetType);
+
+		const int handlerIndex = CPakFileBuilder::FindAssetHandler(assetType);
+
+		if (handlerIndex < 0)
+			Error("Asset '%s' uses unknown asset type '%.4s'.\n", assetPath, assetType);
+
+		BuildManifestAsset_s& asset = assets.emplace_back();
+
+		asset.guid = Pak_GetGuidOverridable(file, assetPath);
+		asset.pathOffset = static_cast<uint32_t>(writer.strings.Add(assetPath));
+		asset.handlerIndex = static_cast<uint16_t>(handlerIndex);
+		asset.reserved = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: compiles the build map and the maps it lists into a manifest
+// Input  : *mapPath -
+//          *manifestPath -
+//-----------------------------------------------------------------------------
+void CBuildManifest::Compile(const char* const mapPath, const char* const manifestPath)
+{
+	Log("*** compiling build map \"%s\".\n", mapPath);
+
+	// The documents must outlive the writer, as its string pool references
+	// their strings.
+	std::vector<std::unique_ptr<js::Document>> docs;
+	docs.push_back(std::make_unique<js::Document>());
+
+	JSON_ParseFromFile(mapPath, "main build map", *docs[0], true);
+
+	// Relative paths in the manifest are resolved against the source map, so
+	// the manifest can be placed anywhere.
+	const std::string absoluteMapPath = fs::absolute(mapPath).string();
+
+	js::Value::ConstMemberIterator paksIt;
+	const bool isBuildList = JSON_GetIterator(*docs[0], "paks", paksIt);
+
+	if (isBuildList)
+	{
+		const js::Value& list = paksIt->value;
+
+		if (!list.IsArray())
+		{
+			Error("Pak build list is of type %s, but code expects %s.\n",
+				JSON_TypeToString(JSON_ExtractType(list)), JSON_TypeToString(JSONFieldType_e::kArray));
+		}
+
+		ssize_t i = -1;
+
+		for (const js::Value& pak : list.GetArray())
+		{
+			i++;
+
+			if (!pak.IsString())
+			{
+				Error("Pak #%zd in build list is of type %s, but code expects %s.\n",
+					i, JSON_TypeToString(JSON_ExtractType(pak)), JSON_TypeToString(JSONFieldType_e::kString));
+			}
+
+			Log("*** parsing listed build map \"%s\".\n", pak.GetString());
+			std::string listedMapPath = pak.GetString();
+
+			Utils::ResolvePath(listedMapPath, absoluteMapPath);
+
+			docs.push_back(std::make_unique<js::Document>());
+			JSON_ParseFromFile(listedMapPath.c_str(), "listed build map", *docs.back(), true);
+		}
+	}
+
+	BuildManifestWriter_s writer;
+
+	std::vector<BuildManifestMap_s> maps(docs.size());
+	std::vector<BuildManifestAsset_s> assets;
+
+	for (size_t i = 0; i < docs.size(); i++)
+	{
+		BuildManifestMap_s& map = maps[i];
+
+		map.rootValueOffset = writer.values.size();
+		map.firstAsset = static_cast<uint32_t>(assets.size());
+
+		BuildManifest_WriteValue(writer, *docs[i]);
+
+		// Assets of the main map are never built when it lists other maps.
+		if (i > 0 || !isBuildList)
+			BuildManifest_ResolveAssets(*docs[i], writer, assets);
+
+		map.assetCount = static_cast<uint32_t>(assets.size() - map.firstAsset);
+	}
+
+	const size_t handlerCount = CPakFileBuilder::GetAssetHandlerCount();
+	std::vector<uint32_t> handlerTypes(handlerCount);
+
+	for (size_t i = 0; i < handlerCount; i++)
+		handlerTypes[i] = static_cast<uint32_t>(writer.strings.Add(CPakFileBuilder::GetAssetHandler(i).assetType));
+
+	const size_t mapPathOffset = writer.strings.Add(absoluteMapPath);
+
+	if (writer.strings.GetSize() > UINT32_MAX)
+		Error("Build map \"%s\" has too much string data to compile; %zu bytes, limit is %u.\n", mapPath, writer.strings.GetSize(), UINT32_MAX);
+
+	std::unique_ptr<char[]> stringBuf(new char[writer.strings.GetSize()]);
+	writer.strings.Write(stringBuf.get());
+
+	BuildManifestFileHeader_s hdr;
+
+	hdr.magic = BUILD_MANIFEST_FILE_MAGIC;
+	hdr.version = BUILD_MANIFEST_FILE_VERSION;
+	hdr.handlerCount = static_cast<unsigned short>(handlerCount);
+
+	hdr.mapCount = static_cast<uint32_t>(maps.size());
+	hdr.assetCount = static_cast<uint32_t>(assets.size());
+
+	hdr.mapPathOffset = static_cast<uint32_t>(mapPathOffset);
+	hdr.handlerTypesOffset = sizeof(BuildManifestFileHeader_s);
+
+	hdr.mapsOffset = IALIGN8(hdr.handlerTypesOffset + handlerTypes.size() * sizeof(uint32_t));
+	hdr.assetsOffset = hdr.mapsOffset + maps.size() * sizeof(BuildManifestMap_s);
+
+	hdr.valuesOffset = hdr.assetsOffset + assets.size() * sizeof(BuildManifestAsset_s);
+	hdr.valuesSize = writer.values.size();
+
+	hdr.stringsOffset = hdr.valuesOffset + hdr.valuesSize;
+	hdr.stringsSize = writer.strings.GetSize();
+
+	const size_t handlerTypesSize = handlerTypes.size() * sizeof(uint32_t);
+
+	const BinaryIOVec_s vecs[] = {
+		{ &hdr, sizeof(hdr) },
+		{ handlerTypes.data(), handlerTypesSize },
+		{ nullptr, hdr.mapsOffset - (hdr.handlerTypesOffset + handlerTypesSize) },
+		{ maps.data(), maps.size() * sizeof(BuildManifestMap_s) },
+		{ assets.data(), assets.size() * sizeof(BuildManifestAsset_s) },
+		{ writer.values.data(), writer.values.size() },
+		{ stringBuf.get(), writer.strings.GetSize() },
+	};
+
+	BinaryIO out;
+
+	if (!out.Open(manifestPath, BinaryIO::Mode_e::Write))
+		Error("Failed to open build manifest \"%s\" for write.\n", manifestPath);
+
+	out.WriteGathered(vecs, ARRAYSIZE(vecs));
+
+	Log("*** compiled %u build maps with %u assets into \"%s\" ( %zu bytes ).\n",
+		hdr.mapCount, hdr.assetCount, manifestPath, static_cast<size_t>(hdr.stringsOffset + hdr.stringsSize));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: maps and validates the build manifest
+// Input  : *manifestPath -
+// Output : false if the file isn't a build manifest
+//-----------------------------------------------------------------------------
+bool CBuildManifest::Load(const char* const manifestPath)
+{
+	if (!m_file.Open(manifestPath) || m_file.GetSize() < sizeof(BuildManifestFileHeader_s))
+		return false;
+
+	const BuildManifestFileHeader_s* const hdr = reinterpret_cast<const BuildManifestFileHeader_s*>(m_file.GetData());
+
+	if (hdr->magic != BUILD_MANIFEST_FILE_MAGIC)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	if (hdr->version != BUILD_MANIFEST_FILE_VERSION)
+	{
+		Error("Build manifest \"%s\" has version %hu, but code expects %hu; the build map must be recompiled.\n",
+			manifestPath, hdr->version, (unsigned short)BUILD_MANIFEST_FILE_VERSION);
+	}
+
+	const bool isInRange = m_file.IsInRange(hdr->handlerTypesOffset, hdr->handlerCount * sizeof(uint32_t))
+		&& m_file.IsInRange(hdr->mapsOffset, hdr->mapCount * sizeof(BuildManifestMap_s))
+		&& m_file.IsInRange(hdr->assetsOffset, hdr->assetCount * sizeof(BuildManifestAsset_s))
+		&& m_file.IsInRange(hdr->valuesOffset, hdr->valuesSize)
+		&& m_file.IsInRange(hdr->stringsOffset, hdr->stringsSize)
+		&& hdr->stringsSize > 0 && m_file.GetData()[hdr->stringsOffset + hdr->stringsSize - 1] == '\0';
+
+	if (!isInRange || hdr->mapCount == 0)
+		Error("Build manifest \"%s\" appears truncated or malformed.\n", manifestPath);
+
+	m_header = hdr;
+	m_maps = reinterpret_cast<const BuildManifestMap_s*>(m_file.GetData() + hdr->mapsOffset);
+	m_assets = reinterpret_cast<const BuildManifestAsset_s*>(m_file.GetData() + hdr->assetsOffset);
+
+	m_values = m_file.GetData() + hdr->valuesOffset;
+	m_valuesEnd = m_values + hdr->valuesSize;
+	m_strings = m_file.GetData() + hdr->stringsOffset;
+
+	// Handler indices are only valid for the asset types they were resolved
+	// against, these change between versions of this program.
+	const uint32_t* const handlerTypes = reinterpret_cast<const uint32_t*>(m_file.GetData() + hdr->handlerTypesOffset);
+	bool handlersMatch = hdr->handlerCount == CPakFileBuilder::GetAssetHandlerCount();
+
+	for (size_t i = 0; handlersMatch && i < hdr->handlerCount; i++)
+	{
+		handlersMatch = handlerTypes[i] < hdr->stringsSize
+			&& strcmp(GetString(handlerTypes[i]), CPakFileBuilder::GetAssetHandler(i).assetType) == 0;
+	}
+
+	if (!handlersMatch)
+		Error("Build manifest \"%s\" was compiled for a different set of asset types; the build map must be recompiled.\n", manifestPath);
+
+	for (uint32_t i = 0; i < hdr->mapCount; i++)
+	{
+		const BuildManifestMap_s& map = m_maps[i];
+
+		if (map.rootValueOffset >= hdr->valuesSize || map.firstAsset > hdr->assetCount || map.assetCount > hdr->assetCount - map.firstAsset)
+			Error("Build manifest \"%s\" has a malformed entry for map #%u.\n", manifestPath, i);
+	}
+
+	for (uint32_t i = 0; i < hdr->assetCount; i++)
+	{
+		const BuildManifestAsset_s& asset = m_assets[i];
+
+		if (asset.pathOffset >= hdr->stringsSize || asset.handlerIndex >= hdr->handlerCount)
+			Error("Build manifest \"%s\" has a malformed entry for asset #%u.\n", manifestPath, i);
+	}
+
+	Log("*** loaded build manifest \"%s\" compiled from \"%s\" ( %u maps, %u assets ).\n",
+		manifestPath, GetMapPath(), hdr->mapCount, hdr->assetCount);
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: reads a value from the value stream
+// Input  : *cur -
+//          &value -
+//          &allocator -
+// Output : pointer to the next value
+//-----------------------------------------------------------------------------
+const char* CBuildManifest::ReadValue(const char* cur, js::Value& value, js::Document::AllocatorType& allocator) const
+{
+	const auto read = [&]<typename T>(T& out)
+	{
+		if (static_cast<size_t>(m_valuesEnd - cur) < sizeof(T))
+			Error("Build manifest value stream is truncated at offset %zu.\n", static_cast<size_t>(cur - m_values));
+
+		memcpy(&out, cur, sizeof(T));
+		cur += sizeof(T);
+	};
+
+	const auto readString = [&]() -> js::Value::StringRefType
+	{
+		uint32_t offset, length;
+
+		read(offset);
+		read(length);
+
+		if (offset >= m_header->stringsSize || length >= m_header->stringsSize - offset)
+			Error("Build manifest string at offset %u is out of range.\n", offset);
+
+		return js::StringRef(GetString(offset), length);
+	};
+
+	BuildManifestValueType_e type;
+	read(type);
+
+	switch (type)
+	{
+	case BuildManifestValueType_e::kNull:
+		value.SetNull();
+		break;
+	case BuildManifestValueType_e::kFalse:
+		value.SetBool(false);
+		break;
+	case BuildManifestValueType_e::kTrue:
+		value.SetBool(true);
+		break;
+	case BuildManifestValueType_e::kInt:
+	{
+		int num;
+		read(num);
+		value.SetInt(num);
+		break;
+	}
+	case BuildManifestValueType_e::kUint:
+	{
+		unsigned int num;
+		read(num);
+		value.SetUint(num);
+		break;
+	}
+	case BuildManifestValueType_e::kInt64:
+	{
+		int64_t num;
+		read(num);
+		value.SetInt64(num);
+		break;
+	}
+	case BuildManifestValueType_e::kUint64:
+	{
+		uint64_t num;
+		read(num);
+		value.SetUint64(num);
+		break;
+	}
+	case BuildManifestValueType_e::kDouble:
+	{
+		double num;
+		read(num);
+		value.SetDouble(num);
+		break;
+	}
+	case BuildManifestValueType_e::kString:
+		value.SetString(readString());
+		break;
+	case BuildManifestValueType_e::kArray:
+	{
+		uint32_t count;
+		read(count);
+
+		value.SetArray();
+		value.Reserve(count, allocator);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			js::Value element;
+			cur = ReadValue(cur, element, allocator);
+
+			value.PushBack(element, allocator);
+		}
+
+		break;
+	}
+	case BuildManifestValueType_e::kObject:
+	{
+		uint32_t count;
+		read(count);
+
+		value.SetObject();
+		value.MemberReserve(count, allocator);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			js::Value name(readString());
+			js::Value member;
+
+			cur = ReadValue(cur, member, allocator);
+			value.AddMember(name, member, allocator);
+		}
+
+		break;
+	}
+	default:
+		Error("Build manifest value at offset %zu has unknown type %hhu.\n", static_cast<size_t>(cur - m_values - 1), static_cast<uint8_t>(type));
+	}
+
+	return cur;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: reconstructs the document of the map, its strings reference the
+//          manifest which must outlive it
+// Input  : mapIndex -
+//          &doc -
+//-----------------------------------------------------------------------------
+void CBuildManifest::LoadDocument(const uint32_t mapIndex, js::Document& doc) const
+{
+	assert(mapIndex < m_header->mapCount);
+	ReadValue(m_values + m_maps[mapIndex].rootValueOffset, doc, doc.GetAllocator());
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: returns the resolved asset for the entry in the "files" array
+// Input  : mapIndex -
+//          assetIndex -
+//-----------------------------------------------------------------------------
+const BuildManifestAsset_s& CBuildManifest::GetAsset(const uint32_t mapIndex, const size_t assetIndex) const
+{
+	const BuildManifestMap_s& map = m_maps[mapIndex];
+
+	if (assetIndex >= map.assetCount)
+		Error("Build manifest map #%u has %u assets, but asset #%zu was requested.\n", mapIndex, map.assetCount, assetIndex);
+
+	return m_assets[map.firstAsset + assetIndex];
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "utils/mappedfile.h"
+
+#define BUILD_MANIFEST_FILE_MAGIC ('R'+('P'<<8)+('k'<<16)+('M'<<24))
+#define BUILD_MANIFEST_FILE_VERSION 1
+
+#define BUILD_MANIFEST_FILE_EXTENSION ".rpakm"
+
+struct BuildManifestFileHeader_s
+{
+	int magic;
+	unsigned short version;
+
+	// Number of asset handlers the handler indices were resolved against, the
+	// types of these are stored so outdated manifests can be detected.
+	unsigned short handlerCount;
+
+	uint32_t mapCount; // The main map, followed by the maps in its "paks" list.
+	uint32_t assetCount;
+
+	uint32_t mapPathOffset; // Source map, relative paths are resolved against it.
+	uint32_t handlerTypesOffset;
+
+	uint64_t mapsOffset;
+	uint64_t assetsOffset;
+
+	uint64_t valuesOffset;
+	uint64_t valuesSize;
+
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+};
+
+struct BuildManifestMap_s
+{
+	uint64_t rootValueOffset; // Offset into the value stream.
+
+	uint32_t firstAsset;
+	uint32_t assetCount; // One for each entry in the "files" array.
+};
+
+struct BuildManifestAsset_s
+{
+	PakGuid_t guid;
+
+	uint32_t pathOffset;
+	uint16_t handlerIndex;
+	uint16_t reserved;
+};
+static_assert(sizeof(BuildManifestAsset_s) == 16);
+
+// Json values are stored as a tag followed by their payload; strings are an
+// offset and length into the string table, arrays and objects their element
+// count followed by the elements, objects store the name of each member before
+// its value.
+enum class BuildManifestValueType_e : uint8_t
+{
+	kNull,
+	kFalse,
+	kTrue,
+	kInt,
+	kUint,
+	kInt64,
+	kUint64,
+	kDouble,
+	kString,
+	kArray,
+	kObject,
+};
+
+// Build map with its listed maps, validated and with the handler and guid of
+// each asset resolved ahead of time. Documents are reconstructed from the
+// manifest without parsing, their strings reference the mapped manifest.
+class CBuildManifest
+{
+public:
+	static void Compile(const char* const mapPath, const char* const manifestPath);
+
+	// Returns false if the file isn't a build manifest.
+	bool Load(const char* const manifestPath);
+
+	void LoadDocument(const uint32_t mapIndex, js::Document& doc) const;
+
+	const BuildManifestAsset_s& GetAsset(const uint32_t mapIndex, const size_t assetIndex) const;
+	inline uint32_t GetAssetCount(const uint32_t mapIndex) const { return m_maps[mapIndex].assetCount; };
+
+	inline uint32_t GetMapCount() const { return m_header->mapCount; };
+	inline const char* GetMapPath() const { return GetString(m_header->mapPathOffset); };
+
+	inline const char* GetString(const uint32_t offset) const { return m_strings + offset; };
+
+private:
+	const char* ReadValue(const char* cur, js::Value& value, js::Document::AllocatorType& allocator) const;
+
+	CMappedFile m_file;
+
+	const BuildManifestFileHeader_s* m_header = nullptr;
+	const BuildManifestMap_s* m_maps = nullptr;
+	const BuildManifestAsset_s* m_assets = nullptr;
+
+	const char* m_values = nullptr;
+	const char* m_valuesEnd = nullptr;
+	const char* m_strings = nullptr;
+};
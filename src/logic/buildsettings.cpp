@@ -42,5 +42,17 @@ void CBuildSettings::Init(const js::Document& doc, const char* const buildMapFil
 	if (JSON_GetValueOrDefault(doc, "keepClientOnly", true))
 		AddFlags(PF_KEEP_CLIENT);
 
+	// Should textures that are a single color be replaced with a 4x4 texture.
+	if (JSON_GetValueOrDefault(doc, "collapseSolidTextures", false))
+		AddFlags(PF_COLLAPSE_SOLID_TEXTURES);
+
+	// Should BC3 textures without any transparency be rewritten as BC1.
+	if (JSON_GetValueOrDefault(doc, "demoteOpaqueBC3", false))
+		AddFlags(PF_DEMOTE_OPAQUE_BC3);
+
+	// Should debug info and other unused blobs be stripped from shader bytecode.
+	if (JSON_GetValueOrDefault(doc, "stripShaders", false))
+		AddFlags(PF_STRIP_SHADERS);
+
 	g_showDebugLogs = JSON_GetValueOrDefault(doc, "showDebugInfo", false);
 }
@@ -7,7 +7,10 @@
 #include "pch.h"
 #include "pakfile.h"
 #include "assets/assets.h"
+#include "buildmanifest.h"
 #include "utils/zstdutils.h"
+#include "utils/parallel.h"
+#include "utils/stringpool.h"
 
 CPakFileBuilder::CPakFileBuilder(const CBuildSettings* const buildSettings, CStreamFileBuilder* const streamBuilder)
 {
@@ -15,7 +18,7 @@ CPakFileBuilder::CPakFileBuilder(const CBuildSettings* const buildSettings, CStr
 	m_streamBuilder = streamBuilder;
 }
 
-static std::unordered_set<PakAssetHandler_s, PakAssetHasher_s> s_pakAssetHandlers
+static const PakAssetHandler_s s_pakAssetHandlers[] =
 {
 	{"anir", PakAssetScope_e::kServerOnly, Assets::AddAnimRecording_v1, Assets::AddAnimRecording_v1},
 	{"txtr", PakAssetScope_e::kClientOnly, Assets::AddTextureAsset_v8, Assets::AddTextureAsset_v8},
@@ -37,7 +40,30 @@ static std::unordered_set<PakAssetHandler_s, PakAssetHasher_s> s_pakAssetHandler
 	{"ui", PakAssetScope_e::kClientOnly, Assets::AddRuiAsset_v30, nullptr}
 };
 
-void CPakFileBuilder::AddJSONAsset(const PakAssetHandler_s& assetHandler, const char* const assetPath, const rapidjson::Value& file)
+int CPakFileBuilder::FindAssetHandler(const char* const assetType)
+{
+	for (int i = 0; i < ARRAYSIZE(s_pakAssetHandlers); i++)
+	{
+		if (strcmp(s_pakAssetHandlers[i].assetType, assetType) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+const PakAssetHandler_s& CPakFileBuilder::GetAssetHandler(const size_t index)
+{
+	assert(index < ARRAYSIZE(s_pakAssetHandlers));
+	return s_pakAssetHandlers[index];
+}
+
+size_t CPakFileBuilder::GetAssetHandlerCount()
+{
+	return ARRAYSIZE(s_pakAssetHandlers);
+}
+
+void CPakFileBuilder::AddJSONAsset(const PakAssetHandler_s& assetHandler, const char* const assetPath, const rapidjson::Value& file,
+	const PakGuid_t* const compiledGuid)
 {
 	switch (assetHandler.assetScope)
 	{
@@ -73,7 +99,7 @@ void CPakFileBuilder::AddJSONAsset(const PakAssetHandler_s& assetHandler, const
 		Debug("Adding '%s' asset \"%s\".\n", assetHandler.assetType, assetPath);
 
 		const steady_clock::time_point start = high_resolution_clock::now();
-		const PakGuid_t assetGuid = Pak_GetGuidOverridable(file, assetPath);
+		const PakGuid_t assetGuid = compiledGuid ? *compiledGuid : Pak_GetGuidOverridable(file, assetPath);
 
 		targetFunc(this, assetGuid, assetPath, file);
 		const steady_clock::time_point stop = high_resolution_clock::now();
@@ -102,13 +128,26 @@ void CPakFileBuilder::AddAsset(const rapidjson::Value& file)
 
 	g_currentAsset = assetPath;
 
-	const auto it = s_pakAssetHandlers.find({ assetType });
+	const int handlerIndex = FindAssetHandler(assetType);
 
-	if (it == s_pakAssetHandlers.end())
+	if (handlerIndex < 0)
 		Error("Asset '%s' uses unknown asset type '%.4s'.\n", assetPath, assetType);
 	else
-		AddJSONAsset(*it, assetPath, file);
+		AddJSONAsset(s_pakAssetHandlers[handlerIndex], assetPath, file);
+
+	g_currentAsset = nullptr;
+}
 
+//-----------------------------------------------------------------------------
+// purpose: adds an asset that was validated and resolved by the build manifest
+//-----------------------------------------------------------------------------
+void CPakFileBuilder::AddCompiledAsset(const rapidjson::Value& file, const CBuildManifest& manifest, const uint32_t mapIndex, const size_t assetIndex)
+{
+	const BuildManifestAsset_s& compiled = manifest.GetAsset(mapIndex, assetIndex);
+	const char* const assetPath = manifest.GetString(compiled.pathOffset);
+
+	g_currentAsset = assetPath;
+	AddJSONAsset(s_pakAssetHandlers[compiled.handlerIndex], assetPath, file, &compiled.guid);
 	g_currentAsset = nullptr;
 }
 
@@ -166,7 +205,8 @@ int64_t CPakFileBuilder::AddStreamingFileReference(const char* const path, const
 //-----------------------------------------------------------------------------
 // purpose: adds new starpak data entry
 //-----------------------------------------------------------------------------
-PakStreamSetEntry_s CPakFileBuilder::AddStreamingDataEntry(const int64_t size, const uint8_t* const data, const PakStreamSet_e set)
+PakStreamSetEntry_s CPakFileBuilder::AddStreamingDataEntry(const int64_t size, const uint8_t* const data, const PakStreamSet_e set,
+	const __m128i* const dataHash)
 {
 	const size_t pageAligned = IALIGN(size, STARPAK_DATABLOCK_ALIGNMENT);
 	const size_t windowRemainder = pageAligned - size;
@@ -184,7 +224,7 @@ PakStreamSetEntry_s CPakFileBuilder::AddStreamingDataEntry(const int64_t size, c
 	}
 
 	StreamAddEntryResults_s results;
-	m_streamBuilder->AddStreamingDataEntry(size, data, set, results);
+	m_streamBuilder->AddStreamingDataEntry(size, data, set, results, dataHash);
 
 	PakStreamSetEntry_s block;
 
@@ -215,47 +255,84 @@ void CPakFileBuilder::WriteHeader(BinaryIO& io)
 
 	const uint16_t version = m_Header.fileVersion;
 
-	io.Write(m_Header.magic);
-	io.Write(m_Header.fileVersion);
-	io.Write(m_Header.flags);
-	io.Write(m_Header.fileTime);
-	io.Write(m_Header.unk0);
-	io.Write(m_Header.compressedSize);
+	// Serialize into a single buffer so the header is written at once.
+	char headerBuf[sizeof(PakHdr_t)];
+	rmem buf(headerBuf, sizeof(headerBuf));
+
+	buf.write(m_Header.magic);
+	buf.write(m_Header.fileVersion);
+	buf.write(m_Header.flags);
+	buf.write(m_Header.fileTime);
+	buf.write(m_Header.unk0);
+	buf.write(m_Header.compressedSize);
 
 	if (version == 8)
-		io.Write(m_Header.embeddedStarpakOffset);
+		buf.write(m_Header.embeddedStarpakOffset);
 
-	io.Write(m_Header.unk1);
-	io.Write(m_Header.decompressedSize);
+	buf.write(m_Header.unk1);
+	buf.write(m_Header.decompressedSize);
 
 	if (version == 8)
-		io.Write(m_Header.embeddedStarpakSize);
+		buf.write(m_Header.embeddedStarpakSize);
 
-	io.Write(m_Header.unk2);
-	io.Write(m_Header.starpakPathsSize);
+	buf.write(m_Header.unk2);
+	buf.write(m_Header.starpakPathsSize);
 
 	if (version == 8)
-		io.Write(m_Header.optStarpakPathsSize);
+		buf.write(m_Header.optStarpakPathsSize);
 
-	io.Write(m_Header.memSlabCount);
-	io.Write(m_Header.memPageCount);
-	io.Write(m_Header.patchIndex);
+	buf.write(m_Header.memSlabCount);
+	buf.write(m_Header.memPageCount);
+	buf.write(m_Header.patchIndex);
 
 	if (version == 8)
-		io.Write(m_Header.alignment);
+		buf.write(m_Header.alignment);
 
-	io.Write(m_Header.pointerCount);
-	io.Write(m_Header.assetCount);
-	io.Write(m_Header.usesCount);
-	io.Write(m_Header.dependentsCount);
+	buf.write(m_Header.pointerCount);
+	buf.write(m_Header.assetCount);
+	buf.write(m_Header.usesCount);
+	buf.write(m_Header.dependentsCount);
 
 	if (version == 7)
 	{
-		io.Write(m_Header.unk7count);
-		io.Write(m_Header.unk8count);
+		buf.write(m_Header.unk7count);
+		buf.write(m_Header.unk8count);
 	}
 	else if (version == 8)
-		io.Write(m_Header.unk3);
+		buf.write(m_Header.unk3);
+
+	assert(buf.getPosition() == Pak_GetHeaderSize(version));
+	io.Write(headerBuf, buf.getPosition());
+}
+
+//-----------------------------------------------------------------------------
+// purpose: serializes a single asset descriptor, the layout differs per version
+//-----------------------------------------------------------------------------
+static void Pak_WriteAssetDescriptor(rmem& buf, const PakAsset_t& asset, const uint16_t version)
+{
+	buf.write(asset.guid);
+	buf.write(asset.unk0);
+	buf.write(asset.headPtr.index);
+	buf.write(asset.headPtr.offset);
+	buf.write(asset.cpuPtr.index);
+	buf.write(asset.cpuPtr.offset);
+	buf.write(asset.GetPackedStreamOffset());
+
+	if (version == 8)
+		buf.write(asset.GetPackedOptStreamOffset());
+
+	assert(asset.pageEnd <= UINT16_MAX);
+	uint16_t pageEnd = static_cast<uint16_t>(asset.pageEnd);
+	buf.write(pageEnd);
+
+	buf.write(asset.internalDependencyCount);
+	buf.write(asset.dependentsIndex);
+	buf.write(asset.usesIndex);
+	buf.write(asset.dependentsCount);
+	buf.write(asset.usesCount);
+	buf.write(asset.headDataSize);
+	buf.write(asset.version);
+	buf.write(asset.id);
 }
 
 //-----------------------------------------------------------------------------
@@ -263,35 +340,24 @@ void CPakFileBuilder::WriteHeader(BinaryIO& io)
 //-----------------------------------------------------------------------------
 void CPakFileBuilder::WriteAssetDescriptors(BinaryIO& io)
 {
+	const uint16_t version = this->m_Header.fileVersion;
+
+	// The descriptor layout differs per version, so the fields are serialized
+	// individually into one buffer which is then written at once.
+	const size_t tableSize = m_assets.size() * Pak_GetAssetDescriptorSize(version);
+	std::unique_ptr<char[]> tableBuf(new char[tableSize]);
+
+	rmem buf(tableBuf.get(), tableSize);
+
 	for (PakAsset_t& it : m_assets)
 	{
-		io.Write(it.guid);
-		io.Write(it.unk0);
-		io.Write(it.headPtr.index);
-		io.Write(it.headPtr.offset);
-		io.Write(it.cpuPtr.index);
-		io.Write(it.cpuPtr.offset);
-		io.Write(it.GetPackedStreamOffset());
-
-		if (this->m_Header.fileVersion == 8)
-			io.Write(it.GetPackedOptStreamOffset());
-
-		assert(it.pageEnd <= UINT16_MAX);
-		uint16_t pageEnd = static_cast<uint16_t>(it.pageEnd);
-		io.Write(pageEnd);
-
-		io.Write(it.internalDependencyCount);
-		io.Write(it.dependentsIndex);
-		io.Write(it.usesIndex);
-		io.Write(it.dependentsCount);
-		io.Write(it.usesCount);
-		io.Write(it.headDataSize);
-		io.Write(it.version);
-		io.Write(it.id);
-
+		Pak_WriteAssetDescriptor(buf, it, version);
 		it.SetPublicData<void*>(nullptr);
 	}
 
+	assert(buf.getPosition() == tableSize);
+	io.Write(tableBuf.get(), tableSize);
+
 	assert(m_assets.size() <= UINT32_MAX);
 	// update header asset count with the assets we've just written
 	this->m_Header.assetCount = static_cast<uint32_t>(m_assets.size());
@@ -315,27 +381,33 @@ void CPakFileBuilder::WritePagePointers(BinaryIO& out)
 	// pointers must be written in order otherwise the runtime crashes as the
 	// decoding depends on their order.
 	std::sort(m_pagePointers.begin(), m_pagePointers.end());
-
-	for (const PagePtr_t& ptr : m_pagePointers)
-		out.Write(ptr);
+	out.Write(m_pagePointers.data(), m_pagePointers.size() * sizeof(PagePtr_t));
 }
 
 void CPakFileBuilder::WriteAssetUses(BinaryIO& out)
 {
+	std::vector<PagePtr_t> uses;
+	uses.reserve(m_Header.usesCount);
+
 	for (const PakAsset_t& it : m_assets)
 	{
 		for (const PakGuidRef_s& ref : it._uses)
-			out.Write(ref.ptr);
+			uses.push_back(ref.ptr);
 	}
+
+	out.Write(uses.data(), uses.size() * sizeof(PagePtr_t));
 }
 
 void CPakFileBuilder::WriteAssetDependents(BinaryIO& out)
 {
+	// The dependents are already stored contiguously per asset.
+	std::vector<BinaryIOVec_s> vecs;
+	vecs.reserve(m_assets.size());
+
 	for (const PakAsset_t& it : m_assets)
-	{
-		for (const unsigned int dependent : it._dependents)
-			out.Write(dependent);
-	}
+		vecs.push_back({ it._dependents.data(), it._dependents.size() * sizeof(unsigned int) });
+
+	out.WriteGathered(vecs.data(), vecs.size());
 }
 
 //-----------------------------------------------------------------------------
@@ -394,6 +466,64 @@ void CPakFileBuilder::GenerateAssetUses()
 	m_Header.usesCount = static_cast<uint32_t>(totalUsesCount);
 }
 
+//-----------------------------------------------------------------------------
+// purpose: writes all tables and the page data into a mapped file, the final
+//          location of everything is known at this point so the assets and
+//          lumps are written in parallel
+//-----------------------------------------------------------------------------
+void CPakFileBuilder::WriteTablesAndPageDataMapped(char* const out)
+{
+	const uint16_t version = m_Header.fileVersion;
+
+	// Same ordering requirement as WritePagePointers.
+	std::sort(m_pagePointers.begin(), m_pagePointers.end());
+
+	const size_t descriptorSize = Pak_GetAssetDescriptorSize(version);
+
+	char* const slabHeaders = out;
+	char* const pageHeaders = slabHeaders + (m_pageBuilder.GetSlabCount() * sizeof(PakSlabHdr_s));
+	char* const pointers = pageHeaders + (m_pageBuilder.GetPageCount() * sizeof(PakPageHdr_s));
+	char* const descriptors = pointers + (m_pagePointers.size() * sizeof(PagePtr_t));
+	char* const uses = descriptors + (m_assets.size() * descriptorSize);
+	char* const dependents = uses + (m_Header.usesCount * sizeof(PagePtr_t));
+	char* const pageData = dependents + (m_Header.dependentsCount * sizeof(uint32_t));
+
+	m_pageBuilder.WriteSlabHeaders(slabHeaders);
+	m_pageBuilder.WritePageHeaders(pageHeaders);
+
+	if (!m_pagePointers.empty())
+		memcpy(pointers, m_pagePointers.data(), m_pagePointers.size() * sizeof(PagePtr_t));
+
+	// Every asset has a fixed slot in the descriptor table, and its uses and
+	// dependents are located through the indices generated earlier.
+	Parallel_For(m_assets.size(), [&](const size_t i)
+	{
+		const PakAsset_t& asset = m_assets[i];
+
+		rmem buf(&descriptors[i * descriptorSize], descriptorSize);
+		Pak_WriteAssetDescriptor(buf, asset, version);
+
+		char* const assetUses = &uses[asset.usesIndex * sizeof(PagePtr_t)];
+
+		for (size_t j = 0; j < asset._uses.size(); j++)
+			memcpy(&assetUses[j * sizeof(PagePtr_t)], &asset._uses[j].ptr, sizeof(PagePtr_t));
+
+		if (!asset._dependents.empty())
+		{
+			memcpy(&dependents[asset.dependentsIndex * sizeof(uint32_t)],
+				asset._dependents.data(), asset._dependents.size() * sizeof(uint32_t));
+		}
+	});
+
+	for (PakAsset_t& it : m_assets)
+		it.SetPublicData<void*>(nullptr);
+
+	assert(m_assets.size() <= UINT32_MAX);
+	this->m_Header.assetCount = static_cast<uint32_t>(m_assets.size());
+
+	m_pageBuilder.WritePageData(pageData);
+}
+
 //-----------------------------------------------------------------------------
 // purpose: populates file relations vector with combined asset relation data
 //-----------------------------------------------------------------------------
@@ -424,6 +554,11 @@ PakPageLump_s CPakFileBuilder::CreatePageLump(const size_t size, const int flags
 	return m_pageBuilder.CreatePageLump(static_cast<int>(size), flags, alignment, buf);
 }
 
+PakPageLump_s CPakFileBuilder::ReservePageLump(const size_t size, const int flags, const int alignment)
+{
+	return m_pageBuilder.ReservePageLump(static_cast<int>(size), flags, alignment);
+}
+
 //-----------------------------------------------------------------------------
 // purpose: 
 // returns: 
@@ -747,7 +882,7 @@ size_t Pak_DecodeStreamAndSwap(BinaryIO& io, const uint16_t pakVersion, const ch
 //-----------------------------------------------------------------------------
 // purpose: builds rpak and starpak from input map file
 //-----------------------------------------------------------------------------
-void CPakFileBuilder::BuildFromMap(const js::Document& doc)
+void CPakFileBuilder::BuildFromMap(const js::Document& doc, const CBuildManifest* const manifest, const uint32_t mapIndex)
 {
 	// determine source asset directory from map file
 	m_assetPath = JSON_GetValueRequired<const char*>(doc, "assetsDir");
@@ -788,10 +923,57 @@ void CPakFileBuilder::BuildFromMap(const js::Document& doc)
 
 	if (JSON_GetIterator(doc, "files", JSONFieldType_e::kArray, filesIt))
 	{
-		for (const auto& file : filesIt->value.GetArray())
-			AddAsset(file);
+		// The streaming budgets apply to the pak as a whole, so textures are
+		// laid out once every asset that could add one has been added.
+		extern void Texture_BeginStreamPlan(const rapidjson::Value& doc);
+		extern void Texture_EndStreamPlan(CPakFileBuilder* const pak);
+
+		Texture_BeginStreamPlan(doc);
+
+		// Model sources are loaded and hashed ahead, the assets themselves are
+		// still added in map order so the output matches a serial build.
+		extern void Model_BeginPrefetch(CPakFileBuilder* const pak, const rapidjson::Value& files);
+		extern void Model_EndPrefetch();
+
+		Model_BeginPrefetch(this, filesIt->value);
+
+		if (manifest)
+		{
+			const rapidjson::Value::ConstArray files = filesIt->value.GetArray();
+
+			if (files.Size() != manifest->GetAssetCount(mapIndex))
+				Error("Build manifest map #%u has %u assets, but its document lists %zu.\n", mapIndex, manifest->GetAssetCount(mapIndex), files.Size());
+
+			for (size_t i = 0; i < files.Size(); i++)
+				AddCompiledAsset(files[i], *manifest, mapIndex, i);
+		}
+		else
+		{
+			for (const auto& file : filesIt->value.GetArray())
+				AddAsset(file);
+		}
+
+		Model_EndPrefetch();
+		Texture_EndStreamPlan(this);
 	}
 
+	extern void Texture_LogIngestStats();
+	Texture_LogIngestStats();
+	extern void DataTable_LogCacheStats();
+	DataTable_LogCacheStats();
+	extern void Shader_LogBuildStats();
+	Shader_LogBuildStats();
+	StringPool_LogStats();
+	JSON_LogParseStats();
+
+	// Settings layouts, json documents and shader bytecode are only shared
+	// within a single build.
+	extern void SettingsLayout_ClearCache();
+	SettingsLayout_ClearCache();
+	JSON_ClearDocumentCache();
+	extern void Shader_ClearByteCodeCache();
+	Shader_ClearByteCodeCache();
+
 	{
 		// write string vectors for starpak paths and get the total length of each vector
 		size_t starpakPathsLength = WriteStarpakPaths(out, STREAMING_SET_MANDATORY);
@@ -820,18 +1002,64 @@ void CPakFileBuilder::BuildFromMap(const js::Document& doc)
 	// Pad all of the slabs so that they fit the alignment padding of all contained pages
 	m_pageBuilder.PadSlabSizeForPageAlignment();
 
-	// Write header info for slab headers and page headers
-	m_pageBuilder.WriteSlabHeaders(out);
-	m_pageBuilder.WritePageHeaders(out);
+	// Everything from here on has a known size, so the final file size is
+	// known as well.
+	const size_t tablesOffset = static_cast<size_t>(out.TellPut());
+	const size_t expectedFileSize = tablesOffset
+		+ (m_pageBuilder.GetSlabCount() * sizeof(PakSlabHdr_s))
+		+ (m_pageBuilder.GetPageCount() * sizeof(PakPageHdr_s))
+		+ (m_pagePointers.size() * sizeof(PagePtr_t))
+		+ (m_assets.size() * Pak_GetAssetDescriptorSize(GetVersion()))
+		+ (m_Header.usesCount * sizeof(PagePtr_t))
+		+ (m_Header.dependentsCount * sizeof(uint32_t))
+		+ m_pageBuilder.GetTotalPageDataSize();
+
+	const steady_clock::time_point writeStart = high_resolution_clock::now();
+	const size_t writeCallsStart = out.GetWriteCallCount();
+
+	// If the backend supports it, map the output and write everything into
+	// its final location directly.
+	char* const mappedFile = out.BeginMappedWrite(expectedFileSize);
+
+	if (mappedFile)
+	{
+		WriteTablesAndPageDataMapped(&mappedFile[tablesOffset]);
+		out.EndMappedWrite();
+	}
+	else
+	{
+		// Let the backend preallocate the file instead.
+		out.Reserve(expectedFileSize);
 
-	WritePagePointers(out);
-	WriteAssetDescriptors(out);
+		// Write header info for slab headers and page headers
+		m_pageBuilder.WriteSlabHeaders(out);
+		m_pageBuilder.WritePageHeaders(out);
 
-	WriteAssetUses(out);
-	WriteAssetDependents(out);
+		WritePagePointers(out);
+		WriteAssetDescriptors(out);
 
-	// now the actual paged data
-	m_pageBuilder.WritePageData(out);
+		WriteAssetUses(out);
+		WriteAssetDependents(out);
+
+		// now the actual paged data
+		m_pageBuilder.WritePageData(out);
+	}
+
+	const steady_clock::time_point writeStop = high_resolution_clock::now();
+	const microseconds writeDuration = duration_cast<microseconds>(writeStop - writeStart);
+
+	if (mappedFile)
+	{
+		Debug("Wrote pak tables and page data through a mapped file using %zu workers; took %lld ms.\n",
+			Parallel_GetDefaultWorkerCount(), writeDuration.count());
+	}
+	else
+	{
+		Debug("Wrote pak tables and page data in %zu write calls using the \"%s\" IO backend; took %lld ms.\n",
+			out.GetWriteCallCount() - writeCallsStart, BinaryIO::BackendToString(out.GetBackend()), writeDuration.count());
+	}
+
+	assert(static_cast<size_t>(out.GetSize()) == expectedFileSize);
 
 	// We are done building the data of the pack, this is the actual size.
 	const size_t decompressedFileSize = out.GetSize();
@@ -862,5 +1090,17 @@ void CPakFileBuilder::BuildFromMap(const js::Document& doc)
 
 	Log("*** built pak file \"%s\" with %zu assets, totaling %zd bytes.\n",
 		m_pakFilePath.c_str(), GetAssetCount(), out.GetSize());
+
+	// All lumps stay alive until the page data has been written, so their sum
+	// is the peak lump memory of the build. Only the allocated lumps are filled
+	// by copying, reserved lumps are read into and adopted lumps are taken over.
+	const size_t allocatedLumpBytes = m_pageBuilder.GetAllocatedLumpBytes();
+	const size_t reservedLumpBytes = m_pageBuilder.GetReservedLumpBytes();
+	const size_t adoptedLumpBytes = m_pageBuilder.GetAdoptedLumpBytes();
+
+	Log("*** page lumps held %.2f MiB at write time; %.2f MiB copied, %.2f MiB read in place, %.2f MiB adopted.\n",
+		(allocatedLumpBytes + reservedLumpBytes + adoptedLumpBytes) / (1024.0 * 1024.0), allocatedLumpBytes / (1024.0 * 1024.0),
+		reservedLumpBytes / (1024.0 * 1024.0), adoptedLumpBytes / (1024.0 * 1024.0));
+
 	out.Close();
 }
@@ -24,6 +24,7 @@ enum class PakAssetScope_e
 };
 
 class CPakFileBuilder;
+class CBuildManifest;
 typedef void(*PakAssetAddFunc_t)(CPakFileBuilder*, const PakGuid_t, const char*, const rapidjson::Value&);
 
 struct PakAssetHandler_s
@@ -39,14 +40,6 @@ struct PakAssetHandler_s
 	PakAssetAddFunc_t func_r5;
 };
 
-struct PakAssetHasher_s
-{
-	std::size_t operator()(const PakAssetHandler_s& s) const
-	{
-		return std::hash<std::string_view>{}(s.assetType);
-	}
-};
-
 class CPakFileBuilder
 {
 	friend class CPakPage;
@@ -58,20 +51,30 @@ public:
 	// assets
 	//----------------------------------------------------------------------------
 
-	void AddJSONAsset(const PakAssetHandler_s& assetHandler, const char* const assetPath, const rapidjson::Value& file);
+	void AddJSONAsset(const PakAssetHandler_s& assetHandler, const char* const assetPath, const rapidjson::Value& file,
+		const PakGuid_t* const compiledGuid = nullptr);
 	void AddAsset(const rapidjson::Value& file);
+	void AddCompiledAsset(const rapidjson::Value& file, const CBuildManifest& manifest, const uint32_t mapIndex, const size_t assetIndex);
+
+	// Handler indices are stable for as long as the handler table is unchanged,
+	// see CBuildManifest.
+	static int FindAssetHandler(const char* const assetType);
+	static const PakAssetHandler_s& GetAssetHandler(const size_t index);
+	static size_t GetAssetHandlerCount();
 
 	void AddPointer(PakPageLump_s& pointerLump, const size_t pointerOffset, const PakPageLump_s& dataLump, const size_t dataOffset);
 	void AddPointer(PakPageLump_s& pointerLump, const size_t pointerOffset);
 
 	int64_t AddStreamingFileReference(const char* const path, const bool mandatory);
 
-	PakStreamSetEntry_s AddStreamingDataEntry(const int64_t size, const uint8_t* const data, const PakStreamSet_e set);
+	PakStreamSetEntry_s AddStreamingDataEntry(const int64_t size, const uint8_t* const data, const PakStreamSet_e set,
+		const __m128i* const dataHash = nullptr);
 
 	//----------------------------------------------------------------------------
 	// inlines
 	//----------------------------------------------------------------------------
 	inline bool IsFlagSet(const int flag) const { return m_buildSettings->IsFlagSet(flag); };
+	inline const CBuildSettings* GetBuildSettings() const { return m_buildSettings; };
 
 	inline size_t GetAssetCount() const { return m_assets.size(); };
 	inline uint16_t GetNumPages() const { return m_pageBuilder.GetPageCount(); };
@@ -120,11 +123,14 @@ public:
 	size_t WriteStarpakPaths(BinaryIO& out, const PakStreamSet_e set);
 	void WritePagePointers(BinaryIO& out);
 
+	void WriteTablesAndPageDataMapped(char* const out);
+
 	void GenerateInternalDependencies();
 	void GenerateAssetDependents();
 	void GenerateAssetUses();
 
 	PakPageLump_s CreatePageLump(const size_t size, const int flags, const int alignment, void* const buf = nullptr);
+	PakPageLump_s ReservePageLump(const size_t size, const int flags, const int alignment);
 	PakAsset_t* GetAssetByGuid(const PakGuid_t guid, size_t* const idx = nullptr, const bool silent = false);
 
 	FORCEINLINE PakAsset_t& BeginAsset(const PakGuid_t assetGuid, const char* const assetPath)
@@ -168,7 +174,9 @@ public:
 		m_processingAsset = false;
 	};
 
-	void BuildFromMap(const js::Document& doc);
+	// If the map was loaded from a build manifest, its assets are added with
+	// their resolved handlers and guids instead of looking these up.
+	void BuildFromMap(const js::Document& doc, const CBuildManifest* const manifest = nullptr, const uint32_t mapIndex = 0);
 
 private:
 	const CBuildSettings* m_buildSettings;
@@ -218,6 +226,16 @@ inline size_t Pak_GetHeaderSize(const uint16_t version)
 	};
 }
 
+inline size_t Pak_GetAssetDescriptorSize(const uint16_t version)
+{
+	switch (version)
+	{
+	case 7: return 0x48;
+	case 8: return 0x50;
+	default: assert(0); return 0;
+	};
+}
+
 static inline bool Pak_IsVersionSupported(const int version)
 {
 	switch (version)
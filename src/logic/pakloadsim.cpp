@@ -0,0 +1,560 @@
+//=============================================================================//
+//
+// Offline pak load simulator
+//
+// ----------------------------------------------------------------------------
+// Replays the work the runtime does when loading a pak file, so the cost of a
+// pak can be estimated before it ships:
+//
+// - slabs are allocated from their headers, aligned to their full boundary.
+// - pages are placed into their slabs following the same padding rules as
+//   CPakPageBuilder::PadSlabSizeForPageAlignment().
+// - pages arrive at a configurable rate; once a page arrived, all pointers
+//   that reside in it are patched into real memory addresses.
+// - assets are processed in order once all their pages arrived and their
+//   internal dependency counter reached 1, at which point their GUID refs get
+//   resolved and their dependents get decremented.
+// - after all assets finished, the slabs flagged SF_TEMP are released.
+//
+// Only uncompressed pak files are supported, encoded paks must be decoded with
+// the decompress command first.
+//=============================================================================//
+#include "pch.h"
+#include "pakfile.h"
+#include "pakloadsim.h"
+
+//-----------------------------------------------------------------------------
+// Constructors/Destructors
+//-----------------------------------------------------------------------------
+CPakLoadSimulator::CPakLoadSimulator()
+	: m_nextPointer(0)
+	, m_pointerFixups(0)
+	, m_invalidPointers(0)
+	, m_internalUses(0)
+	, m_externalUses(0)
+	, m_invalidUses(0)
+{
+}
+CPakLoadSimulator::~CPakLoadSimulator()
+{
+	for (PakLoadSimSlab_s& slab : m_slabs)
+	{
+		if (slab.memory)
+			_aligned_free(slab.memory);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: reads the pak header, see CPakFileBuilder::WriteHeader()
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::ReadHeader(BinaryIO& io)
+{
+	io.Read(m_header.magic);
+	io.Read(m_header.fileVersion);
+
+	const uint16_t version = m_header.fileVersion;
+
+	io.Read(m_header.flags);
+	io.Read(m_header.fileTime);
+	io.Read(m_header.unk0);
+	io.Read(m_header.compressedSize);
+
+	if (version == 8)
+		io.Read(m_header.embeddedStarpakOffset);
+
+	io.Read(m_header.unk1);
+	io.Read(m_header.decompressedSize);
+
+	if (version == 8)
+		io.Read(m_header.embeddedStarpakSize);
+
+	io.Read(m_header.unk2);
+	io.Read(m_header.starpakPathsSize);
+
+	if (version == 8)
+		io.Read(m_header.optStarpakPathsSize);
+
+	io.Read(m_header.memSlabCount);
+	io.Read(m_header.memPageCount);
+	io.Read(m_header.patchIndex);
+
+	if (version == 8)
+		io.Read(m_header.alignment);
+
+	io.Read(m_header.pointerCount);
+	io.Read(m_header.assetCount);
+	io.Read(m_header.usesCount);
+	io.Read(m_header.dependentsCount);
+
+	if (version == 7)
+	{
+		io.Read(m_header.unk7count);
+		io.Read(m_header.unk8count);
+	}
+	else if (version == 8)
+		io.Read(m_header.unk3);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: reads the slab, page, pointer, asset, uses and dependents tables in
+// the order CPakFileBuilder::BuildFromMap() writes them
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::ReadTables(BinaryIO& io)
+{
+	const uint16_t version = m_header.fileVersion;
+
+	// Starpak paths are not used by the simulation; the sizes already include
+	// the alignment padding.
+	io.SeekGet(m_header.starpakPathsSize + (version == 8 ? m_header.optStarpakPathsSize : 0), std::ios::cur);
+
+	if (m_header.memSlabCount > PAK_MAX_SLAB_COUNT)
+	{
+		Error("Pak file \"%s\" has %hu slabs, but the runtime has a limit of %hu.\n",
+			m_pakPath.c_str(), m_header.memSlabCount, PAK_MAX_SLAB_COUNT);
+	}
+
+	m_slabs.resize(m_header.memSlabCount);
+
+	for (PakLoadSimSlab_s& slab : m_slabs)
+	{
+		io.Read(slab.header);
+
+		slab.memory = nullptr;
+		slab.allocSize = 0;
+		slab.nextPageOffset = 0;
+		slab.pageDataSize = 0;
+		slab.alignmentPadding = 0;
+	}
+
+	m_pages.resize(m_header.memPageCount);
+
+	for (PakLoadSimPage_s& page : m_pages)
+	{
+		io.Read(page.header);
+
+		if (page.header.slabIndex < 0 || page.header.slabIndex >= m_header.memSlabCount)
+		{
+			Error("Pak file \"%s\" has a page mapped to slab #%d, but only %hu slabs were listed.\n",
+				m_pakPath.c_str(), page.header.slabIndex, m_header.memSlabCount);
+		}
+
+		page.slabOffset = 0;
+		page.fileOffset = 0;
+	}
+
+	m_pointers.resize(m_header.pointerCount);
+
+	for (PagePtr_t& ptr : m_pointers)
+		io.Read(ptr);
+
+	m_assets.resize(m_header.assetCount);
+	m_guidToAsset.reserve(m_header.assetCount);
+
+	for (uint32_t i = 0; i < m_header.assetCount; i++)
+	{
+		PakLoadSimAsset_s& asset = m_assets[i];
+
+		uint8_t unk0[0x8];
+		int64_t packedStreamOffset;
+
+		io.Read(asset.guid);
+		io.Read(unk0);
+		io.Read(asset.headPtr.index);
+		io.Read(asset.headPtr.offset);
+		io.Read(asset.cpuPtr.index);
+		io.Read(asset.cpuPtr.offset);
+		io.Read(packedStreamOffset);
+
+		if (version == 8)
+			io.Read(packedStreamOffset); // Optional stream offset.
+
+		io.Read(asset.pageEnd);
+		io.Read(asset.internalDependencyCount);
+		io.Read(asset.dependentsIndex);
+		io.Read(asset.usesIndex);
+		io.Read(asset.dependentsCount);
+		io.Read(asset.usesCount);
+		io.Read(asset.headDataSize);
+		io.Read(asset.version);
+		io.Read(asset.type);
+
+		if (asset.pageEnd > m_header.memPageCount)
+		{
+			Warning("Asset #%u (%llX) has a page end of %hu, but the pak only has %hu pages.\n",
+				i, asset.guid, asset.pageEnd, m_header.memPageCount);
+		}
+
+		m_guidToAsset.emplace(asset.guid, i);
+	}
+
+	m_uses.resize(m_header.usesCount);
+
+	for (PagePtr_t& ptr : m_uses)
+		io.Read(ptr);
+
+	m_dependents.resize(m_header.dependentsCount);
+
+	for (uint32_t& dependent : m_dependents)
+		io.Read(dependent);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: allocates all slabs to their full aligned size and computes the
+// offsets of each page into its slab
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::AllocateSlabs()
+{
+	// Same tracking as CPakPageBuilder::PadSlabSizeForPageAlignment().
+	for (PakLoadSimPage_s& page : m_pages)
+	{
+		PakLoadSimSlab_s& slab = m_slabs[page.header.slabIndex];
+
+		const size_t pageAlign = max(page.header.alignment, 1);
+		const size_t pageOffsetAligned = IALIGN(slab.nextPageOffset, pageAlign);
+
+		slab.alignmentPadding += pageOffsetAligned - slab.nextPageOffset;
+		page.slabOffset = pageOffsetAligned;
+
+		slab.nextPageOffset = pageOffsetAligned + page.header.dataSize;
+		slab.pageDataSize += page.header.dataSize;
+	}
+
+	for (size_t i = 0; i < m_slabs.size(); i++)
+	{
+		PakLoadSimSlab_s& slab = m_slabs[i];
+
+		const size_t slabAlign = max(slab.header.alignment, 1);
+		slab.allocSize = IALIGN(slab.header.dataSize, slabAlign);
+
+		if (slab.nextPageOffset > slab.allocSize)
+		{
+			Error("Slab #%zu in pak file \"%s\" requires %zu bytes for its pages, but only %zu were allocated.\n",
+				i, m_pakPath.c_str(), slab.nextPageOffset, slab.allocSize);
+		}
+
+		if (!slab.allocSize)
+			continue;
+
+		slab.memory = reinterpret_cast<char*>(_aligned_malloc(slab.allocSize, slabAlign));
+
+		if (!slab.memory)
+			Error("Failed to allocate %zu bytes for slab #%zu.\n", slab.allocSize, i);
+
+		memset(slab.memory, 0, slab.allocSize);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: computes the file offsets of each page; pages are stored directly
+// after each other without their alignment padding
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::PlacePages(BinaryIO& io)
+{
+	size_t fileOffset = static_cast<size_t>(io.TellGet());
+
+	for (PakLoadSimPage_s& page : m_pages)
+	{
+		page.fileOffset = fileOffset;
+		fileOffset += page.header.dataSize;
+	}
+
+	const size_t fileSize = static_cast<size_t>(io.GetSize());
+
+	if (fileOffset > fileSize)
+		Error("Pak file \"%s\" appears truncated! ( %zu < %zu ).\n", m_pakPath.c_str(), fileSize, fileOffset);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: converts a page pointer to the address in the simulated slabs,
+//          returns null if the pointer is out of bounds
+//-----------------------------------------------------------------------------
+char* CPakLoadSimulator::ResolvePagePtr(const PagePtr_t& ptr, const size_t accessSize) const
+{
+	if (ptr.index < 0 || ptr.index >= static_cast<int>(m_pages.size()))
+		return nullptr;
+
+	const PakLoadSimPage_s& page = m_pages[ptr.index];
+
+	if (ptr.offset < 0 || static_cast<size_t>(ptr.offset) + accessSize > static_cast<size_t>(page.header.dataSize))
+		return nullptr;
+
+	const PakLoadSimSlab_s& slab = m_slabs[page.header.slabIndex];
+	return &slab.memory[page.slabOffset + ptr.offset];
+}
+
+const PakLoadSimAsset_s* CPakLoadSimulator::FindAssetByGuid(const PakGuid_t guid) const
+{
+	const auto it = m_guidToAsset.find(guid);
+
+	if (it == m_guidToAsset.end())
+		return nullptr;
+
+	return &m_assets[it->second];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: marks a page as arrived and patches all the pointers residing in it
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::ArrivePage(const uint16_t pageIndex)
+{
+	// Pointers are sorted by page index and then offset, see
+	// CPakFileBuilder::WritePagePointers(), so we only have to walk forward.
+	while (m_nextPointer < m_pointers.size())
+	{
+		const PagePtr_t& location = m_pointers[m_nextPointer];
+
+		if (location.index > pageIndex)
+			break;
+
+		m_nextPointer++;
+
+		char* const pointerAddr = ResolvePagePtr(location, sizeof(PagePtr_t));
+
+		if (!pointerAddr)
+		{
+			Warning("Pointer #%zu is located out of bounds ( %d:%d ).\n",
+				m_nextPointer-1, location.index, location.offset);
+
+			m_invalidPointers++;
+			continue;
+		}
+
+		PagePtr_t target;
+		memcpy(&target, pointerAddr, sizeof(PagePtr_t));
+
+		char* const targetAddr = ResolvePagePtr(target, 0);
+
+		if (!targetAddr)
+		{
+			Warning("Pointer #%zu at ( %d:%d ) points out of bounds ( %d:%d ).\n",
+				m_nextPointer-1, location.index, location.offset, target.index, target.offset);
+
+			m_invalidPointers++;
+			continue;
+		}
+
+		memcpy(pointerAddr, &targetAddr, sizeof(char*));
+		m_pointerFixups++;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: runs the internal dependency countdown in asset order, returns true
+//          if any asset finished
+//-----------------------------------------------------------------------------
+bool CPakLoadSimulator::ProcessReadyAssets(const uint32_t tick, const uint32_t pagesLoaded)
+{
+	bool anyFinished = false;
+
+	for (uint32_t i = 0; i < m_assets.size(); i++)
+	{
+		if (m_assetReady[i])
+			continue;
+
+		const PakLoadSimAsset_s& asset = m_assets[i];
+
+		if (asset.pageEnd > pagesLoaded)
+			continue;
+
+		// The asset depends on itself, so the counter bottoms out at 1.
+		if (m_dependencyCounters[i] > 1)
+			continue;
+
+		// Resolve the GUID refs into the header pointers of the used assets.
+		for (uint32_t j = 0; j < asset.usesCount; j++)
+		{
+			const size_t useIndex = static_cast<size_t>(asset.usesIndex) + j;
+
+			if (useIndex >= m_uses.size())
+			{
+				m_invalidUses++;
+				continue;
+			}
+
+			char* const refAddr = ResolvePagePtr(m_uses[useIndex], sizeof(PakGuid_t));
+
+			if (!refAddr)
+			{
+				m_invalidUses++;
+				continue;
+			}
+
+			PakGuid_t guid;
+			memcpy(&guid, refAddr, sizeof(PakGuid_t));
+
+			const PakLoadSimAsset_s* const dependency = FindAssetByGuid(guid);
+
+			if (!dependency)
+			{
+				// Lives in another pak, the runtime resolves these from the
+				// global asset table instead.
+				m_externalUses++;
+				continue;
+			}
+
+			char* const headerAddr = ResolvePagePtr(dependency->headPtr, 0);
+			memcpy(refAddr, &headerAddr, sizeof(char*));
+
+			m_internalUses++;
+		}
+
+		m_assetReady[i] = true;
+		m_readyOrder.push_back({ i, tick, pagesLoaded });
+
+		for (uint32_t j = 0; j < asset.dependentsCount; j++)
+		{
+			const size_t dependentIndex = static_cast<size_t>(asset.dependentsIndex) + j;
+
+			if (dependentIndex >= m_dependents.size())
+				continue;
+
+			const uint32_t dependent = m_dependents[dependentIndex];
+
+			if (dependent < m_dependencyCounters.size())
+				m_dependencyCounters[dependent]--;
+		}
+
+		anyFinished = true;
+	}
+
+	return anyFinished;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: loads the pak file and prepares the runtime state
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::Load(const char* const pakPath)
+{
+	m_pakPath = pakPath;
+	BinaryIO io;
+
+	if (!io.Open(pakPath, BinaryIO::Mode_e::Read))
+		Error("Failed to open pak file \"%s\" for load simulation.\n", pakPath);
+
+	if (io.GetSize() < 6) // size of magic( 4 ) + version( 2 ).
+		Error("Short read on pak file \"%s\"; header criteria unavailable!\n", pakPath);
+
+	ReadHeader(io);
+
+	if (m_header.magic != RPAK_MAGIC)
+		Error("Pak file \"%s\" has invalid magic! ( %x != %x ).\n", pakPath, m_header.magic, RPAK_MAGIC);
+
+	if (!Pak_IsVersionSupported(m_header.fileVersion))
+		Error("Pak file \"%s\" has version %hu which is unsupported!\n", pakPath, m_header.fileVersion);
+
+	if (m_header.flags & (PAK_HEADER_FLAGS_RTECH_ENCODED | PAK_HEADER_FLAGS_OODLE_ENCODED | PAK_HEADER_FLAGS_ZSTD_ENCODED))
+		Error("Pak file \"%s\" is encoded using %s; decode it before simulating!\n", pakPath, Pak_EncodeAlgorithmToString(m_header.flags));
+
+	ReadTables(io);
+	AllocateSlabs();
+	PlacePages(io);
+
+	// Copy the page data into the slabs, this is what the runtime does when
+	// the page arrives, but the data is only patched upon arrival.
+	for (const PakLoadSimPage_s& page : m_pages)
+	{
+		if (!page.header.dataSize)
+			continue;
+
+		const PakLoadSimSlab_s& slab = m_slabs[page.header.slabIndex];
+
+		io.SeekGet(page.fileOffset);
+		io.Read(&slab.memory[page.slabOffset], page.header.dataSize);
+	}
+
+	io.Close();
+
+	m_assetReady.assign(m_assets.size(), false);
+	m_dependencyCounters.resize(m_assets.size());
+
+	for (size_t i = 0; i < m_assets.size(); i++)
+		m_dependencyCounters[i] = m_assets[i].internalDependencyCount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: simulates the load with given page arrival rate
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::Run(const int pagesPerTick)
+{
+	const uint32_t pageRate = static_cast<uint32_t>(max(pagesPerTick, 1));
+	const uint32_t numPages = static_cast<uint32_t>(m_pages.size());
+
+	uint32_t pagesLoaded = 0;
+	uint32_t tick = 0;
+
+	for (;; tick++)
+	{
+		const uint32_t arriving = min(pageRate, numPages - pagesLoaded);
+
+		for (uint32_t i = 0; i < arriving; i++)
+			ArrivePage(static_cast<uint16_t>(pagesLoaded++));
+
+		// Finishing an asset can unblock its dependents within the same tick.
+		while (ProcessReadyAssets(tick, pagesLoaded))
+			;
+
+		if (pagesLoaded == numPages)
+			break;
+	}
+
+	ReportResults(pageRate, tick + 1);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: prints the results of the simulation
+//-----------------------------------------------------------------------------
+void CPakLoadSimulator::ReportResults(const int pagesPerTick, const uint32_t tickCount) const
+{
+	Log("*** load simulation of pak file \"%s\" ( %d pages per tick, %u ticks ).\n",
+		m_pakPath.c_str(), pagesPerTick, tickCount);
+
+	// All slabs are allocated up front when the pak starts loading, so the
+	// allocated memory is the most the pak ever occupies.
+	size_t allocatedMemory = 0;
+	size_t tempMemory = 0;
+
+	for (size_t i = 0; i < m_slabs.size(); i++)
+	{
+		const PakLoadSimSlab_s& slab = m_slabs[i];
+
+		Log("slab #%zu: flags=0x%x align=%d allocated=%zu bytes ( %zu page data, %zu alignment padding ).\n",
+			i, slab.header.flags, slab.header.alignment, slab.allocSize, slab.pageDataSize, slab.alignmentPadding);
+
+		allocatedMemory += slab.allocSize;
+
+		if (slab.header.flags & SF_TEMP)
+			tempMemory += slab.allocSize;
+	}
+
+	Log("allocated memory: %zu bytes; freed after SF_TEMP release: %zu bytes; resident: %zu bytes.\n",
+		allocatedMemory, tempMemory, allocatedMemory - tempMemory);
+
+	Log("pointer fixups: %zu ( %zu invalid ).\n", m_pointerFixups, m_invalidPointers);
+	Log("guid refs: %zu internal, %zu external ( %zu invalid ).\n", m_internalUses, m_externalUses, m_invalidUses);
+
+	Log("asset ready order:\n");
+
+	for (const PakLoadSimReadyAsset_s& ready : m_readyOrder)
+	{
+		const PakLoadSimAsset_s& asset = m_assets[ready.assetIndex];
+
+		Utils::FourCCString_t type;
+		Utils::FourCCToString(type, asset.type);
+
+		Log("tick %u: asset #%u ( %.4s %llX ) after %u pages.\n",
+			ready.tick, ready.assetIndex, type, asset.guid, ready.pagesLoaded);
+	}
+
+	const size_t stalled = m_assets.size() - m_readyOrder.size();
+
+	if (stalled > 0)
+	{
+		Warning("%zu assets never became ready; their dependency counters did not reach 1.\n", stalled);
+
+		for (size_t i = 0; i < m_assets.size(); i++)
+		{
+			if (!m_assetReady[i])
+				Warning("asset #%zu ( %llX ) stalled with dependency counter %hd.\n", i, m_assets[i].guid, m_dependencyCounters[i]);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "public/rpak.h"
+#include "pakpage.h"
+
+// Default number of pages that arrive from the disk per simulated tick.
+#define PAK_LOADSIM_DEFAULT_PAGES_PER_TICK 1
+
+// Asset descriptor as stored in the pak file, the layout differs between
+// versions hence this is read field by field, see WriteAssetDescriptors.
+struct PakLoadSimAsset_s
+{
+	PakGuid_t guid;
+
+	PagePtr_t headPtr;
+	PagePtr_t cpuPtr;
+
+	uint16_t pageEnd;
+	short internalDependencyCount;
+
+	uint32_t dependentsIndex;
+	uint32_t usesIndex;
+
+	uint32_t dependentsCount;
+	uint32_t usesCount;
+
+	uint32_t headDataSize;
+	uint32_t version;
+	uint32_t type;
+};
+
+// A slab as allocated by the runtime, all pages that are mapped to this slab
+// are placed in here at their aligned offsets.
+struct PakLoadSimSlab_s
+{
+	PakSlabHdr_s header;
+
+	char* memory;
+	size_t allocSize;
+
+	size_t nextPageOffset;
+	size_t pageDataSize;
+	size_t alignmentPadding;
+};
+
+struct PakLoadSimPage_s
+{
+	PakPageHdr_s header;
+
+	size_t slabOffset; // Offset of this page into its slab.
+	size_t fileOffset; // Offset of this page's data in the pak file.
+};
+
+struct PakLoadSimReadyAsset_s
+{
+	uint32_t assetIndex;
+	uint32_t tick;
+	uint32_t pagesLoaded;
+};
+
+class CPakLoadSimulator
+{
+public:
+	CPakLoadSimulator();
+	~CPakLoadSimulator();
+
+	void Load(const char* const pakPath);
+	void Run(const int pagesPerTick);
+
+private:
+	void ReadHeader(BinaryIO& io);
+	void ReadTables(BinaryIO& io);
+
+	void AllocateSlabs();
+	void PlacePages(BinaryIO& io);
+
+	void ArrivePage(const uint16_t pageIndex);
+	bool ProcessReadyAssets(const uint32_t tick, const uint32_t pagesLoaded);
+
+	char* ResolvePagePtr(const PagePtr_t& ptr, const size_t accessSize) const;
+	const PakLoadSimAsset_s* FindAssetByGuid(const PakGuid_t guid) const;
+
+	void ReportResults(const int pagesPerTick, const uint32_t tickCount) const;
+
+private:
+	std::string m_pakPath;
+	PakHdr_t m_header;
+
+	std::vector<PakLoadSimSlab_s> m_slabs;
+	std::vector<PakLoadSimPage_s> m_pages;
+
+	std::vector<PagePtr_t> m_pointers;
+	std::vector<PakLoadSimAsset_s> m_assets;
+	std::vector<PagePtr_t> m_uses;
+	std::vector<uint32_t> m_dependents;
+
+	std::unordered_map<PakGuid_t, uint32_t> m_guidToAsset;
+
+	// Runtime state.
+	std::vector<short> m_dependencyCounters;
+	std::vector<bool> m_assetReady;
+	std::vector<PakLoadSimReadyAsset_s> m_readyOrder;
+
+	size_t m_nextPointer; // Pointers are sorted by page, so we patch them as they arrive.
+
+	size_t m_pointerFixups;
+	size_t m_invalidPointers;
+
+	size_t m_internalUses;
+	size_t m_externalUses;
+	size_t m_invalidUses;
+};
@@ -36,12 +36,16 @@
 //=============================================================================//
 #include "pch.h"
 #include "pakpage.h"
+#include "utils/parallel.h"
 
 //-----------------------------------------------------------------------------
 // Constructors/Destructors
 //-----------------------------------------------------------------------------
 CPakPageBuilder::CPakPageBuilder()
 	: m_slabCount(0)
+	, m_allocatedLumpBytes(0)
+	, m_reservedLumpBytes(0)
+	, m_adoptedLumpBytes(0)
 {
 }
 CPakPageBuilder::~CPakPageBuilder()
@@ -195,10 +199,10 @@ PakPage_s& CPakPageBuilder::FindOrCreatePage(const int flags, const int align, c
 }
 
 //-----------------------------------------------------------------------------
-// Create a page lump, which is a piece of data that will be placed inside the
+// Insert a page lump, which is a piece of data that will be placed inside the
 // page with user requested alignment.
 //-----------------------------------------------------------------------------
-const PakPageLump_s CPakPageBuilder::CreatePageLump(const int size, const int flags, const int align, void* const buf)
+const PakPageLump_s CPakPageBuilder::InsertPageLump(const int size, const int flags, const int align, char* const buf)
 {
 	// Alignment is only observed to be <= 64
 	assert(align != 0 && align < UINT8_MAX);
@@ -230,19 +234,6 @@ const PakPageLump_s CPakPageBuilder::CreatePageLump(const int size, const int fl
 
 	page.header.dataSize += alignedPageLumpSize;
 
-	char* targetBuf;
-
-	// Note: we don't have to allocate the buffer with the aligned size since
-	// these buffers are individual and are padded out with null-lumps when
-	// writing out the pages, so we could save on memory here.
-	if (!buf)
-	{
-		targetBuf = new char[size];
-		memset(targetBuf, 0, size);
-	}
-	else
-		targetBuf = reinterpret_cast<char*>(buf);
-
 	const int lumpPadAmount = alignedPageLumpSize - size;
 
 	// Reserve for 2 because we need to add a padding lump afterwards to pad the
@@ -252,7 +243,7 @@ const PakPageLump_s CPakPageBuilder::CreatePageLump(const int size, const int fl
 
 	PakPageLump_s& lump = page.lumps.emplace_back();
 
-	lump.data = targetBuf;
+	lump.data = buf;
 	lump.size = size;
 	lump.alignment = page.header.alignment;
 
@@ -277,6 +268,45 @@ const PakPageLump_s CPakPageBuilder::CreatePageLump(const int size, const int fl
 	return lump;
 }
 
+//-----------------------------------------------------------------------------
+// Create a page lump with a zero initialized buffer, or adopt the provided
+// buffer which must have been allocated with new[], the lump will own it.
+//-----------------------------------------------------------------------------
+const PakPageLump_s CPakPageBuilder::CreatePageLump(const int size, const int flags, const int align, void* const buf)
+{
+	char* targetBuf;
+
+	// Note: we don't have to allocate the buffer with the aligned size since
+	// these buffers are individual and are padded out with null-lumps when
+	// writing out the pages, so we could save on memory here.
+	if (!buf)
+	{
+		targetBuf = new char[size];
+		memset(targetBuf, 0, size);
+
+		m_allocatedLumpBytes += size;
+	}
+	else
+	{
+		targetBuf = reinterpret_cast<char*>(buf);
+		m_adoptedLumpBytes += size;
+	}
+
+	return InsertPageLump(size, flags, align, targetBuf);
+}
+
+//-----------------------------------------------------------------------------
+// Create a page lump with an uninitialized buffer, the caller must fill the
+// entire buffer, i.e. by reading file data directly into it.
+//-----------------------------------------------------------------------------
+const PakPageLump_s CPakPageBuilder::ReservePageLump(const int size, const int flags, const int align)
+{
+	char* const targetBuf = new char[size];
+	m_reservedLumpBytes += size;
+
+	return InsertPageLump(size, flags, align, targetBuf);
+}
+
 //-----------------------------------------------------------------------------
 // There are 2 important things we have to take into account here:
 // 
@@ -321,16 +351,33 @@ void CPakPageBuilder::PadSlabSizeForPageAlignment()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Returns the total size of all page data as it is written out to the file
+//-----------------------------------------------------------------------------
+size_t CPakPageBuilder::GetTotalPageDataSize() const
+{
+	size_t totalSize = 0;
+
+	for (const PakPage_s& page : m_pages)
+		totalSize += page.header.dataSize;
+
+	return totalSize;
+}
+
 //-----------------------------------------------------------------------------
 // Write out the slab headers in the order they were created
 //-----------------------------------------------------------------------------
 void CPakPageBuilder::WriteSlabHeaders(BinaryIO& out) const
+{
+	PakSlabHdr_s headers[PAK_MAX_SLAB_COUNT];
+	WriteSlabHeaders(reinterpret_cast<char*>(headers));
+
+	out.Write(headers, m_slabCount * sizeof(PakSlabHdr_s));
+}
+void CPakPageBuilder::WriteSlabHeaders(char* const out) const
 {
 	for (uint16_t i = 0; i < m_slabCount; i++)
-	{
-		const PakSlab_s& slab = m_slabs[i];
-		out.Write(slab.header);
-	}
+		memcpy(&out[i * sizeof(PakSlabHdr_s)], &m_slabs[i].header, sizeof(PakSlabHdr_s));
 }
 
 //-----------------------------------------------------------------------------
@@ -338,31 +385,71 @@ void CPakPageBuilder::WriteSlabHeaders(BinaryIO& out) const
 //-----------------------------------------------------------------------------
 void CPakPageBuilder::WritePageHeaders(BinaryIO& out) const
 {
+	std::vector<PakPageHdr_s> headers(m_pages.size());
+	WritePageHeaders(reinterpret_cast<char*>(headers.data()));
+
+	out.Write(headers.data(), headers.size() * sizeof(PakPageHdr_s));
+}
+void CPakPageBuilder::WritePageHeaders(char* const out) const
+{
+	for (size_t i = 0; i < m_pages.size(); i++)
+		memcpy(&out[i * sizeof(PakPageHdr_s)], &m_pages[i].header, sizeof(PakPageHdr_s));
+}
+
+//-----------------------------------------------------------------------------
+// Write out the paged data
+//-----------------------------------------------------------------------------
+void CPakPageBuilder::WritePageData(BinaryIO& out) const
+{
+	std::vector<BinaryIOVec_s> vecs;
+
 	for (const PakPage_s& page : m_pages)
 	{
-		out.Write(page.header);
+		for (const PakPageLump_s& lump : page.lumps)
+		{
+			// If the lump has no data, it is padding to either:
+			// - pad out the previous asset to align our current asset.
+			// - pad out the current asset to its full aligned size.
+			// - pad out the page to its full aligned size.
+			// These are written out as zeros by the gathered write.
+			vecs.push_back({ lump.data, static_cast<size_t>(lump.size) });
+		}
 	}
+
+	out.WriteGathered(vecs.data(), vecs.size());
 }
 
 //-----------------------------------------------------------------------------
-// Write out the paged data
+// Write out the paged data into its final location in a mapped file, the
+// lumps are copied across multiple threads. The output must already be zero
+// filled as padding lumps are skipped.
 //-----------------------------------------------------------------------------
-void CPakPageBuilder::WritePageData(BinaryIO& out) const
+void CPakPageBuilder::WritePageData(char* const out) const
 {
+	struct LumpCopy_s
+	{
+		const char* data;
+		size_t offset;
+		size_t size;
+	};
+
+	std::vector<LumpCopy_s> copies;
+	size_t offset = 0;
+
 	for (const PakPage_s& page : m_pages)
 	{
 		for (const PakPageLump_s& lump : page.lumps)
 		{
 			if (lump.data)
-				out.Write(lump.data, lump.size);
-			else
-			{
-				// Lump is padding to either:
-				// - pad out the previous asset to align our current asset.
-				// - pad out the current asset to its full aligned size.
-				// - pad out the page to its full aligned size.
-				out.Pad(lump.size);
-			}
+				copies.push_back({ lump.data, offset, static_cast<size_t>(lump.size) });
+
+			offset += lump.size;
 		}
 	}
+
+	Parallel_For(copies.size(), [&](const size_t i)
+	{
+		const LumpCopy_s& copy = copies[i];
+		memcpy(&out[copy.offset], copy.data, copy.size);
+	});
 }
@@ -69,6 +69,13 @@ public:
 	inline uint16_t GetPageCount() const { return static_cast<uint16_t>(m_pages.size()); }
 
 	const PakPageLump_s CreatePageLump(const int size, const int flags, const int align, void* const buf = nullptr);
+	const PakPageLump_s ReservePageLump(const int size, const int flags, const int align);
+
+	inline size_t GetAllocatedLumpBytes() const { return m_allocatedLumpBytes; }
+	inline size_t GetReservedLumpBytes() const { return m_reservedLumpBytes; }
+	inline size_t GetAdoptedLumpBytes() const { return m_adoptedLumpBytes; }
+
+	size_t GetTotalPageDataSize() const;
 
 	void PadSlabSizeForPageAlignment();
 
@@ -76,13 +83,25 @@ public:
 	void WritePageHeaders(BinaryIO& out) const;
 	void WritePageData(BinaryIO& out) const;
 
+	// Variants that write into a memory buffer.
+	void WriteSlabHeaders(char* const out) const;
+	void WritePageHeaders(char* const out) const;
+	void WritePageData(char* const out) const;
+
 private:
 	PakSlab_s& FindOrCreateSlab(const int flags, const int align);
 	PakPage_s& FindOrCreatePage(const int flags, const int align, const int size);
 
+	const PakPageLump_s InsertPageLump(const int size, const int flags, const int align, char* const buf);
+
 private:
 	std::array<PakSlab_s, PAK_MAX_SLAB_COUNT> m_slabs;
 	uint16_t m_slabCount;
 
 	std::vector<PakPage_s> m_pages;
+
+	// Lump storage statistics, reserved and adopted buffers are not copied.
+	size_t m_allocatedLumpBytes;
+	size_t m_reservedLumpBytes;
+	size_t m_adoptedLumpBytes;
 };
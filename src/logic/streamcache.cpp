@@ -297,11 +297,17 @@ StreamCacheFileHeader_s CStreamCache::ConstructHeader() const
 	return fileHeader;
 }
 
-StreamCacheFindParams_s CStreamCache::CreateParams(const uint8_t* const data, const int64_t size, const char* const streamFilePath)
+// Thread safe, data may be hashed ahead of the serial build.
+__m128i CStreamCache::HashData(const uint8_t* const data, const int64_t size)
 {
 	__m128i hash;
 	MurmurHash3_x64_128(data, static_cast<size_t>(size), MURMUR_SEED, &hash);
 
+	return hash;
+}
+
+StreamCacheFindParams_s CStreamCache::CreateParams(const __m128i& hash, const int64_t size, const char* const streamFilePath)
+{
 	StreamCacheFindParams_s ret;
 
 	ret.hash = hash;
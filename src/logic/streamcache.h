@@ -55,7 +55,8 @@ public:
 	int64_t AddStarPakPathToMapList(const std::string& path, const bool optional);
 	StreamCacheFileHeader_s ConstructHeader() const;
 
-	static StreamCacheFindParams_s CreateParams(const uint8_t* const data, const int64_t size, const char* const streamFilePath);
+	static __m128i HashData(const uint8_t* const data, const int64_t size);
+	static StreamCacheFindParams_s CreateParams(const __m128i& hash, const int64_t size, const char* const streamFilePath);
 
 	bool Find(const StreamCacheFindParams_s& params, StreamCacheFindResult_s& result, const bool optional);
 	void Add(const StreamCacheFindParams_s& params, const int64_t offset, const bool optional);
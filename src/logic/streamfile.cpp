@@ -175,15 +175,17 @@ void CStreamFileBuilder::FinishStreamFileStream(const PakStreamSet_e set)
 }
 
 //-----------------------------------------------------------------------------
-// purpose: adds new starpak data entry
+// purpose: adds new starpak data entry, dataHash is optional
 //-----------------------------------------------------------------------------
 bool CStreamFileBuilder::AddStreamingDataEntry(const int64_t size, const uint8_t* const data,
-	const PakStreamSet_e set, StreamAddEntryResults_s& outResults)
+	const PakStreamSet_e set, StreamAddEntryResults_s& outResults, const __m128i* const dataHash)
 {
 	const bool isMandatory = set == STREAMING_SET_MANDATORY;
 	const std::string& newStarPak = isMandatory ? m_mandatoryStreamFileName : m_optionalStreamFileName;
 
-	StreamCacheFindParams_s params = m_streamCache.CreateParams(data, size, newStarPak.c_str());
+	// The hash may have been computed ahead of time, see CStreamCache::HashData.
+	const __m128i hash = dataHash ? *dataHash : CStreamCache::HashData(data, size);
+	StreamCacheFindParams_s params = CStreamCache::CreateParams(hash, size, newStarPak.c_str());
 	StreamCacheFindResult_s result;
 
 	if (m_streamCache.Find(params, result, !isMandatory))
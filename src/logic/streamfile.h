@@ -22,7 +22,8 @@ public:
 	void CreateStreamFileStream(const std::string& streamFilePath, const PakStreamSet_e set);
 	void FinishStreamFileStream(const PakStreamSet_e set);
 
-	bool AddStreamingDataEntry(const int64_t size, const uint8_t* const data, const PakStreamSet_e set, StreamAddEntryResults_s& results);
+	bool AddStreamingDataEntry(const int64_t size, const uint8_t* const data, const PakStreamSet_e set, StreamAddEntryResults_s& results,
+		const __m128i* const dataHash = nullptr);
 
 	inline size_t GetMandatoryStreamingAssetCount() const { return m_mandatoryStreamingDataBlocks.size(); };
 	inline size_t GetOptionalStreamingAssetCount() const { return m_optionalStreamingDataBlocks.size(); };
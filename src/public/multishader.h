@@ -160,6 +160,18 @@ public:
 			o.buffer = nullptr;
 		}
 
+		// Transfers the ownership of the buffer to the caller, returns null if
+		// the buffer isn't owned by this entry. The buffer remains accessible
+		// through this entry for as long as the new owner keeps it alive.
+		char* DetachBuffer()
+		{
+			if (!buffer || !deleteBuffer)
+				return nullptr;
+
+			deleteBuffer = false;
+			return const_cast<char*>(buffer);
+		}
+
 		const char* buffer;
 		unsigned int size;
 		unsigned short refIndex; // if this shader entry is a reference. do not set "buffer" if this is used
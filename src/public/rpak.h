@@ -331,7 +331,8 @@ static_assert(sizeof(PatchAssetHeader_t) == 24);
 // internal data structure for storing patch_master entries before being written
 struct PtchEntry
 {
-	std::string pakFileName;
+	const char* pakFileName = nullptr; // Points into the map document, which outlives the entry.
+	size_t pakFileNameLen = 0;
 	uint8_t highestPatchNum = 0;
 	uint32_t pakFileNameOffset = 0;
 };
@@ -57,8 +57,10 @@ static_assert(sizeof(RuiPackageMapping_v1_t) == 8);
 struct RuiPackage {
 	
 
+	// Only the header and the tables needed to build the runtime structures
+	// are parsed here, the bulk sections are read straight into the page lumps
+	// with ReadSection() to avoid copying them through temporary buffers.
 	RuiPackage(const fs::path& inputPath) {
-		FILE* f = NULL;
 		errno_t errorCode = fopen_s(&f, inputPath.string().c_str(), "rb");
 		if (errorCode == 0) {
 			fread(&hdr,sizeof(hdr),1,f);
@@ -67,52 +69,33 @@ struct RuiPackage {
 			if(hdr.packageVersion != RUI_PACKAGE_VERSION)
 				Error("Attempted to load an unsupported RUIP file (expected version %u, got %u).\n", RUI_PACKAGE_VERSION, hdr.packageVersion);
 
-			fseek(f,(long)hdr.nameOffset,0);
-			name.resize(hdr.nameSize);
-			fread(name.data(), 1, hdr.nameSize, f);
-
-			fseek(f,(long)hdr.defaultValuesOffset,0);
-			defaultData.resize(hdr.defaultValuesSize);
-			fread(defaultData.data(),1,hdr.defaultValuesSize,f);
-
-			fseek(f,(long)hdr.defaultStringDataOffset,0);
-			defaultStrings.resize(hdr.defaultStringsDataSize);
-			fread(defaultStrings.data(),1,hdr.defaultStringsDataSize,f);
-
 			fseek(f,(long)hdr.rpakPointersInDefaultDataOffset,0);
 			defaultStringOffsets.resize(hdr.rpakPointersInDefaltDataCount);
 			fread(defaultStringOffsets.data(),sizeof(uint16_t),hdr.rpakPointersInDefaltDataCount,f);
 
-			fseek(f,(long)hdr.styleDescriptorOffset,0);
-			styleDescriptors.resize(hdr.styleDescriptorCount*sizeof(StyleDescriptor_v30_s));
-			fread(styleDescriptors.data(),sizeof(StyleDescriptor_v30_s),hdr.styleDescriptorCount,f);
+			ParseKeyframingMappings();
+		}
+		else {
+			Error("Could not open ruip file %s with error %x",inputPath.string().c_str(),errorCode);
+		}
+	}
 
-			fseek(f,(long)hdr.renderJobOffset,0);
-			renderJobs.resize(hdr.renderJobSize);
-			fread(renderJobs.data(),1,hdr.renderJobSize,f);
+	~RuiPackage() {
+		if (f)
+			fclose(f);
+	}
 
-			fseek(f,(long)hdr.transformDataOffset,0);
-			transformData.resize(hdr.transformDataSize);
-			fread(transformData.data(),1,hdr.transformDataSize,f);
+	RuiPackage(const RuiPackage&) = delete;
+	RuiPackage& operator=(const RuiPackage&) = delete;
 
-			fseek(f,(long)hdr.argumentsOffset,0);
-			arguments.resize(hdr.argCount);
-			fread(arguments.data(),sizeof(Argument_s),hdr.argCount,f);
+	void ReadSection(void* const dest, const uint64_t offset, const size_t size) {
+		if (!size)
+			return;
 
-			fseek(f,(long)hdr.argClusterOffset,0);
-			argCluster.resize(hdr.argClusterCount);
-			fread(argCluster.data(),sizeof(ArgCluster_s),hdr.argClusterCount,f);
+		fseek(f,(long)offset,0);
 
-			fseek(f, (long)hdr.keyframingOffset, 0);
-			std::vector<char> keyframingData;
-			keyframingData.resize(hdr.keyframingSize);
-			fread(keyframingData.data(), 1, hdr.keyframingSize, f);
-			ParseKeyframingData(keyframingData);
-			fclose(f);
-		}
-		else {
-			Error("Could not open ruip file %s with error %x",inputPath.string().c_str(),errorCode);
-		}
+		if (fread(dest,1,size,f) != size)
+			Error("Short read on RUIP file section at offset %llu (%zu bytes).\n", offset, size);
 	}
 
 	RuiHeader_v30_s CreateRuiHeader_v30() {
@@ -135,24 +118,17 @@ struct RuiPackage {
 		return ruiHdr;
 	}
 
-	void ParseKeyframingData(const std::vector<char>& keyframingData) {
-		const size_t mappingDataSize = static_cast<size_t>(hdr.keyframingCount) * sizeof(RuiPackageMapping_v1_t);
+	void ParseKeyframingMappings() {
+		const size_t mappingDataSize = KeyframingMappingsSize();
 
 		if (hdr.keyframingSize < mappingDataSize)
 			Error("RUI package keyframing data is too small for %u mappings (%u bytes, expected at least %zu).\n",
 				hdr.keyframingCount, hdr.keyframingSize, mappingDataSize);
 
 		keyframingMappings.resize(hdr.keyframingCount);
-
-		if (!keyframingMappings.empty())
-			memcpy(keyframingMappings.data(), keyframingData.data(), mappingDataSize);
-
-		const size_t valuesSize = static_cast<size_t>(hdr.keyframingSize) - mappingDataSize;
-		keyframingValues.resize(valuesSize);
 		keyframingValueOffsets.clear();
 
-		if (valuesSize > 0)
-			memcpy(keyframingValues.data(), &keyframingData[mappingDataSize], valuesSize);
+		ReadSection(keyframingMappings.data(), hdr.keyframingOffset, mappingDataSize);
 
 		size_t valueOffset = 0;
 
@@ -170,22 +146,30 @@ struct RuiPackage {
 		}
 	}
 
+	size_t KeyframingMappingsSize() const {
+		return static_cast<size_t>(hdr.keyframingCount) * sizeof(RuiPackageMapping_v1_t);
+	}
+
+	size_t KeyframingValuesSize() const {
+		return static_cast<size_t>(hdr.keyframingSize) - KeyframingMappingsSize();
+	}
+
+	uint64_t KeyframingValuesOffset() const {
+		return hdr.keyframingOffset + KeyframingMappingsSize();
+	}
+
+	size_t StyleDescriptorsSize() const {
+		return static_cast<size_t>(hdr.styleDescriptorCount) * sizeof(StyleDescriptor_v30_s);
+	}
+
 	size_t RuntimeKeyframingSize() const {
-		return (keyframingMappings.size() * sizeof(RuiMapping_v30_s)) + keyframingValues.size();
+		return (keyframingMappings.size() * sizeof(RuiMapping_v30_s)) + KeyframingValuesSize();
 	}
 
+	FILE* f = NULL;
 	RuiPackageHeader_v1_t hdr{};
 
-	std::vector<char> name;
-	std::vector<char> defaultData;
-	std::vector<char> defaultStrings;
 	std::vector<uint16_t> defaultStringOffsets;
-	std::vector<char> transformData;
-	std::vector<char> renderJobs;
-	std::vector<Argument_s> arguments;
-	std::vector<ArgCluster_s> argCluster;
-	std::vector<char> styleDescriptors;
 	std::vector<RuiPackageMapping_v1_t> keyframingMappings;
 	std::vector<size_t> keyframingValueOffsets;
-	std::vector<char> keyframingValues;
 };
@@ -57,12 +57,21 @@ struct SettingsLayoutHeader_s
 };
 static_assert(sizeof(SettingsLayoutHeader_s) == 72);
 
+// Allows looking up field names by string view without copying them.
+struct SettingsFieldNameHash_s
+{
+	using is_transparent = void;
+
+	size_t operator()(const std::string_view& name) const
+	{
+		return std::hash<std::string_view>{}(name);
+	}
+};
+
 struct SettingsLayoutParseResult_s
 {
 	SettingsLayoutParseResult_s()
-		: subHeadersBufBase(0)
-		, curSubHeaderBufIndex(0)
-		, alignment(0)
+		: alignment(0)
 		, arrayElemCount(0)
 		, subLayoutCount(0)
 		, highestSubLayoutIndex(0)
@@ -71,6 +80,8 @@ struct SettingsLayoutParseResult_s
 		, hashSeed(0)
 		, hashTableSize(0)
 		, hashStepScale(0)
+		, hashTotalProbes(0)
+		, hashMaxProbes(0)
 	{}
 
 	std::vector<std::string> fieldNames;
@@ -81,8 +92,10 @@ struct SettingsLayoutParseResult_s
 	std::vector<uint32_t> bucketMap;
 	std::vector<SettingsFieldType_e> typeMap;
 
-	size_t subHeadersBufBase;
-	size_t curSubHeaderBufIndex;
+	// Index of the first field with the given name, a name can occur multiple
+	// times in which case nextOccurrenceMap chains to the next field with it.
+	std::unordered_map<std::string, uint32_t, SettingsFieldNameHash_s, std::equal_to<>> fieldNameMap;
+	std::vector<uint32_t> nextOccurrenceMap; // UINT32_MAX if there is none.
 
 	uint32_t alignment;
 
@@ -98,6 +111,10 @@ struct SettingsLayoutParseResult_s
 	uint32_t hashSeed;
 	uint32_t hashTableSize; // Number of hash buckets, must be a power of 2.
 	uint32_t hashStepScale;
+
+	// Linear probe lengths of the lookups of all fields, these are minimized.
+	uint32_t hashTotalProbes;
+	uint32_t hashMaxProbes;
 };
 
 struct SettingsLayoutAsset_s
@@ -106,6 +123,11 @@ struct SettingsLayoutAsset_s
 	std::vector<SettingsLayoutAsset_s> subLayouts;
 };
 
+// Returns the fully parsed layout, including its offset map and hash
+// parameters. Layouts are parsed once per build and shared between the
+// settings and settings layout assets, the result must not be modified.
+extern const SettingsLayoutAsset_s& SettingsLayout_GetLayout(CPakFileBuilder* const pak, const char* const assetPath);
+
 static const char* s_settingsFieldTypeNames[] = {
 	"bool",
 	"int",
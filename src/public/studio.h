@@ -409,4 +409,55 @@ struct VertexGroupHeader_t
 
 	int unused[16];
 };
+
+// one for every mesh of every LOD, the vertices and indices of the mesh are
+// stored contiguously in the buffers of the vertex group.
+struct VertexGroupMesh_t
+{
+	__int64 flags;	// mesh flags, these determine the vertex format
+
+	unsigned int vertOffset;	// offset into the vertex buffer for this mesh's vertices
+	unsigned int vertCacheSize;	// size of a single vertex
+	unsigned int vertCount;		// number of vertices
+
+	int unk1;
+
+	int externalWeightOffset;	// offset into the extended weights buffer for this mesh
+	int externalWeightSize;		// number of bytes in the extended weights buffer used by this mesh
+
+	int indexOffset;	// index of the first index in the index buffer for this mesh
+	int indexCount;		// number of indices
+
+	int legacyWeightOffset;
+	int legacyWeightCount;
+
+	int stripOffset;	// index of the first strip for this mesh
+	int stripCount;		// number of strips
+
+	int unk[4];
+};
+static_assert(sizeof(VertexGroupMesh_t) == 0x48);
+
+#define VG_STRIP_IS_TRILIST 0x01
+
+// same as the strip header from source vtx files, indices are relative to the
+// mesh and index the vertices of the mesh.
+struct VertexGroupStrip_t
+{
+	int numIndices;
+	int indexOffset;
+
+	int numVerts;
+	int vertOffset;
+
+	short numBones;
+	unsigned char flags;
+
+	int numBoneStateChanges;
+	int boneStateChangeOffset;
+
+	int numTopologyIndices;
+	int topologyOffset;
+};
+static_assert(sizeof(VertexGroupStrip_t) == 0x23);
 #pragma pack(pop)
\ No newline at end of file
@@ -0,0 +1,1186 @@
+//=============================================================================//
+//
+// Block compression encoder for raw image sources
+//
+// ----------------------------------------------------------------------------
+// Supported formats:
+//
+// - BC1 and BC3, color blocks are fitted along the principal axis of the
+//   block's colors, and refined using least squares on the chosen indices.
+//   BC1 blocks with transparent pixels use the 3 color mode.
+// - BC4 and BC5, channel blocks use the 8 value mode, the 6 value mode with
+//   explicit 0 and 255 is tried as well on the highest quality preset.
+// - BC7, encoded using mode 6 only (single subset, RGBA endpoints with p-bits
+//   and 4 bit indices). This is a fraction of the search space of a full BC7
+//   encoder, but it is fast and beats BC3 on most content.
+// - R8G8B8A8, which is passed through as-is.
+//
+//=============================================================================//
+#include "pch.h"
+#include "bcencoder.h"
+#include "dxutils.h"
+#include "parallel.h"
+
+#define BC_BLOCK_DIM 4
+#define BC_BLOCK_PIXELS (BC_BLOCK_DIM * BC_BLOCK_DIM)
+
+typedef uint8_t BCBlockRGBA_t[BC_BLOCK_PIXELS][4];
+
+static const DXGI_FORMAT s_bcSupportedFormats[] = {
+	DXGI_FORMAT_BC1_UNORM,
+	DXGI_FORMAT_BC1_UNORM_SRGB,
+	DXGI_FORMAT_BC3_UNORM,
+	DXGI_FORMAT_BC3_UNORM_SRGB,
+	DXGI_FORMAT_BC4_UNORM,
+	DXGI_FORMAT_BC5_UNORM,
+	DXGI_FORMAT_BC7_UNORM,
+	DXGI_FORMAT_BC7_UNORM_SRGB,
+	DXGI_FORMAT_R8G8B8A8_UNORM,
+	DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+};
+
+// BC7 interpolation weights for 4 bit indices.
+static const int s_bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+bool BC_IsFormatSupported(const DXGI_FORMAT format)
+{
+	for (const DXGI_FORMAT supported : s_bcSupportedFormats)
+	{
+		if (supported == format)
+			return true;
+	}
+
+	return false;
+}
+
+bool BC_IsBlockCompressed(const DXGI_FORMAT format)
+{
+	return BC_IsFormatSupported(format)
+		&& format != DXGI_FORMAT_R8G8B8A8_UNORM
+		&& format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+}
+
+static size_t BC_GetBlockSize(const DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+		return 8;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: parses the target format from its name
+//-----------------------------------------------------------------------------
+DXGI_FORMAT BC_ParseFormat(const char* const name)
+{
+	static const char s_formatPrefix[] = "DXGI_FORMAT_";
+
+	for (const DXGI_FORMAT supported : s_bcSupportedFormats)
+	{
+		const char* const fullName = DXUtils::GetFormatAsString(supported);
+
+		if (_stricmp(name, fullName) == 0 || _stricmp(name, &fullName[sizeof(s_formatPrefix) - 1]) == 0)
+			return supported;
+	}
+
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: parses the quality preset from its name
+//-----------------------------------------------------------------------------
+bool BC_ParseQuality(const char* const name, BCQuality_e& quality)
+{
+	if (_stricmp(name, "fast") == 0)
+		quality = BCQuality_e::Fast;
+	else if (_stricmp(name, "normal") == 0)
+		quality = BCQuality_e::Normal;
+	else if (_stricmp(name, "high") == 0)
+		quality = BCQuality_e::High;
+	else
+		return false;
+
+	return true;
+}
+
+size_t BC_GetBlockCount(const uint32_t width, const uint32_t height)
+{
+	const size_t blocksX = (width + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+	const size_t blocksY = (height + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+
+	return blocksX * blocksY;
+}
+
+size_t BC_GetImageSize(const DXGI_FORMAT format, const uint32_t width, const uint32_t height)
+{
+	if (!BC_IsBlockCompressed(format))
+		return static_cast<size_t>(width) * height * 4;
+
+	return BC_GetBlockCount(width, height) * BC_GetBlockSize(format);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: fetches a 4x4 block from the image, edge pixels are repeated for
+//          blocks that exceed the image bounds
+//-----------------------------------------------------------------------------
+static void BC_FetchBlock(const uint8_t* const rgba, const uint32_t width, const uint32_t height,
+	const uint32_t blockX, const uint32_t blockY, BCBlockRGBA_t& block)
+{
+	for (uint32_t y = 0; y < BC_BLOCK_DIM; y++)
+	{
+		const uint32_t srcY = (std::min)(blockY * BC_BLOCK_DIM + y, height - 1);
+
+		for (uint32_t x = 0; x < BC_BLOCK_DIM; x++)
+		{
+			const uint32_t srcX = (std::min)(blockX * BC_BLOCK_DIM + x, width - 1);
+			memcpy(block[y * BC_BLOCK_DIM + x], &rgba[(static_cast<size_t>(srcY) * width + srcX) * 4], 4);
+		}
+	}
+}
+
+static inline float BC_Clamp255(const float value)
+{
+	return (std::max)(0.0f, (std::min)(255.0f, value));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: fits the endpoints of a line through the first N channels of the
+//          pixels, using the bounding box or the principal axis
+//-----------------------------------------------------------------------------
+template <int N>
+static void BC_FitEndpoints(const float (*const pixels)[4], const int count, const BCQuality_e quality, float (&e0)[4], float (&e1)[4])
+{
+	float minValue[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+	float maxValue[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	for (int i = 0; i < count; i++)
+	{
+		for (int c = 0; c < N; c++)
+		{
+			minValue[c] = (std::min)(minValue[c], pixels[i][c]);
+			maxValue[c] = (std::max)(maxValue[c], pixels[i][c]);
+		}
+	}
+
+	if (quality == BCQuality_e::Fast || count == 1)
+	{
+		// Inset the box slightly, the extremes are rarely the best endpoints.
+		for (int c = 0; c < N; c++)
+		{
+			const float inset = (maxValue[c] - minValue[c]) / 16.0f;
+
+			e0[c] = minValue[c] + inset;
+			e1[c] = maxValue[c] - inset;
+		}
+
+		return;
+	}
+
+	float mean[4] = {};
+
+	for (int i = 0; i < count; i++)
+	{
+		for (int c = 0; c < N; c++)
+			mean[c] += pixels[i][c];
+	}
+
+	for (int c = 0; c < N; c++)
+		mean[c] /= count;
+
+	float covariance[4][4] = {};
+
+	for (int i = 0; i < count; i++)
+	{
+		float delta[4];
+
+		for (int c = 0; c < N; c++)
+			delta[c] = pixels[i][c] - mean[c];
+
+		for (int a = 0; a < N; a++)
+		{
+			for (int b = 0; b < N; b++)
+				covariance[a][b] += delta[a] * delta[b];
+		}
+	}
+
+	// Power iteration, starting from the diagonal of the bounding box.
+	float axis[4];
+	float axisLength = 0.0f;
+
+	for (int c = 0; c < N; c++)
+	{
+		axis[c] = maxValue[c] - minValue[c];
+		axisLength += axis[c] * axis[c];
+	}
+
+	// All pixels are equal.
+	if (axisLength == 0.0f)
+	{
+		for (int c = 0; c < N; c++)
+		{
+			e0[c] = mean[c];
+			e1[c] = mean[c];
+		}
+
+		return;
+	}
+
+	for (int iter = 0; iter < 8; iter++)
+	{
+		float next[4] = {};
+		float largest = 0.0f;
+
+		for (int a = 0; a < N; a++)
+		{
+			for (int b = 0; b < N; b++)
+				next[a] += covariance[a][b] * axis[b];
+
+			largest = (std::max)(largest, fabsf(next[a]));
+		}
+
+		if (largest == 0.0f)
+			break;
+
+		for (int c = 0; c < N; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	axisLength = 0.0f;
+
+	for (int c = 0; c < N; c++)
+		axisLength += axis[c] * axis[c];
+
+	axisLength = sqrtf(axisLength);
+
+	for (int c = 0; c < N; c++)
+		axis[c] /= axisLength;
+
+	float minProj = FLT_MAX;
+	float maxProj = -FLT_MAX;
+
+	for (int i = 0; i < count; i++)
+	{
+		float proj = 0.0f;
+
+		for (int c = 0; c < N; c++)
+			proj += (pixels[i][c] - mean[c]) * axis[c];
+
+		minProj = (std::min)(minProj, proj);
+		maxProj = (std::max)(maxProj, proj);
+	}
+
+	for (int c = 0; c < N; c++)
+	{
+		e0[c] = BC_Clamp255(mean[c] + axis[c] * minProj);
+		e1[c] = BC_Clamp255(mean[c] + axis[c] * maxProj);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: solves the endpoints that minimize the squared error for the given
+//          interpolation weights, returns false if the system is singular
+//-----------------------------------------------------------------------------
+template <int N>
+static bool BC_RefineEndpoints(const float (*const pixels)[4], const float* const weights, const int count, float (&e0)[4], float (&e1)[4])
+{
+	float alpha2 = 0.0f;
+	float beta2 = 0.0f;
+	float alphaBeta = 0.0f;
+
+	float alphaX[4] = {};
+	float betaX[4] = {};
+
+	for (int i = 0; i < count; i++)
+	{
+		const float beta = weights[i];
+		const float alpha = 1.0f - beta;
+
+		alpha2 += alpha * alpha;
+		beta2 += beta * beta;
+		alphaBeta += alpha * beta;
+
+		for (int c = 0; c < N; c++)
+		{
+			alphaX[c] += alpha * pixels[i][c];
+			betaX[c] += beta * pixels[i][c];
+		}
+	}
+
+	const float det = alpha2 * beta2 - alphaBeta * alphaBeta;
+
+	if (fabsf(det) < 1e-6f)
+		return false;
+
+	const float invDet = 1.0f / det;
+
+	for (int c = 0; c < N; c++)
+	{
+		e0[c] = BC_Clamp255((alphaX[c] * beta2 - betaX[c] * alphaBeta) * invDet);
+		e1[c] = BC_Clamp255((betaX[c] * alpha2 - alphaX[c] * alphaBeta) * invDet);
+	}
+
+	return true;
+}
+
+static int BC_GetRefineIterations(const BCQuality_e quality)
+{
+	switch (quality)
+	{
+	case BCQuality_e::Fast: return 0;
+	case BCQuality_e::Normal: return 1;
+	default: return 8;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// BC1 color blocks
+//-----------------------------------------------------------------------------
+static uint16_t BC_PackRGB565(const float (&color)[4])
+{
+	const int r = static_cast<int>(BC_Clamp255(color[0]) * (31.0f / 255.0f) + 0.5f);
+	const int g = static_cast<int>(BC_Clamp255(color[1]) * (63.0f / 255.0f) + 0.5f);
+	const int b = static_cast<int>(BC_Clamp255(color[2]) * (31.0f / 255.0f) + 0.5f);
+
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void BC_UnpackRGB565(const uint16_t packed, int (&color)[3])
+{
+	const int r = (packed >> 11) & 0x1F;
+	const int g = (packed >> 5) & 0x3F;
+	const int b = packed & 0x1F;
+
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+static void BC_BuildColorPalette(const uint16_t c0, const uint16_t c1, const bool fourColor, int (&palette)[4][3])
+{
+	BC_UnpackRGB565(c0, palette[0]);
+	BC_UnpackRGB565(c1, palette[1]);
+
+	for (int c = 0; c < 3; c++)
+	{
+		if (fourColor)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+}
+
+// Returns the total squared error of the opaque pixels.
+static int BC_FindColorIndices(const BCBlockRGBA_t& block, const bool (&transparent)[BC_BLOCK_PIXELS],
+	const int (&palette)[4][3], const bool fourColor, uint8_t (&indices)[BC_BLOCK_PIXELS])
+{
+	const int paletteSize = fourColor ? 4 : 3;
+	int totalError = 0;
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		if (transparent[i])
+		{
+			indices[i] = 3;
+			continue;
+		}
+
+		int bestError = INT_MAX;
+
+		for (int j = 0; j < paletteSize; j++)
+		{
+			const int dr = block[i][0] - palette[j][0];
+			const int dg = block[i][1] - palette[j][1];
+			const int db = block[i][2] - palette[j][2];
+			const int error = dr * dr + dg * dg + db * db;
+
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = static_cast<uint8_t>(j);
+			}
+		}
+
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+static void BC_EncodeColorBlock(const BCBlockRGBA_t& block, const bool allowTransparency, const BCQuality_e quality, uint8_t* const out)
+{
+	float pixels[BC_BLOCK_PIXELS][4];
+	bool transparent[BC_BLOCK_PIXELS];
+	int count = 0;
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		transparent[i] = allowTransparency && block[i][3] < 128;
+
+		if (transparent[i])
+			continue;
+
+		for (int c = 0; c < 3; c++)
+			pixels[count][c] = block[i][c];
+
+		count++;
+	}
+
+	uint16_t c0 = 0;
+	uint16_t c1 = 0;
+	uint8_t indices[BC_BLOCK_PIXELS];
+
+	// The 3 color mode is required to encode transparent pixels, which is
+	// selected by storing the endpoints in ascending order.
+	const bool fourColor = (count == BC_BLOCK_PIXELS);
+
+	if (count == 0)
+	{
+		for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+			indices[i] = 3;
+	}
+	else
+	{
+		float e0[4];
+		float e1[4];
+
+		BC_FitEndpoints<3>(pixels, count, quality, e0, e1);
+
+		c0 = BC_PackRGB565(e0);
+		c1 = BC_PackRGB565(e1);
+
+		int palette[4][3];
+		BC_BuildColorPalette(c0, c1, fourColor, palette);
+
+		int bestError = BC_FindColorIndices(block, transparent, palette, fourColor, indices);
+		const int iterations = BC_GetRefineIterations(quality);
+
+		for (int iter = 0; iter < iterations && bestError > 0; iter++)
+		{
+			static const float s_fourColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+			static const float s_threeColorWeights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+
+			float weights[BC_BLOCK_PIXELS];
+			int weightCount = 0;
+
+			for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+			{
+				if (!transparent[i])
+					weights[weightCount++] = fourColor ? s_fourColorWeights[indices[i]] : s_threeColorWeights[indices[i]];
+			}
+
+			if (!BC_RefineEndpoints<3>(pixels, weights, count, e0, e1))
+				break;
+
+			const uint16_t newC0 = BC_PackRGB565(e0);
+			const uint16_t newC1 = BC_PackRGB565(e1);
+
+			BC_BuildColorPalette(newC0, newC1, fourColor, palette);
+
+			uint8_t newIndices[BC_BLOCK_PIXELS];
+			const int error = BC_FindColorIndices(block, transparent, palette, fourColor, newIndices);
+
+			if (error >= bestError)
+				break;
+
+			bestError = error;
+			c0 = newC0;
+			c1 = newC1;
+
+			memcpy(indices, newIndices, sizeof(indices));
+		}
+
+		if (c0 == c1)
+		{
+			// Equal endpoints select the 3 color mode, the first entry is the
+			// only one that is equal to the endpoints in both modes.
+			for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+			{
+				if (!transparent[i])
+					indices[i] = 0;
+			}
+		}
+		else if (fourColor ? (c0 < c1) : (c0 > c1))
+		{
+			static const uint8_t s_fourColorRemap[4] = { 1, 0, 3, 2 };
+			static const uint8_t s_threeColorRemap[4] = { 1, 0, 2, 3 };
+
+			std::swap(c0, c1);
+
+			for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+				indices[i] = fourColor ? s_fourColorRemap[indices[i]] : s_threeColorRemap[indices[i]];
+		}
+	}
+
+	uint32_t indexBits = 0;
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+		indexBits |= static_cast<uint32_t>(indices[i]) << (i * 2);
+
+	memcpy(&out[0], &c0, sizeof(c0));
+	memcpy(&out[2], &c1, sizeof(c1));
+	memcpy(&out[4], &indexBits, sizeof(indexBits));
+}
+
+//-----------------------------------------------------------------------------
+// BC4 channel blocks, also used for the alpha of BC3 and both channels of BC5
+//-----------------------------------------------------------------------------
+static void BC_BuildChannelPalette(const int a0, const int a1, int (&palette)[8])
+{
+	palette[0] = a0;
+	palette[1] = a1;
+
+	if (a0 > a1)
+	{
+		for (int i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+	}
+	else
+	{
+		for (int i = 2; i < 6; i++)
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static int BC_FindChannelIndices(const uint8_t (&values)[BC_BLOCK_PIXELS], const int (&palette)[8], uint8_t (&indices)[BC_BLOCK_PIXELS])
+{
+	int totalError = 0;
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		int bestError = INT_MAX;
+
+		for (int j = 0; j < 8; j++)
+		{
+			const int delta = values[i] - palette[j];
+			const int error = delta * delta;
+
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = static_cast<uint8_t>(j);
+			}
+		}
+
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+static void BC_EncodeChannelBlock(const uint8_t (&values)[BC_BLOCK_PIXELS], const BCQuality_e quality, uint8_t* const out)
+{
+	int minValue = 255;
+	int maxValue = 0;
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		minValue = (std::min)(minValue, static_cast<int>(values[i]));
+		maxValue = (std::max)(maxValue, static_cast<int>(values[i]));
+	}
+
+	int palette[8];
+	uint8_t indices[BC_BLOCK_PIXELS];
+
+	// Use the 8 value mode, unless all values are equal.
+	int a0 = maxValue;
+	int a1 = minValue;
+
+	BC_BuildChannelPalette(a0, a1, palette);
+	const int error = BC_FindChannelIndices(values, palette, indices);
+
+	// The 6 value mode has exact 0 and 255 entries, which allows for more
+	// precision in between if the block has values on either extreme.
+	if (quality == BCQuality_e::High && error > 0)
+	{
+		int innerMin = 255;
+		int innerMax = 0;
+
+		for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+		{
+			if (values[i] == 0 || values[i] == 255)
+				continue;
+
+			innerMin = (std::min)(innerMin, static_cast<int>(values[i]));
+			innerMax = (std::max)(innerMax, static_cast<int>(values[i]));
+		}
+
+		if (innerMin > innerMax)
+		{
+			innerMin = 0;
+			innerMax = 0;
+		}
+
+		int altPalette[8];
+		uint8_t altIndices[BC_BLOCK_PIXELS];
+
+		BC_BuildChannelPalette(innerMin, innerMax, altPalette);
+
+		if (BC_FindChannelIndices(values, altPalette, altIndices) < error)
+		{
+			a0 = innerMin;
+			a1 = innerMax;
+
+			memcpy(indices, altIndices, sizeof(indices));
+		}
+	}
+
+	uint64_t indexBits = 0;
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+		indexBits |= static_cast<uint64_t>(indices[i]) << (i * 3);
+
+	out[0] = static_cast<uint8_t>(a0);
+	out[1] = static_cast<uint8_t>(a1);
+
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = static_cast<uint8_t>(indexBits >> (i * 8));
+}
+
+//-----------------------------------------------------------------------------
+// BC7 mode 6 blocks
+//-----------------------------------------------------------------------------
+struct BCBitWriter_s
+{
+	uint8_t* out;
+	uint32_t pos;
+
+	void Write(const uint32_t value, const uint32_t bits)
+	{
+		for (uint32_t i = 0; i < bits; i++, pos++)
+		{
+			if ((value >> i) & 1)
+				out[pos >> 3] |= static_cast<uint8_t>(1 << (pos & 7));
+		}
+	}
+};
+
+struct BCBitReader_s
+{
+	const uint8_t* in;
+	uint32_t pos;
+
+	uint32_t Read(const uint32_t bits)
+	{
+		uint32_t value = 0;
+
+		for (uint32_t i = 0; i < bits; i++, pos++)
+			value |= static_cast<uint32_t>((in[pos >> 3] >> (pos & 7)) & 1) << i;
+
+		return value;
+	}
+};
+
+// Quantizes the endpoint to 7 bits per channel plus a shared p-bit.
+static void BC_QuantizeBC7Endpoint(const float (&endpoint)[4], uint8_t (&quantized)[4], uint8_t& pbit)
+{
+	float bestError = FLT_MAX;
+
+	for (uint8_t p = 0; p < 2; p++)
+	{
+		uint8_t candidate[4];
+		float error = 0.0f;
+
+		for (int c = 0; c < 4; c++)
+		{
+			const int q = static_cast<int>((endpoint[c] - p) / 2.0f + 0.5f);
+			candidate[c] = static_cast<uint8_t>((std::max)(0, (std::min)(127, q)));
+
+			const float delta = static_cast<float>((candidate[c] << 1) | p) - endpoint[c];
+			error += delta * delta;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			pbit = p;
+
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+static void BC_BuildBC7Palette(const uint8_t (&q0)[4], const uint8_t p0, const uint8_t (&q1)[4], const uint8_t p1, int (&palette)[16][4])
+{
+	for (int c = 0; c < 4; c++)
+	{
+		const int v0 = (q0[c] << 1) | p0;
+		const int v1 = (q1[c] << 1) | p1;
+
+		for (int i = 0; i < 16; i++)
+			palette[i][c] = ((64 - s_bc7Weights4[i]) * v0 + s_bc7Weights4[i] * v1 + 32) >> 6;
+	}
+}
+
+static int BC_FindBC7Indices(const BCBlockRGBA_t& block, const int (&palette)[16][4], uint8_t (&indices)[BC_BLOCK_PIXELS])
+{
+	int totalError = 0;
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		int bestError = INT_MAX;
+
+		for (int j = 0; j < 16; j++)
+		{
+			int error = 0;
+
+			for (int c = 0; c < 4; c++)
+			{
+				const int delta = block[i][c] - palette[j][c];
+				error += delta * delta;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = static_cast<uint8_t>(j);
+			}
+		}
+
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+static void BC_EncodeBC7Block(const BCBlockRGBA_t& block, const BCQuality_e quality, uint8_t* const out)
+{
+	float pixels[BC_BLOCK_PIXELS][4];
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			pixels[i][c] = block[i][c];
+	}
+
+	float e0[4];
+	float e1[4];
+
+	BC_FitEndpoints<4>(pixels, BC_BLOCK_PIXELS, quality, e0, e1);
+
+	uint8_t q0[4], q1[4];
+	uint8_t p0, p1;
+
+	BC_QuantizeBC7Endpoint(e0, q0, p0);
+	BC_QuantizeBC7Endpoint(e1, q1, p1);
+
+	int palette[16][4];
+	uint8_t indices[BC_BLOCK_PIXELS];
+
+	BC_BuildBC7Palette(q0, p0, q1, p1, palette);
+
+	int bestError = BC_FindBC7Indices(block, palette, indices);
+	const int iterations = BC_GetRefineIterations(quality);
+
+	for (int iter = 0; iter < iterations && bestError > 0; iter++)
+	{
+		float weights[BC_BLOCK_PIXELS];
+
+		for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+			weights[i] = s_bc7Weights4[indices[i]] / 64.0f;
+
+		if (!BC_RefineEndpoints<4>(pixels, weights, BC_BLOCK_PIXELS, e0, e1))
+			break;
+
+		uint8_t newQ0[4], newQ1[4];
+		uint8_t newP0, newP1;
+
+		BC_QuantizeBC7Endpoint(e0, newQ0, newP0);
+		BC_QuantizeBC7Endpoint(e1, newQ1, newP1);
+
+		BC_BuildBC7Palette(newQ0, newP0, newQ1, newP1, palette);
+
+		uint8_t newIndices[BC_BLOCK_PIXELS];
+		const int error = BC_FindBC7Indices(block, palette, newIndices);
+
+		if (error >= bestError)
+			break;
+
+		bestError = error;
+
+		memcpy(q0, newQ0, sizeof(q0));
+		memcpy(q1, newQ1, sizeof(q1));
+		p0 = newP0;
+		p1 = newP1;
+
+		memcpy(indices, newIndices, sizeof(indices));
+	}
+
+	// The most significant bit of the first index is implicitly zero, swap
+	// the endpoints and invert the indices if it isn't.
+	if (indices[0] & 0x8)
+	{
+		std::swap(q0, q1);
+		std::swap(p0, p1);
+
+		for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+			indices[i] = static_cast<uint8_t>(15 - indices[i]);
+	}
+
+	memset(out, 0, 16);
+	BCBitWriter_s writer = { out, 0 };
+
+	writer.Write(1 << 6, 7); // Mode 6.
+
+	for (int c = 0; c < 4; c++)
+	{
+		writer.Write(q0[c], 7);
+		writer.Write(q1[c], 7);
+	}
+
+	writer.Write(p0, 1);
+	writer.Write(p1, 1);
+
+	writer.Write(indices[0], 3);
+
+	for (int i = 1; i < BC_BLOCK_PIXELS; i++)
+		writer.Write(indices[i], 4);
+
+	assert(writer.pos == 128);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: encodes a single block into the target format
+//-----------------------------------------------------------------------------
+static void BC_EncodeBlock(const BCBlockRGBA_t& block, const DXGI_FORMAT format, const BCQuality_e quality, uint8_t* const out)
+{
+	uint8_t channel[BC_BLOCK_PIXELS];
+
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		BC_EncodeColorBlock(block, true, quality, out);
+		break;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+			channel[i] = block[i][3];
+
+		BC_EncodeChannelBlock(channel, quality, &out[0]);
+		BC_EncodeColorBlock(block, false, quality, &out[8]);
+		break;
+	case DXGI_FORMAT_BC4_UNORM:
+		for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+			channel[i] = block[i][0];
+
+		BC_EncodeChannelBlock(channel, quality, out);
+		break;
+	case DXGI_FORMAT_BC5_UNORM:
+		for (int c = 0; c < 2; c++)
+		{
+			for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+				channel[i] = block[i][c];
+
+			BC_EncodeChannelBlock(channel, quality, &out[c * 8]);
+		}
+		break;
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		BC_EncodeBC7Block(block, quality, out);
+		break;
+	default:
+		assert(0); // code bug, format must be validated by the caller.
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: encodes the image into the target format
+//-----------------------------------------------------------------------------
+void BC_CompressImage(const uint8_t* const rgba, const uint32_t width, const uint32_t height,
+	const DXGI_FORMAT format, const BCQuality_e quality, uint8_t* const out)
+{
+	assert(BC_IsFormatSupported(format));
+
+	if (!BC_IsBlockCompressed(format))
+	{
+		memcpy(out, rgba, BC_GetImageSize(format, width, height));
+		return;
+	}
+
+	const uint32_t blocksX = (width + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+	const uint32_t blocksY = (height + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+	const size_t blockSize = BC_GetBlockSize(format);
+
+	Parallel_For(blocksY, [&](const size_t blockY)
+	{
+		BCBlockRGBA_t block;
+
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			BC_FetchBlock(rgba, width, height, blockX, static_cast<uint32_t>(blockY), block);
+			BC_EncodeBlock(block, format, quality, &out[(blockY * blocksX + blockX) * blockSize]);
+		}
+	});
+}
+
+//-----------------------------------------------------------------------------
+// Decoders, these only need to cover the blocks produced by the encoder.
+//-----------------------------------------------------------------------------
+static void BC_DecodeColorBlock(const uint8_t* const in, const bool forceFourColor, BCBlockRGBA_t& block)
+{
+	uint16_t c0, c1;
+	uint32_t indexBits;
+
+	memcpy(&c0, &in[0], sizeof(c0));
+	memcpy(&c1, &in[2], sizeof(c1));
+	memcpy(&indexBits, &in[4], sizeof(indexBits));
+
+	const bool fourColor = forceFourColor || c0 > c1;
+
+	int palette[4][3];
+	BC_BuildColorPalette(c0, c1, fourColor, palette);
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		const uint32_t index = (indexBits >> (i * 2)) & 0x3;
+
+		for (int c = 0; c < 3; c++)
+			block[i][c] = static_cast<uint8_t>(palette[index][c]);
+
+		block[i][3] = (!fourColor && index == 3) ? 0 : 255;
+	}
+}
+
+static void BC_DecodeChannelBlock(const uint8_t* const in, const int channel, BCBlockRGBA_t& block)
+{
+	int palette[8];
+	BC_BuildChannelPalette(in[0], in[1], palette);
+
+	uint64_t indexBits = 0;
+
+	for (int i = 0; i < 6; i++)
+		indexBits |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+		block[i][channel] = static_cast<uint8_t>(palette[(indexBits >> (i * 3)) & 0x7]);
+}
+
+static void BC_DecodeBC7Block(const uint8_t* const in, BCBlockRGBA_t& block)
+{
+	BCBitReader_s reader = { in, 0 };
+
+	// Only mode 6 is produced by the encoder.
+	if (reader.Read(7) != (1 << 6))
+	{
+		assert(0);
+		memset(block, 0, sizeof(block));
+
+		return;
+	}
+
+	uint8_t q0[4], q1[4];
+
+	for (int c = 0; c < 4; c++)
+	{
+		q0[c] = static_cast<uint8_t>(reader.Read(7));
+		q1[c] = static_cast<uint8_t>(reader.Read(7));
+	}
+
+	const uint8_t p0 = static_cast<uint8_t>(reader.Read(1));
+	const uint8_t p1 = static_cast<uint8_t>(reader.Read(1));
+
+	int palette[16][4];
+	BC_BuildBC7Palette(q0, p0, q1, p1, palette);
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		const uint32_t index = reader.Read(i == 0 ? 3 : 4);
+
+		for (int c = 0; c < 4; c++)
+			block[i][c] = static_cast<uint8_t>(palette[index][c]);
+	}
+}
+
+static void BC_DecodeBlock(const uint8_t* const in, const DXGI_FORMAT format, BCBlockRGBA_t& block)
+{
+	// Channels that aren't stored by the format decode to opaque black.
+	for (int i = 0; i < BC_BLOCK_PIXELS; i++)
+	{
+		block[i][0] = 0;
+		block[i][1] = 0;
+		block[i][2] = 0;
+		block[i][3] = 255;
+	}
+
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		BC_DecodeColorBlock(in, false, block);
+		break;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		BC_DecodeColorBlock(&in[8], true, block);
+		BC_DecodeChannelBlock(&in[0], 3, block);
+		break;
+	case DXGI_FORMAT_BC4_UNORM:
+		BC_DecodeChannelBlock(in, 0, block);
+		break;
+	case DXGI_FORMAT_BC5_UNORM:
+		BC_DecodeChannelBlock(&in[0], 0, block);
+		BC_DecodeChannelBlock(&in[8], 1, block);
+		break;
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		BC_DecodeBC7Block(in, block);
+		break;
+	default:
+		assert(0);
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: decodes an image that was encoded into one of the supported formats
+//-----------------------------------------------------------------------------
+void BC_DecompressImage(const uint8_t* const encoded, const uint32_t width, const uint32_t height,
+	const DXGI_FORMAT format, uint8_t* const rgba)
+{
+	assert(BC_IsFormatSupported(format));
+
+	if (!BC_IsBlockCompressed(format))
+	{
+		memcpy(rgba, encoded, BC_GetImageSize(format, width, height));
+		return;
+	}
+
+	const uint32_t blocksX = (width + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+	const uint32_t blocksY = (height + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+	const size_t blockSize = BC_GetBlockSize(format);
+
+	Parallel_For(blocksY, [&](const size_t blockY)
+	{
+		BCBlockRGBA_t block;
+
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			BC_DecodeBlock(&encoded[(blockY * blocksX + blockX) * blockSize], format, block);
+
+			for (uint32_t y = 0; y < BC_BLOCK_DIM; y++)
+			{
+				const size_t dstY = blockY * BC_BLOCK_DIM + y;
+
+				if (dstY >= height)
+					break;
+
+				for (uint32_t x = 0; x < BC_BLOCK_DIM; x++)
+				{
+					const uint32_t dstX = blockX * BC_BLOCK_DIM + x;
+
+					if (dstX >= width)
+						break;
+
+					memcpy(&rgba[(dstY * width + dstX) * 4], block[y * BC_BLOCK_DIM + x], 4);
+				}
+			}
+		}
+	});
+}
+
+static int BC_GetStoredChannelCount(const DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC4_UNORM:
+		return 1;
+	case DXGI_FORMAT_BC5_UNORM:
+		return 2;
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		return 3; // The alpha is only 1 bit.
+	default:
+		return 4;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: computes the peak signal-to-noise ratio of the encoded image
+//-----------------------------------------------------------------------------
+double BC_ComputePSNR(const uint8_t* const rgba, const uint32_t width, const uint32_t height,
+	const DXGI_FORMAT format, const uint8_t* const encoded)
+{
+	const int channelCount = BC_GetStoredChannelCount(format);
+	uint64_t squaredError = 0;
+
+	if (!BC_IsBlockCompressed(format))
+	{
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			for (int c = 0; c < channelCount; c++)
+			{
+				const int delta = rgba[i * 4 + c] - encoded[i * 4 + c];
+				squaredError += delta * delta;
+			}
+		}
+	}
+	else
+	{
+		const uint32_t blocksX = (width + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+		const uint32_t blocksY = (height + (BC_BLOCK_DIM - 1)) / BC_BLOCK_DIM;
+		const size_t blockSize = BC_GetBlockSize(format);
+
+		for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+		{
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				BCBlockRGBA_t block;
+				BC_DecodeBlock(&encoded[(static_cast<size_t>(blockY) * blocksX + blockX) * blockSize], format, block);
+
+				for (uint32_t y = 0; y < BC_BLOCK_DIM; y++)
+				{
+					const uint32_t srcY = blockY * BC_BLOCK_DIM + y;
+
+					if (srcY >= height)
+						break;
+
+					for (uint32_t x = 0; x < BC_BLOCK_DIM; x++)
+					{
+						const uint32_t srcX = blockX * BC_BLOCK_DIM + x;
+
+						if (srcX >= width)
+							break;
+
+						const uint8_t* const source = &rgba[(static_cast<size_t>(srcY) * width + srcX) * 4];
+
+						for (int c = 0; c < channelCount; c++)
+						{
+							const int delta = source[c] - block[y * BC_BLOCK_DIM + x][c];
+							squaredError += delta * delta;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	const double sampleCount = static_cast<double>(width) * height * channelCount;
+	const double meanSquaredError = squaredError / sampleCount;
+
+	if (meanSquaredError == 0.0)
+		return std::numeric_limits<double>::infinity();
+
+	return 10.0 * log10((255.0 * 255.0) / meanSquaredError);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Block compression quality presets, higher quality presets are slower.
+enum class BCQuality_e
+{
+	Fast = 0, // Bounding box endpoints.
+	Normal,   // Principal axis endpoints, refined once.
+	High      // Principal axis endpoints, refined until converged, alternative block modes are tried.
+};
+
+extern bool BC_IsFormatSupported(const DXGI_FORMAT format);
+extern bool BC_IsBlockCompressed(const DXGI_FORMAT format);
+
+// Accepts format names with or without the "DXGI_FORMAT_" prefix, returns
+// DXGI_FORMAT_UNKNOWN if the format isn't supported by the encoder.
+extern DXGI_FORMAT BC_ParseFormat(const char* const name);
+extern bool BC_ParseQuality(const char* const name, BCQuality_e& quality);
+
+extern size_t BC_GetBlockCount(const uint32_t width, const uint32_t height);
+extern size_t BC_GetImageSize(const DXGI_FORMAT format, const uint32_t width, const uint32_t height);
+
+// Encodes an RGBA8 image into the target format, the block rows are spread
+// across all cores. The output must be BC_GetImageSize() bytes large.
+extern void BC_CompressImage(const uint8_t* const rgba, const uint32_t width, const uint32_t height,
+	const DXGI_FORMAT format, const BCQuality_e quality, uint8_t* const out);
+
+// Decodes an image that was encoded into one of the supported formats back to
+// RGBA8, channels that aren't stored by the format are set to opaque black.
+extern void BC_DecompressImage(const uint8_t* const encoded, const uint32_t width, const uint32_t height,
+	const DXGI_FORMAT format, uint8_t* const rgba);
+
+// Decodes the encoded image and returns the peak signal-to-noise ratio against
+// the RGBA8 source, over the channels that are stored by the format.
+extern double BC_ComputePSNR(const uint8_t* const rgba, const uint32_t width, const uint32_t height,
+	const DXGI_FORMAT format, const uint8_t* const encoded);
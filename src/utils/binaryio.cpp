@@ -2,6 +2,16 @@
 #include "binaryio.h"
 #include <sys/stat.h>
 
+static BinaryIO::Backend_e s_defaultBackend = BinaryIO::Backend_e::Stream;
+
+// writes to the native backend are accumulated in a buffer of this size before
+// they are submitted to the file, writes that are equal or larger are submitted
+// directly.
+static constexpr size_t NATIVE_WRITE_BUF_SIZE = 4 * 1024 * 1024;
+
+// WriteFile and ReadFile take a 32bit size, larger requests are split up.
+static constexpr size_t NATIVE_MAX_IO_SIZE = 1024 * 1024 * 1024;
+
 //-----------------------------------------------------------------------------
 // Purpose: CIOStream constructors
 //-----------------------------------------------------------------------------
@@ -47,14 +57,25 @@ static std::ios_base::openmode GetInternalStreamMode(const BinaryIO::Mode_e mode
 //-----------------------------------------------------------------------------
 bool BinaryIO::Open(const char* const filePath, const Mode_e mode)
 {
-	m_flags = GetInternalStreamMode(mode);
-	m_mode = mode;
+	if (m_fileHandle != INVALID_HANDLE_VALUE || m_mappedFile.IsOpen())
+	{
+		NativeClose();
+	}
 
 	if (m_stream.is_open())
 	{
 		m_stream.close();
 	}
 
+	m_flags = GetInternalStreamMode(mode);
+	m_mode = mode;
+	m_backend = s_defaultBackend;
+
+	if (m_backend == Backend_e::Native)
+	{
+		return NativeOpen(filePath);
+	}
+
 	m_stream.open(filePath, m_flags);
 
 	if (!m_stream.is_open() || !m_stream.good())
@@ -83,8 +104,22 @@ void BinaryIO::Reset()
 {
 	m_size = 0;
 	m_skip = 0;
+	m_writeCalls = 0;
 	m_mode = Mode_e::None;
 	m_flags = 0;
+	m_backend = s_defaultBackend;
+
+	m_fileHandle = INVALID_HANDLE_VALUE;
+	m_mapHandle = NULL;
+	m_writeMapView = nullptr;
+	m_writeMapSize = 0;
+	m_position = 0;
+	m_nativeEof = false;
+	m_nativeFail = false;
+
+	m_writeBuf.reset();
+	m_writeBufUsed = 0;
+	m_writeBufOffset = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -92,7 +127,11 @@ void BinaryIO::Reset()
 //-----------------------------------------------------------------------------
 void BinaryIO::Close()
 {
-	m_stream.close();
+	if (m_backend == Backend_e::Native)
+		NativeClose();
+	else
+		m_stream.close();
+
 	Reset();
 }
 
@@ -101,10 +140,97 @@ void BinaryIO::Close()
 //-----------------------------------------------------------------------------
 void BinaryIO::Flush()
 {
-	if (IsWritable())
+	if (!IsWritable())
+		return;
+
+	if (m_backend == Backend_e::Native)
+		NativeFlushWriteBuffer();
+	else
 		m_stream.flush();
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: preallocates disk space for a file that is expected to grow to the
+//          given size, the file size itself remains unchanged
+// Input  : expectedSize - 
+// Output : true if the space has been reserved
+//-----------------------------------------------------------------------------
+bool BinaryIO::Reserve(const size_t expectedSize)
+{
+	// The stream backend has no way to do this without changing the size.
+	if (m_backend != Backend_e::Native || !IsWritable())
+		return false;
+
+	FILE_ALLOCATION_INFO allocInfo;
+	allocInfo.AllocationSize.QuadPart = static_cast<LONGLONG>(expectedSize);
+
+	return SetFileInformationByHandle(m_fileHandle, FileAllocationInfo, &allocInfo, sizeof(allocInfo)) != FALSE;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: resizes the file and maps it entirely for writing, the caller can
+//          then write anywhere in the file directly, and from any thread.
+//          Data past the previous end of the file is zero filled.
+// Input  : fileSize - the final size of the file
+// Output : pointer to the start of the file, or nullptr if the backend does
+//          not support this, in which case regular writes should be used
+//-----------------------------------------------------------------------------
+char* BinaryIO::BeginMappedWrite(const size_t fileSize)
+{
+	// Writable mappings require read access on the file handle as well.
+	if (m_backend != Backend_e::Native || !IsWritable() || !IsReadMode() || m_writeMapView)
+		return nullptr;
+
+	assert(static_cast<std::streamoff>(fileSize) >= m_size);
+	NativeFlushWriteBuffer();
+
+	LARGE_INTEGER newSize;
+	newSize.QuadPart = static_cast<LONGLONG>(fileSize);
+
+	if (!SetFilePointerEx(m_fileHandle, newSize, NULL, FILE_BEGIN) || !SetEndOfFile(m_fileHandle))
+		return nullptr;
+
+	m_mapHandle = CreateFileMappingA(m_fileHandle, NULL, PAGE_READWRITE, newSize.HighPart, newSize.LowPart, NULL);
+
+	if (!m_mapHandle)
+		return nullptr;
+
+	m_writeMapView = reinterpret_cast<char*>(MapViewOfFile(m_mapHandle, FILE_MAP_WRITE, 0, 0, 0));
+
+	if (!m_writeMapView)
+	{
+		CloseHandle(m_mapHandle);
+		m_mapHandle = NULL;
+
+		return nullptr;
+	}
+
+	m_writeMapSize = fileSize;
+	return m_writeMapView;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: unmaps the file after a mapped write, the position is moved to the
+//          end of the file
+//-----------------------------------------------------------------------------
+void BinaryIO::EndMappedWrite()
+{
+	if (!m_writeMapView)
+		return;
+
+	UnmapViewOfFile(m_writeMapView);
+	m_writeMapView = nullptr;
+
+	CloseHandle(m_mapHandle);
+	m_mapHandle = NULL;
+
+	m_position = static_cast<std::streamoff>(m_writeMapSize);
+	m_size = m_position;
+	m_skip = 0;
+
+	m_writeMapSize = 0;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: gets the position of the current character in the stream
 // Output : std::streampos
@@ -112,11 +238,19 @@ void BinaryIO::Flush()
 std::streamoff BinaryIO::TellGet()
 {
 	assert(IsReadMode());
+
+	if (m_backend == Backend_e::Native)
+		return m_position;
+
 	return m_stream.tellg();
 }
 std::streamoff BinaryIO::TellPut()
 {
 	assert(IsWriteMode());
+
+	if (m_backend == Backend_e::Native)
+		return m_position;
+
 	return m_stream.tellp();
 }
 
@@ -128,7 +262,11 @@ std::streamoff BinaryIO::TellPut()
 void BinaryIO::SeekGet(const std::streamoff offset, const std::ios_base::seekdir way)
 {
 	assert(IsReadMode());
-	m_stream.seekg(offset, way);
+
+	if (m_backend == Backend_e::Native)
+		NativeSeek(offset, way);
+	else
+		m_stream.seekg(offset, way);
 }
 //-----------------------------------------------------------------------------
 // NOTE: if you seek beyond the end of the file to try and pad it out, use the
@@ -138,11 +276,28 @@ void BinaryIO::SeekPut(const std::streamoff offset, const std::ios_base::seekdir
 {
 	assert(IsWriteMode());
 
+	// Resolve the native position before the skip delta, as seeking from the
+	// end beyond the file size grows it.
+	if (m_backend == Backend_e::Native)
+		NativeSeek(offset, way);
+	else
+		m_stream.seekp(offset, way);
+
 	CalcSkipDelta(offset, way);
-	m_stream.seekp(offset, way);
 }
 void BinaryIO::Seek(const std::streamoff offset, const std::ios_base::seekdir way)
 {
+	// The native backend only has one position, so it must only be moved once.
+	if (m_backend == Backend_e::Native)
+	{
+		if (IsWriteMode())
+			SeekPut(offset, way);
+		else
+			SeekGet(offset, way);
+
+		return;
+	}
+
 	if (IsReadMode())
 		SeekGet(offset, way);
 	if (IsWriteMode())
@@ -150,14 +305,31 @@ void BinaryIO::Seek(const std::streamoff offset, const std::ios_base::seekdir wa
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: returns the data
+// Purpose: returns the data, only available on the stream backend as the
+//          native backend never opens the stream
 // Output : std::filebuf*
 //-----------------------------------------------------------------------------
 const std::filebuf* BinaryIO::GetData() const
 {
+	assert(m_backend == Backend_e::Stream);
+
+	if (m_backend != Backend_e::Stream)
+		return nullptr;
+
 	return m_stream.rdbuf();
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: returns the mapped view of the file, only available on the native
+//          backend in read mode
+// Output : pointer to the start of the file, or nullptr if it isn't mapped
+//-----------------------------------------------------------------------------
+const char* BinaryIO::GetMappedData() const
+{
+	assert(m_backend == Backend_e::Native && m_mode == Mode_e::Read);
+	return m_mappedFile.GetData();
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: returns the data size
 // Output : std::streampos
@@ -183,7 +355,13 @@ bool BinaryIO::IsWriteMode() const
 //-----------------------------------------------------------------------------
 bool BinaryIO::IsReadable() const
 {
-	if (!IsReadMode() || !m_stream || m_stream.eof())
+	if (!IsReadMode())
+		return false;
+
+	if (m_backend == Backend_e::Native)
+		return (m_fileHandle != INVALID_HANDLE_VALUE || m_mappedFile.IsOpen()) && !m_nativeFail && !m_nativeEof;
+
+	if (!m_stream || m_stream.eof())
 		return false;
 
 	return true;
@@ -195,7 +373,13 @@ bool BinaryIO::IsReadable() const
 //-----------------------------------------------------------------------------
 bool BinaryIO::IsWritable() const
 {
-	if (!IsWriteMode() || !m_stream)
+	if (!IsWriteMode())
+		return false;
+
+	if (m_backend == Backend_e::Native)
+		return m_fileHandle != INVALID_HANDLE_VALUE && !m_nativeFail;
+
+	if (!m_stream)
 		return false;
 
 	return true;
@@ -207,6 +391,9 @@ bool BinaryIO::IsWritable() const
 //-----------------------------------------------------------------------------
 bool BinaryIO::IsEof() const
 {
+	if (m_backend == Backend_e::Native)
+		return m_nativeEof;
+
 	return m_stream.eof();
 }
 
@@ -220,7 +407,7 @@ bool BinaryIO::ReadString(std::string& out)
 	if (!IsReadable())
 		return false;
 
-	while (!m_stream.eof())
+	while (!IsEof())
 	{
 		const char c = Read<char>();
 
@@ -246,7 +433,7 @@ bool BinaryIO::ReadString(char* const buf, const size_t len)
 
 	size_t i = 0;
 
-	while (i < len && !m_stream.eof())
+	while (i < len && !IsEof())
 	{
 		const char c = Read<char>();
 
@@ -272,12 +459,68 @@ bool BinaryIO::WriteString(const std::string& input, const bool nullterminate)
 	const char* const text = input.c_str();
 	const size_t len = input.length() + nullterminate;
 
-	m_stream.write(text, len);
+	WriteBytes(text, len);
 	CalcAddDelta(len);
 
 	return true;
 }
 
+// gathered writes are coalesced into a staging buffer of this size, entries
+// that are equal or larger are written out directly.
+static constexpr size_t GATHER_BUF_SIZE = 1024 * 1024;
+
+//-----------------------------------------------------------------------------
+// Purpose: writes all entries sequentially with as few writes as possible
+// Input  : *vecs - 
+//			count - 
+//-----------------------------------------------------------------------------
+void BinaryIO::WriteGathered(const BinaryIOVec_s* const vecs, const size_t count)
+{
+	if (!IsWritable())
+		return;
+
+	std::unique_ptr<char[]> stagingBuf(new char[GATHER_BUF_SIZE]);
+	size_t stagedSize = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const BinaryIOVec_s& vec = vecs[i];
+
+		if (!vec.size)
+			continue;
+
+		if (stagedSize + vec.size > GATHER_BUF_SIZE)
+		{
+			if (stagedSize)
+				Write(stagingBuf.get(), stagedSize);
+
+			stagedSize = 0;
+		}
+
+		if (vec.size >= GATHER_BUF_SIZE)
+		{
+			if (vec.data)
+				Write(vec.data, vec.size);
+			else
+				Pad(vec.size);
+
+			continue;
+		}
+
+		char* const target = &stagingBuf[stagedSize];
+
+		if (vec.data)
+			memcpy(target, vec.data, vec.size);
+		else
+			memset(target, 0, vec.size);
+
+		stagedSize += vec.size;
+	}
+
+	if (stagedSize)
+		Write(stagingBuf.get(), stagedSize);
+}
+
 // limit number of io calls and allocations by just using this static buffer
 // for padding out the stream.
 static constexpr size_t PAD_BUF_SIZE = 4096;
@@ -380,3 +623,329 @@ void BinaryIO::CalcSkipDelta(const std::streamoff offset, const std::ios_base::s
 	if (m_skip < 0)
 		m_skip = 0;
 }
+
+//-----------------------------------------------------------------------------
+// Purpose: sets the backend used by files opened after this call
+// Input  : backend - 
+//-----------------------------------------------------------------------------
+void BinaryIO::SetDefaultBackend(const Backend_e backend)
+{
+	s_defaultBackend = backend;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: gets the backend used by newly opened files
+// Output : the backend
+//-----------------------------------------------------------------------------
+BinaryIO::Backend_e BinaryIO::GetDefaultBackend()
+{
+	return s_defaultBackend;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: backend enum <-> string conversions
+//-----------------------------------------------------------------------------
+const char* BinaryIO::BackendToString(const Backend_e backend)
+{
+	switch (backend)
+	{
+	case Backend_e::Stream: return "stream";
+	case Backend_e::Native: return "native";
+	}
+
+	assert(0);
+	return "unknown";
+}
+bool BinaryIO::StringToBackend(const char* const str, Backend_e& backend)
+{
+	if (_stricmp(str, "stream") == 0)
+	{
+		backend = Backend_e::Stream;
+		return true;
+	}
+
+	if (_stricmp(str, "native") == 0)
+	{
+		backend = Backend_e::Native;
+		return true;
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: opens the file using Win32 file handles, files opened for reading
+//          only are mapped into memory entirely through CMappedFile
+// Input  : *filePath - 
+// Output : true if operation is successful
+//-----------------------------------------------------------------------------
+bool BinaryIO::NativeOpen(const char* const filePath)
+{
+	m_position = 0;
+	m_nativeEof = false;
+	m_nativeFail = false;
+
+	// The file size must remain constant for the view to stay valid, hence
+	// files are only mapped in read mode.
+	if (m_mode == Mode_e::Read)
+	{
+		if (!m_mappedFile.Open(filePath))
+			return false;
+
+		m_size = static_cast<std::streamoff>(m_mappedFile.GetSize());
+		return true;
+	}
+
+	DWORD access = 0;
+	DWORD disposition = 0;
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+
+	switch (m_mode)
+	{
+	case Mode_e::Write:
+		access = GENERIC_WRITE;
+		disposition = CREATE_ALWAYS;
+		break;
+	case Mode_e::ReadWrite:
+		access = GENERIC_READ | GENERIC_WRITE;
+		disposition = OPEN_EXISTING;
+		break;
+	case Mode_e::ReadWriteCreate:
+		access = GENERIC_READ | GENERIC_WRITE;
+		disposition = CREATE_ALWAYS;
+		break;
+	default:
+		assert(0); // code bug, can never reach this.
+		return false;
+	}
+
+	m_fileHandle = CreateFileA(filePath, access, FILE_SHARE_READ, NULL, disposition, flags, NULL);
+
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if (IsReadMode())
+	{
+		LARGE_INTEGER fileSize;
+
+		if (!GetFileSizeEx(m_fileHandle, &fileSize))
+		{
+			NativeClose();
+			return false;
+		}
+
+		m_size = fileSize.QuadPart;
+	}
+
+	if (IsWriteMode())
+	{
+		m_writeBuf.reset(new char[NATIVE_WRITE_BUF_SIZE]);
+		m_writeBufUsed = 0;
+		m_writeBufOffset = 0;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: submits any pending writes and closes all native handles
+//-----------------------------------------------------------------------------
+void BinaryIO::NativeClose()
+{
+	m_mappedFile.Close();
+
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+		return;
+
+	if (IsWriteMode())
+		NativeFlushWriteBuffer();
+
+	EndMappedWrite();
+
+	CloseHandle(m_fileHandle);
+	m_fileHandle = INVALID_HANDLE_VALUE;
+
+	m_writeBuf.reset();
+	m_writeBufUsed = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: reads from the current position, either from the mapped view or
+//          through a positional read on the file handle
+// Input  : *buf - 
+//			size - 
+//-----------------------------------------------------------------------------
+void BinaryIO::NativeRead(void* const buf, const size_t size)
+{
+	// Data that has been written but not yet submitted must be visible.
+	if (m_writeBufUsed)
+		NativeFlushWriteBuffer();
+
+	char* const target = reinterpret_cast<char*>(buf);
+	size_t numRead = 0;
+
+	if (m_mappedFile.IsOpen())
+	{
+		const size_t available = m_position < m_size
+			? static_cast<size_t>(m_size - m_position)
+			: 0;
+
+		numRead = (std::min)(size, available);
+
+		if (numRead)
+			memcpy(target, &m_mappedFile.GetData()[m_position], numRead);
+	}
+	else
+	{
+		while (numRead < size)
+		{
+			const std::streamoff offset = m_position + numRead;
+			const DWORD toRead = static_cast<DWORD>((std::min)(size - numRead, NATIVE_MAX_IO_SIZE));
+
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+			DWORD bytesRead = 0;
+
+			if (!ReadFile(m_fileHandle, &target[numRead], toRead, &bytesRead, &overlapped))
+			{
+				if (GetLastError() != ERROR_HANDLE_EOF)
+					m_nativeFail = true;
+
+				break;
+			}
+
+			if (!bytesRead)
+				break;
+
+			numRead += bytesRead;
+		}
+	}
+
+	m_position += numRead;
+
+	// Same as the stream backend, a short read sets the end of file state.
+	if (numRead < size)
+		m_nativeEof = true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: writes to the current position, contiguous writes are accumulated
+//          in the write buffer and submitted at once
+// Input  : *buf - 
+//			size - 
+//-----------------------------------------------------------------------------
+void BinaryIO::NativeWrite(const void* const buf, const size_t size)
+{
+	// Pending writes can only be appended to if we didn't seek away.
+	if (m_writeBufUsed && (m_writeBufOffset + static_cast<std::streamoff>(m_writeBufUsed) != m_position))
+		NativeFlushWriteBuffer();
+
+	if (size >= NATIVE_WRITE_BUF_SIZE)
+	{
+		NativeFlushWriteBuffer();
+		NativeWriteAt(buf, size, m_position);
+	}
+	else
+	{
+		if (m_writeBufUsed + size > NATIVE_WRITE_BUF_SIZE)
+			NativeFlushWriteBuffer();
+
+		if (!m_writeBufUsed)
+			m_writeBufOffset = m_position;
+
+		memcpy(&m_writeBuf[m_writeBufUsed], buf, size);
+		m_writeBufUsed += size;
+	}
+
+	m_position += size;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: submits a positional write to the file handle
+// Input  : *buf - 
+//			size - 
+//			offset - 
+// Output : true on success, false otherwise
+//-----------------------------------------------------------------------------
+bool BinaryIO::NativeWriteAt(const void* const buf, const size_t size, const std::streamoff offset)
+{
+	const char* const source = reinterpret_cast<const char*>(buf);
+	size_t numWritten = 0;
+
+	while (numWritten < size)
+	{
+		const std::streamoff writeOffset = offset + numWritten;
+		const DWORD toWrite = static_cast<DWORD>((std::min)(size - numWritten, NATIVE_MAX_IO_SIZE));
+
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(writeOffset & 0xFFFFFFFF);
+		overlapped.OffsetHigh = static_cast<DWORD>(writeOffset >> 32);
+
+		DWORD bytesWritten = 0;
+		m_writeCalls++;
+
+		if (!WriteFile(m_fileHandle, &source[numWritten], toWrite, &bytesWritten, &overlapped) || bytesWritten != toWrite)
+		{
+			m_nativeFail = true;
+			return false;
+		}
+
+		numWritten += bytesWritten;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: submits all pending writes to the file handle
+//-----------------------------------------------------------------------------
+void BinaryIO::NativeFlushWriteBuffer()
+{
+	if (!m_writeBufUsed)
+		return;
+
+	NativeWriteAt(m_writeBuf.get(), m_writeBufUsed, m_writeBufOffset);
+	m_writeBufUsed = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: moves the shared position of the native backend
+// Input  : offset - 
+//			way - 
+//-----------------------------------------------------------------------------
+void BinaryIO::NativeSeek(const std::streamoff offset, const std::ios_base::seekdir way)
+{
+	std::streamoff base = 0;
+
+	switch (way)
+	{
+	case std::ios_base::beg:
+		break;
+	case std::ios_base::cur:
+		base = m_position;
+		break;
+	case std::ios_base::end:
+		base = m_size;
+		break;
+	default:
+		assert(false && "Unsupported seek direction.");
+		return;
+	}
+
+	const std::streamoff newPosition = base + offset;
+	assert(newPosition >= 0);
+
+	if (newPosition < 0)
+	{
+		m_nativeFail = true;
+		return;
+	}
+
+	// Seeking clears the end of file state, same as the stream backend.
+	m_position = newPosition;
+	m_nativeEof = false;
+}
@@ -1,4 +1,13 @@
 #pragma once
+#include "mappedfile.h"
+
+// A single entry of a gathered write, entries without data are written out as
+// zeros, see BinaryIO::WriteGathered().
+struct BinaryIOVec_s
+{
+	const void* data;
+	size_t size;
+};
 
 class BinaryIO
 {
@@ -12,6 +21,12 @@ public:
 		ReadWriteCreate
 	};
 
+	enum class Backend_e
+	{
+		Stream = 0, // std::fstream.
+		Native      // Win32 file handles, buffered writes and mapped reads.
+	};
+
 	BinaryIO();
 	~BinaryIO();
 
@@ -22,6 +37,11 @@ public:
 	void Reset();
 	void Flush();
 
+	bool Reserve(const size_t expectedSize);
+
+	char* BeginMappedWrite(const size_t fileSize);
+	void EndMappedWrite();
+
 	std::streamoff TellGet();
 	std::streamoff TellPut();
 
@@ -29,7 +49,8 @@ public:
 	void SeekPut(const std::streamoff offset, const std::ios_base::seekdir way = std::ios::beg);
 	void Seek(const std::streamoff offset, const std::ios_base::seekdir way = std::ios::beg);
 
-	const std::filebuf* GetData() const;
+	const std::filebuf* GetData() const; // Stream backend only.
+	const char* GetMappedData() const;   // Native backend in read mode only.
 	const std::streamoff GetSize() const;
 
 	bool IsReadMode() const;
@@ -40,6 +61,16 @@ public:
 
 	bool IsEof() const;
 
+	inline Backend_e GetBackend() const { return m_backend; }
+
+	// The backend is selected when a file is opened, so this only affects
+	// files that are opened after this call.
+	static void SetDefaultBackend(const Backend_e backend);
+	static Backend_e GetDefaultBackend();
+
+	static const char* BackendToString(const Backend_e backend);
+	static bool StringToBackend(const char* const str, Backend_e& backend);
+
 	//-----------------------------------------------------------------------------
 	// Purpose: reads any value from the file
 	//-----------------------------------------------------------------------------
@@ -47,7 +78,7 @@ public:
 	inline void Read(T& value)
 	{
 		if (IsReadable())
-			m_stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+			ReadBytes(&value, sizeof(value));
 	}
 
 	//-----------------------------------------------------------------------------
@@ -57,13 +88,13 @@ public:
 	inline void Read(T* const value, const size_t size)
 	{
 		if (IsReadable())
-			m_stream.read(reinterpret_cast<char*>(value), size);
+			ReadBytes(value, size);
 	}
 	template<typename T>
 	inline void Read(T& value, const size_t size)
 	{
 		if (IsReadable())
-			m_stream.read(reinterpret_cast<char*>(&value), size);
+			ReadBytes(&value, size);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -76,7 +107,7 @@ public:
 		if (!IsReadable())
 			return value;
 
-		m_stream.read(reinterpret_cast<char*>(&value), sizeof(value));
+		ReadBytes(&value, sizeof(value));
 		return value;
 	}
 	bool ReadString(std::string& svOut);
@@ -93,7 +124,7 @@ public:
 
 		const size_t count = sizeof(value);
 
-		m_stream.write(reinterpret_cast<const char*>(&value), count);
+		WriteBytes(&value, count);
 		CalcAddDelta(count);
 	}
 
@@ -106,20 +137,68 @@ public:
 		if (!IsWritable())
 			return;
 
-		m_stream.write(reinterpret_cast<const char*>(value), size);
+		WriteBytes(value, size);
 		CalcAddDelta(size);
 	}
 	bool WriteString(const std::string& svInput, const bool nullterminate);
+	void WriteGathered(const BinaryIOVec_s* const vecs, const size_t count);
 	void Pad(const size_t count);
 
+	inline size_t GetWriteCallCount() const { return m_writeCalls; }
+
 protected:
 	void CalcAddDelta(const size_t count);
 	void CalcSkipDelta(const std::streamoff offset, const std::ios_base::seekdir way);
 
+private:
+	inline void ReadBytes(void* const buf, const size_t size)
+	{
+		if (m_backend == Backend_e::Stream)
+			m_stream.read(reinterpret_cast<char*>(buf), size);
+		else
+			NativeRead(buf, size);
+	}
+
+	inline void WriteBytes(const void* const buf, const size_t size)
+	{
+		if (m_backend == Backend_e::Stream)
+		{
+			m_stream.write(reinterpret_cast<const char*>(buf), size);
+			m_writeCalls++;
+		}
+		else
+			NativeWrite(buf, size);
+	}
+
+	bool NativeOpen(const char* const filePath);
+	void NativeClose();
+
+	void NativeRead(void* const buf, const size_t size);
+	void NativeWrite(const void* const buf, const size_t size);
+	bool NativeWriteAt(const void* const buf, const size_t size, const std::streamoff offset);
+	void NativeFlushWriteBuffer();
+	void NativeSeek(const std::streamoff offset, const std::ios_base::seekdir way);
+
 private:
 	std::fstream            m_stream; // I/O stream.
 	std::streamoff          m_size;   // File size.
 	std::streamoff          m_skip;   // Amount skipped back.
+	size_t                  m_writeCalls; // Number of writes submitted to the backend.
 	std::ios_base::openmode m_flags;  // Stream flags.
 	Mode_e                  m_mode;   // Stream mode.
+	Backend_e               m_backend; // Backend used for the opened file.
+
+	// Native backend state, the get and put positions are shared.
+	CMappedFile             m_mappedFile; // Entire file mapped, only in Mode_e::Read.
+	HANDLE                  m_fileHandle; // All other modes.
+	HANDLE                  m_mapHandle;
+	char*                   m_writeMapView; // Entire file mapped, only during a mapped write.
+	size_t                  m_writeMapSize;
+	std::streamoff          m_position; // Current file position.
+	bool                    m_nativeEof;
+	bool                    m_nativeFail;
+
+	std::unique_ptr<char[]> m_writeBuf;
+	size_t                  m_writeBufUsed;
+	std::streamoff          m_writeBufOffset; // File offset of the first buffered byte.
 };
@@ -0,0 +1,217 @@
+//=============================================================================//
+//
+// Single pass csv tokenizer
+//
+//=============================================================================//
+#include "pch.h"
+#include "csvdocument.h"
+#include <emmintrin.h>
+
+//-----------------------------------------------------------------------------
+// Purpose: returns a pointer to the first separator, quote or line break
+//          character in [p, end), or end if there is none
+//-----------------------------------------------------------------------------
+static const char* Csv_FindSpecialChar(const char* p, const char* const end)
+{
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i lineFeed = _mm_set1_epi8('\n');
+	const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+	while (end - p >= 16)
+	{
+		const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+		const __m128i matches = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chars, comma), _mm_cmpeq_epi8(chars, quote)),
+			_mm_or_si128(_mm_cmpeq_epi8(chars, lineFeed), _mm_cmpeq_epi8(chars, carriageReturn)));
+
+		const int mask = _mm_movemask_epi8(matches);
+
+		if (mask)
+		{
+			unsigned long index;
+			_BitScanForward(&index, mask);
+
+			return p + index;
+		}
+
+		p += 16;
+	}
+
+	for (; p < end; p++)
+	{
+		const char c = *p;
+
+		if (c == ',' || c == '"' || c == '\n' || c == '\r')
+			return p;
+	}
+
+	return end;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: adds the cell in range [start, end), unquoting it if needed
+//-----------------------------------------------------------------------------
+void CCsvDocument::AddCell(const char* const start, const char* const end, const bool hasCarriageReturn)
+{
+	std::string_view cell(start, end - start);
+
+	// Carriage returns are dropped anywhere in the cell, but are usually only
+	// found at the end of the last one in a row.
+	bool isBuffered = false;
+
+	if (hasCarriageReturn)
+	{
+		while (!cell.empty() && cell.back() == '\r')
+			cell.remove_suffix(1);
+
+		if (cell.find('\r') != std::string_view::npos)
+		{
+			const size_t base = m_cellBuffer.size();
+
+			for (const char c : cell)
+			{
+				if (c != '\r')
+					m_cellBuffer.push_back(c);
+			}
+
+			cell = std::string_view(m_cellBuffer.data() + base, m_cellBuffer.size() - base);
+			isBuffered = true;
+		}
+	}
+
+	if (cell.size() < 2 || cell.front() != '"' || cell.back() != '"')
+	{
+		m_cells.push_back(cell);
+		return;
+	}
+
+	cell = cell.substr(1, cell.size() - 2);
+
+	if (cell.find('"') == std::string_view::npos)
+	{
+		m_cells.push_back(cell);
+		return;
+	}
+
+	// Escaped quotes; "" becomes ". Cells that are already buffered are
+	// unescaped in place, as the result is never longer.
+	const size_t base = isBuffered ? cell.data() - m_cellBuffer.data() - 1 : m_cellBuffer.size();
+	size_t length = 0;
+
+	if (!isBuffered)
+		m_cellBuffer.resize(base + cell.size());
+
+	for (size_t i = 0; i < cell.size(); i++)
+	{
+		m_cellBuffer[base + length++] = cell[i];
+
+		if (cell[i] == '"' && i + 1 < cell.size() && cell[i + 1] == '"')
+			i++;
+	}
+
+	m_cellBuffer.resize(base + length);
+	m_cells.push_back(std::string_view(m_cellBuffer.data() + base, length));
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: tokenizes the csv data in one pass
+// Input  : *data -
+//			size -
+//-----------------------------------------------------------------------------
+void CCsvDocument::Parse(const char* const data, const size_t size)
+{
+	m_cells.clear();
+	m_rowOffsets.clear();
+	m_cellBuffer.clear();
+
+	// A cell never grows when it is unquoted or stripped, and each source
+	// byte ends up in at most one stored cell.
+	m_cellBuffer.reserve(size);
+
+	const char* p = data;
+	const char* const end = data + size;
+
+	// Skip the UTF-8 byte order mark.
+	if (size >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+		p += 3;
+
+	bool rowStarted = false;
+	bool endsWithSeparator = false;
+
+	while (p < end)
+	{
+		if (!rowStarted)
+		{
+			m_rowOffsets.push_back(m_cells.size());
+			rowStarted = true;
+		}
+
+		const char* const cellStart = p;
+		endsWithSeparator = false;
+
+		// Quotes only have a meaning if the cell starts with one.
+		const char* first = p;
+
+		while (first < end && *first == '\r')
+			first++;
+
+		const bool startsQuoted = first < end && *first == '"';
+		bool quoted = false;
+		bool hasCarriageReturn = false;
+
+		while (p < end)
+		{
+			p = Csv_FindSpecialChar(p, end);
+
+			if (p == end)
+				break;
+
+			const char c = *p;
+
+			if (c == '"')
+			{
+				if (startsQuoted)
+					quoted = !quoted;
+			}
+			else if (c == '\r')
+				hasCarriageReturn = true;
+			else if (c == '\n' || !quoted)
+				break;
+
+			p++;
+		}
+
+		if (p == end)
+		{
+			// A trailing line that is empty or only holds carriage returns
+			// isn't a row.
+			const bool isEmpty = m_rowOffsets.back() == m_cells.size()
+				&& std::all_of(cellStart, end, [](const char c) { return c == '\r'; });
+
+			if (isEmpty)
+				m_rowOffsets.pop_back();
+			else
+				AddCell(cellStart, end, hasCarriageReturn);
+
+			break;
+		}
+
+		AddCell(cellStart, p, hasCarriageReturn);
+
+		if (*p == '\n')
+			rowStarted = false;
+		else
+			endsWithSeparator = true;
+
+		p++;
+	}
+
+	// A separator right before the end still adds an empty cell.
+	if (endsWithSeparator)
+		m_cells.push_back(std::string_view());
+
+	if (!m_rowOffsets.empty())
+		m_rowOffsets.push_back(m_cells.size());
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <string_view>
+
+// Tokenized csv document, cells are views into the source data, except those
+// that had to be unquoted or stripped of carriage returns. The source data
+// must outlive the document. Parsing follows the rules of rapidcsv with its
+// default parameters; comma separated, quoted cells are unquoted, and line
+// breaks always end the row.
+class CCsvDocument
+{
+public:
+	void Parse(const char* const data, const size_t size);
+
+	// Includes the header row.
+	inline size_t GetRowCount() const { return m_rowOffsets.empty() ? 0 : m_rowOffsets.size() - 1; };
+	inline size_t GetColumnCount(const size_t rowIdx) const { return m_rowOffsets[rowIdx + 1] - m_rowOffsets[rowIdx]; };
+
+	inline const std::string_view& GetCell(const size_t rowIdx, const size_t colIdx) const
+	{
+		assert(colIdx < GetColumnCount(rowIdx));
+		return m_cells[m_rowOffsets[rowIdx] + colIdx];
+	}
+
+private:
+	void AddCell(const char* const start, const char* const end, const bool hasCarriageReturn);
+
+	std::vector<std::string_view> m_cells;
+
+	// Index of the first cell of each row, with an extra entry at the end.
+	std::vector<size_t> m_rowOffsets;
+
+	// Storage for cells that couldn't be referenced in place. Reserved to
+	// the source size up front, as views into it must remain valid.
+	std::string m_cellBuffer;
+};
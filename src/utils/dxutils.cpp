@@ -156,6 +156,29 @@ DXGI_FORMAT MakeSRGB(_In_ DXGI_FORMAT format) noexcept
 	}
 }
 
+//-----------------------------------------------------------------------------
+// purpose: checks if the format is the sRGB variant of one of the formats that
+//          MakeSRGB maps
+// returns: true if the format is sRGB
+//-----------------------------------------------------------------------------
+bool DXUtils::IsSRGB(DXGI_FORMAT fmt) noexcept
+{
+	switch (fmt)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // purpose: gets the dxgi format from header
 // returns: DXGI_FORMAT
@@ -497,4 +520,221 @@ bool DXUtils::GetParsedShaderData(const char* bytecode, size_t /*bytecodeLen*/,
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+static const uint32_t s_dxbcHashShifts[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+
+static const uint32_t s_dxbcHashConstants[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+	0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+	0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+	0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+	0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+	0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+	0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+	0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+// Single MD5 round over a 64 byte block.
+static void DXUtils_HashBlock(uint32_t state[4], const uint32_t block[16])
+{
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+
+	for (uint32_t i = 0; i < 64; i++)
+	{
+		uint32_t f;
+		uint32_t g;
+
+		if (i < 16)
+		{
+			f = (b & c) | (~b & d);
+			g = i;
+		}
+		else if (i < 32)
+		{
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) & 15;
+		}
+		else if (i < 48)
+		{
+			f = b ^ c ^ d;
+			g = (3 * i + 5) & 15;
+		}
+		else
+		{
+			f = c ^ (b | ~d);
+			g = (7 * i) & 15;
+		}
+
+		f += a + s_dxbcHashConstants[i] + block[g];
+		a = d;
+		d = c;
+		c = b;
+		b += (f << s_dxbcHashShifts[i]) | (f >> (32 - s_dxbcHashShifts[i]));
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+// The container hash is MD5 with a different padding; the bit count is stored
+// at the start of the last block instead of its end, which ends with the
+// byte count * 2 | 1. See ComputeHashRetail in the DirectX Shader Compiler.
+static void DXUtils_ComputeContainerHash(const char* const data, const uint32_t dataLen, DXBCHash& outHash)
+{
+	uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+	uint32_t block[16];
+
+	const uint32_t fullBlocksSize = dataLen & ~63u;
+
+	for (uint32_t offset = 0; offset < fullBlocksSize; offset += 64)
+	{
+		memcpy(block, &data[offset], sizeof(block));
+		DXUtils_HashBlock(state, block);
+	}
+
+	const uint32_t remainder = dataLen - fullBlocksSize;
+	unsigned char* const blockBytes = reinterpret_cast<unsigned char*>(block);
+
+	memset(block, 0, sizeof(block));
+
+	if (remainder >= 56)
+	{
+		// Not enough space left for the sizes, pad this block and add another.
+		memcpy(blockBytes, &data[fullBlocksSize], remainder);
+		blockBytes[remainder] = 0x80;
+
+		DXUtils_HashBlock(state, block);
+		memset(block, 0, sizeof(block));
+	}
+	else
+	{
+		memcpy(&blockBytes[4], &data[fullBlocksSize], remainder);
+		blockBytes[4 + remainder] = 0x80;
+	}
+
+	block[0] = dataLen << 3;
+	block[15] = (dataLen << 1) | 1;
+
+	DXUtils_HashBlock(state, block);
+	memcpy(outHash.Digest, state, sizeof(outHash.Digest));
+}
+
+static bool DXUtils_IsRequiredBlob(const uint32_t fourCC)
+{
+	switch (fourCC)
+	{
+	case DXBC_FOURCC_RDEF_NAME: // Used for reflection, also by RePak itself.
+	case DXBC_FOURCC_SHDR_NAME:
+	case DXBC_FOURCC_SHEX_NAME:
+	case DXBC_FOURCC_SFI0_NAME:
+	case DXBC_FOURCC_IFCE_NAME:
+	case DXBC_FOURCC_ISGN_NAME:
+	case DXBC_FOURCC_ISG1_NAME:
+	case DXBC_FOURCC_OSGN_NAME:
+	case DXBC_FOURCC_OSG1_NAME:
+	case DXBC_FOURCC_OSG5_NAME:
+	case DXBC_FOURCC_PCSG_NAME:
+	case DXBC_FOURCC_PSG1_NAME:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: rebuilds the container in place with only the blobs that are
+//          required by the runtime, and recomputes its hash
+// Output : the new size of the container, or bytecodeLen if it wasn't changed
+//-----------------------------------------------------------------------------
+uint32_t DXUtils::StripShaderByteCode(char* const bytecode, const uint32_t bytecodeLen)
+{
+	if (bytecodeLen < sizeof(DXBCHeader))
+		return bytecodeLen;
+
+	DXBCHeader* const fileHeader = reinterpret_cast<DXBCHeader*>(bytecode);
+
+	if (!fileHeader->isValid() || fileHeader->ContainerSizeInBytes != bytecodeLen || (bytecodeLen & 3)
+		|| fileHeader->BlobCount > (bytecodeLen - sizeof(DXBCHeader)) / sizeof(uint32_t))
+	{
+		return bytecodeLen;
+	}
+
+	std::vector<uint32_t> keptBlobOffsets;
+	keptBlobOffsets.reserve(fileHeader->BlobCount);
+
+	uint32_t prevBlobEnd = static_cast<uint32_t>(sizeof(DXBCHeader) + (fileHeader->BlobCount * sizeof(uint32_t)));
+	bool hasShaderCode = false;
+
+	// Blobs are moved towards the start of the container, which requires them
+	// to be stored in order. Containers that aren't are left as is.
+	for (uint32_t i = 0; i < fileHeader->BlobCount; ++i)
+	{
+		const uint32_t blobOffset = fileHeader->BlobOffset(i);
+
+		if (blobOffset < prevBlobEnd || (blobOffset & 3) || blobOffset > bytecodeLen - sizeof(DXBCBlobHeader))
+			return bytecodeLen;
+
+		const DXBCBlobHeader* const blob = fileHeader->pBlob(i);
+
+		if (blob->BlobSize > bytecodeLen - blobOffset - sizeof(DXBCBlobHeader))
+			return bytecodeLen;
+
+		prevBlobEnd = blobOffset + sizeof(DXBCBlobHeader) + blob->BlobSize;
+
+		if (blob->BlobFourCC == DXBC_FOURCC_SHDR_NAME || blob->BlobFourCC == DXBC_FOURCC_SHEX_NAME)
+			hasShaderCode = true;
+
+		if (DXUtils_IsRequiredBlob(blob->BlobFourCC))
+			keptBlobOffsets.push_back(blobOffset);
+	}
+
+	// Only strip containers with D3D11 shader code, as the required
+	// blobs of other containers are unknown.
+	if (!hasShaderCode || keptBlobOffsets.size() == fileHeader->BlobCount)
+		return bytecodeLen;
+
+	const uint32_t keptBlobCount = static_cast<uint32_t>(keptBlobOffsets.size());
+	uint32_t writeOffset = static_cast<uint32_t>(sizeof(DXBCHeader) + (keptBlobCount * sizeof(uint32_t)));
+
+	for (uint32_t i = 0; i < keptBlobCount; ++i)
+	{
+		const uint32_t blobOffset = keptBlobOffsets[i];
+		const uint32_t blobSize = static_cast<uint32_t>(sizeof(DXBCBlobHeader) + reinterpret_cast<const DXBCBlobHeader*>(&bytecode[blobOffset])->BlobSize);
+
+		memmove(&bytecode[writeOffset], &bytecode[blobOffset], blobSize);
+		reinterpret_cast<uint32_t*>(&bytecode[sizeof(DXBCHeader)])[i] = writeOffset;
+
+		const uint32_t alignedEnd = IALIGN4(writeOffset + blobSize);
+		memset(&bytecode[writeOffset + blobSize], 0, alignedEnd - (writeOffset + blobSize));
+
+		writeOffset = alignedEnd;
+	}
+
+	fileHeader->BlobCount = keptBlobCount;
+	fileHeader->ContainerSizeInBytes = writeOffset;
+
+	// The hash covers everything after the hash itself.
+	const uint32_t hashedDataStart = offsetof(DXBCHeader, Version);
+	DXUtils_ComputeContainerHash(&bytecode[hashedDataStart], writeOffset - hashedDataStart, fileHeader->Hash);
+
+	return writeOffset;
+}
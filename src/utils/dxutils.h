@@ -23,6 +23,20 @@
 #define DXBC_FOURCC_NAME      (('C'<<24)+('B'<<16)+('X'<<8)+'D')
 #define DXBC_FOURCC_RDEF_NAME (('F'<<24)+('E'<<16)+('D'<<8)+'R')
 
+// Blobs needed to create the shader and its input layout in the runtime, all
+// other blobs (debug info, statistics, etc) can be stripped.
+#define DXBC_FOURCC_SHDR_NAME (('R'<<24)+('D'<<16)+('H'<<8)+'S')
+#define DXBC_FOURCC_SHEX_NAME (('X'<<24)+('E'<<16)+('H'<<8)+'S')
+#define DXBC_FOURCC_SFI0_NAME (('0'<<24)+('I'<<16)+('F'<<8)+'S')
+#define DXBC_FOURCC_IFCE_NAME (('E'<<24)+('C'<<16)+('F'<<8)+'I')
+#define DXBC_FOURCC_ISGN_NAME (('N'<<24)+('G'<<16)+('S'<<8)+'I')
+#define DXBC_FOURCC_ISG1_NAME (('1'<<24)+('G'<<16)+('S'<<8)+'I')
+#define DXBC_FOURCC_OSGN_NAME (('N'<<24)+('G'<<16)+('S'<<8)+'O')
+#define DXBC_FOURCC_OSG1_NAME (('1'<<24)+('G'<<16)+('S'<<8)+'O')
+#define DXBC_FOURCC_OSG5_NAME (('5'<<24)+('G'<<16)+('S'<<8)+'O')
+#define DXBC_FOURCC_PCSG_NAME (('G'<<24)+('S'<<16)+('C'<<8)+'P')
+#define DXBC_FOURCC_PSG1_NAME (('1'<<24)+('G'<<16)+('S'<<8)+'P')
+
 struct DDS_PIXELFORMAT {
 	DWORD dwSize;
 	DWORD dwFlags;
@@ -177,6 +191,8 @@ class DXUtils
 public:
 	static DXGI_FORMAT GetFormatFromHeader(const DDS_HEADER& hdr) noexcept;
 	static const char* GetFormatAsString(DXGI_FORMAT fmt);
+	static bool IsSRGB(DXGI_FORMAT fmt) noexcept;
 
 	static bool GetParsedShaderData(const char* bytecode, size_t bytecodeLen, ParsedDXShaderData_t* outData);
+	static uint32_t StripShaderByteCode(char* const bytecode, const uint32_t bytecodeLen);
 };
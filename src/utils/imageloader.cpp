@@ -0,0 +1,306 @@
+//=============================================================================//
+//
+// Image loader for raw texture sources
+//
+//=============================================================================//
+#include "pch.h"
+#include "imageloader.h"
+#include "mappedfile.h"
+
+#include <wincodec.h>
+#include <wrl/client.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using Microsoft::WRL::ComPtr;
+
+#define TGA_HEADER_SIZE 18
+
+#define TGA_TYPE_TRUECOLOR 2
+#define TGA_TYPE_GRAYSCALE 3
+#define TGA_TYPE_RLE_TRUECOLOR 10
+#define TGA_TYPE_RLE_GRAYSCALE 11
+
+#define TGA_DESC_RIGHT_TO_LEFT (1 << 4)
+#define TGA_DESC_TOP_TO_BOTTOM (1 << 5)
+
+static void Image_DecodeTGAPixel(const uint8_t* const src, const uint32_t bytesPerPixel, uint8_t* const dest)
+{
+	switch (bytesPerPixel)
+	{
+	case 1:
+		dest[0] = src[0];
+		dest[1] = src[0];
+		dest[2] = src[0];
+		dest[3] = 255;
+		break;
+	case 3:
+		dest[0] = src[2];
+		dest[1] = src[1];
+		dest[2] = src[0];
+		dest[3] = 255;
+		break;
+	case 4:
+		dest[0] = src[2];
+		dest[1] = src[1];
+		dest[2] = src[0];
+		dest[3] = src[3];
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: decodes an uncompressed or run-length encoded TGA image
+//-----------------------------------------------------------------------------
+static bool Image_LoadTGA(const CMappedFile& file, const char* const filePath, ImageRGBA_s& image, std::string& error)
+{
+	if (!file.IsInRange(0, TGA_HEADER_SIZE))
+	{
+		error = Utils::VFormat("Image \"%s\" appears truncated; missing TGA header.\n", filePath);
+		return false;
+	}
+
+	const uint8_t* const data = reinterpret_cast<const uint8_t*>(file.GetData());
+
+	const uint8_t idLength = data[0];
+	const uint8_t colorMapType = data[1];
+	const uint8_t imageType = data[2];
+
+	const uint32_t width = data[12] | (data[13] << 8);
+	const uint32_t height = data[14] | (data[15] << 8);
+
+	const uint8_t bitsPerPixel = data[16];
+	const uint8_t descriptor = data[17];
+
+	if (colorMapType != 0)
+	{
+		error = Utils::VFormat("Image \"%s\" uses a color map, which is not supported.\n", filePath);
+		return false;
+	}
+
+	const bool isRLE = imageType == TGA_TYPE_RLE_TRUECOLOR || imageType == TGA_TYPE_RLE_GRAYSCALE;
+	const bool isGrayscale = imageType == TGA_TYPE_GRAYSCALE || imageType == TGA_TYPE_RLE_GRAYSCALE;
+
+	if (!isRLE && !isGrayscale && imageType != TGA_TYPE_TRUECOLOR)
+	{
+		error = Utils::VFormat("Image \"%s\" has unsupported TGA image type %hhu.\n", filePath, imageType);
+		return false;
+	}
+
+	if (isGrayscale ? (bitsPerPixel != 8) : (bitsPerPixel != 24 && bitsPerPixel != 32))
+	{
+		error = Utils::VFormat("Image \"%s\" has unsupported bit depth %hhu for TGA image type %hhu.\n", filePath, bitsPerPixel, imageType);
+		return false;
+	}
+
+	if (descriptor & TGA_DESC_RIGHT_TO_LEFT)
+	{
+		error = Utils::VFormat("Image \"%s\" is stored right to left, which is not supported.\n", filePath);
+		return false;
+	}
+
+	if (width == 0 || height == 0)
+	{
+		error = Utils::VFormat("Image \"%s\" has invalid dimensions %ux%u.\n", filePath, width, height);
+		return false;
+	}
+
+	const uint32_t bytesPerPixel = bitsPerPixel / 8;
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(pixelCount * 4);
+
+	size_t offset = TGA_HEADER_SIZE + idLength;
+	size_t pixelIndex = 0;
+
+	// Run-length encoded packets may cross scanlines, so the image is decoded
+	// as one continuous stream of pixels.
+	while (pixelIndex < pixelCount)
+	{
+		size_t runLength = 1;
+		bool isRun = false;
+
+		if (isRLE)
+		{
+			if (!file.IsInRange(offset, 1))
+			{
+				error = Utils::VFormat("Image \"%s\" appears truncated; pixel data ends at offset %zu.\n", filePath, offset);
+				return false;
+			}
+
+			const uint8_t packet = data[offset++];
+
+			runLength = (packet & 0x7F) + 1;
+			isRun = (packet & 0x80) != 0;
+
+			if (runLength > pixelCount - pixelIndex)
+			{
+				error = Utils::VFormat("Image \"%s\" has a run-length packet that exceeds the image bounds.\n", filePath);
+				return false;
+			}
+		}
+
+		const size_t readSize = isRun ? bytesPerPixel : (runLength * bytesPerPixel);
+
+		if (!file.IsInRange(offset, readSize))
+		{
+			error = Utils::VFormat("Image \"%s\" appears truncated; pixel data ends at offset %zu.\n", filePath, offset);
+			return false;
+		}
+
+		for (size_t i = 0; i < runLength; i++)
+		{
+			const uint8_t* const src = &data[offset + (isRun ? 0 : i * bytesPerPixel)];
+			Image_DecodeTGAPixel(src, bytesPerPixel, &image.pixels[(pixelIndex + i) * 4]);
+		}
+
+		offset += readSize;
+		pixelIndex += runLength;
+	}
+
+	// TGA images are stored bottom to top, unless flagged otherwise.
+	if (!(descriptor & TGA_DESC_TOP_TO_BOTTOM))
+	{
+		const size_t rowSize = static_cast<size_t>(width) * 4;
+
+		for (uint32_t y = 0; y < height / 2; y++)
+		{
+			uint8_t* const top = &image.pixels[y * rowSize];
+			uint8_t* const bottom = &image.pixels[(height - 1 - y) * rowSize];
+
+			std::swap_ranges(top, top + rowSize, bottom);
+		}
+	}
+
+	return true;
+}
+
+// COM has to be initialized on every thread that uses WIC, worker threads
+// join the multithreaded apartment the first time they decode an image and
+// leave it again when they exit. Each thread creates its own factory so it
+// is always released before the apartment is left.
+struct ImageThreadWIC_s
+{
+	ImageThreadWIC_s()
+		: initResult(CoInitializeEx(nullptr, COINIT_MULTITHREADED))
+	{
+		// The thread may already be initialized in a different mode, which
+		// is fine as the factory is free threaded.
+		if (SUCCEEDED(initResult) || initResult == RPC_E_CHANGED_MODE)
+		{
+			if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))))
+				factory.Reset();
+		}
+	}
+
+	~ImageThreadWIC_s()
+	{
+		factory.Reset();
+
+		// A failed call, including RPC_E_CHANGED_MODE, did not increment the
+		// initialization count of the thread.
+		if (SUCCEEDED(initResult))
+			CoUninitialize();
+	}
+
+	HRESULT initResult;
+	ComPtr<IWICImagingFactory> factory;
+};
+
+static IWICImagingFactory* Image_GetWICFactory()
+{
+	thread_local ImageThreadWIC_s s_threadWIC;
+	return s_threadWIC.factory.Get();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: initializes the image decoders on the calling thread
+// Output : false if WIC could not be initialized
+//-----------------------------------------------------------------------------
+bool Image_InitDecoders()
+{
+	return Image_GetWICFactory() != nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: decodes the first frame of the image through WIC
+//-----------------------------------------------------------------------------
+static bool Image_LoadWIC(const CMappedFile& file, const char* const filePath, ImageRGBA_s& image, std::string& error)
+{
+	IWICImagingFactory* const factory = Image_GetWICFactory();
+
+	if (!factory)
+	{
+		error = Utils::VFormat("Failed to initialize the Windows Imaging Component for image \"%s\".\n", filePath);
+		return false;
+	}
+
+	if (file.GetSize() > UINT32_MAX)
+	{
+		error = Utils::VFormat("Image \"%s\" is too large ( file size = %zu ).\n", filePath, file.GetSize());
+		return false;
+	}
+
+	ComPtr<IWICStream> stream;
+	ComPtr<IWICBitmapDecoder> decoder;
+	ComPtr<IWICBitmapFrameDecode> frame;
+	ComPtr<IWICFormatConverter> converter;
+
+	UINT width = 0;
+	UINT height = 0;
+
+	if (FAILED(factory->CreateStream(&stream))
+		|| FAILED(stream->InitializeFromMemory(reinterpret_cast<BYTE*>(const_cast<char*>(file.GetData())), static_cast<DWORD>(file.GetSize())))
+		|| FAILED(factory->CreateDecoderFromStream(stream.Get(), nullptr, WICDecodeMetadataCacheOnDemand, &decoder))
+		|| FAILED(decoder->GetFrame(0, &frame))
+		|| FAILED(frame->GetSize(&width, &height)))
+	{
+		error = Utils::VFormat("Failed to decode image \"%s\".\n", filePath);
+		return false;
+	}
+
+	if (width == 0 || height == 0)
+	{
+		error = Utils::VFormat("Image \"%s\" has invalid dimensions %ux%u.\n", filePath, width, height);
+		return false;
+	}
+
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	if (FAILED(factory->CreateFormatConverter(&converter))
+		|| FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom))
+		|| FAILED(converter->CopyPixels(nullptr, width * 4, static_cast<UINT>(image.pixels.size()), image.pixels.data())))
+	{
+		error = Utils::VFormat("Failed to convert image \"%s\" to RGBA.\n", filePath);
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: loads the image and converts it to RGBA8
+// Input  : &filePath - 
+//          &image - 
+//          &error - 
+// Output : true if the image was loaded
+//-----------------------------------------------------------------------------
+bool Image_LoadRGBA(const std::string& filePath, ImageRGBA_s& image, std::string& error)
+{
+	CMappedFile file;
+
+	if (!file.Open(filePath))
+		return false;
+
+	const char* const pFilePath = filePath.c_str();
+	const size_t extPos = filePath.rfind('.');
+
+	if (extPos != std::string::npos && _stricmp(&pFilePath[extPos], ".tga") == 0)
+		return Image_LoadTGA(file, pFilePath, image, error);
+
+	return Image_LoadWIC(file, pFilePath, image, error);
+}
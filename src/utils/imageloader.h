@@ -0,0 +1,22 @@
+#pragma once
+
+// Uncompressed 32 bit RGBA image, rows are stored top to bottom.
+struct ImageRGBA_s
+{
+	std::vector<uint8_t> pixels;
+
+	uint32_t width;
+	uint32_t height;
+};
+
+// Initializes the decoders on the calling thread, call this before loading
+// images in parallel to report a missing WIC installation once. Returns false
+// if WIC could not be initialized.
+extern bool Image_InitDecoders();
+
+// Loads the image and converts it to RGBA8. TGA files are decoded directly,
+// all other formats (PNG, BMP, etc) are decoded through WIC. Returns false if
+// the file could not be opened, in which case the error is left empty, or if
+// the file could not be decoded, in which case the error describes why. Safe
+// to call from worker threads as it never exits the process.
+extern bool Image_LoadRGBA(const std::string& filePath, ImageRGBA_s& image, std::string& error);
@@ -5,15 +5,83 @@
 //===========================================================================//
 #include "pch.h"
 #include "jsonutils.h"
+#include "mappedfile.h"
+#include <atomic>
+#include <mutex>
+
+// A cached document owns the pool its values and the in-situ parsed file data
+// are allocated from, so it must not move once parsed.
+struct JSONCachedDocument_s
+{
+    JSONCachedDocument_s(const size_t chunkCapacity)
+        : allocator(chunkCapacity)
+        , document(&allocator)
+    {}
+
+    rapidjson::MemoryPoolAllocator<> allocator;
+    rapidjson::Document document;
+};
+
+// Documents are keyed by their file path, files that don't exist are cached as
+// null so optional files aren't looked up over and over again.
+static std::unordered_map<std::string, std::unique_ptr<const JSONCachedDocument_s>> s_jsonDocumentCache;
+static std::mutex s_jsonDocumentCacheMutex;
+
+// Parse statistics since the last JSON_LogParseStats.
+static std::atomic<size_t> s_jsonParseCount(0);
+static std::atomic<size_t> s_jsonParseBytes(0);
+static std::atomic<int64_t> s_jsonParseTimeNs(0);
+static std::atomic<size_t> s_jsonCacheHits(0);
 
 //-----------------------------------------------------------------------------
-// Purpose: parsing a json file from stream.
+// Purpose: parses the mapped file in-situ, the file data is copied into the
+//          allocator of the document so its strings can be referenced directly.
+//-----------------------------------------------------------------------------
+static bool JSON_ParseMappedFile(const CMappedFile& file, const char* const debugName, rapidjson::Document& document)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const size_t fileSize = file.GetSize();
+
+    char* const buf = static_cast<char*>(document.GetAllocator().Malloc(fileSize + 1));
+
+    if (fileSize)
+        memcpy(buf, file.GetData(), fileSize);
+
+    buf[fileSize] = '\0';
+
+    const bool hasParseError = document.ParseInsitu(buf).HasParseError();
+    const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+    s_jsonParseCount++;
+    s_jsonParseBytes += fileSize;
+    s_jsonParseTimeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+
+    if (hasParseError)
+    {
+        g_jsonErrorCallback("%s: %s parse error at position %zu: [%s].\n", __FUNCTION__, debugName,
+            document.GetErrorOffset(), rapidjson::GetParseError_En(document.GetParseError()));
+
+        return false;
+    }
+
+    if (!document.IsObject())
+    {
+        g_jsonErrorCallback("%s: %s root was not an object.\n", __FUNCTION__, debugName);
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: parsing a json file, the whole file is read at once and parsed
+//          in-situ into memory owned by the document.
 //-----------------------------------------------------------------------------
 bool JSON_ParseFromFile(const char* const assetPath, const char* const debugName, rapidjson::Document& document, const bool mandatory)
 {
-    std::ifstream ifs(assetPath);
+    CMappedFile file;
 
-    if (!ifs)
+    if (!file.Open(assetPath))
     {
         // Note: mandatory only prevents the error if the file doesn't exist,
         // if there are parsing or validation problems, we will still error as
@@ -24,23 +92,87 @@ bool JSON_ParseFromFile(const char* const assetPath, const char* const debugName
         return false;
     }
 
-    rapidjson::IStreamWrapper jsonStreamWrapper(ifs);
+    return JSON_ParseMappedFile(file, debugName, document);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: returns the parsed json file from the document cache, parsing it if
+//          it wasn't requested before. Returns null if the file couldn't be
+//          opened or parsed, same error rules as JSON_ParseFromFile apply.
+//-----------------------------------------------------------------------------
+const rapidjson::Document* JSON_GetCachedDocument(const char* const assetPath, const char* const debugName, const bool mandatory)
+{
+    const std::string filePath(assetPath);
 
-    if (document.ParseStream(jsonStreamWrapper).HasParseError())
     {
-        g_jsonErrorCallback("%s: %s parse error at position %zu: [%s].\n", __FUNCTION__, debugName,
-            document.GetErrorOffset(), rapidjson::GetParseError_En(document.GetParseError()));
+        std::lock_guard<std::mutex> lock(s_jsonDocumentCacheMutex);
+        const auto it = s_jsonDocumentCache.find(filePath);
 
-        return false;
+        if (it != s_jsonDocumentCache.end())
+        {
+            s_jsonCacheHits++;
+
+            if (it->second)
+                return &it->second->document;
+
+            if (mandatory)
+                g_jsonErrorCallback("%s: couldn't open %s file.\n", __FUNCTION__, debugName);
+
+            return nullptr;
+        }
     }
 
-    if (!document.IsObject())
+    CMappedFile file;
+    std::unique_ptr<JSONCachedDocument_s> cached;
+
+    if (file.Open(filePath))
     {
-        g_jsonErrorCallback("%s: %s root was not an object.\n", __FUNCTION__, debugName);
-        return false;
+        // Size the pool such that most documents fit in a single chunk, as
+        // the file data and its values are both allocated from it.
+        const size_t chunkCapacity = max(file.GetSize() * 3, size_t(RAPIDJSON_ALLOCATOR_DEFAULT_CHUNK_CAPACITY));
+        cached = std::make_unique<JSONCachedDocument_s>(chunkCapacity);
+
+        // Parse errors aren't cached, these are reported again if the file
+        // gets requested again.
+        if (!JSON_ParseMappedFile(file, debugName, cached->document))
+            return nullptr;
     }
+    else if (mandatory)
+        g_jsonErrorCallback("%s: couldn't open %s file.\n", __FUNCTION__, debugName);
 
-    return true;
+    std::lock_guard<std::mutex> lock(s_jsonDocumentCacheMutex);
+
+    // If another thread parsed it in the meantime, use that one as it might
+    // already be referenced.
+    const auto it = s_jsonDocumentCache.try_emplace(filePath, std::move(cached));
+    return it.first->second ? &it.first->second->document : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: releases all cached documents, previously returned documents must
+//          no longer be referenced.
+//-----------------------------------------------------------------------------
+void JSON_ClearDocumentCache()
+{
+    std::lock_guard<std::mutex> lock(s_jsonDocumentCacheMutex);
+    s_jsonDocumentCache.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: logs the time spent parsing json files since the last call.
+//-----------------------------------------------------------------------------
+void JSON_LogParseStats()
+{
+    if (s_jsonParseCount)
+    {
+        Log("*** parsed %zu json files ( %.2f KiB ) in %.3f ms; %zu were reused from the document cache.\n",
+            s_jsonParseCount.load(), s_jsonParseBytes / 1024.0, s_jsonParseTimeNs / 1000000.0, s_jsonCacheHits.load());
+    }
+
+    s_jsonParseCount = 0;
+    s_jsonParseBytes = 0;
+    s_jsonParseTimeNs = 0;
+    s_jsonCacheHits = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -510,6 +510,12 @@ inline V JSON_GetNumberRequired(const T& data, typename T::StringRefType member)
 }
 
 bool JSON_ParseFromFile(const char* const assetPath, const char* const debugName, rapidjson::Document& document, const bool mandatory);
+
+// Documents are cached by path until JSON_ClearDocumentCache is called, these
+// are shared and must not be modified.
+const rapidjson::Document* JSON_GetCachedDocument(const char* const assetPath, const char* const debugName, const bool mandatory);
+void JSON_ClearDocumentCache();
+void JSON_LogParseStats();
 void JSON_DocumentToBufferDeserialize(const rapidjson::Document& document, rapidjson::StringBuffer& buffer, unsigned int indent = 4);
 
 #endif // JSONUTILS_H
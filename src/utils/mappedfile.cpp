@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "mappedfile.h"
+
+CMappedFile::CMappedFile()
+	: m_fileHandle(INVALID_HANDLE_VALUE)
+	, m_mapHandle(NULL)
+	, m_data(nullptr)
+	, m_size(0)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: opens and maps the entire file
+// Input  : *filePath - 
+// Output : true if operation is successful
+//-----------------------------------------------------------------------------
+bool CMappedFile::Open(const char* const filePath)
+{
+	Close();
+
+	m_fileHandle = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(m_fileHandle, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	// Empty files cannot be mapped, but are valid.
+	if (!m_size)
+		return true;
+
+	m_mapHandle = CreateFileMappingA(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (!m_mapHandle)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = reinterpret_cast<const char*>(MapViewOfFile(m_mapHandle, FILE_MAP_READ, 0, 0, 0));
+
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: unmaps and closes the file
+//-----------------------------------------------------------------------------
+void CMappedFile::Close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+
+	if (m_mapHandle)
+	{
+		CloseHandle(m_mapHandle);
+		m_mapHandle = NULL;
+	}
+
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_fileHandle);
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+
+	m_size = 0;
+}
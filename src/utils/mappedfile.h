@@ -0,0 +1,37 @@
+#pragma once
+
+// Read-only view of an entire file, mapped into memory. Reading from the view
+// avoids copying through intermediate stream buffers.
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	CMappedFile(const CMappedFile&) = delete;
+	CMappedFile& operator=(const CMappedFile&) = delete;
+
+	bool Open(const char* const filePath);
+	inline bool Open(const std::string& filePath) { return Open(filePath.c_str()); };
+
+	void Close();
+
+	// Empty files are open, but have no data.
+	inline bool IsOpen() const { return m_fileHandle != INVALID_HANDLE_VALUE; };
+
+	inline const char* GetData() const { return m_data; };
+	inline size_t GetSize() const { return m_size; };
+
+	// Returns true if the range [offset, offset+size) lies within the file.
+	inline bool IsInRange(const size_t offset, const size_t size) const
+	{
+		return offset <= m_size && size <= (m_size - offset);
+	}
+
+private:
+	HANDLE m_fileHandle;
+	HANDLE m_mapHandle;
+
+	const char* m_data;
+	size_t m_size;
+};
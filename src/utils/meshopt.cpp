@@ -0,0 +1,245 @@
+//=============================================================================//
+//
+// Triangle and vertex order optimization for vertex caches
+//
+//=============================================================================//
+#include "pch.h"
+#include "meshopt.h"
+
+// Parameters of the vertex scoring function, as tuned by Tom Forsyth in his
+// "Linear-Speed Vertex Cache Optimisation" paper.
+#define MESHOPT_FORSYTH_CACHE_SIZE 32
+#define MESHOPT_FORSYTH_CACHE_DECAY_POWER 1.5f
+#define MESHOPT_FORSYTH_LAST_TRI_SCORE 0.75f
+#define MESHOPT_FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define MESHOPT_FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+#define MESHOPT_INVALID_INDEX UINT32_MAX
+
+float MeshOpt_ComputeACMR(const uint16_t* const indices, const size_t indexCount, const size_t cacheSize)
+{
+	const size_t triCount = indexCount / 3;
+
+	if (!triCount)
+		return 0.0f;
+
+	// Timestamp of the last time each vertex was transformed, a vertex is in
+	// the FIFO as long as fewer than cacheSize vertices were transformed since.
+	std::vector<size_t> transformedAt(UINT16_MAX + 1, SIZE_MAX);
+	size_t misses = 0;
+
+	for (size_t i = 0; i < triCount * 3; i++)
+	{
+		size_t& timestamp = transformedAt[indices[i]];
+
+		if (timestamp == SIZE_MAX || (misses - timestamp) >= cacheSize)
+		{
+			timestamp = misses;
+			misses++;
+		}
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(triCount);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: scores a vertex by its position in the cache and the number of
+//          triangles that still need it
+//-----------------------------------------------------------------------------
+static float MeshOpt_ScoreVertex(const int cachePos, const uint32_t activeTriCount)
+{
+	if (activeTriCount == 0)
+		return -1.0f; // No triangles left, never pick this vertex.
+
+	float score = 0.0f;
+
+	if (cachePos >= 0)
+	{
+		// The vertices of the last triangle get a fixed score, so the next
+		// triangle doesn't favour a particular edge of it.
+		if (cachePos < 3)
+			score = MESHOPT_FORSYTH_LAST_TRI_SCORE;
+		else
+		{
+			const float scaler = 1.0f / (MESHOPT_FORSYTH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePos - 3) * scaler, MESHOPT_FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	// Boost vertices with few triangles left, to get rid of lone triangles
+	// before they end up costing a cache miss later on.
+	score += MESHOPT_FORSYTH_VALENCE_BOOST_SCALE * powf(static_cast<float>(activeTriCount), -MESHOPT_FORSYTH_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+void MeshOpt_OptimizeVertexCache(uint16_t* const indices, const size_t indexCount, const size_t vertexCount)
+{
+	const size_t triCount = indexCount / 3;
+
+	if (triCount < 2)
+		return;
+
+	// Triangles that use each vertex, the first activeTriCount entries in the
+	// range of a vertex are the triangles that haven't been emitted yet.
+	std::vector<uint32_t> vertexTriOffsets(vertexCount + 1, 0);
+	std::vector<uint32_t> vertexActiveTriCount(vertexCount, 0);
+
+	for (size_t i = 0; i < triCount * 3; i++)
+		vertexActiveTriCount[indices[i]]++;
+
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexTriOffsets[v + 1] = vertexTriOffsets[v] + vertexActiveTriCount[v];
+
+	std::vector<uint32_t> vertexTris(triCount * 3);
+	std::vector<uint32_t> fillCount(vertexCount, 0);
+
+	for (size_t i = 0; i < triCount * 3; i++)
+	{
+		const uint16_t v = indices[i];
+		vertexTris[vertexTriOffsets[v] + fillCount[v]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<float> vertexScore(vertexCount);
+
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = MeshOpt_ScoreVertex(-1, vertexActiveTriCount[v]);
+
+	std::vector<float> triScore(triCount);
+	std::vector<bool> triEmitted(triCount, false);
+
+	uint32_t bestTri = 0;
+
+	for (size_t t = 0; t < triCount; t++)
+	{
+		triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+		if (triScore[t] > triScore[bestTri])
+			bestTri = static_cast<uint32_t>(t);
+	}
+
+	std::vector<uint16_t> output;
+	output.reserve(triCount * 3);
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+
+	cache.reserve(MESHOPT_FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(MESHOPT_FORSYTH_CACHE_SIZE + 3);
+
+	size_t deadEndCursor = 0;
+
+	for (size_t emitted = 0; emitted < triCount; emitted++)
+	{
+		// Nothing in the cache is connected to any remaining triangle, take
+		// the next one in input order instead of scanning all of them.
+		if (bestTri == MESHOPT_INVALID_INDEX)
+		{
+			while (triEmitted[deadEndCursor])
+				deadEndCursor++;
+
+			bestTri = static_cast<uint32_t>(deadEndCursor);
+		}
+
+		const uint16_t* const tri = &indices[bestTri * 3];
+		triEmitted[bestTri] = true;
+
+		newCache.clear();
+
+		for (int c = 0; c < 3; c++)
+		{
+			const uint16_t v = tri[c];
+			output.push_back(v);
+
+			// Remove the triangle from the active set of the vertex.
+			uint32_t* const tris = &vertexTris[vertexTriOffsets[v]];
+			const uint32_t activeCount = vertexActiveTriCount[v];
+
+			for (uint32_t i = 0; i < activeCount; i++)
+			{
+				if (tris[i] == bestTri)
+				{
+					std::swap(tris[i], tris[activeCount - 1]);
+					vertexActiveTriCount[v]--;
+
+					break;
+				}
+			}
+
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+		}
+
+		for (const uint32_t v : cache)
+		{
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+		}
+
+		// Rescore every vertex whose cache position changed, including the
+		// ones that fell out, and propagate the change to their triangles.
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			const uint32_t v = newCache[i];
+			const int cachePos = i < MESHOPT_FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+			const float score = MeshOpt_ScoreVertex(cachePos, vertexActiveTriCount[v]);
+			const float delta = score - vertexScore[v];
+
+			vertexScore[v] = score;
+
+			const uint32_t* const tris = &vertexTris[vertexTriOffsets[v]];
+
+			for (uint32_t j = 0; j < vertexActiveTriCount[v]; j++)
+				triScore[tris[j]] += delta;
+		}
+
+		if (newCache.size() > MESHOPT_FORSYTH_CACHE_SIZE)
+			newCache.resize(MESHOPT_FORSYTH_CACHE_SIZE);
+
+		cache.swap(newCache);
+
+		// The next triangle is the best one among those that use a vertex
+		// that is currently in the cache.
+		bestTri = MESHOPT_INVALID_INDEX;
+		float bestScore = -1.0f;
+
+		for (const uint32_t v : cache)
+		{
+			const uint32_t* const tris = &vertexTris[vertexTriOffsets[v]];
+
+			for (uint32_t j = 0; j < vertexActiveTriCount[v]; j++)
+			{
+				if (triScore[tris[j]] > bestScore)
+				{
+					bestScore = triScore[tris[j]];
+					bestTri = tris[j];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output.data(), output.size() * sizeof(uint16_t));
+}
+
+void MeshOpt_OptimizeVertexFetch(uint16_t* const indices, const size_t indexCount, const size_t vertexCount, std::vector<uint32_t>& remap)
+{
+	remap.assign(vertexCount, MESHOPT_INVALID_INDEX);
+	uint32_t nextVertex = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t& newIndex = remap[indices[i]];
+
+		if (newIndex == MESHOPT_INVALID_INDEX)
+			newIndex = nextVertex++;
+
+		indices[i] = static_cast<uint16_t>(newIndex);
+	}
+
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == MESHOPT_INVALID_INDEX)
+			remap[v] = nextVertex++;
+	}
+}
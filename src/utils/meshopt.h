@@ -0,0 +1,20 @@
+#pragma once
+
+// Size of the FIFO cache that is simulated to compute the ACMR.
+#define MESHOPT_ACMR_CACHE_SIZE 16
+
+// Returns the average cache miss ratio of the triangle list, which is the
+// number of vertex shader invocations per triangle with a FIFO post-transform
+// cache of the given size. Ranges from 0.5 (best) to 3.0 (worst).
+extern float MeshOpt_ComputeACMR(const uint16_t* const indices, const size_t indexCount, const size_t cacheSize = MESHOPT_ACMR_CACHE_SIZE);
+
+// Reorders the triangles of the list in place to improve the post-transform
+// vertex cache hit rate, using Tom Forsyth's linear-speed algorithm. Indices
+// must be below vertexCount.
+extern void MeshOpt_OptimizeVertexCache(uint16_t* const indices, const size_t indexCount, const size_t vertexCount);
+
+// Builds a vertex remap table that orders the vertices by first use in the
+// triangle list, which improves vertex fetch locality. Vertices that aren't
+// referenced are moved to the end in their original order. The indices are
+// rewritten in place, remap[oldIndex] holds the new index of each vertex.
+extern void MeshOpt_OptimizeVertexFetch(uint16_t* const indices, const size_t indexCount, const size_t vertexCount, std::vector<uint32_t>& remap);
@@ -0,0 +1,295 @@
+//=============================================================================//
+//
+// Mip chain generation for raw texture sources
+//
+//=============================================================================//
+#include "pch.h"
+#include "mipgen.h"
+#include "parallel.h"
+
+// Radius of the Kaiser filter in destination pixels, and its window shape.
+#define MIP_KAISER_RADIUS 3.0f
+#define MIP_KAISER_ALPHA 4.0f
+
+struct MipFilterTap_s
+{
+	uint32_t index;
+	float weight;
+};
+
+// Linear space RGBA image, each level is filtered in this space.
+struct MipLinearImage_s
+{
+	std::vector<float> pixels;
+
+	uint32_t width;
+	uint32_t height;
+};
+
+bool Mip_ParseFilter(const char* const name, MipFilter_e& filter)
+{
+	if (_stricmp(name, "box") == 0)
+		filter = MipFilter_e::Box;
+	else if (_stricmp(name, "kaiser") == 0)
+		filter = MipFilter_e::Kaiser;
+	else
+		return false;
+
+	return true;
+}
+
+uint32_t Mip_GetFullChainCount(const uint32_t width, const uint32_t height)
+{
+	uint32_t size = (std::max)(width, height);
+	uint32_t count = 1;
+
+	while (size > 1)
+	{
+		size >>= 1;
+		count++;
+	}
+
+	return count;
+}
+
+static const float* Mip_GetSRGBToLinearTable()
+{
+	static const std::array<float, 256> s_table = []()
+	{
+		std::array<float, 256> table;
+
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			const float value = i / 255.0f;
+			table[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		return table;
+	}();
+
+	return s_table.data();
+}
+
+static inline uint8_t Mip_QuantizeUnorm(const float value)
+{
+	return static_cast<uint8_t>((std::max)(0.0f, (std::min)(1.0f, value)) * 255.0f + 0.5f);
+}
+
+static inline uint8_t Mip_LinearToSRGB(const float value)
+{
+	const float clamped = (std::max)(0.0f, (std::min)(1.0f, value));
+	const float encoded = clamped <= 0.0031308f ? clamped * 12.92f : 1.055f * powf(clamped, 1.0f / 2.4f) - 0.055f;
+
+	return Mip_QuantizeUnorm(encoded);
+}
+
+// Zeroth order modified Bessel function of the first kind.
+static float Mip_BesselI0(const float x)
+{
+	const float halfX2 = (x * 0.5f) * (x * 0.5f);
+
+	float sum = 1.0f;
+	float term = 1.0f;
+
+	for (int k = 1; k < 32; k++)
+	{
+		term *= halfX2 / static_cast<float>(k * k);
+		sum += term;
+
+		if (term < sum * 1e-8f)
+			break;
+	}
+
+	return sum;
+}
+
+static float Mip_KaiserWeight(const float t)
+{
+	const float x = t / MIP_KAISER_RADIUS;
+
+	if (fabsf(x) >= 1.0f)
+		return 0.0f;
+
+	const float window = Mip_BesselI0(MIP_KAISER_ALPHA * sqrtf(1.0f - x * x)) / Mip_BesselI0(MIP_KAISER_ALPHA);
+
+	if (t == 0.0f)
+		return window;
+
+	const float piT = 3.14159265358979f * t;
+	return (sinf(piT) / piT) * window;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: builds the taps of every destination pixel along one axis, the
+//          weights of each pixel are normalized
+//-----------------------------------------------------------------------------
+static void Mip_BuildFilterAxis(const uint32_t srcSize, const uint32_t dstSize, const MipFilter_e filter,
+	std::vector<std::vector<MipFilterTap_s>>& axis)
+{
+	const float scale = static_cast<float>(srcSize) / static_cast<float>(dstSize);
+	axis.resize(dstSize);
+
+	for (uint32_t d = 0; d < dstSize; d++)
+	{
+		std::vector<MipFilterTap_s>& taps = axis[d];
+		float totalWeight = 0.0f;
+
+		if (filter == MipFilter_e::Box)
+		{
+			const float start = d * scale;
+			const float end = (d + 1) * scale;
+
+			const uint32_t first = static_cast<uint32_t>(floorf(start));
+			const uint32_t last = (std::min)(static_cast<uint32_t>(ceilf(end)), srcSize);
+
+			for (uint32_t i = first; i < last; i++)
+			{
+				const float weight = (std::min)(static_cast<float>(i + 1), end) - (std::max)(static_cast<float>(i), start);
+
+				if (weight <= 0.0f)
+					continue;
+
+				taps.push_back({ i, weight });
+				totalWeight += weight;
+			}
+		}
+		else
+		{
+			const float center = (d + 0.5f) * scale;
+			const float radius = MIP_KAISER_RADIUS * scale;
+
+			const int first = static_cast<int>(floorf(center - radius));
+			const int last = static_cast<int>(ceilf(center + radius));
+
+			for (int i = first; i <= last; i++)
+			{
+				const float weight = Mip_KaiserWeight((i + 0.5f - center) / scale);
+
+				if (weight == 0.0f)
+					continue;
+
+				// Repeat the edge pixels for taps that exceed the image.
+				const uint32_t index = static_cast<uint32_t>((std::max)(0, (std::min)(i, static_cast<int>(srcSize) - 1)));
+
+				taps.push_back({ index, weight });
+				totalWeight += weight;
+			}
+		}
+
+		for (MipFilterTap_s& tap : taps)
+			tap.weight /= totalWeight;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: resamples the image to the destination size using a separable
+//          filter, the rows of each pass are spread across all cores
+//-----------------------------------------------------------------------------
+static void Mip_Resample(const MipLinearImage_s& src, MipLinearImage_s& dst, const MipFilter_e filter)
+{
+	std::vector<std::vector<MipFilterTap_s>> axisX;
+	std::vector<std::vector<MipFilterTap_s>> axisY;
+
+	Mip_BuildFilterAxis(src.width, dst.width, filter, axisX);
+	Mip_BuildFilterAxis(src.height, dst.height, filter, axisY);
+
+	// Horizontal pass, from src into an image that is only resized in width.
+	std::vector<float> temp(static_cast<size_t>(dst.width) * src.height * 4);
+
+	Parallel_For(src.height, [&](const size_t y)
+	{
+		const float* const srcRow = &src.pixels[y * src.width * 4];
+		float* const tempRow = &temp[y * dst.width * 4];
+
+		for (uint32_t x = 0; x < dst.width; x++)
+		{
+			float sum[4] = {};
+
+			for (const MipFilterTap_s& tap : axisX[x])
+			{
+				for (int c = 0; c < 4; c++)
+					sum[c] += srcRow[tap.index * 4 + c] * tap.weight;
+			}
+
+			memcpy(&tempRow[x * 4], sum, sizeof(sum));
+		}
+	});
+
+	dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+	// Vertical pass, from the intermediate image into dst.
+	Parallel_For(dst.height, [&](const size_t y)
+	{
+		float* const dstRow = &dst.pixels[y * dst.width * 4];
+		memset(dstRow, 0, dst.width * 4 * sizeof(float));
+
+		for (const MipFilterTap_s& tap : axisY[y])
+		{
+			const float* const tempRow = &temp[static_cast<size_t>(tap.index) * dst.width * 4];
+
+			for (uint32_t i = 0; i < dst.width * 4; i++)
+				dstRow[i] += tempRow[i] * tap.weight;
+		}
+	});
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: generates the mip chain of the base image
+//-----------------------------------------------------------------------------
+void Mip_GenerateChain(const ImageRGBA_s& base, const uint32_t mipCount, const bool isSRGB,
+	const MipFilter_e filter, std::vector<ImageRGBA_s>& outMips)
+{
+	assert(mipCount > 0);
+	outMips.resize(mipCount - 1);
+
+	if (mipCount == 1)
+		return;
+
+	const float* const srgbToLinear = Mip_GetSRGBToLinearTable();
+
+	MipLinearImage_s current;
+	current.width = base.width;
+	current.height = base.height;
+	current.pixels.resize(base.pixels.size());
+
+	Parallel_For(base.height, [&](const size_t y)
+	{
+		const size_t rowStart = y * base.width * 4;
+
+		for (size_t i = rowStart; i < rowStart + base.width * 4; i++)
+		{
+			// Alpha is always linear.
+			const bool isColor = (i & 3) != 3;
+			current.pixels[i] = (isSRGB && isColor) ? srgbToLinear[base.pixels[i]] : base.pixels[i] / 255.0f;
+		}
+	});
+
+	// Each level is filtered from the previous one, which keeps the filter
+	// footprint small while still covering the whole area of the base level.
+	for (uint32_t level = 1; level < mipCount; level++)
+	{
+		MipLinearImage_s next;
+		next.width = (std::max)(1u, base.width >> level);
+		next.height = (std::max)(1u, base.height >> level);
+
+		Mip_Resample(current, next, filter);
+
+		ImageRGBA_s& mip = outMips[level - 1];
+		mip.width = next.width;
+		mip.height = next.height;
+		mip.pixels.resize(static_cast<size_t>(next.width) * next.height * 4);
+
+		Parallel_For(next.height, [&](const size_t y)
+		{
+			const size_t rowStart = y * next.width * 4;
+
+			for (size_t i = rowStart; i < rowStart + next.width * 4; i++)
+			{
+				const bool isColor = (i & 3) != 3;
+				mip.pixels[i] = (isSRGB && isColor) ? Mip_LinearToSRGB(next.pixels[i]) : Mip_QuantizeUnorm(next.pixels[i]);
+			}
+		});
+
+		current = std::move(next);
+	}
+}
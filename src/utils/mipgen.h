@@ -0,0 +1,20 @@
+#pragma once
+#include "imageloader.h"
+
+enum class MipFilter_e
+{
+	Box = 0, // Area average, fast and free of ringing.
+	Kaiser   // Kaiser windowed sinc, sharper but may ring around hard edges.
+};
+
+extern bool Mip_ParseFilter(const char* const name, MipFilter_e& filter);
+
+// Returns the number of levels in the full chain down to 1x1, including the
+// base level.
+extern uint32_t Mip_GetFullChainCount(const uint32_t width, const uint32_t height);
+
+// Generates levels 1 to mipCount-1 of the chain, each level being half the
+// size of the previous one. Filtering is done in linear space, if isSRGB is
+// set the color channels are converted from and back to sRGB.
+extern void Mip_GenerateChain(const ImageRGBA_s& base, const uint32_t mipCount, const bool isSRGB,
+	const MipFilter_e filter, std::vector<ImageRGBA_s>& outMips);
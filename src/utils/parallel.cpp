@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "parallel.h"
+#include <thread>
+#include <atomic>
+
+//-----------------------------------------------------------------------------
+// Purpose: returns the number of workers to use by default
+//-----------------------------------------------------------------------------
+size_t Parallel_GetDefaultWorkerCount()
+{
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+
+	// Can return 0 if it can't be determined.
+	return hardwareThreads ? hardwareThreads : 1;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: runs func for every index in [0, count) across multiple threads
+// Input  : count - 
+//			&func - 
+//			workerCount - 0 for default
+//-----------------------------------------------------------------------------
+void Parallel_For(const size_t count, const std::function<void(const size_t)>& func, const size_t workerCount)
+{
+	if (!count)
+		return;
+
+	const size_t numWorkers = (std::min)(count, workerCount ? workerCount : Parallel_GetDefaultWorkerCount());
+
+	// Not worth spinning up threads for.
+	if (numWorkers <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i);
+
+		return;
+	}
+
+	std::atomic<size_t> nextIndex(0);
+
+	const auto workerFunc = [&]()
+	{
+		for (size_t i = nextIndex++; i < count; i = nextIndex++)
+			func(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(numWorkers - 1);
+
+	for (size_t i = 0; i < numWorkers - 1; i++)
+		threads.emplace_back(workerFunc);
+
+	workerFunc();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
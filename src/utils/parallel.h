@@ -0,0 +1,11 @@
+#pragma once
+#include <functional>
+
+// Returns the number of workers to use when no explicit count is given, this
+// is the number of hardware threads available on this machine.
+extern size_t Parallel_GetDefaultWorkerCount();
+
+// Runs func for every index in [0, count) on up to workerCount threads, the
+// calling thread is one of them. Returns once all indices have been processed.
+// Indices are handed out in ascending order, but may complete in any order.
+extern void Parallel_For(const size_t count, const std::function<void(const size_t)>& func, const size_t workerCount = 0);
@@ -0,0 +1,197 @@
+//=============================================================================//
+//
+// Rectangle bin packing for texture atlases
+//
+//=============================================================================//
+#include "pch.h"
+#include "rectpacker.h"
+
+// Horizontal segment of the skyline, the area below it is considered full.
+struct SkylineNode_s
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: returns the lowest height at which a rectangle of the given width
+//          can rest on the skyline starting at node index, or UINT32_MAX if it
+//          would stick out of the bin
+//-----------------------------------------------------------------------------
+static uint32_t RectPack_FitSkyline(const std::vector<SkylineNode_s>& skyline, const size_t index, const uint32_t width, const uint32_t binWidth)
+{
+	if (skyline[index].x + width > binWidth)
+		return UINT32_MAX;
+
+	uint32_t y = 0;
+	int64_t widthLeft = width;
+
+	for (size_t i = index; widthLeft > 0; i++)
+	{
+		y = (std::max)(y, skyline[i].y);
+		widthLeft -= skyline[i].width;
+	}
+
+	return y;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: raises the skyline under the newly placed rectangle
+//-----------------------------------------------------------------------------
+static void RectPack_AddSkylineLevel(std::vector<SkylineNode_s>& skyline, const size_t index, const PackRect_s& rect)
+{
+	skyline.insert(skyline.begin() + index, { rect.x, rect.y + rect.height, rect.width });
+
+	// Shrink or remove the nodes that are now covered by the new one.
+	for (size_t i = index + 1; i < skyline.size();)
+	{
+		const SkylineNode_s& prev = skyline[i - 1];
+		SkylineNode_s& node = skyline[i];
+
+		const uint32_t prevEnd = prev.x + prev.width;
+
+		if (node.x >= prevEnd)
+			break;
+
+		const uint32_t shrink = prevEnd - node.x;
+
+		if (node.width > shrink)
+		{
+			node.x += shrink;
+			node.width -= shrink;
+
+			break;
+		}
+
+		skyline.erase(skyline.begin() + i);
+	}
+
+	// Merge neighbours at the same height.
+	for (size_t i = 1; i < skyline.size();)
+	{
+		if (skyline[i - 1].y == skyline[i].y)
+		{
+			skyline[i - 1].width += skyline[i].width;
+			skyline.erase(skyline.begin() + i);
+		}
+		else
+			i++;
+	}
+}
+
+uint32_t RectPack_Skyline(std::vector<PackRect_s>& rects, const uint32_t binWidth)
+{
+	// Tall rectangles go first, as these leave the least usable gaps behind
+	// when the shorter ones are placed next to them.
+	std::vector<size_t> order(rects.size());
+
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	std::sort(order.begin(), order.end(), [&rects](const size_t a, const size_t b)
+		{
+			if (rects[a].height != rects[b].height)
+				return rects[a].height > rects[b].height;
+
+			if (rects[a].width != rects[b].width)
+				return rects[a].width > rects[b].width;
+
+			return a < b;
+		});
+
+	std::vector<SkylineNode_s> skyline;
+	skyline.push_back({ 0, 0, binWidth });
+
+	uint32_t binHeight = 0;
+
+	for (const size_t rectIndex : order)
+	{
+		PackRect_s& rect = rects[rectIndex];
+
+		size_t bestIndex = SIZE_MAX;
+		uint32_t bestTop = UINT32_MAX;
+		uint32_t bestNodeWidth = UINT32_MAX;
+
+		// Bottom-left; lowest top edge first, then the narrowest segment so
+		// the wider ones remain available for the wider rectangles.
+		for (size_t i = 0; i < skyline.size(); i++)
+		{
+			const uint32_t y = RectPack_FitSkyline(skyline, i, rect.width, binWidth);
+
+			if (y == UINT32_MAX)
+				continue;
+
+			const uint32_t top = y + rect.height;
+
+			if (top < bestTop || (top == bestTop && skyline[i].width < bestNodeWidth))
+			{
+				bestIndex = i;
+				bestTop = top;
+				bestNodeWidth = skyline[i].width;
+			}
+		}
+
+		if (bestIndex == SIZE_MAX)
+			return 0;
+
+		rect.x = skyline[bestIndex].x;
+		rect.y = bestTop - rect.height;
+
+		RectPack_AddSkylineLevel(skyline, bestIndex, rect);
+		binHeight = (std::max)(binHeight, bestTop);
+	}
+
+	return binHeight;
+}
+
+bool RectPack_PackMinArea(std::vector<PackRect_s>& rects, const uint32_t maxSize, const uint32_t heightAlignment,
+	uint32_t& binWidth, uint32_t& binHeight)
+{
+	uint64_t totalArea = 0;
+	uint32_t maxRectWidth = 1;
+	uint32_t maxRectHeight = 1;
+
+	for (const PackRect_s& rect : rects)
+	{
+		totalArea += static_cast<uint64_t>(rect.width) * rect.height;
+
+		maxRectWidth = (std::max)(maxRectWidth, rect.width);
+		maxRectHeight = (std::max)(maxRectHeight, rect.height);
+	}
+
+	uint64_t bestArea = UINT64_MAX;
+	std::vector<PackRect_s> candidate;
+
+	for (uint32_t width = heightAlignment; width <= maxSize; width <<= 1)
+	{
+		if (width < maxRectWidth)
+			continue;
+
+		// Skip the widths that can't possibly beat the best one so far.
+		const uint64_t minHeight = (std::max)(static_cast<uint64_t>(maxRectHeight), (totalArea + width - 1) / width);
+
+		if (width * minHeight >= bestArea)
+			continue;
+
+		candidate = rects;
+		const uint32_t height = IALIGN(RectPack_Skyline(candidate, width), heightAlignment);
+
+		if (height == 0 || height > maxSize)
+			continue;
+
+		const uint64_t area = static_cast<uint64_t>(width) * height;
+
+		if (area < bestArea)
+		{
+			bestArea = area;
+
+			binWidth = width;
+			binHeight = height;
+
+			rects.swap(candidate);
+		}
+	}
+
+	return bestArea != UINT64_MAX;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+struct PackRect_s
+{
+	// Input size of the rectangle, padding included.
+	uint32_t width;
+	uint32_t height;
+
+	// Output position of the rectangle in the bin.
+	uint32_t x;
+	uint32_t y;
+};
+
+// Packs the rectangles into a bin of the given width using a skyline packer
+// with the bottom-left heuristic, the bin grows downwards. The order of the
+// rectangles is kept. Returns the height of the bin, or 0 if a rectangle is
+// wider than the bin.
+extern uint32_t RectPack_Skyline(std::vector<PackRect_s>& rects, const uint32_t binWidth);
+
+// Packs the rectangles into the bin with the smallest area, trying power of
+// two widths up to maxSize. Heights are rounded up to the given alignment.
+// Returns false if the rectangles don't fit in a bin of maxSize x maxSize.
+extern bool RectPack_PackMinArea(std::vector<PackRect_s>& rects, const uint32_t maxSize, const uint32_t heightAlignment,
+	uint32_t& binWidth, uint32_t& binHeight);
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "stringpool.h"
+
+// Totals over all pools that were added since the last StringPool_LogStats.
+static size_t s_stringPoolCount = 0;
+static size_t s_stringPoolUniqueCount = 0;
+static size_t s_stringPoolSize = 0;
+static size_t s_stringPoolTotalSize = 0;
+
+CStringPool::CStringPool()
+	: m_size(0)
+	, m_totalSize(0)
+	, m_totalCount(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: interns the string
+// Input  : &str -
+// Output : offset of the string in the pool
+//-----------------------------------------------------------------------------
+size_t CStringPool::Add(const std::string_view& str)
+{
+	m_totalSize += str.length() + 1;
+	m_totalCount++;
+
+	const auto it = m_offsets.try_emplace(str, m_size);
+
+	if (it.second)
+	{
+		m_strings.push_back(str);
+		m_size += str.length() + 1;
+	}
+
+	return it.first->second;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: finds a string that was interned before
+// Input  : &str -
+// Output : offset of the string in the pool
+//-----------------------------------------------------------------------------
+size_t CStringPool::Find(const std::string_view& str) const
+{
+	const auto it = m_offsets.find(str);
+
+	if (it == m_offsets.end())
+		Error("String \"%.*s\" was not added to the string pool.\n", static_cast<int>(str.length()), str.data());
+
+	return it->second;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: writes the unique strings in the order they were added
+// Input  : *buf -
+//-----------------------------------------------------------------------------
+void CStringPool::Write(char* const buf) const
+{
+	char* cur = buf;
+
+	for (const std::string_view& str : m_strings)
+	{
+		memcpy(cur, str.data(), str.length());
+		cur[str.length()] = '\0';
+
+		cur += str.length() + 1;
+	}
+
+	assert(static_cast<size_t>(cur - buf) == m_size);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: adds the statistics of a pool to the totals
+// Input  : &stats -
+//-----------------------------------------------------------------------------
+void StringPool_AddStats(const StringPoolStats_s& stats)
+{
+	s_stringPoolCount += stats.count;
+	s_stringPoolUniqueCount += stats.uniqueCount;
+	s_stringPoolSize += stats.size;
+	s_stringPoolTotalSize += stats.totalSize;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: logs the dedup ratio of all pools added since the last call
+//-----------------------------------------------------------------------------
+void StringPool_LogStats()
+{
+	if (s_stringPoolCount > s_stringPoolUniqueCount)
+	{
+		Log("*** interned %zu strings into %zu unique ones; %zu -> %zu bytes ( %.2fx ).\n",
+			s_stringPoolCount, s_stringPoolUniqueCount, s_stringPoolTotalSize, s_stringPoolSize,
+			s_stringPoolSize ? static_cast<double>(s_stringPoolTotalSize) / s_stringPoolSize : 0.0);
+	}
+
+	s_stringPoolCount = 0;
+	s_stringPoolUniqueCount = 0;
+	s_stringPoolSize = 0;
+	s_stringPoolTotalSize = 0;
+}
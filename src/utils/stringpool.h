@@ -0,0 +1,56 @@
+#pragma once
+#include <string_view>
+
+// Interning statistics of a pool, see StringPool_AddStats.
+struct StringPoolStats_s
+{
+	size_t count;       // Number of strings that were added.
+	size_t uniqueCount; // Number of strings that are written.
+	size_t size;        // Size of the unique strings.
+	size_t totalSize;   // Size of all strings that were added.
+};
+
+// Interns strings that are written into a single buffer, identical strings
+// are stored once. Offsets are assigned as strings are added, so the size of
+// the buffer is known before it is allocated. Strings aren't copied, these
+// must outlive the pool.
+class CStringPool
+{
+public:
+	CStringPool();
+
+	// Returns the offset of the null terminated string in the pool, adding it
+	// if it isn't in there yet.
+	size_t Add(const std::string_view& str);
+
+	// Returns the offset of a string that was added before, errors if it
+	// wasn't.
+	size_t Find(const std::string_view& str) const;
+
+	// Writes all unique strings into the buffer, which must be at least
+	// GetSize() bytes.
+	void Write(char* const buf) const;
+
+	// Size of the unique strings, including their null terminators.
+	inline size_t GetSize() const { return m_size; };
+
+	// Size the strings would have taken without interning.
+	inline size_t GetTotalSize() const { return m_totalSize; };
+
+	inline StringPoolStats_s GetStats() const { return { m_totalCount, m_strings.size(), m_size, m_totalSize }; };
+
+private:
+	std::unordered_map<std::string_view, size_t> m_offsets;
+	std::vector<std::string_view> m_strings;
+
+	size_t m_size;
+	size_t m_totalSize;
+	size_t m_totalCount;
+};
+
+// Adds the pool to the totals of StringPool_LogStats, this should be done once
+// for each pool that ends up in the pak.
+extern void StringPool_AddStats(const StringPoolStats_s& stats);
+
+// Logs how much string data was saved by interning since the last call.
+extern void StringPool_LogStats();